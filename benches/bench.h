@@ -0,0 +1,56 @@
+/*
+ * Shared helpers for the benchmarks in this directory.
+ * Include before anything else so the POSIX clock is declared and lepk_file gets a 64 bit off_t.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif /* _GNU_SOURCE */
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif /* _FILE_OFFSET_BITS */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Monotonic time in nanoseconds. */
+static inline unsigned long long bench_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ull + (unsigned long long) ts.tv_nsec;
+}
+
+static inline int bench_compare_u64(const void *a, const void *b) {
+	unsigned long long x = *(const unsigned long long *) a;
+	unsigned long long y = *(const unsigned long long *) b;
+	return (x > y) - (x < y);
+}
+
+/* Sort samples and return the p-th percentile (0-100). */
+static inline unsigned long long bench_percentile(unsigned long long *samples, unsigned long count, double p) {
+	qsort(samples, count, sizeof(unsigned long long), bench_compare_u64);
+	unsigned long index = (unsigned long) (p / 100.0 * (double) (count - 1));
+	return samples[index];
+}
+
+/* Cheap deterministic pseudo random numbers (xorshift64*). */
+static inline unsigned long long bench_rand(unsigned long long *state) {
+	unsigned long long x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 2685821657736338717ull;
+}
+
+/* Size parameter from the environment, falls back to def. */
+static inline unsigned long bench_param(const char *name, unsigned long def) {
+	const char *value = getenv(name);
+	return value != NULL ? strtoul(value, NULL, 10) : def;
+}
+
+#endif /* BENCH_H */
@@ -0,0 +1,97 @@
+#include "bench.h"
+
+#include <malloc.h>
+#include <string.h>
+
+#define LEPK_HT_IMPLEMENTATION
+#include "lepk_ht.h"
+#define LEPK_ART_IMPLEMENTATION
+#include "lepk_art.h"
+
+/* Keys inline in the hash table, hashed up to the terminator. */
+typedef struct {
+	char text[32];
+} Path;
+
+/* Heap bytes in use, including blocks big enough to be mmap'd. */
+static size_t heap_bytes(void) {
+	struct mallinfo2 info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+}
+
+int main(void) {
+	unsigned long count = bench_param("BENCH_COUNT", 1ul << 20);
+	unsigned long lookups = bench_param("BENCH_LOOKUPS", 1ul << 22);
+
+	printf("== lepk_art (%lu path keys, %lu lookups) ==\n", count, lookups);
+
+	/* File paths, sharing directories like real ones do. */
+	Path *paths = calloc(count, sizeof(Path));
+	size_t *lengths = malloc(count * sizeof(size_t));
+	for (unsigned long i = 0; i < count; i++) {
+		lengths[i] = sprintf(paths[i].text, "/data/%02lx/%lu/%lu.bin", i % 251, i / 251 % 64, i);
+	}
+	unsigned long *probes = malloc(lookups * sizeof(unsigned long));
+	unsigned long long state = 17;
+	for (unsigned long i = 0; i < lookups; i++) {
+		probes[i] = bench_rand(&state) % count;
+	}
+
+	size_t before = heap_bytes();
+	unsigned long long start = bench_now();
+	LepkArt *art = lepk_art_create(sizeof(unsigned long));
+	for (unsigned long i = 0; i < count; i++) {
+		lepk_art_set(art, paths[i].text, lengths[i], &i);
+	}
+	unsigned long long art_build = bench_now() - start;
+	size_t art_bytes = heap_bytes() - before;
+
+	before = heap_bytes();
+	start = bench_now();
+	LepkHt *table = lepk_ht_create(lepk_ht_hash_string, lepk_ht_compare_string, sizeof(Path), sizeof(unsigned long));
+	for (unsigned long i = 0; i < count; i++) {
+		lepk__ht_set(table, &paths[i], &i);
+	}
+	unsigned long long ht_build = bench_now() - start;
+	size_t ht_bytes = heap_bytes() - before;
+
+	unsigned long sum = 0;
+	start = bench_now();
+	for (unsigned long i = 0; i < lookups; i++) {
+		unsigned long p = probes[i];
+		sum += *(unsigned long *) lepk_art_find(art, paths[p].text, lengths[p]);
+	}
+	unsigned long long art_time = bench_now() - start;
+
+	start = bench_now();
+	for (unsigned long i = 0; i < lookups; i++) {
+		sum -= *(unsigned long *) lepk_ht_find(table, &paths[probes[i]]);
+	}
+	unsigned long long ht_time = bench_now() - start;
+
+	/* Paths below an existing key, answered by the deepest key on the way down. */
+	char query[64];
+	start = bench_now();
+	for (unsigned long i = 0; i < lookups; i++) {
+		unsigned long p = probes[i];
+		memcpy(query, paths[p].text, lengths[p]);
+		memcpy(query + lengths[p], "/x", 2);
+		sum += *(unsigned long *) lepk_art_longest_prefix(art, query, lengths[p] + 2, NULL);
+	}
+	unsigned long long prefix_time = bench_now() - start;
+
+	printf("%-16s %8s %14s %12s %10s\n", "", "build ms", "bytes/key", "lookup ns", "Mlookup/s");
+	printf("%-16s %8.2f %14.2f %12.2f %10.2f\n", "lepk_art", art_build / 1e6, (double) art_bytes / count,
+			(double) art_time / lookups, lookups / (art_time / 1e3));
+	printf("%-16s %8.2f %14.2f %12.2f %10.2f\n", "lepk_ht", ht_build / 1e6, (double) ht_bytes / count,
+			(double) ht_time / lookups, lookups / (ht_time / 1e3));
+	printf("%-16s %8s %14s %12.2f %10.2f  (checksum %lu)\n", "longest prefix", "", "",
+			(double) prefix_time / lookups, lookups / (prefix_time / 1e3), sum);
+
+	lepk_ht_destroy(table);
+	lepk_art_destroy(art);
+	free(probes);
+	free(lengths);
+	free(paths);
+	return 0;
+}
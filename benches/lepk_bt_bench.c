@@ -0,0 +1,150 @@
+#include "bench.h"
+
+#include <stdint.h>
+
+#define LEPK_DA_IMPLEMENTATION
+#include "lepk_da.h"
+#define LEPK_HT_IMPLEMENTATION
+#include "lepk_ht.h"
+#define LEPK_BT_IMPLEMENTATION
+#include "lepk_bt.h"
+
+typedef struct {
+	int32_t key;
+	int32_t data;
+} Pair;
+
+static int compare_pair(const void *a, const void *b) {
+	int32_t x = ((const Pair *) a)->key;
+	int32_t y = ((const Pair *) b)->key;
+	return (x > y) - (x < y);
+}
+
+/* Distinct keys in scattered order, multiplying by an odd constant is a bijection on 32 bits. */
+static int32_t key_at(unsigned long i) {
+	return (int32_t) (uint32_t) (i * 2654435761u);
+}
+
+/* Random point lookups, every key present. */
+static void bench_lookup(unsigned long count, unsigned long lookups) {
+	unsigned long long start = bench_now();
+	LepkBt *tree = lepk_bt_create(lepk_bt_compare_int32, sizeof(int32_t), sizeof(int32_t));
+	for (unsigned long i = 0; i < count; i++) {
+		int32_t key = key_at(i);
+		lepk__bt_set(tree, &key, &key);
+	}
+	unsigned long long tree_build = bench_now() - start;
+
+	start = bench_now();
+	LepkHt *table = lepk_ht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int32_t), sizeof(int32_t));
+	for (unsigned long i = 0; i < count; i++) {
+		int32_t key = key_at(i);
+		lepk__ht_set(table, &key, &key);
+	}
+	unsigned long long table_build = bench_now() - start;
+
+	int32_t *probes = malloc(lookups * sizeof(int32_t));
+	unsigned long long state = 3;
+	for (unsigned long i = 0; i < lookups; i++) {
+		probes[i] = key_at(bench_rand(&state) % count);
+	}
+
+	long sum = 0;
+	start = bench_now();
+	for (unsigned long i = 0; i < lookups; i++) {
+		sum += *(int32_t *) lepk_bt_find(tree, &probes[i]);
+	}
+	unsigned long long tree_time = bench_now() - start;
+
+	start = bench_now();
+	for (unsigned long i = 0; i < lookups; i++) {
+		sum -= *(int32_t *) lepk_ht_find(table, &probes[i]);
+	}
+	unsigned long long table_time = bench_now() - start;
+
+	printf("%-10s %10s %12s %14s\n", "lookup", "build ms", "lookup ns", "bytes/pair");
+	printf("%-10s %10.2f %12.2f %14.2f\n", "lepk_bt", tree_build / 1e6, (double) tree_time / lookups, (double) lepk_bt_bytes(tree) / count);
+	printf("%-10s %10.2f %12.2f %14s  (checksum %ld)\n", "lepk_ht", table_build / 1e6, (double) table_time / lookups, "-", sum);
+
+	free(probes);
+	lepk_ht_destroy(table);
+	lepk_bt_destroy(tree);
+}
+
+/*
+ * Pairs arrive in batches and ranges are queried between batches.
+ * The sorted array has to be sorted again after every batch, the tree is always in order.
+ */
+static void bench_ranges(unsigned long count, unsigned long batch, unsigned long ranges, unsigned long length) {
+	/* Keys are spread over all of int32_t, a range spans about length of them. */
+	int64_t width = (int64_t) ((1ull << 32) / count * length);
+	long sums[2] = { 0, 0 };
+	unsigned long long times[2];
+
+	for (int mode = 0; mode < 2; mode++) {
+		/* Same ranges for both. */
+		unsigned long long state = 9;
+		LepkBt *tree = lepk_bt_create(lepk_bt_compare_int32, sizeof(int32_t), sizeof(int32_t));
+		Pair *sorted = lepk_da_create(sizeof(Pair));
+
+		unsigned long long start = bench_now();
+		for (unsigned long done = 0; done < count; done += batch) {
+			for (unsigned long i = done; i < done + batch && i < count; i++) {
+				Pair pair = { key_at(i), (int32_t) i };
+				if (mode == 0) {
+					lepk__bt_set(tree, &pair.key, &pair.data);
+				} else {
+					lepk_da_push(sorted, pair);
+				}
+			}
+			if (mode == 1) {
+				qsort(sorted, lepk_da_count(sorted), sizeof(Pair), compare_pair);
+			}
+
+			for (unsigned long r = 0; r < ranges; r++) {
+				int32_t low = (int32_t) (uint32_t) bench_rand(&state);
+				int32_t high = low + width > INT32_MAX ? INT32_MAX : (int32_t) (low + width);
+				if (mode == 0) {
+					LepkBtIterator iterator = lepk_bt_lower_bound(tree, low);
+					const int32_t *key;
+					int32_t *data;
+					while (lepk_bt_next(&iterator, (const void **) &key, (void **) &data) && *key < high) {
+						sums[0] += *data;
+					}
+				} else {
+					unsigned long first = 0;
+					unsigned long last = lepk_da_count(sorted);
+					while (first < last) {
+						unsigned long middle = (first + last) / 2;
+						if (sorted[middle].key < low) {
+							first = middle + 1;
+						} else {
+							last = middle;
+						}
+					}
+					for (; first < lepk_da_count(sorted) && sorted[first].key < high; first++) {
+						sums[1] += sorted[first].data;
+					}
+				}
+			}
+		}
+		times[mode] = bench_now() - start;
+
+		lepk_da_destroy(sorted);
+		lepk_bt_destroy(tree);
+	}
+
+	printf("ranges     %lu pairs in batches of %lu, %lu ranges of ~%lu pairs per batch\n", count, batch, ranges, length);
+	printf("%-10s %10.2f ms  (sum %ld)\n", "lepk_bt", times[0] / 1e6, sums[0]);
+	printf("%-10s %10.2f ms  (sum %ld)\n", "sort+scan", times[1] / 1e6, sums[1]);
+}
+
+int main(void) {
+	unsigned long count = bench_param("BENCH_COUNT", 1ul << 20);
+
+	printf("== lepk_bt (%lu int32 keys) ==\n", count);
+	bench_lookup(count, bench_param("BENCH_LOOKUPS", 1ul << 22));
+	bench_ranges(count, bench_param("BENCH_BATCH", 1ul << 14), bench_param("BENCH_RANGES", 64), bench_param("BENCH_RANGE_LENGTH", 100));
+
+	return 0;
+}
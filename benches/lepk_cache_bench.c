@@ -0,0 +1,128 @@
+#include "bench.h"
+
+#include <math.h>
+#include <pthread.h>
+
+#define LEPK_HT_IMPLEMENTATION
+#include "lepk_ht.h"
+#define LEPK_CACHE_IMPLEMENTATION
+#include "lepk_cache.h"
+
+/* Keys drawn from a Zipfian distribution over [0, keys), inverse transform sampling on the cumulative weights. */
+static unsigned int *zipf_stream(unsigned long keys, unsigned long count, double s, unsigned long long seed) {
+	double *cdf = malloc(keys * sizeof(double));
+	double sum = 0.0;
+	for (unsigned long i = 0; i < keys; i++) {
+		sum += 1.0 / pow((double) (i + 1), s);
+		cdf[i] = sum;
+	}
+
+	unsigned int *stream = malloc(count * sizeof(unsigned int));
+	for (unsigned long i = 0; i < count; i++) {
+		double u = (double) (bench_rand(&seed) >> 11) / (double) (1ull << 53) * sum;
+		unsigned long low = 0;
+		unsigned long high = keys - 1;
+		while (low < high) {
+			unsigned long mid = (low + high) / 2;
+			if (cdf[mid] < u) {
+				low = mid + 1;
+			} else {
+				high = mid;
+			}
+		}
+		/* Scatter ranks so popular keys aren't neighbours. */
+		stream[i] = (unsigned int) (low * 2654435761u);
+	}
+
+	free(cdf);
+	return stream;
+}
+
+/* Look up every key, putting it on a miss like a read-through cache would. */
+static void bench_policy(const unsigned int *stream, unsigned long count, LepkCachePolicy policy, unsigned long budget) {
+	LepkCache *cache = lepk_cache_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned int), sizeof(unsigned long), policy, budget);
+
+	unsigned long long start = bench_now();
+	for (unsigned long i = 0; i < count; i++) {
+		if (lepk_cache_get(cache, &stream[i]) == NULL) {
+			unsigned long value = stream[i];
+			lepk__cache_put(cache, &stream[i], &value);
+		}
+	}
+	unsigned long long elapsed = bench_now() - start;
+
+	LepkCacheStats stats;
+	lepk_cache_stats(cache, &stats);
+	printf("%-6s budget %-8lu  hit ratio %6.2f%%  %7.2f ns/op  (%lu evictions)\n",
+			policy == LEPK_CACHE_LRU ? "lru" : "clock", budget, 100.0 * stats.hits / count, (double) elapsed / count, stats.evictions);
+
+	lepk_cache_destroy(cache);
+}
+
+typedef struct {
+	LepkCacheSharded *cache;
+	const unsigned int *stream;
+	unsigned long count;
+} Worker;
+
+static void *bench_worker(void *arg) {
+	Worker *worker = arg;
+	for (unsigned long i = 0; i < worker->count; i++) {
+		unsigned long value;
+		if (!lepk__cache_sharded_get(worker->cache, &worker->stream[i], &value)) {
+			value = worker->stream[i];
+			lepk__cache_sharded_put(worker->cache, &worker->stream[i], &value, 1);
+		}
+	}
+	return NULL;
+}
+
+/* Threads each replaying their own part of the stream against one shared cache. */
+static void bench_sharded(const unsigned int *stream, unsigned long count, LepkCachePolicy policy, unsigned long budget, unsigned long threads) {
+	LepkCacheSharded *cache = lepk_cache_sharded_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned int), sizeof(unsigned long), policy, budget);
+	pthread_t *ids = malloc(threads * sizeof(pthread_t));
+	Worker *workers = malloc(threads * sizeof(Worker));
+
+	unsigned long long start = bench_now();
+	for (unsigned long i = 0; i < threads; i++) {
+		workers[i].cache = cache;
+		workers[i].stream = stream + i * (count / threads);
+		workers[i].count = count / threads;
+		pthread_create(&ids[i], NULL, bench_worker, &workers[i]);
+	}
+	for (unsigned long i = 0; i < threads; i++) {
+		pthread_join(ids[i], NULL);
+	}
+	unsigned long long elapsed = bench_now() - start;
+
+	LepkCacheStats stats;
+	lepk_cache_sharded_stats(cache, &stats);
+	printf("%-6s sharded %2lu threads  hit ratio %6.2f%%  %7.2f Mops/s\n",
+			policy == LEPK_CACHE_LRU ? "lru" : "clock", threads, 100.0 * stats.hits / (stats.hits + stats.misses), (count / threads * threads) / (elapsed / 1e3));
+
+	free(workers);
+	free(ids);
+	lepk_cache_sharded_destroy(cache);
+}
+
+int main(void) {
+	unsigned long keys = bench_param("BENCH_KEYS", 1ul << 20);
+	unsigned long count = bench_param("BENCH_OPS", 1ul << 23);
+	/* Skew times 100, 99 is the classic web cache workload. */
+	double s = bench_param("BENCH_ZIPF", 99) / 100.0;
+
+	printf("== lepk_cache (%lu ops over %lu keys, zipf %.2f) ==\n", count, keys, s);
+	unsigned int *stream = zipf_stream(keys, count, s, 13);
+
+	for (unsigned long percent = 1; percent <= 10; percent *= 10) {
+		bench_policy(stream, count, LEPK_CACHE_LRU, keys * percent / 100);
+		bench_policy(stream, count, LEPK_CACHE_CLOCK, keys * percent / 100);
+	}
+	for (unsigned long threads = 1; threads <= 8; threads *= 2) {
+		bench_sharded(stream, count, LEPK_CACHE_LRU, keys / 10, threads);
+		bench_sharded(stream, count, LEPK_CACHE_CLOCK, keys / 10, threads);
+	}
+
+	free(stream);
+	return 0;
+}
@@ -0,0 +1,116 @@
+#include "bench.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define LEPK_HT_IMPLEMENTATION
+#include "lepk_ht.h"
+#define LEPK_CHT_IMPLEMENTATION
+#include "lepk_cht.h"
+
+typedef struct {
+	LepkCht *cht;
+	LepkHt *ht;
+	pthread_mutex_t *lock;
+	unsigned long keys;
+	unsigned long ops;
+	/* Percentage of operations that are reads. */
+	unsigned long read_percent;
+	unsigned long long seed;
+} Worker;
+
+static void *worker_run(void *arg) {
+	Worker *worker = arg;
+	unsigned long long state = worker->seed;
+	unsigned long output = 0;
+
+	for (unsigned long i = 0; i < worker->ops; i++) {
+		unsigned long long r = bench_rand(&state);
+		unsigned long key = (unsigned long) (r >> 8) % worker->keys;
+		bool read = (r & 0xff) % 100 < worker->read_percent;
+
+		if (worker->cht != NULL) {
+			if (read) {
+				lepk__cht_get(worker->cht, &key, &output);
+			} else {
+				lepk__cht_set(worker->cht, &key, &i);
+			}
+		} else {
+			pthread_mutex_lock(worker->lock);
+			if (read) {
+				lepk__ht_get(worker->ht, &key, &output);
+			} else {
+				lepk__ht_set(worker->ht, &key, &i);
+			}
+			pthread_mutex_unlock(worker->lock);
+		}
+	}
+
+	return NULL;
+}
+
+/* Throughput in million operations per second. */
+static double bench_run(bool concurrent, unsigned long threads, unsigned long keys, unsigned long ops, unsigned long read_percent) {
+	LepkCht *cht = NULL;
+	LepkHt *ht = NULL;
+	pthread_mutex_t lock;
+	pthread_mutex_init(&lock, NULL);
+
+	if (concurrent) {
+		cht = lepk_cht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned long), sizeof(unsigned long));
+	} else {
+		ht = lepk_ht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned long), sizeof(unsigned long));
+	}
+	for (unsigned long i = 0; i < keys; i++) {
+		if (concurrent) {
+			lepk__cht_set(cht, &i, &i);
+		} else {
+			lepk__ht_set(ht, &i, &i);
+		}
+	}
+
+	pthread_t *handles = malloc(threads * sizeof(pthread_t));
+	Worker *workers = malloc(threads * sizeof(Worker));
+	unsigned long long start = bench_now();
+	for (unsigned long i = 0; i < threads; i++) {
+		workers[i] = (Worker) { cht, ht, &lock, keys, ops, read_percent, 0x9e3779b97f4a7c15ull * (i + 1) };
+		pthread_create(&handles[i], NULL, worker_run, &workers[i]);
+	}
+	for (unsigned long i = 0; i < threads; i++) {
+		pthread_join(handles[i], NULL);
+	}
+	unsigned long long elapsed = bench_now() - start;
+
+	free(handles);
+	free(workers);
+	if (concurrent) {
+		lepk_cht_destroy(cht);
+	} else {
+		lepk_ht_destroy(ht);
+	}
+	pthread_mutex_destroy(&lock);
+
+	return (double) (threads * ops) / (elapsed / 1e3);
+}
+
+static void bench_scaling(const char *name, unsigned long max_threads, unsigned long keys, unsigned long ops, unsigned long read_percent) {
+	printf("%s (%lu%% reads)\n", name, read_percent);
+	printf("  threads  lepk_ht+mutex Mops/s  lepk_cht Mops/s\n");
+	for (unsigned long threads = 1; threads <= max_threads; threads *= 2) {
+		double locked = bench_run(false, threads, keys, ops, read_percent);
+		double concurrent = bench_run(true, threads, keys, ops, read_percent);
+		printf("  %7lu  %20.2f  %15.2f\n", threads, locked, concurrent);
+	}
+}
+
+int main(void) {
+	unsigned long keys = bench_param("BENCH_KEYS", 1ul << 20);
+	unsigned long ops = bench_param("BENCH_OPS", 1ul << 21);
+	unsigned long max_threads = bench_param("BENCH_THREADS", (unsigned long) sysconf(_SC_NPROCESSORS_ONLN));
+
+	printf("== lepk_cht (%lu keys, %lu ops per thread) ==\n", keys, ops);
+	bench_scaling("read heavy", max_threads, keys, ops, 95);
+	bench_scaling("mixed", max_threads, keys, ops, 50);
+
+	return 0;
+}
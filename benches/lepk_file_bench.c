@@ -0,0 +1,452 @@
+#include "bench.h"
+
+#include <malloc.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LEPK_FILE_IMPLEMENTATION
+#include "lepk_file.h"
+
+/* Sum of every 8 byte word, so every page has to be read. */
+static uint64_t checksum(const char *data, uint64_t length) {
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(uint64_t));
+		sum += word;
+	}
+	return sum;
+}
+
+/* Scan a whole file, read into one buffer against mapped. Runs twice and reports the second, warm page cache run. */
+static void bench_map(unsigned long megabytes) {
+	unsigned long length = megabytes << 20;
+	char *content = malloc(length);
+	unsigned long long state = 1;
+	for (unsigned long i = 0; i < length; i += sizeof(unsigned long long)) {
+		unsigned long long word = bench_rand(&state);
+		memcpy(content + i, &word, sizeof(word));
+	}
+	lepk_file_write("lepk_file_bench.bin", content, length, LEPK_FILE_MODE_BINARY);
+	free(content);
+
+	unsigned long long times[2];
+	uint64_t sums[2];
+	for (int run = 0; run < 2; run++) {
+		unsigned long long start = bench_now();
+		char *buffer = lepk_file_read("lepk_file_bench.bin", NULL);
+		sums[0] = checksum(buffer, length);
+		free(buffer);
+		times[0] = bench_now() - start;
+
+		start = bench_now();
+		LepkFileView view;
+		lepk_file_map("lepk_file_bench.bin", LEPK_FILE_ADVICE_SEQUENTIAL, &view);
+		sums[1] = checksum(view.data, view.length);
+		lepk_file_unmap(&view);
+		times[1] = bench_now() - start;
+	}
+
+	printf("scan %lu MiB   read %7.2f GB/s   map %7.2f GB/s   %s\n", megabytes,
+			(double) length / times[0], (double) length / times[1], sums[0] == sums[1] ? "(sums match)" : "(SUMS DIFFER)");
+	lepk_file_remove("lepk_file_bench.bin");
+}
+
+/* Append short log-like records one at a time, reopening the file per record against one open writer. */
+static void bench_append(unsigned long records) {
+	char record[64];
+	unsigned long long times[3];
+
+	lepk_file_create("lepk_file_bench.log");
+	unsigned long long start = bench_now();
+	for (unsigned long i = 0; i < records; i++) {
+		int length = snprintf(record, sizeof(record), "%lu request handled\n", i);
+		lepk_file_append("lepk_file_bench.log", record, length, LEPK_FILE_MODE_BINARY);
+	}
+	times[0] = bench_now() - start;
+
+	/* Same records, each as a number and a message fragment. */
+	for (int run = 1; run < 3; run++) {
+		start = bench_now();
+		LepkFileWriter *writer = lepk_file_writer_open("lepk_file_bench.log", false, 0, NULL);
+		for (unsigned long i = 0; i < records; i++) {
+			int length = snprintf(record, sizeof(record), "%lu", i);
+			if (run == 1) {
+				lepk_file_writer_write(writer, record, length);
+				lepk_file_writer_write(writer, " request handled\n", 17);
+			} else {
+				LepkFileFragment fragments[] = { { record, length }, { " request handled\n", 17 } };
+				lepk_file_writer_writev(writer, fragments, 2);
+			}
+		}
+		lepk_file_writer_close(writer);
+		times[run] = bench_now() - start;
+	}
+
+	printf("append %lu records   lepk_file_append %8.2f ns/record   writer %6.2f ns/record   writev %6.2f ns/record\n", records,
+			(double) times[0] / records, (double) times[1] / records, (double) times[2] / records);
+	lepk_file_remove("lepk_file_bench.log");
+}
+
+/* Heap bytes in use, including blocks big enough to be mmap'd. */
+static size_t heap_bytes(void) {
+	struct mallinfo2 info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+}
+
+/* Count lines of a log-like file, loaded whole and split with memchr against streamed through a reader. */
+static void bench_lines(unsigned long megabytes) {
+	unsigned long length = megabytes << 20;
+	char *content = malloc(length);
+	unsigned long long state = 3;
+	for (unsigned long i = 0; i < length; i++) {
+		/* Lines of 20 to 200 characters. */
+		unsigned long line = 20 + bench_rand(&state) % 180;
+		for (unsigned long j = 0; j < line && i < length; j++, i++) {
+			content[i] = 'a' + (char) (j % 26);
+		}
+		if (i < length) {
+			content[i] = '\n';
+		}
+	}
+	lepk_file_write("lepk_file_bench.log", content, length, LEPK_FILE_MODE_BINARY);
+	free(content);
+
+	size_t before = heap_bytes();
+	unsigned long long start = bench_now();
+	char *buffer = lepk_file_read("lepk_file_bench.log", NULL);
+	size_t read_bytes = heap_bytes() - before;
+	unsigned long read_lines = 0;
+	for (const char *line = buffer, *end = buffer + length; line < end; read_lines++) {
+		const char *found = memchr(line, '\n', end - line);
+		line = found != NULL ? found + 1 : end;
+	}
+	free(buffer);
+	unsigned long long read_time = bench_now() - start;
+	printf("lines %lu MiB   read+memchr        %7.2f GB/s   %9zu heap bytes   %lu lines\n", megabytes, (double) length / read_time, read_bytes, read_lines);
+
+	for (int read_ahead = 0; read_ahead < 2; read_ahead++) {
+		before = heap_bytes();
+		start = bench_now();
+		LepkFileReader *reader = lepk_file_reader_open("lepk_file_bench.log", 0, read_ahead, NULL);
+		const char *line;
+		unsigned long line_length;
+		unsigned long lines = 0;
+		size_t reader_bytes = 0;
+		while (lepk_file_reader_line(reader, '\n', &line, &line_length)) {
+			if (lines++ == 0) {
+				reader_bytes = heap_bytes() - before;
+			}
+		}
+		lepk_file_reader_close(reader);
+		unsigned long long time = bench_now() - start;
+		printf("lines %lu MiB   reader%-12s %7.2f GB/s   %9zu heap bytes   %lu lines\n", megabytes, read_ahead ? " read ahead" : "",
+				(double) length / time, reader_bytes, lines);
+	}
+
+	lepk_file_remove("lepk_file_bench.log");
+}
+
+/* Read many small files one by one with lepk_file_read against batched, on a thread pool and on io_uring where available. */
+static void bench_batch(unsigned long files) {
+	mkdir("lepk_file_bench_files", 0755);
+	char (*paths)[48] = malloc(files * sizeof(*paths));
+	char content[4096];
+	unsigned long long state = 9;
+	for (unsigned long i = 0; i < sizeof(content); i++) {
+		content[i] = 'a' + (char) (bench_rand(&state) % 26);
+	}
+	unsigned long total = 0;
+	for (unsigned long i = 0; i < files; i++) {
+		snprintf(paths[i], sizeof(paths[i]), "lepk_file_bench_files/%lu.txt", i);
+		/* 256 bytes to 4 KiB, config or JSON sized. */
+		unsigned long length = 256 + bench_rand(&state) % 3841;
+		lepk_file_write(paths[i], content, length, LEPK_FILE_MODE_BINARY);
+		total += length;
+	}
+
+	char *buffers = malloc(files * 4096);
+	LepkFileBatchRead *reads = malloc(files * sizeof(LepkFileBatchRead));
+	for (unsigned long i = 0; i < files; i++) {
+		reads[i].filepath = paths[i];
+		reads[i].buffer = buffers + i * 4096;
+		reads[i].capacity = 4096;
+	}
+	/* Untimed pass, so no mode pays for faulting the buffers in or filling the caches. */
+	lepk_file_read_batch(reads, files, 1);
+
+	unsigned long long start = bench_now();
+	unsigned long read_total = 0;
+	for (unsigned long i = 0; i < files; i++) {
+		char *buffer = lepk_file_read(paths[i], NULL);
+		read_total += strlen(buffer);
+		free(buffer);
+	}
+	unsigned long long read_time = bench_now() - start;
+	printf("batch %lu files   lepk_file_read     %8.2f us/file   %s\n", files, read_time / 1e3 / files, read_total == total ? "(lengths match)" : "(LENGTHS DIFFER)");
+
+	unsigned long modes[] = { 1, LEPK_FILE_BATCH_THREADS, 0 };
+	for (int mode = 0; mode < 3; mode++) {
+		start = bench_now();
+		LepkFileStatus status = lepk_file_read_batch(reads, files, modes[mode]);
+		unsigned long long time = bench_now() - start;
+
+		unsigned long batch_total = 0;
+		for (unsigned long i = 0; i < files; i++) {
+			batch_total += reads[i].length;
+		}
+		printf("batch %lu files   %-18s %8.2f us/file   %s\n", files, mode == 0 ? "batch 1 thread" : mode == 1 ? "batch threads" : "batch io_uring",
+				time / 1e3 / files, status == LEPK_FILE_STATUS_OK && batch_total == total ? "(lengths match)" : "(LENGTHS DIFFER)");
+	}
+
+	for (unsigned long i = 0; i < files; i++) {
+		lepk_file_remove(paths[i]);
+	}
+	rmdir("lepk_file_bench_files");
+	free(reads);
+	free(buffers);
+	free(paths);
+}
+
+/* Load a whole file with lepk_file_read against lepk_file_read_parallel at growing thread counts. Warm page cache. */
+static void bench_parallel(unsigned long megabytes) {
+	uint64_t length = (uint64_t) megabytes << 20;
+	LepkFileWriter *writer = lepk_file_writer_open("lepk_file_bench.bin", false, 0, NULL);
+	unsigned long long state = 11;
+	unsigned long long block[4096];
+	for (uint64_t written = 0; written < length; written += sizeof(block)) {
+		for (unsigned long i = 0; i < 4096; i++) {
+			block[i] = bench_rand(&state);
+		}
+		lepk_file_writer_write(writer, block, sizeof(block));
+	}
+	lepk_file_writer_close(writer);
+
+	unsigned long long start = bench_now();
+	char *buffer = lepk_file_read("lepk_file_bench.bin", NULL);
+	uint64_t expected = checksum(buffer, length);
+	free(buffer);
+	unsigned long long time = bench_now() - start;
+	printf("load %lu MiB   lepk_file_read             %7.2f GB/s\n", megabytes, (double) length / time);
+
+	for (int huge_pages = 0; huge_pages < 2; huge_pages++) {
+		for (unsigned long threads = 1; threads <= 8; threads *= 2) {
+			start = bench_now();
+			LepkFileView view;
+			lepk_file_read_parallel("lepk_file_bench.bin", threads, huge_pages, &view);
+			uint64_t sum = checksum(view.data, view.length);
+			lepk_file_unmap(&view);
+			time = bench_now() - start;
+			printf("load %lu MiB   parallel %lu thread%s%-11s %7.2f GB/s   %s\n", megabytes, threads, threads == 1 ? " " : "s",
+					huge_pages ? " huge" : "", (double) length / time, sum == expected ? "(sums match)" : "(SUMS DIFFER)");
+		}
+	}
+	lepk_file_remove("lepk_file_bench.bin");
+}
+
+/* Copy and concatenate files through user space with lepk_file_read and lepk_file_write against the kernel copies. */
+static void bench_copy(unsigned long megabytes) {
+	uint64_t length = (uint64_t) megabytes << 20;
+	LepkFileWriter *writer = lepk_file_writer_open("lepk_file_bench.bin", false, 0, NULL);
+	unsigned long long state = 13;
+	unsigned long long block[4096];
+	for (uint64_t written = 0; written < length; written += sizeof(block)) {
+		for (unsigned long i = 0; i < 4096; i++) {
+			block[i] = bench_rand(&state);
+		}
+		lepk_file_writer_write(writer, block, sizeof(block));
+	}
+	lepk_file_writer_close(writer);
+
+	unsigned long long start = bench_now();
+	char *buffer = lepk_file_read("lepk_file_bench.bin", NULL);
+	lepk_file_write("lepk_file_bench.copy", buffer, length, LEPK_FILE_MODE_BINARY);
+	free(buffer);
+	unsigned long long read_time = bench_now() - start;
+	lepk_file_remove("lepk_file_bench.copy");
+
+	start = bench_now();
+	lepk_file_copy("lepk_file_bench.bin", "lepk_file_bench.copy");
+	unsigned long long copy_time = bench_now() - start;
+
+	LepkFileView original;
+	LepkFileView copy;
+	lepk_file_map("lepk_file_bench.bin", LEPK_FILE_ADVICE_SEQUENTIAL, &original);
+	lepk_file_map("lepk_file_bench.copy", LEPK_FILE_ADVICE_SEQUENTIAL, &copy);
+	bool same = checksum(original.data, original.length) == checksum(copy.data, copy.length);
+	lepk_file_unmap(&copy);
+	lepk_file_unmap(&original);
+	printf("copy %lu MiB     read+write %7.2f GB/s   lepk_file_copy   %7.2f GB/s   %s\n", megabytes,
+			(double) length / read_time, (double) length / copy_time, same ? "(sums match)" : "(SUMS DIFFER)");
+
+	/* The file four times over. */
+	const char *parts[] = { "lepk_file_bench.bin", "lepk_file_bench.copy", "lepk_file_bench.bin", "lepk_file_bench.copy" };
+	start = bench_now();
+	lepk_file_create("lepk_file_bench.joined");
+	for (int i = 0; i < 4; i++) {
+		buffer = lepk_file_read(parts[i], NULL);
+		lepk_file_append("lepk_file_bench.joined", buffer, length, LEPK_FILE_MODE_BINARY);
+		free(buffer);
+	}
+	read_time = bench_now() - start;
+	lepk_file_remove("lepk_file_bench.joined");
+
+	start = bench_now();
+	lepk_file_concat("lepk_file_bench.joined", parts, 4);
+	copy_time = bench_now() - start;
+	printf("concat 4x%lu MiB read+append %6.2f GB/s   lepk_file_concat %7.2f GB/s\n", megabytes,
+			(double) length * 4 / read_time, (double) length * 4 / copy_time);
+
+	lepk_file_remove("lepk_file_bench.joined");
+	lepk_file_remove("lepk_file_bench.copy");
+	lepk_file_remove("lepk_file_bench.bin");
+}
+
+/* Replace small files in place, atomically at each durability level, and atomically in one group commit. */
+static void bench_atomic(unsigned long writes) {
+	char content[4096];
+	memset(content, 'x', sizeof(content));
+	char (*paths)[48] = malloc(writes * sizeof(*paths));
+	for (unsigned long i = 0; i < writes; i++) {
+		snprintf(paths[i], sizeof(paths[i]), "lepk_file_bench_%lu.json", i);
+	}
+
+	unsigned long long start = bench_now();
+	for (unsigned long i = 0; i < writes; i++) {
+		lepk_file_write(paths[i], content, sizeof(content), LEPK_FILE_MODE_BINARY);
+	}
+	unsigned long long time = bench_now() - start;
+	printf("replace %lu x 4 KiB   %-18s %9.2f us/write %9.0f writes/s\n", writes, "lepk_file_write", time / 1e3 / writes, writes / (time / 1e9));
+
+	const char *names[] = { "atomic none", "atomic data", "atomic full" };
+	for (int durability = LEPK_FILE_DURABILITY_NONE; durability <= LEPK_FILE_DURABILITY_FULL; durability++) {
+		start = bench_now();
+		for (unsigned long i = 0; i < writes; i++) {
+			lepk_file_write_atomic(paths[i], content, sizeof(content), durability);
+		}
+		time = bench_now() - start;
+		printf("replace %lu x 4 KiB   %-18s %9.2f us/write %9.0f writes/s\n", writes, names[durability], time / 1e3 / writes, writes / (time / 1e9));
+	}
+
+	const char *group_names[] = { "group none", "group data", "group full" };
+	for (int durability = LEPK_FILE_DURABILITY_NONE; durability <= LEPK_FILE_DURABILITY_FULL; durability++) {
+		start = bench_now();
+		LepkFileGroup *group = lepk_file_group_create(durability);
+		for (unsigned long i = 0; i < writes; i++) {
+			lepk_file_group_write(group, paths[i], content, sizeof(content));
+		}
+		LepkFileStatus status = lepk_file_group_commit(group);
+		lepk_file_group_destroy(group);
+		time = bench_now() - start;
+		printf("replace %lu x 4 KiB   %-18s %9.2f us/write %9.0f writes/s%s\n", writes, group_names[durability], time / 1e3 / writes, writes / (time / 1e9),
+				status == LEPK_FILE_STATUS_OK ? "" : "   (COMMIT FAILED)");
+	}
+
+	for (unsigned long i = 0; i < writes; i++) {
+		lepk_file_remove(paths[i]);
+	}
+	free(paths);
+}
+
+/* Bitwise CRC-32C, the slow scalar checksum the fast paths replace. */
+static uint32_t crc32c_bytewise(const char *data, uint64_t length) {
+	uint32_t crc = ~0u;
+	for (uint64_t i = 0; i < length; i++) {
+		crc ^= (unsigned char) data[i];
+		for (int bit = 0; bit < 8; bit++) {
+			crc = crc & 1 ? (crc >> 1) ^ 0x82f63b78 : crc >> 1;
+		}
+	}
+	return ~crc;
+}
+
+/* Checksum and hash throughput in memory, then over a mapped file with threads and streamed through a reader. */
+static void bench_checksum(unsigned long megabytes) {
+	uint64_t length = (uint64_t) megabytes << 20;
+	char *content = malloc(length);
+	unsigned long long state = 17;
+	for (uint64_t i = 0; i + sizeof(unsigned long long) <= length; i += sizeof(unsigned long long)) {
+		unsigned long long word = bench_rand(&state);
+		memcpy(content + i, &word, sizeof(word));
+	}
+	lepk_file_write("lepk_file_bench.bin", content, length, LEPK_FILE_MODE_BINARY);
+
+	/* The bitwise CRC gets a sixteenth of the data, it would take too long otherwise. */
+	unsigned long long start = bench_now();
+	uint32_t slow = crc32c_bytewise(content, length / 16);
+	unsigned long long time = bench_now() - start;
+	printf("checksum %lu MiB   %-24s %7.2f GB/s\n", megabytes, "bitwise crc32c", (double) (length / 16) / time);
+	uint32_t expected = lepk_file_crc32c(0, content, length / 16);
+	if (expected != slow) {
+		printf("checksum %lu MiB   (CRCS DIFFER)\n", megabytes);
+	}
+
+	start = bench_now();
+	expected = lepk_file_crc32c(0, content, length);
+	time = bench_now() - start;
+	printf("checksum %lu MiB   %-24s %7.2f GB/s\n", megabytes, "lepk_file_crc32c", (double) length / time);
+
+	start = bench_now();
+	LepkFileHash hash = lepk_file_hash(content, length, 0);
+	time = bench_now() - start;
+	printf("checksum %lu MiB   %-24s %7.2f GB/s\n", megabytes, "lepk_file_hash", (double) length / time);
+
+	/* Small pieces, like a protocol hashing each message as it arrives. */
+	start = bench_now();
+	LepkFileHasher hasher;
+	lepk_file_hasher_init(&hasher, 0);
+	for (uint64_t i = 0; i < length; i += 1000) {
+		lepk_file_hasher_update(&hasher, content + i, length - i < 1000 ? length - i : 1000);
+	}
+	LepkFileHash streamed = lepk_file_hasher_final(&hasher);
+	time = bench_now() - start;
+	printf("checksum %lu MiB   %-24s %7.2f GB/s   %s\n", megabytes, "hasher 1000 byte pieces", (double) length / time,
+			streamed.low == hash.low && streamed.high == hash.high ? "(hashes match)" : "(HASHES DIFFER)");
+	free(content);
+
+	for (unsigned long threads = 1; threads <= 8; threads *= 2) {
+		uint32_t crc;
+		start = bench_now();
+		lepk_file_checksum("lepk_file_bench.bin", threads, &crc);
+		time = bench_now() - start;
+		printf("checksum %lu MiB   checksum %lu thread%-7s %7.2f GB/s   %s\n", megabytes, threads, threads == 1 ? "" : "s",
+				(double) length / time, crc == expected ? "(crcs match)" : "(CRCS DIFFER)");
+	}
+
+	start = bench_now();
+	lepk_file_digest("lepk_file_bench.bin", 0, &streamed);
+	time = bench_now() - start;
+	printf("checksum %lu MiB   %-24s %7.2f GB/s   %s\n", megabytes, "lepk_file_digest", (double) length / time,
+			streamed.low == hash.low && streamed.high == hash.high ? "(hashes match)" : "(HASHES DIFFER)");
+
+	start = bench_now();
+	LepkFileReader *reader = lepk_file_reader_open("lepk_file_bench.bin", 0, true, NULL);
+	uint32_t crc = 0;
+	const char *chunk;
+	unsigned long chunk_length;
+	while (lepk_file_reader_next(reader, &chunk, &chunk_length)) {
+		crc = lepk_file_crc32c(crc, chunk, chunk_length);
+	}
+	lepk_file_reader_close(reader);
+	time = bench_now() - start;
+	printf("checksum %lu MiB   %-24s %7.2f GB/s   %s\n", megabytes, "reader crc32c", (double) length / time, crc == expected ? "(crcs match)" : "(CRCS DIFFER)");
+
+	lepk_file_remove("lepk_file_bench.bin");
+}
+
+int main(void) {
+	printf("== lepk_file ==\n");
+	bench_map(bench_param("BENCH_FILE_MB", 256));
+	bench_lines(bench_param("BENCH_FILE_MB", 256));
+	bench_append(bench_param("BENCH_RECORDS", 1ul << 18));
+	bench_parallel(bench_param("BENCH_PARALLEL_MB", 2048));
+	bench_copy(bench_param("BENCH_COPY_MB", 1024));
+	bench_atomic(bench_param("BENCH_ATOMIC", 256));
+	bench_checksum(bench_param("BENCH_CHECKSUM_MB", 1024));
+	bench_batch(bench_param("BENCH_FILES", 100000));
+
+	return 0;
+}
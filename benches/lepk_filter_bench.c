@@ -0,0 +1,68 @@
+#include "bench.h"
+
+#define LEPK_HT_IMPLEMENTATION
+#include "lepk_ht.h"
+#define LEPK_FILTER_IMPLEMENTATION
+#include "lepk_filter.h"
+
+/* Lookups into a table much larger than the last level cache, most of them misses, with and without a filter in front. */
+int main(void) {
+	unsigned long count = bench_param("BENCH_COUNT", 1ul << 22);
+	unsigned long lookups = bench_param("BENCH_LOOKUPS", 1ul << 23);
+	/* Percentage of lookups that hit. */
+	unsigned long hit_rate = bench_param("BENCH_HITS", 10);
+	double fpr = 0.01;
+
+	printf("== lepk_filter (%lu keys, %lu lookups, %lu%% hits, fpr %.2f%%) ==\n", count, lookups, hit_rate, fpr * 100.0);
+
+	LepkHt *table = lepk_ht_create_with_capacity(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned long), sizeof(unsigned long), count);
+	LepkBloom *bloom = lepk_bloom_create(lepk_ht_hash_generic, sizeof(unsigned long), count, fpr);
+	LepkCuckoo *cuckoo = lepk_cuckoo_create(lepk_ht_hash_generic, sizeof(unsigned long), count, fpr);
+
+	unsigned long long state = 17;
+	unsigned long *keys = malloc(count * sizeof(unsigned long));
+	for (unsigned long i = 0; i < count; i++) {
+		/* Even keys are stored, odd ones miss. */
+		keys[i] = bench_rand(&state) & ~1ul;
+		lepk__ht_set(table, &keys[i], &i);
+		lepk_bloom_add(bloom, &keys[i]);
+		lepk_cuckoo_add(cuckoo, &keys[i]);
+	}
+
+	unsigned long *probes = malloc(lookups * sizeof(unsigned long));
+	for (unsigned long i = 0; i < lookups; i++) {
+		unsigned long key = keys[bench_rand(&state) % count];
+		probes[i] = bench_rand(&state) % 100 < hit_rate ? key : key | 1;
+	}
+
+	printf("%-14s %10s %10s %10s %12s\n", "", "ns/lookup", "speedup", "found", "bytes/key");
+	unsigned long long plain = 0;
+	for (int mode = 0; mode < 3; mode++) {
+		unsigned long found = 0;
+		unsigned long long start = bench_now();
+		for (unsigned long i = 0; i < lookups; i++) {
+			if (mode == 1 && !lepk_bloom_contains(bloom, &probes[i])) {
+				continue;
+			}
+			if (mode == 2 && !lepk_cuckoo_contains(cuckoo, &probes[i])) {
+				continue;
+			}
+			found += lepk_ht_find(table, &probes[i]) != NULL;
+		}
+		unsigned long long elapsed = bench_now() - start;
+		if (mode == 0) {
+			plain = elapsed;
+		}
+
+		unsigned long bytes = mode == 1 ? lepk_bloom_bytes(bloom) : mode == 2 ? lepk_cuckoo_bytes(cuckoo) : 0;
+		printf("%-14s %10.2f %9.2fx %10lu %12.2f\n", mode == 0 ? "lepk_ht" : mode == 1 ? "bloom+lepk_ht" : "cuckoo+lepk_ht",
+				(double) elapsed / lookups, (double) plain / elapsed, found, (double) bytes / count);
+	}
+
+	free(probes);
+	free(keys);
+	lepk_cuckoo_destroy(cuckoo);
+	lepk_bloom_destroy(bloom);
+	lepk_ht_destroy(table);
+	return 0;
+}
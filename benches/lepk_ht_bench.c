@@ -0,0 +1,273 @@
+#include "bench.h"
+
+#include <string.h>
+
+#define LEPK_HT_IMPLEMENTATION
+#include "lepk_ht.h"
+
+/*
+ * Per insert latency of a growing table.
+ * Stop-the-world resizing shows up as huge outliers in the tail.
+ */
+static void bench_insert_latency(unsigned long count, unsigned long step) {
+	unsigned long long *samples = malloc(count * sizeof(unsigned long long));
+	LepkHt *table = lepk_ht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned long), sizeof(unsigned long));
+	lepk_ht_rehash_step(table, step);
+
+	unsigned long long start = bench_now();
+	for (unsigned long i = 0; i < count; i++) {
+		unsigned long long t = bench_now();
+		lepk__ht_set(table, &i, &i);
+		samples[i] = bench_now() - t;
+	}
+	unsigned long long total = bench_now() - start;
+
+	printf("insert latency  step %-4lu  total %8.2f ms  p50 %6llu ns  p99 %6llu ns  p999 %8llu ns  max %10llu ns\n",
+			step, total / 1e6,
+			bench_percentile(samples, count, 50.0),
+			bench_percentile(samples, count, 99.0),
+			bench_percentile(samples, count, 99.9),
+			bench_percentile(samples, count, 100.0));
+
+	lepk_ht_destroy(table);
+	free(samples);
+}
+
+/* Full table scan over the dense value array. */
+static void bench_scan(unsigned long count) {
+	LepkHt *table = lepk_ht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned long), sizeof(unsigned long));
+	for (unsigned long i = 0; i < count; i++) {
+		lepk__ht_set(table, &i, &i);
+	}
+	/* Leave holes behind so the scan has to compact first. */
+	for (unsigned long i = 0; i < count; i += 4) {
+		lepk__ht_remove(table, &i, NULL);
+	}
+
+	unsigned long long start = bench_now();
+	const unsigned long *values = lepk__ht_values(table);
+	unsigned long long compacted = bench_now();
+	unsigned long sum = 0;
+	for (int pass = 0; pass < 10; pass++) {
+		for (unsigned long i = 0; i < lepk_ht_count(table); i++) {
+			sum += values[i];
+		}
+	}
+	unsigned long long end = bench_now();
+
+	double bytes = 10.0 * lepk_ht_count(table) * sizeof(unsigned long);
+	printf("scan            compact %8.2f ms  scan %6.2f GB/s  (sum %lu)\n", (compacted - start) / 1e6, bytes / (end - compacted), sum);
+
+	lepk_ht_destroy(table);
+}
+
+/* Random probes into a table much larger than the last level cache, half of them misses. */
+static void bench_batch(unsigned long count, unsigned long probes) {
+	LepkHt *table = lepk_ht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned long), sizeof(unsigned long));
+	unsigned long *keys = malloc(count * sizeof(unsigned long));
+	for (unsigned long i = 0; i < count; i++) {
+		keys[i] = i * 2;
+	}
+	unsigned long long start = bench_now();
+	lepk_ht_set_batch(table, keys, keys, count);
+	printf("set batch       %lu keys  %8.2f ms\n", count, (bench_now() - start) / 1e6);
+	free(keys);
+
+	unsigned long *probe_keys = malloc(probes * sizeof(unsigned long));
+	unsigned long *outputs = malloc(probes * sizeof(unsigned long));
+	unsigned long long state = 7;
+	for (unsigned long i = 0; i < probes; i++) {
+		probe_keys[i] = bench_rand(&state) % (count * 2);
+	}
+
+	start = bench_now();
+	for (unsigned long i = 0; i < probes; i++) {
+		lepk__ht_get(table, &probe_keys[i], &outputs[i]);
+	}
+	unsigned long long single = bench_now() - start;
+
+	start = bench_now();
+	unsigned long found = lepk_ht_get_batch(table, probe_keys, probes, outputs, NULL);
+	unsigned long long batch = bench_now() - start;
+
+	printf("get loop        %lu probes  %8.2f ns/probe\n", probes, (double) single / probes);
+	printf("get batch       %lu probes  %8.2f ns/probe  %.2fx  (%lu found)\n", probes, (double) batch / probes, (double) single / batch, found);
+
+	free(probe_keys);
+	free(outputs);
+	lepk_ht_destroy(table);
+}
+
+/* Loading a known amount of pairs, growing from scratch against sizing up front. */
+static void bench_bulk_load(unsigned long count) {
+	for (int mode = 0; mode < 3; mode++) {
+		unsigned long long start = bench_now();
+		LepkHt *table;
+		if (mode == 1) {
+			table = lepk_ht_create_with_capacity(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned long), sizeof(unsigned long), count);
+		} else {
+			table = lepk_ht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned long), sizeof(unsigned long));
+			if (mode == 2) {
+				lepk_ht_reserve(table, count);
+			}
+		}
+		for (unsigned long i = 0; i < count; i++) {
+			lepk__ht_set(table, &i, &i);
+		}
+		unsigned long long elapsed = bench_now() - start;
+		printf("bulk load       %-14s %lu keys  %8.2f ms\n", mode == 0 ? "create" : mode == 1 ? "with_capacity" : "reserve", count, elapsed / 1e6);
+		lepk_ht_destroy(table);
+	}
+}
+
+/*
+ * Tiny maps, where most real tables live. Tables grown from empty stay small up to LEPK_HT_SMALL pairs,
+ * a capacity hint above it forces a presized hashed layout for comparison.
+ */
+static void bench_small(unsigned long lookups) {
+	printf("small           %-5s %16s %16s %16s %16s\n", "size", "build ns", "hashed build ns", "get ns", "hashed get ns");
+	for (unsigned long size = 1; size <= 32; size *= 2) {
+		double build[2];
+		double get[2];
+		unsigned long sum = 0;
+
+		for (int mode = 0; mode < 2; mode++) {
+			unsigned long capacity = mode == 0 ? 0 : 64;
+			unsigned long tables = lookups / size / 8;
+			unsigned long long start = bench_now();
+			for (unsigned long t = 0; t < tables; t++) {
+				LepkHt *table = lepk_ht_create_with_capacity(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned int), sizeof(unsigned int), capacity);
+				for (unsigned int i = 0; i < size; i++) {
+					lepk__ht_set(table, &(unsigned int) { i * 7 }, &i);
+				}
+				sum += lepk_ht_count(table);
+				lepk_ht_destroy(table);
+			}
+			build[mode] = (double) (bench_now() - start) / tables;
+
+			LepkHt *table = lepk_ht_create_with_capacity(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned int), sizeof(unsigned int), capacity);
+			for (unsigned int i = 0; i < size; i++) {
+				lepk__ht_set(table, &(unsigned int) { i * 7 }, &i);
+			}
+			start = bench_now();
+			for (unsigned long i = 0; i < lookups; i++) {
+				/* Cycles through every key plus one miss. */
+				unsigned int key = (unsigned int) (i % (size + 1)) * 7;
+				unsigned int *data = lepk_ht_find(table, &key);
+				sum += data != NULL ? *data : 1;
+			}
+			get[mode] = (double) (bench_now() - start) / lookups;
+			lepk_ht_destroy(table);
+		}
+
+		printf("small           %-5lu %16.2f %16.2f %16.2f %16.2f  (checksum %lu)\n", size, build[0], build[1], get[0], get[1], sum);
+	}
+}
+
+/*
+ * Startup cost of a large lookup table, rebuilding it from its pairs against mapping a saved copy.
+ * The mapped lookups include faulting the pages in.
+ */
+static void bench_map_load(unsigned long count, unsigned long probes) {
+	LepkHt *table = lepk_ht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned long), sizeof(unsigned long));
+	for (unsigned long i = 0; i < count; i++) {
+		lepk__ht_set(table, &i, &i);
+	}
+	unsigned long long start = bench_now();
+	lepk_ht_save(table, "lepk_ht_bench.bin");
+	unsigned long long save = bench_now() - start;
+
+	start = bench_now();
+	LepkHt *rebuilt = lepk_ht_create_with_capacity(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned long), sizeof(unsigned long), count);
+	lepk_ht_set_batch(rebuilt, lepk__ht_keys(table), lepk__ht_values(table), count);
+	unsigned long long rebuild = bench_now() - start;
+
+	start = bench_now();
+	LepkHt *mapped = lepk_ht_map_load(lepk_ht_hash_generic, lepk_ht_compare_generic, "lepk_ht_bench.bin");
+	unsigned long long map = bench_now() - start;
+
+	unsigned long long state = 11;
+	unsigned long sum = 0;
+	unsigned long long times[2];
+	for (int mode = 0; mode < 2; mode++) {
+		LepkHt *current = mode == 0 ? mapped : rebuilt;
+		start = bench_now();
+		for (unsigned long i = 0; i < probes; i++) {
+			unsigned long key = bench_rand(&state) % count;
+			unsigned long *data = lepk_ht_find(current, &key);
+			sum += *data;
+		}
+		times[mode] = bench_now() - start;
+	}
+
+	printf("map load        %lu keys  save %8.2f ms  rebuild %8.2f ms  map %8.3f ms\n", count, save / 1e6, rebuild / 1e6, map / 1e6);
+	printf("map load        %lu probes  mapped %6.2f ns/probe  rebuilt %6.2f ns/probe  (sum %lu)\n",
+			probes, (double) times[0] / probes, (double) times[1] / probes, sum);
+
+	lepk_ht_destroy(mapped);
+	lepk_ht_destroy(rebuilt);
+	lepk_ht_destroy(table);
+	remove("lepk_ht_bench.bin");
+}
+
+typedef struct {
+	char text[16];
+} Word;
+
+static void count_word(void *data, bool inserted, void *user) {
+	(void) inserted;
+	(void) user;
+	(*(unsigned long *) data)++;
+}
+
+/* Word counting, one read-modify-write per word. */
+static void bench_word_count(unsigned long words, unsigned long vocabulary) {
+	Word *stream = malloc(words * sizeof(Word));
+	unsigned long long state = 3;
+	for (unsigned long i = 0; i < words; i++) {
+		memset(&stream[i], 0, sizeof(Word));
+		sprintf(stream[i].text, "w%llx", bench_rand(&state) % vocabulary);
+	}
+
+	for (int mode = 0; mode < 3; mode++) {
+		LepkHt *table = lepk_ht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(Word), sizeof(unsigned long));
+		unsigned long long start = bench_now();
+		for (unsigned long i = 0; i < words; i++) {
+			if (mode == 0) {
+				unsigned long count = 0;
+				lepk__ht_get(table, &stream[i], &count);
+				count++;
+				lepk__ht_set(table, &stream[i], &count);
+			} else if (mode == 1) {
+				unsigned long *count = lepk_ht_get_or_insert(table, &stream[i], NULL);
+				(*count)++;
+			} else {
+				lepk_ht_upsert(table, &stream[i], count_word, NULL);
+			}
+		}
+		unsigned long long elapsed = bench_now() - start;
+		printf("word count      %-14s %lu words, %lu unique  %8.2f ms\n",
+				mode == 0 ? "get+set" : mode == 1 ? "get_or_insert" : "upsert",
+				words, lepk_ht_count(table), elapsed / 1e6);
+		lepk_ht_destroy(table);
+	}
+
+	free(stream);
+}
+
+int main(void) {
+	unsigned long count = bench_param("BENCH_COUNT", 1ul << 22);
+
+	printf("== lepk_ht (%lu keys) ==\n", count);
+	bench_insert_latency(count, 0);
+	bench_insert_latency(count, 16);
+	bench_insert_latency(count, 64);
+	bench_scan(count);
+	bench_bulk_load(count);
+	bench_small(bench_param("BENCH_SMALL_LOOKUPS", 1ul << 24));
+	bench_word_count(bench_param("BENCH_WORDS", 1ul << 22), bench_param("BENCH_VOCABULARY", 1ul << 18));
+	bench_batch(bench_param("BENCH_BATCH_COUNT", 1ul << 23), bench_param("BENCH_PROBES", 1ul << 22));
+	bench_map_load(count, bench_param("BENCH_PROBES", 1ul << 22));
+
+	return 0;
+}
@@ -0,0 +1,90 @@
+#include "bench.h"
+
+#include <string.h>
+
+#define LEPK_FILE_IMPLEMENTATION
+#include "lepk_file.h"
+#define LEPK_HT_IMPLEMENTATION
+#include "lepk_ht.h"
+#define LEPK_INTERN_IMPLEMENTATION
+#include "lepk_intern.h"
+
+#define CORPUS_PATH "intern_bench_corpus.txt"
+
+/* Identifiers with a skewed distribution, roughly like source code or logs. */
+static void write_corpus(unsigned long words, unsigned long vocabulary) {
+	unsigned long long state = 42;
+	char *buffer = malloc(words * 24);
+	unsigned long length = 0;
+	for (unsigned long i = 0; i < words; i++) {
+		unsigned long long r = bench_rand(&state);
+		/* Squaring a uniform number favours small IDs. */
+		double u = (double) (r >> 11) / (double) (1ull << 53);
+		unsigned long word = (unsigned long) (u * u * vocabulary);
+		length += sprintf(buffer + length, "ident_%lx%c", word, i % 16 == 15 ? '\n' : ' ');
+	}
+	lepk_file_write(CORPUS_PATH, buffer, length, LEPK_FILE_MODE_BINARY);
+	free(buffer);
+}
+
+int main(void) {
+	unsigned long words = bench_param("BENCH_WORDS", 10000000);
+	unsigned long vocabulary = bench_param("BENCH_VOCABULARY", 1000000);
+	const char *path = getenv("BENCH_CORPUS");
+	if (path == NULL) {
+		write_corpus(words, vocabulary);
+		path = CORPUS_PATH;
+	}
+
+	char *corpus = lepk_file_read(path, NULL);
+	if (corpus == NULL) {
+		fprintf(stderr, "Unable to read %s.\n", path);
+		return 1;
+	}
+	unsigned long corpus_length = strlen(corpus);
+
+	printf("== lepk_intern (%s, %.1f MB) ==\n", path, corpus_length / 1e6);
+
+	LepkIntern *interner = lepk_intern_create();
+	unsigned long tokens = 0;
+	unsigned long long checksum = 0;
+
+	for (int pass = 0; pass < 2; pass++) {
+		unsigned long long start = bench_now();
+		const char *c = corpus;
+		tokens = 0;
+		while (*c != '\0') {
+			while (*c == ' ' || *c == '\n' || *c == '\t') {
+				c++;
+			}
+			const char *token = c;
+			while (*c != '\0' && *c != ' ' && *c != '\n' && *c != '\t') {
+				c++;
+			}
+			if (c != token) {
+				checksum += lepk_intern(interner, token, c - token);
+				tokens++;
+			}
+		}
+		unsigned long long elapsed = bench_now() - start;
+
+		printf("%-8s %lu tokens, %lu unique  %7.2f ms  %6.2f Mtokens/s\n",
+				pass == 0 ? "intern" : "reintern", tokens, lepk_intern_count(interner),
+				elapsed / 1e6, tokens / (elapsed / 1e3));
+	}
+
+	unsigned long long start = bench_now();
+	unsigned long bytes = 0;
+	for (unsigned long id = 0; id < lepk_intern_count(interner); id++) {
+		bytes += lepk_intern_length(interner, id) + (lepk_intern_string(interner, id)[0] == 'i');
+	}
+	unsigned long long elapsed = bench_now() - start;
+	printf("id->string %lu lookups  %7.2f ms  (%lu bytes, checksum %llu)\n", lepk_intern_count(interner), elapsed / 1e6, bytes, checksum);
+
+	lepk_intern_destroy(interner);
+	free(corpus);
+	if (getenv("BENCH_CORPUS") == NULL) {
+		lepk_file_remove(CORPUS_PATH);
+	}
+	return 0;
+}
@@ -0,0 +1,91 @@
+#include "bench.h"
+
+#include <string.h>
+
+/* Logs only get as big as asked, compaction is timed separately. */
+#define LEPK_KV_COMPACT_MIN (1ull << 40)
+
+#define LEPK_FILE_IMPLEMENTATION
+#include "lepk_file.h"
+#define LEPK_HT_IMPLEMENTATION
+#include "lepk_ht.h"
+#define LEPK_KV_IMPLEMENTATION
+#include "lepk_kv.h"
+
+#define VALUE_SIZE 100
+
+static void bench_remove(void) {
+	remove("lepk_kv_bench.log");
+	remove("lepk_kv_bench.snap");
+}
+
+/* Set ops distinct 16 byte keys to 100 byte values. */
+static void bench_set(LepkKv *kv, unsigned long ops, unsigned long long seed) {
+	char key[17];
+	char value[VALUE_SIZE];
+	memset(value, 'v', sizeof(value));
+	for (unsigned long i = 0; i < ops; i++) {
+		snprintf(key, sizeof(key), "%016llx", bench_rand(&seed));
+		lepk_kv_set(kv, key, 16, value, sizeof(value));
+	}
+}
+
+static void bench_durability(LepkFileDurability durability, unsigned long group, unsigned long ops) {
+	const char *names[] = { "none", "data", "full" };
+	bench_remove();
+	LepkKv *kv = lepk_kv_open("lepk_kv_bench", durability, group, NULL);
+
+	unsigned long long start = bench_now();
+	bench_set(kv, ops, 3);
+	LepkFileStatus status = lepk_kv_close(kv);
+	unsigned long long time = bench_now() - start;
+	printf("set %-8lu %-5s group %-4lu %9.2f us/op %10.0f ops/s%s\n", ops, names[durability], group, time / 1e3 / ops, ops / (time / 1e9),
+			status == LEPK_FILE_STATUS_OK ? "" : "   (COMMIT FAILED)");
+}
+
+/* Time to open a store whose pairs are all in the log, then all in a snapshot. */
+static void bench_recovery(unsigned long pairs) {
+	bench_remove();
+	LepkKv *kv = lepk_kv_open("lepk_kv_bench", LEPK_FILE_DURABILITY_NONE, 1024, NULL);
+	bench_set(kv, pairs, 7);
+	lepk_kv_close(kv);
+
+	LepkFileView view;
+	lepk_file_map("lepk_kv_bench.log", LEPK_FILE_ADVICE_NORMAL, &view);
+	double megabytes = view.length / 1048576.0;
+	lepk_file_unmap(&view);
+
+	unsigned long long start = bench_now();
+	kv = lepk_kv_open("lepk_kv_bench", LEPK_FILE_DURABILITY_NONE, 1024, NULL);
+	unsigned long long log_time = bench_now() - start;
+	lepk_kv_compact(kv);
+	lepk_kv_close(kv);
+
+	start = bench_now();
+	kv = lepk_kv_open("lepk_kv_bench", LEPK_FILE_DURABILITY_NONE, 1024, NULL);
+	unsigned long long snapshot_time = bench_now() - start;
+	unsigned long count = lepk_kv_count(kv);
+	lepk_kv_close(kv);
+
+	printf("open %-8lu pairs %8.2f MiB log   replay %9.2f ms   snapshot %9.2f ms%s\n", pairs, megabytes, log_time / 1e6, snapshot_time / 1e6,
+			count == pairs ? "" : "   (PAIRS LOST)");
+}
+
+int main(void) {
+	unsigned long ops = bench_param("BENCH_KV_OPS", 1ul << 20);
+	unsigned long synced = bench_param("BENCH_KV_SYNCED", 4096);
+	unsigned long pairs = bench_param("BENCH_KV_PAIRS", 1ul << 20);
+
+	printf("== lepk_kv (16 byte keys, %d byte values) ==\n", VALUE_SIZE);
+	for (int durability = LEPK_FILE_DURABILITY_NONE; durability <= LEPK_FILE_DURABILITY_FULL; durability++) {
+		/* Syncing every mutation is too slow for the full run. */
+		bench_durability(durability, 1, durability == LEPK_FILE_DURABILITY_NONE ? ops : synced);
+		bench_durability(durability, 64, ops);
+	}
+	for (unsigned long count = pairs / 64; count <= pairs; count *= 4) {
+		bench_recovery(count);
+	}
+
+	bench_remove();
+	return 0;
+}
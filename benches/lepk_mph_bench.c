@@ -0,0 +1,72 @@
+#include "bench.h"
+
+#define LEPK_FILE_IMPLEMENTATION
+#include "lepk_file.h"
+#define LEPK_HT_IMPLEMENTATION
+#include "lepk_ht.h"
+#define LEPK_MPH_IMPLEMENTATION
+#include "lepk_mph.h"
+
+#define IMAGE_PATH "mph_bench.bin"
+
+int main(void) {
+	unsigned long count = bench_param("BENCH_KEYS", 1ul << 20);
+	unsigned long lookups = bench_param("BENCH_LOOKUPS", 1ul << 23);
+
+	printf("== lepk_mph (%lu keys, %lu lookups) ==\n", count, lookups);
+
+	unsigned long long state = 11;
+	unsigned long *keys = malloc(count * sizeof(unsigned long));
+	for (unsigned long i = 0; i < count; i++) {
+		keys[i] = bench_rand(&state);
+	}
+
+	unsigned long long start = bench_now();
+	LepkMph *mph = lepk_mph_create(keys, sizeof(unsigned long), keys, sizeof(unsigned long), count);
+	printf("build     lepk_mph  %8.2f ms\n", (bench_now() - start) / 1e6);
+
+	start = bench_now();
+	LepkHt *table = lepk_ht_create_with_capacity(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned long), sizeof(unsigned long), count);
+	lepk_ht_set_batch(table, keys, keys, count);
+	printf("build     lepk_ht   %8.2f ms\n", (bench_now() - start) / 1e6);
+
+	/* Round trip through a file like a build step would. */
+	unsigned long length;
+	void *image = lepk_mph_serialize(mph, &length);
+	lepk_file_write(IMAGE_PATH, image, length, LEPK_FILE_MODE_BINARY);
+	free(image);
+	start = bench_now();
+	char *content = lepk_file_read(IMAGE_PATH, NULL);
+	LepkMph *loaded = lepk_mph_load(content, 0);
+	printf("load      lepk_mph  %8.2f ms  (%.2f bytes per key incl. key and data)\n", (bench_now() - start) / 1e6, (double) length / count);
+	free(content);
+	lepk_file_remove(IMAGE_PATH);
+
+	unsigned long *probes = malloc(lookups * sizeof(unsigned long));
+	for (unsigned long i = 0; i < lookups; i++) {
+		probes[i] = keys[bench_rand(&state) % count];
+	}
+
+	unsigned long sum = 0;
+	start = bench_now();
+	for (unsigned long i = 0; i < lookups; i++) {
+		sum += *(const unsigned long *) lepk_mph_get(loaded, &probes[i]);
+	}
+	unsigned long long mph_time = bench_now() - start;
+
+	start = bench_now();
+	for (unsigned long i = 0; i < lookups; i++) {
+		sum -= *(const unsigned long *) lepk_ht_find(table, &probes[i]);
+	}
+	unsigned long long ht_time = bench_now() - start;
+
+	printf("lookup    lepk_mph  %8.2f ns/lookup\n", (double) mph_time / lookups);
+	printf("lookup    lepk_ht   %8.2f ns/lookup  (checksum %lu)\n", (double) ht_time / lookups, sum);
+
+	free(probes);
+	free(keys);
+	lepk_ht_destroy(table);
+	lepk_mph_destroy(mph);
+	lepk_mph_destroy(loaded);
+	return 0;
+}
@@ -0,0 +1,79 @@
+#include "bench.h"
+
+#include <malloc.h>
+
+#define LEPK_HT_IMPLEMENTATION
+#include "lepk_ht.h"
+#define LEPK_SET_IMPLEMENTATION
+#include "lepk_set.h"
+
+/* Heap bytes in use, including blocks big enough to be mmap'd. */
+static size_t heap_bytes(void) {
+	struct mallinfo2 info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+}
+
+int main(void) {
+	unsigned long count = bench_param("BENCH_COUNT", 1ul << 20);
+	unsigned long lookups = bench_param("BENCH_LOOKUPS", 1ul << 23);
+
+	printf("== lepk_set (%lu int keys, %lu lookups, half of them misses) ==\n", count, lookups);
+
+	unsigned long long state = 5;
+	unsigned int *keys = malloc(count * sizeof(unsigned int));
+	for (unsigned long i = 0; i < count; i++) {
+		/* Odd keys are members, even ones are misses. */
+		keys[i] = (unsigned int) (bench_rand(&state) | 1);
+	}
+	unsigned int *probes = malloc(lookups * sizeof(unsigned int));
+	for (unsigned long i = 0; i < lookups; i++) {
+		probes[i] = keys[bench_rand(&state) % count] ^ (unsigned int) (i & 1);
+	}
+
+	size_t before = heap_bytes();
+	unsigned long long start = bench_now();
+	LepkSet *set = lepk_set_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned int));
+	for (unsigned long i = 0; i < count; i++) {
+		lepk__set_add(set, &keys[i]);
+	}
+	unsigned long long set_build = bench_now() - start;
+	size_t set_bytes = heap_bytes() - before;
+
+	/* lepk_ht as a set, with a one byte dummy value. */
+	before = heap_bytes();
+	start = bench_now();
+	LepkHt *table = lepk_ht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(unsigned int), 1);
+	char dummy = 0;
+	for (unsigned long i = 0; i < count; i++) {
+		lepk__ht_set(table, &keys[i], &dummy);
+	}
+	unsigned long long ht_build = bench_now() - start;
+	size_t ht_bytes = heap_bytes() - before;
+
+	unsigned long set_hits = 0;
+	start = bench_now();
+	for (unsigned long i = 0; i < lookups; i++) {
+		set_hits += lepk__set_contains(set, &probes[i]);
+	}
+	unsigned long long set_time = bench_now() - start;
+
+	unsigned long ht_hits = 0;
+	start = bench_now();
+	for (unsigned long i = 0; i < lookups; i++) {
+		ht_hits += lepk_ht_find(table, &probes[i]) != NULL;
+	}
+	unsigned long long ht_time = bench_now() - start;
+
+	printf("%-10s %8s %14s %12s %10s\n", "", "build ms", "bytes/element", "lookup ns", "Mlookup/s");
+	printf("%-10s %8.2f %14.2f %12.2f %10.2f\n", "lepk_set", set_build / 1e6, (double) set_bytes / lepk_set_count(set),
+			(double) set_time / lookups, lookups / (set_time / 1e3));
+	printf("%-10s %8.2f %14.2f %12.2f %10.2f\n", "lepk_ht", ht_build / 1e6, (double) ht_bytes / lepk_ht_count(table),
+			(double) ht_time / lookups, lookups / (ht_time / 1e3));
+	printf("hits: %lu / %lu\n", set_hits, ht_hits);
+
+	lepk_ht_destroy(table);
+	lepk_set_destroy(set);
+	free(probes);
+	free(keys);
+	return 0;
+}
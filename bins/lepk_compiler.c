@@ -40,6 +40,10 @@
  *     Output file.
  */
 
+/* lepk_file's implementation needs POSIX declarations and a 64 bit off_t, which have to be asked for before any system header. */
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
 #include "lepk_type.h"
 #define LEPK_FILE_IMPLEMENTATION
 #include "lepk_file.h"
@@ -59,18 +63,21 @@ static void usage(const char *program) {
 	exit(1);
 }
 
-static void write_impl(const char *output_filepath, const char *source, const char *def, U32 first_header, U32 first_header_end) {
-		lepk_file_append(output_filepath, "#ifdef ", 7, LEPK_FILE_MODE_BINARY);
-		lepk_file_append(output_filepath, def, strlen(def), LEPK_FILE_MODE_BINARY);
-		lepk_file_append(output_filepath, "\n", 1, LEPK_FILE_MODE_BINARY);
-
-		lepk_file_append(output_filepath, source, first_header, LEPK_FILE_MODE_BINARY);
-		lepk_file_append(output_filepath, source + first_header_end, strlen(source + first_header_end), LEPK_FILE_MODE_BINARY);
-
-		lepk_file_append(output_filepath, "#endif /*", 9, LEPK_FILE_MODE_BINARY);
-		lepk_file_append(output_filepath, def, strlen(def), LEPK_FILE_MODE_BINARY);
-		lepk_file_append(output_filepath, "*/", 2, LEPK_FILE_MODE_BINARY);
-		lepk_file_append(output_filepath, "\n", 1, LEPK_FILE_MODE_BINARY);
+static void write_impl(LepkFileWriter *output, const char *source, const char *def, U32 first_header, U32 first_header_end) {
+		LepkFileFragment fragments[] = {
+			{ "#ifdef ", 7 },
+			{ def, strlen(def) },
+			{ "\n", 1 },
+
+			{ source, first_header },
+			{ source + first_header_end, strlen(source + first_header_end) },
+
+			{ "#endif /*", 9 },
+			{ def, strlen(def) },
+			{ "*/", 2 },
+			{ "\n", 1 },
+		};
+		lepk_file_writer_writev(output, fragments, sizeof(fragments) / sizeof(fragments[0]));
 }
 
 I32 main(I32 argc, char **argv) {
@@ -120,18 +127,26 @@ I32 main(I32 argc, char **argv) {
 	}
 
 	/* Create final file. */
+	LepkFileWriter *output = lepk_file_writer_open(output_filepath, false, 0, NULL);
+	if (output == NULL) {
+		printf("Unable to open %s.\n", output_filepath);
+		return 1;
+	}
+
 	if (is_pragma) {
-		lepk_file_write(output_filepath, header, strlen(header), LEPK_FILE_MODE_BINARY);
+		lepk_file_writer_write(output, header, strlen(header));
 
-		write_impl(output_filepath, source, implementation_define, first_header, first_header_end);
+		write_impl(output, source, implementation_define, first_header, first_header_end);
 	} else {
-		lepk_file_write(output_filepath, header, last_endif, LEPK_FILE_MODE_BINARY);
+		lepk_file_writer_write(output, header, last_endif);
 
-		write_impl(output_filepath, source, implementation_define, first_header, first_header_end);
+		write_impl(output, source, implementation_define, first_header, first_header_end);
 
-		lepk_file_append(output_filepath, header + last_endif, strlen(header + last_endif), LEPK_FILE_MODE_BINARY);
+		lepk_file_writer_write(output, header + last_endif, strlen(header + last_endif));
 	}
 
+	lepk_file_writer_close(output);
+
 	free(source);
 	free(header);
 
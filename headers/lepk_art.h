@@ -0,0 +1,176 @@
+/* Version: 1.0 */
+
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2022 Linus Erik Pontus Kåreblom
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Adaptive radix tree.
+ *
+ * Add:
+ *     #define LEPK_ART_IMPLEMENTATION
+ * in one C or C++ file, before #include "lepk_art.h", to create the implementation.
+ *
+ * If LEPK_ART_STATIC is defined the implementation will be local to a single file only.
+ */
+
+/*
+ * === Documentation ===
+ * Maps byte strings of any length to fixed size data, ordered byte by byte, so it answers
+ * prefix questions a hash table can't. Keys are copied into the tree and may contain zero bytes.
+ * Lookups take the key length instead of calling strlen or hashing, and only touch one node per byte
+ * that tells keys apart, since runs of bytes shared by every key below a node are stored once in that node.
+ *
+ * Inner nodes grow and shrink between 4, 16, 48 and 256 children. Nodes with up to 16 children
+ * are searched with SSE2 when it's available.
+ *
+ * Usage:
+ * LepkArt *routes = lepk_art_create(sizeof(Handler));
+ * lepk_art_set(routes, "/api/", 5, &api_handler);
+ * lepk_art_set(routes, "/api/users/", 11, &users_handler);
+ * unsigned long matched;
+ * Handler *handler = lepk_art_longest_prefix(routes, path, strlen(path), &matched);
+ *
+ * Visiting every key starting with "/api/" in byte order, returning false from the callback stops early:
+ * lepk_art_each_prefix(routes, "/api/", 5, visit, NULL);
+ */
+
+#ifndef LEPK_ART_H
+#define LEPK_ART_H
+
+#ifndef LEPK_ART_STATIC
+#define LEPKART extern
+#else /* LEPK_ART_STATIC */
+#define LEPKART static
+#endif /* LEPK_ART_STATIC */
+
+#include <stdbool.h>
+
+/* Adaptive radix tree. */
+typedef struct LepkArt LepkArt;
+/* Visit callback, return false to stop visiting. */
+typedef bool (*LepkArtVisit)(const void *key, unsigned long length, void *data, void *user);
+
+/* Create a tree. */
+LEPKART LepkArt *lepk_art_create(unsigned long data_size);
+/* Destroy a tree. */
+LEPKART void lepk_art_destroy(LepkArt *art);
+
+/* Retrieve key count from tree. */
+LEPKART unsigned long lepk_art_count(const LepkArt *art);
+/* Memory held by the tree in bytes. */
+LEPKART unsigned long lepk_art_bytes(const LepkArt *art);
+/* Remove every key. */
+LEPKART void lepk_art_clear(LepkArt *art);
+
+/* Set the data for key in tree. */
+LEPKART void lepk_art_set(LepkArt *art, const void *key, unsigned long length, const void *data);
+/* Get data for key from tree. Returns false, leaving output untouched, if key isn't in the tree. */
+LEPKART bool lepk_art_get(const LepkArt *art, const void *key, unsigned long length, void *output);
+/* Remove key from tree. Returns false if key isn't in the tree, output is optional. */
+LEPKART bool lepk_art_remove(LepkArt *art, const void *key, unsigned long length, void *output);
+/* Pointer to the data stored for key, NULL if key isn't in the tree. Valid until the key is removed. */
+LEPKART void *lepk_art_find(const LepkArt *art, const void *key, unsigned long length);
+/*
+ * Data of the longest key in tree that key starts with, NULL if there is none.
+ * matched is optional and set to the length of that key.
+ */
+LEPKART void *lepk_art_longest_prefix(const LepkArt *art, const void *key, unsigned long length, unsigned long *matched);
+/* Call visit on every key starting with prefix, in byte order. A length of 0 visits every key. */
+LEPKART void lepk_art_each_prefix(const LepkArt *art, const void *prefix, unsigned long length, LepkArtVisit visit, void *user);
+
+#ifdef LEPK_ART_TEST
+
+#include <assert.h>
+
+static bool lepk__art_test_visit(const void *key, unsigned long length, void *data, void *user) {
+	char *joined = user;
+	strncat(joined, key, length);
+	strcat(joined, *(int *) data % 2 ? "!" : ",");
+	return *(int *) data != 99;
+}
+
+static void lepk_art_test(void) {
+	LepkArt *art = lepk_art_create(sizeof(int));
+	const char *routes[] = { "/", "/usr", "/usr/lib", "/usr/local/bin", "/usr/local/lib", "/var" };
+	for (int i = 0; i < 6; i++) {
+		lepk_art_set(art, routes[i], strlen(routes[i]), &i);
+	}
+	lepk_art_set(art, "/usr", 4, &(int) { 7 });
+	assert(lepk_art_count(art) == 6 && "lepk_art_set failed.");
+	int output = 0;
+	assert(lepk_art_get(art, "/usr", 4, &output) && output == 7 && "lepk_art_get failed.");
+	assert(!lepk_art_get(art, "/us", 3, &output) && !lepk_art_get(art, "/usr/local", 10, &output) && "lepk_art_get failed.");
+
+	unsigned long matched;
+	assert(*(int *) lepk_art_longest_prefix(art, "/usr/local/bin/lepkc", 20, &matched) == 3 && matched == 14 && "lepk_art_longest_prefix failed.");
+	assert(*(int *) lepk_art_longest_prefix(art, "/usr/share", 10, &matched) == 7 && matched == 4 && "lepk_art_longest_prefix failed.");
+	assert(*(int *) lepk_art_longest_prefix(art, "/home", 5, &matched) == 0 && matched == 1 && "lepk_art_longest_prefix failed.");
+	assert(lepk_art_longest_prefix(art, "usr", 3, NULL) == NULL && "lepk_art_longest_prefix failed.");
+
+	char joined[256] = "";
+	lepk_art_each_prefix(art, "/usr/", 5, lepk__art_test_visit, joined);
+	assert(strcmp(joined, "/usr/lib,/usr/local/bin!/usr/local/lib,") == 0 && "lepk_art_each_prefix failed.");
+
+	/* Keys sharing more bytes than a node stores inline, zero bytes, and every node size. */
+	const char *long_keys[] = { "a long shared prefix/1", "a long shared prefix/2", "a long shared", "a long shared prefix/1/x" };
+	for (int i = 0; i < 4; i++) {
+		lepk_art_set(art, long_keys[i], strlen(long_keys[i]), &(int) { 10 + i });
+	}
+	for (int i = 0; i < 256; i++) {
+		unsigned char key[3] = { 'k', (unsigned char) i, 0 };
+		lepk_art_set(art, key, 3, &i);
+		lepk_art_set(art, key, 2, &i);
+	}
+	assert(lepk_art_count(art) == 6 + 4 + 512 && "lepk_art_set failed.");
+	assert(*(int *) lepk_art_find(art, "k\0\0", 3) == 0 && *(int *) lepk_art_find(art, "k\377", 2) == 255 && "lepk_art_find failed.");
+	assert(lepk_art_find(art, "a long shared prefix/", 21) == NULL && *(int *) lepk_art_find(art, "a long shared", 13) == 12 && "lepk_art_find failed.");
+	assert(*(int *) lepk_art_longest_prefix(art, "a long shared prefix/3", 22, &matched) == 12 && matched == 13 && "lepk_art_longest_prefix failed.");
+
+	joined[0] = '\0';
+	lepk_art_each_prefix(art, "a long", 6, lepk__art_test_visit, joined);
+	assert(strcmp(joined, "a long shared,a long shared prefix/1,a long shared prefix/1/x!a long shared prefix/2!") == 0 && "lepk_art_each_prefix failed.");
+	joined[0] = '\0';
+	lepk_art_set(art, "a long shared prefix/1", 22, &(int) { 99 });
+	lepk_art_each_prefix(art, "", 0, lepk__art_test_visit, joined);
+	assert(strncmp(joined, "/,/usr!", 7) == 0 && strstr(joined, "a long shared prefix/1!") != NULL && strstr(joined, "/x") == NULL && "lepk_art_each_prefix failed.");
+
+	for (int i = 0; i < 256; i++) {
+		unsigned char key[3] = { 'k', (unsigned char) i, 0 };
+		assert(lepk_art_remove(art, key, 3, &output) && output == i && "lepk_art_remove failed.");
+		if (i % 2 == 0) {
+			lepk_art_remove(art, key, 2, NULL);
+		}
+	}
+	assert(!lepk_art_remove(art, "k", 1, NULL) && lepk_art_count(art) == 6 + 4 + 128 && "lepk_art_remove failed.");
+	assert(*(int *) lepk_art_find(art, "k\1", 2) == 1 && lepk_art_find(art, "k\2", 2) == NULL && "lepk_art_remove failed.");
+	assert(lepk_art_remove(art, "a long shared", 13, NULL) && *(int *) lepk_art_find(art, "a long shared prefix/1/x", 24) == 13 && "lepk_art_remove failed.");
+
+	lepk_art_clear(art);
+	assert(lepk_art_count(art) == 0 && lepk_art_find(art, "/", 1) == NULL && lepk_art_bytes(art) > 0 && "lepk_art_clear failed.");
+	lepk_art_destroy(art);
+}
+
+#endif /* LEPK_ART_TEST */
+
+#endif /* LEPK_ART_H */
@@ -0,0 +1,186 @@
+/* Version: 1.0 */
+
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2022 Linus Erik Pontus Kåreblom
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Ordered map, a B+tree.
+ *
+ * Add:
+ *     #define LEPK_BT_IMPLEMENTATION
+ * in one C or C++ file, before #include "lepk_bt.h", to create the implementation.
+ *
+ * If LEPK_BT_STATIC is defined the implementation will be local to a single file only.
+ *
+ * Use:
+ *     #define LEPK_BT_NODE_SIZE [int]
+ * to define how many bytes of keys a node holds, which decides how many keys fit in it.
+ *
+ * Uses the compare callback from lepk_ht.h.
+ */
+
+/*
+ * === Documentation ===
+ * Pairs are kept sorted by the compare function, which has to order keys and not just tell them apart.
+ * lepk_ht_compare_generic orders bytes, so it only sorts unsigned integers correctly on big endian machines,
+ * use lepk_bt_compare_int32 or lepk_bt_compare_int64 for numbers instead. Nodes using those
+ * are searched without calling the compare function, 32 bit keys four at a time with SSE2.
+ *
+ * Every pair lives in a leaf and leaves are linked in order, so ranges are walked without going back up the tree.
+ * Keys are stored together, apart from the data, so searching a node only touches a few cache lines.
+ *
+ * Usage:
+ * LepkBt *tree = lepk_bt_create(lepk_bt_compare_int32, sizeof(int), sizeof(float));
+ * lepk_bt_set(tree, 4, 1.5f);
+ *
+ * Iterating over every key from 10 up to but not including 20:
+ * LepkBtIterator iterator = lepk_bt_lower_bound(tree, 10);
+ * const int *key;
+ * float *data;
+ * while (lepk_bt_next(&iterator, (const void **) &key, (void **) &data) && *key < 20) { ... }
+ *
+ * Iterators are invalidated by modifying the tree.
+ */
+
+#ifndef LEPK_BT_H
+#define LEPK_BT_H
+
+#ifndef LEPK_BT_STATIC
+#define LEPKBT extern
+#else /* LEPK_BT_STATIC */
+#define LEPKBT static
+#endif /* LEPK_BT_STATIC */
+
+#include <stdbool.h>
+
+#include "lepk_ht.h"
+
+/* B+tree. */
+typedef struct LepkBt LepkBt;
+/* Position in a tree, the next pair lepk_bt_next returns. */
+typedef struct {
+	const LepkBt *tree;
+	void *node;
+	unsigned long index;
+} LepkBtIterator;
+
+/* Create a tree. */
+LEPKBT LepkBt *lepk_bt_create(LepkHtCompare compare, unsigned long key_size, unsigned long data_size);
+/* Destroy a tree. */
+LEPKBT void lepk_bt_destroy(LepkBt *tree);
+
+/* Retrieve pair count from tree. */
+LEPKBT unsigned long lepk_bt_count(const LepkBt *tree);
+/* Memory held by the tree in bytes. */
+LEPKBT unsigned long lepk_bt_bytes(const LepkBt *tree);
+/* Remove every pair. */
+LEPKBT void lepk_bt_clear(LepkBt *tree);
+
+/* Set the pair in tree. */
+LEPKBT void lepk__bt_set(LepkBt *tree, const void *key, const void *data);
+/* Get pair from tree. Returns false, leaving output untouched, if key isn't in the tree. */
+LEPKBT bool lepk__bt_get(const LepkBt *tree, const void *key, void *output);
+/* Remove pair from tree. Returns false if key isn't in the tree, output is optional. */
+LEPKBT bool lepk__bt_remove(LepkBt *tree, const void *key, void *output);
+/* Pointer to the data stored for key, NULL if key isn't in the tree. Valid until the tree is modified. */
+LEPKBT void *lepk_bt_find(const LepkBt *tree, const void *key);
+
+/* Iterator at the smallest key. */
+LEPKBT LepkBtIterator lepk_bt_begin(const LepkBt *tree);
+/* Iterator at the first key not less than key. */
+LEPKBT LepkBtIterator lepk__bt_lower_bound(const LepkBt *tree, const void *key);
+/* Step to the next pair in order, setting key and data (both optional) to it. Returns false past the last pair. */
+LEPKBT bool lepk_bt_next(LepkBtIterator *iterator, const void **key, void **data);
+
+/* Pre-written compare function for int32_t keys, searched with SIMD. */
+LEPKBT int lepk_bt_compare_int32(const void *a, const void *b, unsigned long size);
+/* Pre-written compare function for int64_t keys. */
+LEPKBT int lepk_bt_compare_int64(const void *a, const void *b, unsigned long size);
+
+#define lepk_bt_set(tree, key, data) do { __typeof__(key) lepk__bt_temp_key = key; __typeof__(data) lepk__bt_temp_data = data; lepk__bt_set(tree, &lepk__bt_temp_key, &lepk__bt_temp_data); } while (0)
+#define lepk_bt_get(tree, key, output) lepk__bt_get(tree, &(__typeof__(key)) { key }, output)
+#define lepk_bt_remove(tree, key, output) lepk__bt_remove(tree, &(__typeof__(key)) { key }, output)
+#define lepk_bt_lower_bound(tree, key) lepk__bt_lower_bound(tree, &(__typeof__(key)) { key })
+
+#ifdef LEPK_BT_TEST
+
+#include <assert.h>
+
+static void lepk_bt_test(void) {
+	LepkBt *tree = lepk_bt_create(lepk_bt_compare_int32, sizeof(int), sizeof(int));
+	/* Scattered insertion order so nodes split everywhere, not just at the right edge. */
+	for (int i = 0; i < 10000; i++) {
+		int key = (i * 7919) % 10000;
+		lepk_bt_set(tree, key, key * 2);
+	}
+	lepk_bt_set(tree, 5, 7);
+	assert(lepk_bt_count(tree) == 10000 && "lepk_bt_set failed.");
+	int output = 0;
+	assert(lepk_bt_get(tree, 5, &output) && output == 7 && "lepk_bt_get failed.");
+	assert(!lepk_bt_get(tree, 10000, &output) && *(int *) lepk_bt_find(tree, &(int) { 9999 }) == 19998 && "lepk_bt_find failed.");
+
+	for (int i = 0; i < 10000; i += 3) {
+		assert(lepk_bt_remove(tree, i, NULL) && "lepk_bt_remove failed.");
+	}
+	assert(!lepk_bt_remove(tree, 3, NULL) && lepk_bt_count(tree) == 6666 && "lepk_bt_remove failed.");
+
+	LepkBtIterator iterator = lepk_bt_begin(tree);
+	const int *key;
+	int *data;
+	int previous = -1;
+	unsigned long count = 0;
+	while (lepk_bt_next(&iterator, (const void **) &key, (void **) &data)) {
+		assert(*key > previous && *key % 3 != 0 && (*data == *key * 2 || *key == 5) && "lepk_bt_next failed.");
+		previous = *key;
+		count++;
+	}
+	assert(count == 6666 && "lepk_bt_next failed.");
+
+	iterator = lepk_bt_lower_bound(tree, 300);
+	assert(lepk_bt_next(&iterator, (const void **) &key, NULL) && *key == 301 && "lepk_bt_lower_bound failed.");
+	iterator = lepk_bt_lower_bound(tree, 10000);
+	assert(!lepk_bt_next(&iterator, NULL, NULL) && "lepk_bt_lower_bound failed.");
+
+	for (int i = 0; i < 10000; i++) {
+		lepk_bt_remove(tree, i, NULL);
+	}
+	assert(lepk_bt_count(tree) == 0 && !lepk_bt_get(tree, 1, &output) && "lepk_bt_remove failed.");
+	lepk_bt_set(tree, -4, 8);
+	lepk_bt_clear(tree);
+	assert(lepk_bt_count(tree) == 0 && lepk_bt_find(tree, &(int) { -4 }) == NULL && "lepk_bt_clear failed.");
+	lepk_bt_destroy(tree);
+
+	LepkBt *strings = lepk_bt_create(lepk_ht_compare_string, 8, sizeof(int));
+	lepk__bt_set(strings, "banana\0", &(int) { 2 });
+	lepk__bt_set(strings, "apple\0\0", &(int) { 1 });
+	lepk__bt_set(strings, "cherry\0", &(int) { 3 });
+	iterator = lepk__bt_lower_bound(strings, "b\0\0\0\0\0\0");
+	const char *text;
+	assert(lepk_bt_next(&iterator, (const void **) &text, (void **) &data) && strcmp(text, "banana") == 0 && *data == 2 && "lepk_bt string keys failed.");
+	lepk_bt_destroy(strings);
+}
+
+#endif /* LEPK_BT_TEST */
+
+#endif /* LEPK_BT_H */
@@ -0,0 +1,212 @@
+/* Version: 1.0 */
+
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2022 Linus Erik Pontus Kåreblom
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Bounded caches with LRU or CLOCK eviction.
+ *
+ * Add:
+ *     #define LEPK_CACHE_IMPLEMENTATION
+ * in one C or C++ file, before #include "lepk_cache.h", to create the implementation.
+ *
+ * If LEPK_CACHE_STATIC is defined the implementation will be local to a single file only.
+ *
+ * Use:
+ *     #define LEPK_CACHE_SHARDS [power of two]
+ * to define how many independently locked caches a sharded cache is split into.
+ *
+ * Requires lepk_ht.h, and pthreads for the sharded cache.
+ */
+
+/*
+ * === Documentation ===
+ * A lepk_ht maps keys to nodes holding the key, data and cost. Nodes are linked into
+ * a recency list (LRU) or swept by a clock hand (CLOCK), so get, put and evicting are all O(1).
+ * CLOCK only sets a bit on hits instead of relinking, which is cheaper but evicts less precisely.
+ *
+ * The budget is spent by the cost of every entry. lepk_cache_put costs 1, making the budget an entry count,
+ * lepk__cache_put_cost takes any cost, like the size in bytes of what the data points at.
+ * Least recently used entries are evicted until the cache fits its budget again.
+ *
+ * Usage:
+ * LepkCache *cache = lepk_cache_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int), sizeof(Image *), LEPK_CACHE_LRU, 64);
+ * lepk_cache_on_evict(cache, free_image, NULL);
+ * Image **image = lepk_cache_get(cache, &id);
+ * if (image == NULL) {
+ *     Image *loaded = load_image(id);
+ *     lepk_cache_put(cache, id, loaded);
+ * }
+ *
+ * A sharded cache splits its budget over LEPK_CACHE_SHARDS caches, each with its own lock, and is safe to share between threads.
+ * Its get copies the data out, since other threads may evict it right after.
+ */
+
+#ifndef LEPK_CACHE_H
+#define LEPK_CACHE_H
+
+#ifndef LEPK_CACHE_STATIC
+#define LEPKCACHE extern
+#else /* LEPK_CACHE_STATIC */
+#define LEPKCACHE static
+#endif /* LEPK_CACHE_STATIC */
+
+#include <stdbool.h>
+
+#include "lepk_ht.h"
+
+/* Cache. */
+typedef struct LepkCache LepkCache;
+/* Cache safe to share between threads. */
+typedef struct LepkCacheSharded LepkCacheSharded;
+
+/* Which entry gets evicted. */
+typedef enum {
+	/* Least recently used. */
+	LEPK_CACHE_LRU,
+	/* Second chance, approximates LRU without touching a list on hits. */
+	LEPK_CACHE_CLOCK,
+} LepkCachePolicy;
+
+/* Called with every evicted pair, before it's removed. */
+typedef void (*LepkCacheEvict)(const void *key, void *data, void *user);
+
+/* Hits, misses and evictions since the cache was created. */
+typedef struct {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+} LepkCacheStats;
+
+/* Create a cache evicting entries once their costs add up to more than budget. */
+LEPKCACHE LepkCache *lepk_cache_create(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size, unsigned long data_size, LepkCachePolicy policy, unsigned long budget);
+/* Destroy a cache. The evict callback isn't called for the remaining pairs. */
+LEPKCACHE void lepk_cache_destroy(LepkCache *cache);
+
+/* Retrieve pair count from cache. */
+LEPKCACHE unsigned long lepk_cache_count(const LepkCache *cache);
+/* Sum of the costs of every pair in the cache. */
+LEPKCACHE unsigned long lepk_cache_cost(const LepkCache *cache);
+/* Set the callback called on evicted pairs. */
+LEPKCACHE void lepk_cache_on_evict(LepkCache *cache, LepkCacheEvict callback, void *user);
+/* Retrieve hit, miss and eviction counters. */
+LEPKCACHE void lepk_cache_stats(const LepkCache *cache, LepkCacheStats *stats);
+
+/* Pointer to the data stored for key, marking it as used. NULL if key isn't cached. Valid until the cache is modified. */
+LEPKCACHE void *lepk_cache_get(LepkCache *cache, const void *key);
+/* Set the pair in cache with a cost of 1. */
+LEPKCACHE void lepk__cache_put(LepkCache *cache, const void *key, const void *data);
+/* Set the pair in cache with cost counted against the budget. A pair costing more than the budget is evicted right away. */
+LEPKCACHE void lepk__cache_put_cost(LepkCache *cache, const void *key, const void *data, unsigned long cost);
+/* Remove pair from cache without calling the evict callback. Returns false if key isn't cached. */
+LEPKCACHE bool lepk__cache_remove(LepkCache *cache, const void *key, void *output);
+
+/* Create a sharded cache, every shard gets an equal part of budget. */
+LEPKCACHE LepkCacheSharded *lepk_cache_sharded_create(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size, unsigned long data_size, LepkCachePolicy policy, unsigned long budget);
+/* Destroy a sharded cache. No other thread may be using it. */
+LEPKCACHE void lepk_cache_sharded_destroy(LepkCacheSharded *cache);
+/* Retrieve pair count from sharded cache. Only exact while no writes are in flight. */
+LEPKCACHE unsigned long lepk_cache_sharded_count(LepkCacheSharded *cache);
+/* Set the callback called on evicted pairs, called with the shard locked. */
+LEPKCACHE void lepk_cache_sharded_on_evict(LepkCacheSharded *cache, LepkCacheEvict callback, void *user);
+/* Sum of the counters of every shard. */
+LEPKCACHE void lepk_cache_sharded_stats(LepkCacheSharded *cache, LepkCacheStats *stats);
+/* Copy the data stored for key to output, marking it as used. Returns false if key isn't cached. */
+LEPKCACHE bool lepk__cache_sharded_get(LepkCacheSharded *cache, const void *key, void *output);
+/* Set the pair in sharded cache with cost counted against the budget. */
+LEPKCACHE void lepk__cache_sharded_put(LepkCacheSharded *cache, const void *key, const void *data, unsigned long cost);
+/* Remove pair from sharded cache without calling the evict callback. Returns false if key isn't cached. */
+LEPKCACHE bool lepk__cache_sharded_remove(LepkCacheSharded *cache, const void *key, void *output);
+
+#define lepk_cache_put(cache, key, data) do { __typeof__(key) lepk__cache_temp_key = key; __typeof__(data) lepk__cache_temp_data = data; lepk__cache_put(cache, &lepk__cache_temp_key, &lepk__cache_temp_data); } while (0)
+#define lepk_cache_remove(cache, key, output) do { __typeof__(key) lepk__cache_temp_key = key; lepk__cache_remove(cache, &lepk__cache_temp_key, output); } while (0)
+#define lepk_cache_sharded_put(cache, key, data) do { __typeof__(key) lepk__cache_temp_key = key; __typeof__(data) lepk__cache_temp_data = data; lepk__cache_sharded_put(cache, &lepk__cache_temp_key, &lepk__cache_temp_data, 1); } while (0)
+#define lepk_cache_sharded_get(cache, key, output) do { __typeof__(key) lepk__cache_temp_key = key; lepk__cache_sharded_get(cache, &lepk__cache_temp_key, output); } while (0)
+
+#ifdef LEPK_CACHE_TEST
+
+#include <assert.h>
+#include <pthread.h>
+
+static void lepk__cache_test_evict(const void *key, void *data, void *user) {
+	assert(*(const int *) key * 10 == *(int *) data && "lepk_cache evict callback failed.");
+	(*(int *) user)++;
+}
+
+static void *lepk__cache_test_worker(void *arg) {
+	LepkCacheSharded *cache = arg;
+	for (int i = 0; i < 20000; i++) {
+		int key = i % 500;
+		int output;
+		if (lepk__cache_sharded_get(cache, &key, &output)) {
+			assert(output == key * 10 && "lepk_cache_sharded_get failed.");
+		} else {
+			lepk_cache_sharded_put(cache, key, key * 10);
+		}
+	}
+	return NULL;
+}
+
+static void lepk_cache_test(void) {
+	for (int policy = LEPK_CACHE_LRU; policy <= LEPK_CACHE_CLOCK; policy++) {
+		int evicted = 0;
+		LepkCache *cache = lepk_cache_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int), sizeof(int), policy, 4);
+		lepk_cache_on_evict(cache, lepk__cache_test_evict, &evicted);
+		for (int i = 0; i < 4; i++) {
+			lepk_cache_put(cache, i, i * 10);
+		}
+		/* 0 is used, so 1 goes first. */
+		assert(*(int *) lepk_cache_get(cache, &(int) { 0 }) == 0 && "lepk_cache_get failed.");
+		lepk_cache_put(cache, 4, 40);
+		assert(evicted == 1 && lepk_cache_count(cache) == 4 && "lepk_cache eviction failed.");
+		assert(lepk_cache_get(cache, &(int) { 1 }) == NULL && lepk_cache_get(cache, &(int) { 0 }) != NULL && "lepk_cache evicted the wrong pair.");
+
+		lepk__cache_put_cost(cache, &(int) { 5 }, &(int) { 50 }, 3);
+		assert(lepk_cache_cost(cache) <= 4 && lepk_cache_get(cache, &(int) { 5 }) != NULL && "lepk__cache_put_cost failed.");
+		lepk_cache_remove(cache, 5, NULL);
+		assert(lepk_cache_cost(cache) < 4 && lepk_cache_get(cache, &(int) { 5 }) == NULL && "lepk_cache_remove failed.");
+
+		LepkCacheStats stats;
+		lepk_cache_stats(cache, &stats);
+		assert(stats.hits == 3 && stats.misses == 2 && stats.evictions == (unsigned long) evicted && "lepk_cache_stats failed.");
+		lepk_cache_destroy(cache);
+	}
+
+	LepkCacheSharded *cache = lepk_cache_sharded_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int), sizeof(int), LEPK_CACHE_LRU, 1024);
+	pthread_t threads[4];
+	for (int i = 0; i < 4; i++) {
+		pthread_create(&threads[i], NULL, lepk__cache_test_worker, cache);
+	}
+	for (int i = 0; i < 4; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	LepkCacheStats stats;
+	lepk_cache_sharded_stats(cache, &stats);
+	assert(stats.hits + stats.misses == 80000 && lepk_cache_sharded_count(cache) <= 500 && "lepk_cache_sharded failed.");
+	lepk_cache_sharded_destroy(cache);
+}
+
+#endif /* LEPK_CACHE_TEST */
+
+#endif /* LEPK_CACHE_H */
@@ -0,0 +1,140 @@
+/* Version: 1.0 */
+
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2022 Linus Erik Pontus Kåreblom
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Concurrent hash table, safe to share between threads without any external locking.
+ *
+ * Add:
+ *     #define LEPK_CHT_IMPLEMENTATION
+ * in one C or C++ file, before #include "lepk_cht.h", to create the implementation.
+ *
+ * If LEPK_CHT_STATIC is defined the implementation will be local to a single file only.
+ *
+ * Use:
+ *     #define LEPK_CHT_SHARDS [power of two]
+ * to define how many independently locked shards a table is split into.
+ *     #define LEPK_CHT_MAX_THREADS [int]
+ * to define how many threads can use tables at the same time.
+ *
+ * Requires pthreads and the GCC/Clang __atomic builtins.
+ * Uses the hashing and compare callbacks from lepk_ht.h.
+ */
+
+/*
+ * === Documentation ===
+ * Keys and data are stored inline. Every table is split into shards picked by hash,
+ * each one with its own lock, sequence counter and open addressed array.
+ *
+ * Reads never lock. They retry if a writer touched the shard during the read,
+ * so the compare callback may be handed a key that is being overwritten and must not crash on it.
+ * Arrays replaced by a resize are freed once no reader can still be looking at them (epoch based reclamation).
+ */
+
+#ifndef LEPK_CHT_H
+#define LEPK_CHT_H
+
+#ifndef LEPK_CHT_STATIC
+#define LEPKCHT extern
+#else /* LEPK_CHT_STATIC */
+#define LEPKCHT static
+#endif /* LEPK_CHT_STATIC */
+
+#include <stdbool.h>
+
+#include "lepk_ht.h"
+
+/* Concurrent hash table. */
+typedef struct LepkCht LepkCht;
+
+/* Create a concurrent hash table. */
+LEPKCHT LepkCht *lepk_cht_create(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size, unsigned long data_size);
+/* Destroy a concurrent hash table. No other thread may be using it. */
+LEPKCHT void lepk_cht_destroy(LepkCht *table);
+
+/* Retrieve item count from hash table. Only exact while no writes are in flight. */
+LEPKCHT unsigned long lepk_cht_count(const LepkCht *table);
+
+/* Set the pair in hash table. */
+LEPKCHT void lepk__cht_set(LepkCht *table, const void *key, const void *data);
+/* Get pair from hash table. Returns false if key isn't in the table. */
+LEPKCHT bool lepk__cht_get(LepkCht *table, const void *key, void *output);
+/* Remove pair from hash table. Returns false if key isn't in the table. */
+LEPKCHT bool lepk__cht_remove(LepkCht *table, const void *key, void *output);
+
+#define lepk_cht_set(table, key, data) do { __typeof__(key) lepk__cht_temp_key = key; __typeof__(data) lepk__cht_temp_data = data; lepk__cht_set(table, &lepk__cht_temp_key, &lepk__cht_temp_data); } while (0)
+#define lepk_cht_get(table, key, output) do { __typeof__(key) lepk__cht_temp_key = key; lepk__cht_get(table, &lepk__cht_temp_key, output); } while (0)
+#define lepk_cht_remove(table, key, output) do { __typeof__(key) lepk__cht_temp_key = key; lepk__cht_remove(table, &lepk__cht_temp_key, output); } while (0)
+
+#ifdef LEPK_CHT_TEST
+
+#include <assert.h>
+#include <pthread.h>
+
+static void *lepk__cht_test_writer(void *arg) {
+	LepkCht *table = arg;
+	for (int i = 0; i < 20000; i++) {
+		lepk_cht_set(table, i, i + 1);
+	}
+	return NULL;
+}
+
+static void *lepk__cht_test_reader(void *arg) {
+	LepkCht *table = arg;
+	for (int i = 0; i < 20000; i++) {
+		int output = 0;
+		if (lepk__cht_get(table, &i, &output)) {
+			assert(output == i + 1 && "lepk_cht concurrent get failed.");
+		}
+	}
+	return NULL;
+}
+
+static void lepk_cht_test(void) {
+	LepkCht *table = lepk_cht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int), sizeof(int));
+	int output = 0;
+
+	lepk_cht_set(table, 4, 8);
+	lepk_cht_get(table, 4, &output);
+	assert(output == 8 && "lepk_cht_get failed.");
+
+	lepk_cht_remove(table, 4, &output);
+	assert(lepk_cht_count(table) == 0 && "lepk_cht_remove failed.");
+
+	pthread_t threads[4];
+	for (int i = 0; i < 4; i++) {
+		pthread_create(&threads[i], NULL, i % 2 ? lepk__cht_test_reader : lepk__cht_test_writer, table);
+	}
+	for (int i = 0; i < 4; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	assert(lepk_cht_count(table) == 20000 && "lepk_cht concurrent set failed.");
+
+	lepk_cht_destroy(table);
+}
+
+#endif /* LEPK_CHT_TEST */
+
+#endif /* LEPK_CHT_H */
@@ -1,4 +1,4 @@
-/* Version: 1.0 */
+/* Version: 1.8 */
 
 /*
  * MIT License
@@ -32,11 +32,132 @@
  * in one C or C++ file, before #include "lepk_file.h", to create the implementation.
  *
  * If LEPK_FILE_STATIC is defined the implementation will be local to a single file only.
+ *
+ * Use:
+ *     #define LEPK_FILE_WRITER_BUFFER [int]
+ * to change the default buffer size of writers, 256 KiB if not defined.
+ *     #define LEPK_FILE_READER_CHUNK [int]
+ * to change the default chunk size of readers, 1 MiB if not defined.
+ *     #define LEPK_FILE_BATCH_THREADS [int]
+ * to change how many threads batch reads use when io_uring isn't available, 8 if not defined.
+ *
+ *     #define LEPK_FILE_NO_POSIX
+ * to leave out everything that needs POSIX even where it's available.
+ *
+ * Reading, writing, mapping, writers, checksums and hashes work with just the C standard library. Readers, batch and
+ * parallel reads, copies and atomic writes need POSIX and pthreads, and are only declared where LEPK_FILE_POSIX is.
+ * There lepk_file_map maps files and writers sync to disk, elsewhere files are read onto the heap and a writer's sync
+ * only flushes. LEPK_FILE_POSIX is defined on Unix-like systems unless the compiler is in strict ISO C mode, like
+ * -std=c99, which hides the POSIX and Linux calls it needs. Define _GNU_SOURCE before the first system header to get
+ * them back, in every file using them. Offsets are off_t, on 32 bit systems define _FILE_OFFSET_BITS as 64 there too
+ * or the implementation won't compile.
+ */
+
+/*
+ * === Documentation ===
+ * lepk_file_map gives a read-only view of a whole file without copying it. Regular files are mapped,
+ * so pages are read in as they're touched and shared with the page cache instead of duplicated on the heap.
+ * Pipes, devices and files reporting no size, like the ones in /proc, are read into memory instead.
+ * Either way the view is length bytes long and, unlike lepk_file_read's buffer, not zero terminated.
+ * LepkFileView view;
+ * if (lepk_file_map("input.log", LEPK_FILE_ADVICE_SEQUENTIAL, &view) == LEPK_FILE_STATUS_OK) {
+ *     count_lines(view.data, view.length);
+ *     lepk_file_unmap(&view);
+ * }
+ *
+ * lepk_file_write and lepk_file_append open and close the file on every call. For many small writes keep
+ * a LepkFileWriter open instead, writes are gathered in its buffer and reach the file when it fills up, on
+ * flush or on close. Fragments passed together to lepk_file_writer_writev that don't fit in what's left of
+ * the buffer go out in one writev call along with whatever was buffered before them.
+ * Data is only durable once lepk_file_writer_sync returns.
+ * LepkFileWriter *log = lepk_file_writer_open("events.log", true, 0, NULL);
+ * LepkFileFragment record[] = { { stamp, stamp_length }, { message, message_length }, { "\n", 1 } };
+ * lepk_file_writer_writev(log, record, 3);
+ * lepk_file_writer_close(log);
+ *
+ * A LepkFileReader streams a file through a few fixed size chunks, so memory use doesn't grow with the file.
+ * With read_ahead a background thread keeps the next chunks filled while the current one is processed.
+ * lepk_file_reader_line hands out records ending in a delimiter, pointing straight into the chunk. Only a
+ * record spanning two chunks is pieced together in a separate buffer, which is as big as the longest such record.
+ * What either call hands out stays valid until the next call on the reader.
+ * LepkFileReader *reader = lepk_file_reader_open("input.log", 0, true, NULL);
+ * const char *line;
+ * unsigned long length;
+ * while (lepk_file_reader_line(reader, '\n', &line, &length)) {
+ *     parse(line, length);
+ * }
+ * lepk_file_reader_close(reader);
+ *
+ * lepk_file_read_batch reads many small files into buffers the caller provides. On Linux it queues the opens,
+ * reads and closes of hundreds of files at a time on an io_uring, so a whole batch costs a handful of system
+ * calls. Where io_uring is missing or disabled a pool of threads reads the files instead.
+ * Each file is read with a single read, which for regular files is all of it, up to the buffer's capacity.
+ * LepkFileBatchRead reads[2] = {
+ *     { .filepath = "a.json", .buffer = a, .capacity = sizeof(a) },
+ *     { .filepath = "b.json", .buffer = b, .capacity = sizeof(b) },
+ * };
+ * if (lepk_file_read_batch(reads, 2, 0) != LEPK_FILE_STATUS_OK) {
+ *     check reads[i].status;
+ * }
+ *
+ * lepk_file_read_parallel loads a whole file with several threads, each reading its own 4 MiB blocks with pread,
+ * which keeps a fast drive busier than one stream does. Sizes and offsets are 64 bit, so it works on files lepk_file_read's
+ * long can't describe. With huge_pages the buffer is mapped and asked to be backed by transparent huge pages,
+ * fewer TLB misses when the file is scanned afterwards. The contents come back as a view, released with lepk_file_unmap.
+ * LepkFileView view;
+ * if (lepk_file_read_parallel("dataset.bin", 0, true, &view) == LEPK_FILE_STATUS_OK) {
+ *     process(view.data, view.length);
+ *     lepk_file_unmap(&view);
+ * }
+ *
+ * lepk_file_copy, lepk_file_concat and lepk_file_copy_range copy inside the kernel instead of reading into and
+ * writing out of user space. A whole file copy first tries to share the source's extents (a reflink) on filesystems
+ * that support it, then copy_file_range, then sendfile, and only then read and write by hand.
+ * const char *parts[] = { "header.bin", "body.bin" };
+ * lepk_file_concat("packet.bin", parts, 2);
+ *
+ * lepk_file_write truncates the file and writes it in place, a crash half way leaves it torn. lepk_file_write_atomic
+ * writes a temporary file next to it and renames it over the old one, so readers see either the old or the new
+ * contents in full. How much survives losing power depends on the durability level, each costing a sync more:
+ * LEPK_FILE_DURABILITY_NONE     Atomic if the program crashes, the OS decides when it reaches the disk.
+ * LEPK_FILE_DURABILITY_DATA     The new contents are on disk before they replace the old, but the rename may still be lost.
+ * LEPK_FILE_DURABILITY_FULL     The rename is on disk too when the call returns.
+ * A LepkFileGroup commits many such writes at once. Their writeback is started together and consecutive writes to the
+ * same directory share its sync, so a group of files costs about as much waiting as one.
+ * LepkFileGroup *group = lepk_file_group_create(LEPK_FILE_DURABILITY_FULL);
+ * lepk_file_group_write(group, "index.json", index, index_length);
+ * lepk_file_group_write(group, "data.bin", data, data_length);
+ * lepk_file_group_commit(group);
+ * lepk_file_group_destroy(group);
+ *
+ * lepk_file_crc32c checksums with CRC-32C, using the crc32 instruction on x86-64 CPUs with SSE4.2 and slicing-by-8 tables
+ * elsewhere. Both give the same values. It picks up where the last call left off, so a file can be checked piece by piece.
+ * lepk_file_crc32c_combine joins the CRCs of two pieces checked separately, which is how lepk_file_checksum spreads a
+ * mapped file over threads, 4 MiB blocks at a time. lepk_file_hash is a fast non-cryptographic 128 bit content hash,
+ * low on its own is a 64 bit one. A LepkFileHasher feeds it piece by piece and lepk_file_digest hashes a mapped file.
+ * Neither is safe against someone crafting collisions on purpose.
+ * LepkFileReader *reader = lepk_file_reader_open("backup.tar", 0, true, NULL);
+ * LepkFileHasher hasher;
+ * lepk_file_hasher_init(&hasher, 0);
+ * uint32_t crc = 0;
+ * const char *chunk;
+ * unsigned long length;
+ * while (lepk_file_reader_next(reader, &chunk, &length)) {
+ *     crc = lepk_file_crc32c(crc, chunk, length);
+ *     lepk_file_hasher_update(&hasher, chunk, length);
+ * }
+ * LepkFileHash hash = lepk_file_hasher_final(&hasher);
+ * lepk_file_reader_close(reader);
  */
 
 #ifndef LEPK_FILE_H
 #define LEPK_FILE_H
 
+/* Strict ISO C hides the POSIX calls unless they were asked for, fall back to stdio instead of failing to compile. */
+#if defined(__unix__) && !defined(LEPK_FILE_NO_POSIX) && (!defined(__STRICT_ANSI__) || defined(_GNU_SOURCE) || defined(_DEFAULT_SOURCE))
+#define LEPK_FILE_POSIX
+#endif /* defined(__unix__) && !defined(LEPK_FILE_NO_POSIX) && (!defined(__STRICT_ANSI__) || defined(_GNU_SOURCE) || defined(_DEFAULT_SOURCE)) */
+
 #ifdef LEPK_FILE_STATIC
 #define LEPKFILE static
 #define LEPKFILEIMPL static
@@ -46,6 +167,7 @@
 #endif /* LEPK_FILE_STATIC */
 
 #include <stdbool.h>
+#include <stdint.h>
 
 /* How a file should be opened. */
 typedef enum {
@@ -65,8 +187,82 @@ typedef enum {
 	LEPK_FILE_STATUS_OUT_OF_MEMORY,
 	/* Deleting file failed. */
 	LEPK_FILE_STATUS_REMOVE_FAILED,
+	/* Reading or mapping file failed. */
+	LEPK_FILE_STATUS_READ_FAILED,
+	/* Writing, flushing or syncing file failed. */
+	LEPK_FILE_STATUS_WRITE_FAILED,
+	/* Destination of a copy is also its source. */
+	LEPK_FILE_STATUS_SAME_FILE,
 } LepkFileStatus;
 
+/* How a mapped file is going to be accessed, lets the OS read ahead or not. */
+typedef enum {
+	LEPK_FILE_ADVICE_NORMAL,
+	/* Front to back, read ahead aggressively and drop pages behind. */
+	LEPK_FILE_ADVICE_SEQUENTIAL,
+	/* Scattered, don't read ahead. */
+	LEPK_FILE_ADVICE_RANDOM,
+	/* All of it soon, start reading it in now. */
+	LEPK_FILE_ADVICE_WILLNEED,
+} LepkFileAdvice;
+
+/* Read-only view of the contents of a file. */
+typedef struct {
+	const char *data;
+	uint64_t length;
+	/* Whether data is mapped or was read onto the heap. */
+	bool mapped;
+} LepkFileView;
+
+/* What an atomic write survives, see the documentation. */
+typedef enum {
+	LEPK_FILE_DURABILITY_NONE,
+	LEPK_FILE_DURABILITY_DATA,
+	LEPK_FILE_DURABILITY_FULL,
+} LepkFileDurability;
+
+/* Atomic writes committed together. */
+typedef struct LepkFileGroup LepkFileGroup;
+
+/* Buffered handle to a file kept open between writes. */
+typedef struct LepkFileWriter LepkFileWriter;
+
+/* Streaming handle reading a file chunk by chunk. */
+typedef struct LepkFileReader LepkFileReader;
+
+/* One file of a batch read. */
+typedef struct {
+	const char *filepath;
+	/* Where the contents go, capacity bytes long. Longer files are cut short. */
+	char *buffer;
+	unsigned long capacity;
+	/* Set by the read. */
+	unsigned long length;
+	LepkFileStatus status;
+} LepkFileBatchRead;
+
+/* 128 bit content hash. */
+typedef struct {
+	uint64_t low;
+	uint64_t high;
+} LepkFileHash;
+
+/* Content hash being fed piece by piece. */
+typedef struct {
+	uint64_t lanes[4];
+	uint64_t seed;
+	uint64_t length;
+	/* Bytes short of a whole stripe, kept until the next update. */
+	unsigned char stripe[32];
+	unsigned long buffered;
+} LepkFileHasher;
+
+/* One piece of a vectored write. */
+typedef struct {
+	const void *data;
+	unsigned long length;
+} LepkFileFragment;
+
 /* Read file and return its contents. NULL return value means function failed, read status for more specific error. */
 LEPKFILE char *lepk_file_read(const char *filepath, LepkFileStatus *status);
 /* Write content to file at filepath. */
@@ -79,6 +275,82 @@ LEPKFILE LepkFileStatus lepk_file_create(const char *filepath);
 LEPKFILE LepkFileStatus lepk_file_remove(const char *filepath);
 /* Check if file exists at filepath. */
 LEPKFILE bool lepk_file_exists(const char *filepath);
+/* Map file at filepath into view, falling back to reading it when it can't be mapped. */
+LEPKFILE LepkFileStatus lepk_file_map(const char *filepath, LepkFileAdvice advice, LepkFileView *view);
+/* Release a view from lepk_file_map. */
+LEPKFILE void lepk_file_unmap(LepkFileView *view);
+/*
+ * Open file at filepath for buffered writing, truncating it unless append is set.
+ * buffer_size of 0 uses LEPK_FILE_WRITER_BUFFER. NULL return value means function failed, read status for more specific error.
+ */
+LEPKFILE LepkFileWriter *lepk_file_writer_open(const char *filepath, bool append, unsigned long buffer_size, LepkFileStatus *status);
+/* Write length bytes of data. */
+LEPKFILE LepkFileStatus lepk_file_writer_write(LepkFileWriter *writer, const void *data, unsigned long length);
+/* Write count fragments back to back. */
+LEPKFILE LepkFileStatus lepk_file_writer_writev(LepkFileWriter *writer, const LepkFileFragment *fragments, unsigned long count);
+/* Hand everything buffered to the OS. */
+LEPKFILE LepkFileStatus lepk_file_writer_flush(LepkFileWriter *writer);
+/* Flush and wait until the data is on disk, only flush without POSIX. */
+LEPKFILE LepkFileStatus lepk_file_writer_sync(LepkFileWriter *writer);
+/* Offset in the file the next write lands at. */
+LEPKFILE uint64_t lepk_file_writer_offset(const LepkFileWriter *writer);
+/* Flush, close the file and free writer. Writer is freed even if the flush fails. */
+LEPKFILE LepkFileStatus lepk_file_writer_close(LepkFileWriter *writer);
+#ifdef LEPK_FILE_POSIX
+/*
+ * Open file at filepath for streaming, chunk_size bytes at a time. chunk_size of 0 uses LEPK_FILE_READER_CHUNK.
+ * read_ahead reads the next chunks on a background thread. NULL return value means function failed, read status for more specific error.
+ */
+LEPKFILE LepkFileReader *lepk_file_reader_open(const char *filepath, unsigned long chunk_size, bool read_ahead, LepkFileStatus *status);
+/* Next piece of the file, up to a chunk long. Returns false at the end of the file or if reading failed. */
+LEPKFILE bool lepk_file_reader_next(LepkFileReader *reader, const char **data, unsigned long *length);
+/* Next record ending in delimiter, without the delimiter. The last record doesn't need one. Returns false at the end of the file or if reading failed. */
+LEPKFILE bool lepk_file_reader_line(LepkFileReader *reader, char delimiter, const char **line, unsigned long *length);
+/* Why the reader stopped, LEPK_FILE_STATUS_OK if it only reached the end of the file. */
+LEPKFILE LepkFileStatus lepk_file_reader_status(const LepkFileReader *reader);
+/* Stop reading, close the file and free reader. */
+LEPKFILE void lepk_file_reader_close(LepkFileReader *reader);
+/*
+ * Read count files at once, filling in length and status of each. threads of 0 uses io_uring where available,
+ * anything else reads with that many threads. Returns the first status that isn't LEPK_FILE_STATUS_OK, if any.
+ */
+LEPKFILE LepkFileStatus lepk_file_read_batch(LepkFileBatchRead *reads, unsigned long count, unsigned long threads);
+/* Read file at filepath into view with threads threads, 0 uses one per CPU. huge_pages backs the view with huge pages where the OS can. */
+LEPKFILE LepkFileStatus lepk_file_read_parallel(const char *filepath, unsigned long threads, bool huge_pages, LepkFileView *view);
+/* Copy file at source to destination, replacing it. Fails without touching either if they're the same file. */
+LEPKFILE LepkFileStatus lepk_file_copy(const char *source, const char *destination);
+/* Write count files at sources back to back into destination, replacing it. Fails without touching it if it's one of the sources. */
+LEPKFILE LepkFileStatus lepk_file_concat(const char *destination, const char *const *sources, unsigned long count);
+/* Copy length bytes of source at source_offset into destination at destination_offset, creating destination if needed. Fails if source ends first. */
+LEPKFILE LepkFileStatus lepk_file_copy_range(const char *source, uint64_t source_offset, const char *destination, uint64_t destination_offset, uint64_t length);
+/* Replace file at filepath with content in one step, readers never see a partial file. */
+LEPKFILE LepkFileStatus lepk_file_write_atomic(const char *filepath, const char *content, unsigned long length, LepkFileDurability durability);
+/* Create an empty group of atomic writes made durable to durability. */
+LEPKFILE LepkFileGroup *lepk_file_group_create(LepkFileDurability durability);
+/* Write content for filepath, it replaces the file on the next commit. */
+LEPKFILE LepkFileStatus lepk_file_group_write(LepkFileGroup *group, const char *filepath, const char *content, unsigned long length);
+/* Sync and put every pending write in place, in the order they were made. The group is empty afterwards, even if it fails. */
+LEPKFILE LepkFileStatus lepk_file_group_commit(LepkFileGroup *group);
+/* Drop writes not committed yet and free group. */
+LEPKFILE void lepk_file_group_destroy(LepkFileGroup *group);
+#endif /* LEPK_FILE_POSIX */
+
+/* CRC-32C of length bytes at data following bytes whose CRC-32C is crc, 0 to start. */
+LEPKFILE uint32_t lepk_file_crc32c(uint32_t crc, const void *data, unsigned long length);
+/* CRC-32C of two pieces back to back, from the CRC-32C of each and the length of the second. */
+LEPKFILE uint32_t lepk_file_crc32c_combine(uint32_t first, uint32_t second, uint64_t second_length);
+/* CRC-32C of file at filepath, checked by threads threads, 0 means one per CPU. Without POSIX it's checked by the calling thread. */
+LEPKFILE LepkFileStatus lepk_file_checksum(const char *filepath, unsigned long threads, uint32_t *crc);
+/* Content hash of length bytes at data. */
+LEPKFILE LepkFileHash lepk_file_hash(const void *data, unsigned long length, uint64_t seed);
+/* Start a content hash, hashes with different seeds are unrelated. */
+LEPKFILE void lepk_file_hasher_init(LepkFileHasher *hasher, uint64_t seed);
+/* Feed length bytes at data to the hash. */
+LEPKFILE void lepk_file_hasher_update(LepkFileHasher *hasher, const void *data, unsigned long length);
+/* Content hash of everything fed so far, the same as lepk_file_hash on it in one piece. */
+LEPKFILE LepkFileHash lepk_file_hasher_final(const LepkFileHasher *hasher);
+/* Content hash of file at filepath. */
+LEPKFILE LepkFileStatus lepk_file_digest(const char *filepath, uint64_t seed, LepkFileHash *hash);
 
 #ifdef LEPK_FILE_TEST
 
@@ -102,6 +374,182 @@ static void lepk_file_test(void) {
 
 	char *content = lepk_file_read("file_test.txt", &status);
 	assert(strcmp(content, "Hello World!World Hello!") == 0 && "lepk_file_read failed!");
+	free(content);
+
+	LepkFileView view;
+	status = lepk_file_map("file_test.txt", LEPK_FILE_ADVICE_SEQUENTIAL, &view);
+	assert(status == LEPK_FILE_STATUS_OK && view.length == 24 && memcmp(view.data, "Hello World!", 12) == 0 && "lepk_file_map failed.");
+#ifdef LEPK_FILE_POSIX
+	assert(view.mapped && "lepk_file_map failed.");
+#endif /* LEPK_FILE_POSIX */
+	lepk_file_unmap(&view);
+	lepk_file_write("file_test.txt", "", 0, LEPK_FILE_MODE_BINARY);
+	status = lepk_file_map("file_test.txt", LEPK_FILE_ADVICE_NORMAL, &view);
+	assert(status == LEPK_FILE_STATUS_OK && !view.mapped && view.length == 0 && "lepk_file_map failed.");
+	lepk_file_unmap(&view);
+	assert(lepk_file_map("file_test_missing.txt", LEPK_FILE_ADVICE_NORMAL, &view) == LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE && "lepk_file_map failed.");
+
+	LepkFileWriter *writer = lepk_file_writer_open("file_test.txt", false, 8, &status);
+	assert(writer != NULL && status == LEPK_FILE_STATUS_OK && "lepk_file_writer_open failed.");
+	lepk_file_writer_write(writer, "Hello", 5);
+	LepkFileFragment fragments[] = { { " ", 1 }, { "", 0 }, { "World", 5 }, { "!", 1 } };
+	status = lepk_file_writer_writev(writer, fragments, 4);
+	assert(status == LEPK_FILE_STATUS_OK && lepk_file_writer_offset(writer) == 12 && "lepk_file_writer_writev failed.");
+	lepk_file_writer_write(writer, "0123456789abcdef", 16);
+	status = lepk_file_writer_sync(writer);
+	assert(status == LEPK_FILE_STATUS_OK && "lepk_file_writer_sync failed.");
+	lepk_file_writer_write(writer, "\n", 1);
+	status = lepk_file_writer_close(writer);
+	assert(status == LEPK_FILE_STATUS_OK && "lepk_file_writer_close failed.");
+	writer = lepk_file_writer_open("file_test.txt", true, 0, NULL);
+	assert(lepk_file_writer_offset(writer) == 29 && "lepk_file_writer_open failed.");
+	lepk_file_writer_write(writer, "end", 3);
+	lepk_file_writer_close(writer);
+	content = lepk_file_read("file_test.txt", NULL);
+	assert(strcmp(content, "Hello World!0123456789abcdef\nend") == 0 && "lepk_file_writer failed.");
+	free(content);
+	lepk_file_write("file_test.txt", "ab\n\ncdefghijklmnopqrstuvwxyz0123456789\nlast", 43, LEPK_FILE_MODE_BINARY);
+#ifdef LEPK_FILE_POSIX
+	/* Tiny chunks, so records span chunk boundaries, and a record longer than a chunk. */
+	for (int read_ahead = 0; read_ahead < 2; read_ahead++) {
+		LepkFileReader *reader = lepk_file_reader_open("file_test.txt", 4, read_ahead, &status);
+		assert(reader != NULL && status == LEPK_FILE_STATUS_OK && "lepk_file_reader_open failed.");
+		const char *expected[] = { "ab", "", "cdefghijklmnopqrstuvwxyz0123456789", "last" };
+		const char *line;
+		unsigned long length;
+		for (int i = 0; i < 4; i++) {
+			bool found = lepk_file_reader_line(reader, '\n', &line, &length);
+			assert(found && length == strlen(expected[i]) && memcmp(line, expected[i], length) == 0 && "lepk_file_reader_line failed.");
+		}
+		assert(!lepk_file_reader_line(reader, '\n', &line, &length) && lepk_file_reader_status(reader) == LEPK_FILE_STATUS_OK && "lepk_file_reader_line failed.");
+		lepk_file_reader_close(reader);
+
+		reader = lepk_file_reader_open("file_test.txt", 16, read_ahead, NULL);
+		unsigned long total = 0;
+		while (lepk_file_reader_next(reader, &line, &length)) {
+			assert(length <= 16 && "lepk_file_reader_next failed.");
+			total += length;
+		}
+		assert(total == 43 && "lepk_file_reader_next failed.");
+		lepk_file_reader_close(reader);
+	}
+	char buffers[3][16];
+	LepkFileBatchRead reads[3] = {
+		{ "file_test.txt", buffers[0], sizeof(buffers[0]), 0, LEPK_FILE_STATUS_OK },
+		{ "file_test_missing.txt", buffers[1], sizeof(buffers[1]), 0, LEPK_FILE_STATUS_OK },
+		{ "file_test.txt", buffers[2], 4, 0, LEPK_FILE_STATUS_OK },
+	};
+	for (unsigned long threads = 0; threads < 3; threads += 2) {
+		status = lepk_file_read_batch(reads, 3, threads);
+		assert(status == LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE && "lepk_file_read_batch failed.");
+		assert(reads[0].status == LEPK_FILE_STATUS_OK && reads[0].length == 16 && memcmp(buffers[0], "ab\n\ncdefghijklmn", 16) == 0 && "lepk_file_read_batch failed.");
+		assert(reads[1].status == LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE && "lepk_file_read_batch failed.");
+		assert(reads[2].status == LEPK_FILE_STATUS_OK && reads[2].length == 4 && memcmp(buffers[2], "ab\n\n", 4) == 0 && "lepk_file_read_batch failed.");
+	}
+	for (int huge_pages = 0; huge_pages < 2; huge_pages++) {
+		status = lepk_file_read_parallel("file_test.txt", 3, huge_pages, &view);
+		assert(status == LEPK_FILE_STATUS_OK && view.length == 43 && memcmp(view.data, "ab\n\ncdef", 8) == 0 && memcmp(view.data + 39, "last", 4) == 0 && "lepk_file_read_parallel failed.");
+		lepk_file_unmap(&view);
+	}
+#endif /* LEPK_FILE_POSIX */
+	assert(lepk_file_crc32c(0, "123456789", 9) == 0xe3069283 && lepk_file_crc32c(0, "", 0) == 0 && "lepk_file_crc32c failed.");
+	assert(lepk_file_crc32c_combine(lepk_file_crc32c(0, "1234", 4), lepk_file_crc32c(0, "56789", 5), 5) == 0xe3069283 && "lepk_file_crc32c_combine failed.");
+	/* Joining with a CRC of 0 shifts over zero bytes, twice by length has to match once by twice that, past 2^32 bits too. */
+	for (uint64_t shift = (uint64_t) 1 << 26; shift <= (uint64_t) 1 << 40; shift <<= 1) {
+		uint32_t twice = lepk_file_crc32c_combine(lepk_file_crc32c_combine(0xe3069283, 0, shift), 0, shift + 12345);
+		assert(twice == lepk_file_crc32c_combine(0xe3069283, 0, 2 * shift + 12345) && "lepk_file_crc32c_combine failed.");
+	}
+	content = lepk_file_read("file_test.txt", NULL);
+	uint32_t crc = lepk_file_crc32c(0, content, 43);
+	LepkFileHash hash = lepk_file_hash(content, 43, 0);
+	LepkFileHash seeded = lepk_file_hash(content, 43, 1);
+	assert(seeded.low != hash.low && seeded.high != hash.high && "lepk_file_hash failed.");
+	free(content);
+	uint32_t file_crc;
+	status = lepk_file_checksum("file_test.txt", 3, &file_crc);
+	assert(status == LEPK_FILE_STATUS_OK && file_crc == crc && "lepk_file_checksum failed.");
+	LepkFileHash file_hash;
+	status = lepk_file_digest("file_test.txt", 0, &file_hash);
+	assert(status == LEPK_FILE_STATUS_OK && file_hash.low == hash.low && file_hash.high == hash.high && "lepk_file_digest failed.");
+#ifdef LEPK_FILE_POSIX
+	/* Streamed through a reader in odd sized chunks. */
+	LepkFileReader *reader = lepk_file_reader_open("file_test.txt", 5, false, NULL);
+	LepkFileHasher hasher;
+	const char *chunk;
+	unsigned long length;
+	lepk_file_hasher_init(&hasher, 0);
+	uint32_t stream_crc = 0;
+	while (lepk_file_reader_next(reader, &chunk, &length)) {
+		stream_crc = lepk_file_crc32c(stream_crc, chunk, length);
+		lepk_file_hasher_update(&hasher, chunk, length);
+	}
+	lepk_file_reader_close(reader);
+	file_hash = lepk_file_hasher_final(&hasher);
+	assert(stream_crc == crc && file_hash.low == hash.low && file_hash.high == hash.high && "lepk_file_hasher_update failed.");
+#endif /* LEPK_FILE_POSIX */
+	/* Long enough for the interleaved stripes of the crc32 instruction. */
+	unsigned char *bytes = malloc(100000);
+	for (int i = 0; i < 100000; i++) {
+		bytes[i] = (unsigned char) (i * 7 + (i >> 8));
+	}
+	crc = lepk_file_crc32c(0, bytes, 100000);
+	assert(crc == lepk_file_crc32c(lepk_file_crc32c(0, bytes, 12345), bytes + 12345, 100000 - 12345) && crc == lepk_file_crc32c_combine(lepk_file_crc32c(0, bytes, 77777), lepk_file_crc32c(0, bytes + 77777, 100000 - 77777), 100000 - 77777) && "lepk_file_crc32c failed.");
+	free(bytes);
+#ifdef LEPK_FILE_POSIX
+	status = lepk_file_copy("file_test.txt", "file_test_copy.txt");
+	content = lepk_file_read("file_test_copy.txt", NULL);
+	assert(status == LEPK_FILE_STATUS_OK && strncmp(content, "ab\n\ncdef", 8) == 0 && strlen(content) == 43 && "lepk_file_copy failed.");
+	free(content);
+	const char *parts[] = { "file_test_copy.txt", "file_test.txt" };
+	status = lepk_file_concat("file_test_copy.txt", parts + 1, 1);
+	assert(status == LEPK_FILE_STATUS_OK && "lepk_file_concat failed.");
+	status = lepk_file_concat("file_test_joined.txt", parts, 2);
+	content = lepk_file_read("file_test_joined.txt", NULL);
+	assert(status == LEPK_FILE_STATUS_OK && strlen(content) == 86 && strncmp(content + 39, "lastab\n", 7) == 0 && "lepk_file_concat failed.");
+	free(content);
+	status = lepk_file_copy_range("file_test.txt", 39, "file_test_joined.txt", 0, 4);
+	content = lepk_file_read("file_test_joined.txt", NULL);
+	assert(status == LEPK_FILE_STATUS_OK && strlen(content) == 86 && strncmp(content, "lastcdef", 8) == 0 && "lepk_file_copy_range failed.");
+	free(content);
+	status = lepk_file_copy_range("file_test.txt", 40, "file_test_joined.txt", 0, 4);
+	assert(status == LEPK_FILE_STATUS_READ_FAILED && "lepk_file_copy_range failed.");
+	assert(lepk_file_copy("file_test_missing.txt", "file_test_copy.txt") == LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE && "lepk_file_copy failed.");
+	assert(lepk_file_copy("file_test.txt", "./file_test.txt") == LEPK_FILE_STATUS_SAME_FILE && "lepk_file_copy failed.");
+	assert(lepk_file_concat("file_test_joined.txt", parts, 2) == LEPK_FILE_STATUS_OK && lepk_file_concat("file_test.txt", parts, 2) == LEPK_FILE_STATUS_SAME_FILE && "lepk_file_concat failed.");
+	content = lepk_file_read("file_test.txt", NULL);
+	assert(strlen(content) == 43 && "lepk_file_concat failed.");
+	free(content);
+	lepk_file_remove("file_test_copy.txt");
+	lepk_file_remove("file_test_joined.txt");
+	for (int durability = LEPK_FILE_DURABILITY_NONE; durability <= LEPK_FILE_DURABILITY_FULL; durability++) {
+		status = lepk_file_write_atomic("file_test_copy.txt", "atomic", 6 - durability, durability);
+		content = lepk_file_read("file_test_copy.txt", NULL);
+		assert(status == LEPK_FILE_STATUS_OK && strlen(content) == 6ul - durability && strncmp(content, "atomic", 6 - durability) == 0 && "lepk_file_write_atomic failed.");
+		free(content);
+	}
+	LepkFileGroup *group = lepk_file_group_create(LEPK_FILE_DURABILITY_FULL);
+	lepk_file_group_write(group, "file_test_copy.txt", "first", 5);
+	lepk_file_group_write(group, "file_test_joined.txt", "second", 6);
+	lepk_file_group_write(group, "file_test_copy.txt", "third", 5);
+	content = lepk_file_read("file_test_copy.txt", NULL);
+	assert(strcmp(content, "atom") == 0 && "lepk_file_group_write failed.");
+	free(content);
+	status = lepk_file_group_commit(group);
+	content = lepk_file_read("file_test_copy.txt", NULL);
+	assert(status == LEPK_FILE_STATUS_OK && strcmp(content, "third") == 0 && "lepk_file_group_commit failed.");
+	free(content);
+	lepk_file_group_write(group, "file_test_joined.txt", "dropped", 7);
+	lepk_file_group_destroy(group);
+	content = lepk_file_read("file_test_joined.txt", NULL);
+	assert(strcmp(content, "second") == 0 && "lepk_file_group_destroy failed.");
+	free(content);
+	assert(lepk_file_write_atomic("file_test_missing/file_test.txt", "", 0, LEPK_FILE_DURABILITY_NONE) == LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE && "lepk_file_write_atomic failed.");
+	lepk_file_remove("file_test_copy.txt");
+	lepk_file_remove("file_test_joined.txt");
+	assert(lepk_file_read_parallel("file_test_missing.txt", 0, false, &view) == LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE && "lepk_file_read_parallel failed.");
+	assert(lepk_file_reader_open("file_test_missing.txt", 0, false, &status) == NULL && status == LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE && "lepk_file_reader_open failed.");
+#endif /* LEPK_FILE_POSIX */
+	assert(lepk_file_writer_open("file_test_missing/file_test.txt", false, 0, &status) == NULL && status == LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE && "lepk_file_writer_open failed.");
 
 	lepk_file_remove("file_test.txt");
 	exists = lepk_file_exists("file_test.txt");
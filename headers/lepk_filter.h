@@ -0,0 +1,189 @@
+/* Version: 1.0 */
+
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2022 Linus Erik Pontus Kåreblom
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Probabilistic membership filters: a blocked Bloom filter and a cuckoo filter.
+ *
+ * Add:
+ *     #define LEPK_FILTER_IMPLEMENTATION
+ * in one C or C++ file, before #include "lepk_filter.h", to create the implementation.
+ *
+ * If LEPK_FILTER_STATIC is defined the implementation will be local to a single file only.
+ *
+ * Uses the hashing callbacks from lepk_ht.h.
+ */
+
+/*
+ * === Documentation ===
+ * Filters answer "definitely not in the set" or "probably in the set", in a few bits per key.
+ * Put one in front of a lepk_ht whose lookups mostly miss, and most misses never touch the table.
+ * Both are sized from the amount of keys they should hold and a target false positive rate.
+ *
+ * The Bloom filter sets 8 bits in a single 32 byte block per key, so a lookup is one cache miss.
+ * Keys can't be removed from it.
+ * The cuckoo filter stores a fingerprint per key in one of two buckets and supports removing,
+ * but adding fails once it's close to full.
+ *
+ * Usage:
+ * LepkBloom *bloom = lepk_bloom_create(lepk_ht_hash_generic, sizeof(int), 10000, 0.01);
+ * lepk_bloom_add(bloom, &key);
+ * if (lepk_bloom_contains(bloom, &key)) {
+ *     found = lepk_ht_find(table, &key);
+ * }
+ *
+ * Storing and loading, using lepk_file.h:
+ * unsigned long length;
+ * void *image = lepk_bloom_serialize(bloom, &length);
+ * lepk_file_write("keys.bloom", image, length, LEPK_FILE_MODE_BINARY);
+ * char *content = lepk_file_read("keys.bloom", NULL);
+ * LepkBloom *loaded = lepk_bloom_load(lepk_ht_hash_generic, content, 0);
+ *
+ * The hashing function isn't stored, load with the one the filter was created with.
+ * Images use the byte order of the machine that built them.
+ */
+
+#ifndef LEPK_FILTER_H
+#define LEPK_FILTER_H
+
+#ifndef LEPK_FILTER_STATIC
+#define LEPKFILTER extern
+#else /* LEPK_FILTER_STATIC */
+#define LEPKFILTER static
+#endif /* LEPK_FILTER_STATIC */
+
+#include <stdbool.h>
+
+#include "lepk_ht.h"
+
+/* Blocked Bloom filter. */
+typedef struct LepkBloom LepkBloom;
+/* Cuckoo filter. */
+typedef struct LepkCuckoo LepkCuckoo;
+
+/* Create a Bloom filter for capacity keys of key_size bytes, with false positive rate fpr between 0 and 1. */
+LEPKFILTER LepkBloom *lepk_bloom_create(LepkHtHash hash, unsigned long key_size, unsigned long capacity, double fpr);
+/* Destroy a Bloom filter. */
+LEPKFILTER void lepk_bloom_destroy(LepkBloom *bloom);
+/* Add key to the filter. */
+LEPKFILTER void lepk_bloom_add(LepkBloom *bloom, const void *key);
+/* False if key was never added, true if it probably was. */
+LEPKFILTER bool lepk_bloom_contains(const LepkBloom *bloom, const void *key);
+/* Forget every key. */
+LEPKFILTER void lepk_bloom_clear(LepkBloom *bloom);
+/* Memory held by the filter in bytes. */
+LEPKFILTER unsigned long lepk_bloom_bytes(const LepkBloom *bloom);
+/* Serialize to a malloc'd image of length bytes. */
+LEPKFILTER void *lepk_bloom_serialize(const LepkBloom *bloom, unsigned long *length);
+/* Load a serialized image, the buffer is copied. Length 0 trusts the size stored in the image. NULL if the image is invalid. */
+LEPKFILTER LepkBloom *lepk_bloom_load(LepkHtHash hash, const void *buffer, unsigned long length);
+
+/* Create a cuckoo filter for capacity keys of key_size bytes, with false positive rate fpr between 0 and 1. */
+LEPKFILTER LepkCuckoo *lepk_cuckoo_create(LepkHtHash hash, unsigned long key_size, unsigned long capacity, double fpr);
+/* Destroy a cuckoo filter. */
+LEPKFILTER void lepk_cuckoo_destroy(LepkCuckoo *cuckoo);
+/* Retrieve key count from the filter. */
+LEPKFILTER unsigned long lepk_cuckoo_count(const LepkCuckoo *cuckoo);
+/* Add key to the filter. Returns false if the filter is full, the key is still found but nothing more can be added. */
+LEPKFILTER bool lepk_cuckoo_add(LepkCuckoo *cuckoo, const void *key);
+/* False if key isn't in the filter, true if it probably is. */
+LEPKFILTER bool lepk_cuckoo_contains(const LepkCuckoo *cuckoo, const void *key);
+/* Remove key from the filter. Only remove keys that were added, or another key may be removed in its place. */
+LEPKFILTER bool lepk_cuckoo_remove(LepkCuckoo *cuckoo, const void *key);
+/* Memory held by the filter in bytes. */
+LEPKFILTER unsigned long lepk_cuckoo_bytes(const LepkCuckoo *cuckoo);
+/* Serialize to a malloc'd image of length bytes. */
+LEPKFILTER void *lepk_cuckoo_serialize(const LepkCuckoo *cuckoo, unsigned long *length);
+/* Load a serialized image, the buffer is copied. Length 0 trusts the size stored in the image. NULL if the image is invalid. */
+LEPKFILTER LepkCuckoo *lepk_cuckoo_load(LepkHtHash hash, const void *buffer, unsigned long length);
+
+#ifdef LEPK_FILTER_TEST
+
+#include <assert.h>
+#include <malloc.h>
+
+static void lepk_filter_test(void) {
+	LepkBloom *bloom = lepk_bloom_create(lepk_ht_hash_generic, sizeof(int), 10000, 0.01);
+	LepkCuckoo *cuckoo = lepk_cuckoo_create(lepk_ht_hash_generic, sizeof(int), 10000, 0.01);
+	for (int i = 0; i < 10000; i++) {
+		lepk_bloom_add(bloom, &i);
+		assert(lepk_cuckoo_add(cuckoo, &i) && "lepk_cuckoo_add failed.");
+	}
+	assert(lepk_cuckoo_count(cuckoo) == 10000 && "lepk_cuckoo_count failed.");
+
+	int bloom_positives = 0;
+	int cuckoo_positives = 0;
+	for (int i = 0; i < 20000; i++) {
+		bool bloom_found = lepk_bloom_contains(bloom, &i);
+		bool cuckoo_found = lepk_cuckoo_contains(cuckoo, &i);
+		if (i < 10000) {
+			assert(bloom_found && cuckoo_found && "lepk filter lost a key.");
+		} else {
+			bloom_positives += bloom_found;
+			cuckoo_positives += cuckoo_found;
+		}
+	}
+	assert(bloom_positives < 300 && "lepk_bloom false positive rate too high.");
+	assert(cuckoo_positives < 300 && "lepk_cuckoo false positive rate too high.");
+
+	for (int i = 0; i < 10000; i += 2) {
+		assert(lepk_cuckoo_remove(cuckoo, &i) && "lepk_cuckoo_remove failed.");
+	}
+	assert(lepk_cuckoo_count(cuckoo) == 5000 && lepk_cuckoo_contains(cuckoo, &(int) { 1 }) && "lepk_cuckoo_remove failed.");
+
+	unsigned long length;
+	void *image = lepk_bloom_serialize(bloom, &length);
+	LepkBloom *loaded_bloom = lepk_bloom_load(lepk_ht_hash_generic, image, length);
+	assert(loaded_bloom != NULL && lepk_bloom_contains(loaded_bloom, &(int) { 1234 }) && "lepk_bloom_load failed.");
+	assert(lepk_bloom_load(lepk_ht_hash_generic, image, length - 1) == NULL && "lepk_bloom_load accepted a short image.");
+	free(image);
+
+	image = lepk_cuckoo_serialize(cuckoo, &length);
+	LepkCuckoo *loaded_cuckoo = lepk_cuckoo_load(lepk_ht_hash_generic, image, 0);
+	assert(loaded_cuckoo != NULL && lepk_cuckoo_count(loaded_cuckoo) == 5000 && lepk_cuckoo_contains(loaded_cuckoo, &(int) { 1235 }) && "lepk_cuckoo_load failed.");
+	assert(lepk_bloom_load(lepk_ht_hash_generic, image, 0) == NULL && "lepk_bloom_load accepted a cuckoo filter.");
+	/* Size, buckets and fingerprint size of the image header, consistent with each other but not usable. */
+	memcpy((char *) image + 8, &(uint64_t) { 64 + 1 * 4 * 3 }, sizeof(uint64_t));
+	memcpy((char *) image + 24, &(uint64_t) { 1 }, sizeof(uint64_t));
+	memcpy((char *) image + 40, &(uint64_t) { 3 }, sizeof(uint64_t));
+	assert(lepk_cuckoo_load(lepk_ht_hash_generic, image, 0) == NULL && "lepk_cuckoo_load accepted a bad fingerprint size.");
+	memcpy((char *) image + 8, &(uint64_t) { 64 + 3 * 4 * 4 }, sizeof(uint64_t));
+	memcpy((char *) image + 24, &(uint64_t) { 3 }, sizeof(uint64_t));
+	memcpy((char *) image + 40, &(uint64_t) { 4 }, sizeof(uint64_t));
+	assert(lepk_cuckoo_load(lepk_ht_hash_generic, image, 0) == NULL && "lepk_cuckoo_load accepted buckets that aren't a power of two.");
+	free(image);
+
+	lepk_bloom_clear(bloom);
+	assert(!lepk_bloom_contains(bloom, &(int) { 1234 }) && "lepk_bloom_clear failed.");
+
+	lepk_cuckoo_destroy(loaded_cuckoo);
+	lepk_bloom_destroy(loaded_bloom);
+	lepk_cuckoo_destroy(cuckoo);
+	lepk_bloom_destroy(bloom);
+}
+
+#endif /* LEPK_FILTER_TEST */
+
+#endif /* LEPK_FILTER_H */
@@ -1,4 +1,4 @@
-/* Version: 1.0 */
+/* Version: 1.8 */
 
 /*
  * MIT License
@@ -32,11 +32,51 @@
  * in one C or C++ file, before #include "lepk_ht.h", to create the implementation.
  *
  * If LEPK_HT_STATIS is defined the implementation will be local to a single file only.
+ *
+ * Use:
+ *     #define LEPK_HT_BATCH [int]
+ * to define how many keys the batch functions prefetch together.
+ *     #define LEPK_HT_MAX_LOAD [float]
+ * to define the default max load factor of new tables.
+ *     #define LEPK_HT_SMALL [int]
+ * to define up to how many pairs a table is searched linearly instead of hashed, 0 always hashes.
+ *     #define LEPK_HT_STATS
+ * before every include to enable lepk_ht_stats. Compiled out by default since it's counted on every probe.
+ *     #define LEPK_HT_STATS_PROBES [int]
+ * to define how many probe lengths the stats histograms track.
+ *     #define LEPK_HT_NO_POSIX
+ * to leave out lepk_ht_save and lepk_ht_map_load, which need mmap and are only there on Unix-like systems.
  */
 
 /*
- * TODO: ACTUALLY MAKE THE THING WORK.
- * Currently, when getting an entry, if it collided and the object at the original collision point has been removed a dead entry is returned instead of the actual entry.
+ * === Documentation ===
+ * Keys and data are copied into the table and stored densely in insertion order.
+ * Iterating is a plain loop over the arrays, which stay valid until the table is modified:
+ * const int *keys = lepk__ht_keys(table);
+ * int *values = lepk__ht_values(table);
+ * for (unsigned long i = 0; i < lepk_ht_count(table); i++) {
+ *     printf("%d: %d\n", keys[i], values[i]);
+ * }
+ *
+ * Tables with at most LEPK_HT_SMALL pairs have no index and never call the hashing function,
+ * lookups compare against every key. Keys of 4 or 8 bytes using lepk_ht_compare_generic are compared
+ * without calling it, several at a time with SSE2. The table switches to hashing once it grows past the limit
+ * and back again on lepk_ht_shrink_to_fit.
+ *
+ * On Unix-like systems, tables that are expensive to build can be saved once and mapped at startup instead:
+ * lepk_ht_save(table, "table.bin");
+ * LepkHt *mapped = lepk_ht_map_load(lepk_ht_hash_generic, lepk_ht_compare_generic, "table.bin");
+ * The file holds the entry arrays and the index as they are in memory, so it only loads on machines
+ * with the same word size and byte order, which the file header checks along with a fingerprint of the hash function.
+ * Mapped tables support every lookup and iteration function but can't be modified.
+ *
+ * Read-modify-write without probing twice:
+ * int *counter = lepk_ht_get_or_insert(table, &key, NULL);
+ * (*counter)++;
+ *
+ * With lepk_da.h included, every key or value can be pushed to a dynamic array in one go:
+ * int *da = lepk_da_create(sizeof(int));
+ * lepk_ht_keys(table, da);
  */
 
 #ifndef LEPK_HT_H
@@ -48,27 +88,119 @@
 #define LEPKHT static
 #endif /* LEPK_HT_STATIC */
 
+#include <stdbool.h>
+
+#if defined(__unix__) && !defined(LEPK_HT_NO_POSIX)
+#define LEPK_HT_POSIX
+#endif /* defined(__unix__) && !defined(LEPK_HT_NO_POSIX) */
+
+#ifdef LEPK_HT_STATS
+#include <stdio.h>
+
+#ifndef LEPK_HT_STATS_PROBES
+#define LEPK_HT_STATS_PROBES 16
+#endif /* LEPK_HT_STATS_PROBES */
+#endif /* LEPK_HT_STATS */
+
 /* Hash Table. */
 typedef struct LepkHt LepkHt;
 /* Hasing function. */
 typedef unsigned long (*LepkHtHash)(const void *key, unsigned long size);
 /* Compare funciton. */
 typedef int (*LepkHtCompare)(const void *a, const void *b, unsigned long size);
+/* Upsert callback, data is zeroed if the key was just inserted. */
+typedef void (*LepkHtUpsert)(void *data, bool inserted, void *user);
+
+#ifdef LEPK_HT_STATS
+/* Table statistics, counters start when the table is created. */
+typedef struct {
+	/* Slots probed by lookups that found their key, the last bucket collects longer probes. */
+	unsigned long hit_probes[LEPK_HT_STATS_PROBES];
+	/* Slots probed by lookups that missed. A lookup during incremental rehash may probe both indices. */
+	unsigned long miss_probes[LEPK_HT_STATS_PROBES];
+	/* Calls to the compare function. */
+	unsigned long compares;
+	/* Index resizes and rebuilds. */
+	unsigned long resizes;
+	/* Processor time spent rehashing, in seconds. */
+	double resize_time;
+
+	float load_factor;
+	/* Removed or migrated index slots still lengthening probes. */
+	unsigned long dead_slots;
+	/* Removed entries waiting to be compacted. */
+	unsigned long holes;
+	/* Memory held by the table. */
+	unsigned long bytes;
+} LepkHtStats;
+#endif /* LEPK_HT_STATS */
 
 /* Create a hash table. */
 LEPKHT LepkHt *lepk_ht_create(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size, unsigned long data_size);
+/* Create a hash table that fits capacity pairs without resizing. */
+LEPKHT LepkHt *lepk_ht_create_with_capacity(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size, unsigned long data_size, unsigned long capacity);
 /* Destroy a hash table. */
 LEPKHT void lepk_ht_destroy(LepkHt *table);
 
 /* Retrieve item count from hash table. */
 LEPKHT unsigned long lepk_ht_count(const LepkHt *table);
+/*
+ * Set how many buckets are migrated per operation while the table is resizing.
+ * 0 (default) rehashes the whole table at once, anything else spreads the resize over the following operations.
+ */
+LEPKHT void lepk_ht_rehash_step(LepkHt *table, unsigned long step);
+/* Set the load factor, between 0 and 1, the table resizes at. */
+LEPKHT void lepk_ht_max_load(LepkHt *table, float max_load);
+/* Make room for capacity pairs in total without resizing. */
+LEPKHT void lepk_ht_reserve(LepkHt *table, unsigned long capacity);
+/* Free all memory not needed for the pairs currently in the table. */
+LEPKHT void lepk_ht_shrink_to_fit(LepkHt *table);
+/* Remove every pair, keeping the memory around for reuse. */
+LEPKHT void lepk_ht_clear(LepkHt *table);
+#ifdef LEPK_HT_STATS
+/* Retrieve statistics of a table. */
+LEPKHT void lepk_ht_stats(const LepkHt *table, LepkHtStats *stats);
+/* Write human readable statistics of a table to file. */
+LEPKHT void lepk_ht_stats_report(const LepkHt *table, FILE *file);
+#endif /* LEPK_HT_STATS */
 
 /* Set the pair in hash table. */
 LEPKHT void lepk__ht_set(LepkHt *table, const void *key, const void *data);
-/* Get pair from hash table. */
-LEPKHT void lepk__ht_get(LepkHt *table, const void *key, void *output);
+/* Get pair from hash table. Returns false, leaving output untouched, if key isn't in the table. */
+LEPKHT bool lepk__ht_get(LepkHt *table, const void *key, void *output);
 /* Remove pair from hash table. */
 LEPKHT void lepk__ht_remove(LepkHt *table, const void *key, void *output);
+/* Pointer to the data stored for key, NULL if key isn't in the table. Valid until the table is modified. */
+LEPKHT void *lepk_ht_find(LepkHt *table, const void *key);
+/* Pointer to the data stored for key, zeroed data is inserted if key is missing. inserted is optional. */
+LEPKHT void *lepk_ht_get_or_insert(LepkHt *table, const void *key, bool *inserted);
+/* Call callback on the data stored for key, inserting it first if missing. */
+LEPKHT void lepk_ht_upsert(LepkHt *table, const void *key, LepkHtUpsert callback, void *user);
+/*
+ * Get count pairs at once, faster than looping over lepk__ht_get for large tables.
+ * keys and outputs are arrays of count keys and data. found is optional and set per key.
+ * Returns how many keys were found.
+ */
+LEPKHT unsigned long lepk_ht_get_batch(LepkHt *table, const void *keys, unsigned long count, void *outputs, bool *found);
+/* Set count pairs at once. keys and data are arrays of count keys and data. */
+LEPKHT void lepk_ht_set_batch(LepkHt *table, const void *keys, const void *data, unsigned long count);
+/* All keys in insertion order, lepk_ht_count long. */
+LEPKHT const void *lepk__ht_keys(LepkHt *table);
+/* All data in insertion order, lepk_ht_count long. */
+LEPKHT void *lepk__ht_values(LepkHt *table);
+#ifdef LEPK_HT_POSIX
+/*
+ * Write table to filepath in a form lepk_ht_map_load can map straight back in.
+ * Keys and data are written as plain bytes, so they must not hold pointers. Returns false if writing failed.
+ */
+LEPKHT bool lepk_ht_save(LepkHt *table, const char *filepath);
+/*
+ * Map a table written by lepk_ht_save, lookups read straight from the file without rehashing or copying anything.
+ * hash must be the function the table was saved with, which is checked. compare must agree with it.
+ * Returns NULL if the file can't be mapped or doesn't match. The table is read-only, destroying it unmaps the file.
+ */
+LEPKHT LepkHt *lepk_ht_map_load(LepkHtHash hash, LepkHtCompare compare, const char *filepath);
+#endif /* LEPK_HT_POSIX */
 
 /* Pre-written hashing function for strings. */
 LEPKHT unsigned long lepk_ht_hash_string(const void *key, unsigned long size);
@@ -82,9 +214,17 @@ LEPKHT int lepk_ht_compare_generic(const void *a, const void *b, unsigned long s
 #define lepk_ht_set(table, key, data) do { __typeof__(key) lepk__ht_temp_key = key; __typeof__(data) lepk__ht_temp_data = data; lepk__ht_set(table, &lepk__ht_temp_key, &lepk__ht_temp_data); } while (0)
 #define lepk_ht_get(table, key, output) do { __typeof__(key) lepk__ht_temp_key = key; lepk__ht_get(table, &lepk__ht_temp_key, output); } while (0)
 #define lepk_ht_remove(table, key, output) do { __typeof__(key) lepk__ht_temp_key = key; lepk__ht_remove(table, &lepk__ht_temp_key, output); } while (0)
+/* Push all keys to the end of a lepk_da dynamic array. */
+#define lepk_ht_keys(table, da) lepk_da_push_array(da, lepk__ht_keys(table), lepk_ht_count(table))
+/* Push all data to the end of a lepk_da dynamic array. */
+#define lepk_ht_values(table, da) lepk_da_push_array(da, lepk__ht_values(table), lepk_ht_count(table))
 
 #ifdef LEPK_HT_TEST
 
+static void lepk__ht_test_upsert(void *data, bool inserted, void *user) {
+	*(int *) data = inserted ? *(int *) user : *(int *) data + *(int *) user;
+}
+
 static void lepk_ht_test(void) {
 	LepkHt *table = lepk_ht_create(lepk_ht_hash_string, lepk_ht_compare_string, sizeof(const char *), sizeof(int));
 	lepk_ht_set(table, "key", 8);
@@ -92,6 +232,121 @@ static void lepk_ht_test(void) {
 	lepk_ht_get(table, "key", &output);
 	assert(output == 8 && "lepk_ht failed.");
 	lepk_ht_destroy(table);
+
+	{
+		LepkHt *table = lepk_ht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int), sizeof(int));
+		lepk_ht_rehash_step(table, 4);
+		for (int i = 0; i < 1000; i++) {
+			lepk_ht_set(table, i, i * 2);
+		}
+		for (int i = 0; i < 1000; i += 2) {
+			lepk_ht_remove(table, i, NULL);
+		}
+		assert(lepk_ht_count(table) == 500 && "lepk_ht_rehash_step count failed.");
+		for (int i = 0; i < 1000; i++) {
+			int output = -1;
+			lepk_ht_get(table, i, &output);
+			assert(output == (i % 2 ? i * 2 : -1) && "lepk_ht_rehash_step failed.");
+		}
+
+		const int *keys = lepk__ht_keys(table);
+		const int *values = lepk__ht_values(table);
+		for (int i = 0; i < 500; i++) {
+			assert(keys[i] == i * 2 + 1 && values[i] == keys[i] * 2 && "lepk__ht_keys failed.");
+		}
+
+		int batch_keys[4] = { 1, 2, 3, 999 };
+		int batch_outputs[4] = { 0 };
+		bool batch_found[4];
+		assert(lepk_ht_get_batch(table, batch_keys, 4, batch_outputs, batch_found) == 3 && "lepk_ht_get_batch failed.");
+		assert(batch_outputs[0] == 2 && batch_outputs[2] == 6 && batch_outputs[3] == 1998 && !batch_found[1] && "lepk_ht_get_batch failed.");
+		lepk_ht_set_batch(table, batch_keys, batch_outputs, 4);
+		assert(lepk_ht_count(table) == 501 && "lepk_ht_set_batch failed.");
+
+		int key = 1;
+		assert(*(int *) lepk_ht_find(table, &key) == 2 && "lepk_ht_find failed.");
+		key = 1000;
+		assert(lepk_ht_find(table, &key) == NULL && "lepk_ht_find failed.");
+		bool inserted;
+		int *data = lepk_ht_get_or_insert(table, &key, &inserted);
+		assert(inserted && *data == 0 && "lepk_ht_get_or_insert failed.");
+		*data = 5;
+		int add = 3;
+		lepk_ht_upsert(table, &key, lepk__ht_test_upsert, &add);
+		assert(lepk__ht_get(table, &key, &output) && output == 8 && "lepk_ht_upsert failed.");
+		lepk_ht_remove(table, 1000, NULL);
+
+		LepkHt *copy = lepk_ht_create_with_capacity(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int), sizeof(int), 1000);
+		lepk_ht_max_load(copy, 0.5f);
+		lepk_ht_set_batch(copy, lepk__ht_keys(table), lepk__ht_values(table), lepk_ht_count(table));
+		lepk_ht_reserve(copy, 4000);
+		for (int i = 0; i < 200; i++) {
+			lepk_ht_remove(copy, i * 2 + 1, NULL);
+		}
+		lepk_ht_shrink_to_fit(copy);
+		assert(lepk_ht_count(copy) == 301 && lepk__ht_get(copy, &batch_keys[3], &output) && output == 1998 && "lepk_ht_shrink_to_fit failed.");
+		lepk_ht_clear(copy);
+		assert(lepk_ht_count(copy) == 0 && !lepk__ht_get(copy, &batch_keys[3], &output) && "lepk_ht_clear failed.");
+		lepk_ht_set(copy, 4, 8);
+		assert(lepk__ht_get(copy, &(int) { 4 }, &output) && output == 8 && "lepk_ht_clear failed.");
+		lepk_ht_destroy(copy);
+
+		LepkHt *small = lepk_ht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int), sizeof(int));
+		for (int i = 0; i < 20; i++) {
+			lepk_ht_set(small, i, i * 3);
+			if (i == 2) {
+				lepk_ht_remove(small, 1, NULL);
+			}
+		}
+		assert(lepk_ht_count(small) == 19 && ((const int *) lepk__ht_keys(small))[1] == 2 && "lepk_ht small map failed.");
+		for (int i = 4; i < 20; i++) {
+			lepk_ht_remove(small, i, NULL);
+		}
+		lepk_ht_shrink_to_fit(small);
+		lepk_ht_set(small, 0, 7);
+		assert(lepk_ht_count(small) == 3 && *(int *) lepk_ht_find(small, &(int) { 0 }) == 7 && "lepk_ht small map failed.");
+		assert(*(int *) lepk_ht_find(small, &(int) { 3 }) == 9 && lepk_ht_find(small, &(int) { 1 }) == NULL && "lepk_ht small map failed.");
+		lepk_ht_destroy(small);
+
+#ifdef LEPK_HT_POSIX
+		assert(lepk_ht_save(table, "ht_test.bin") && "lepk_ht_save failed.");
+		assert(lepk_ht_map_load(lepk_ht_hash_string, lepk_ht_compare_generic, "ht_test.bin") == NULL && "lepk_ht_map_load failed.");
+		LepkHt *mapped = lepk_ht_map_load(lepk_ht_hash_generic, lepk_ht_compare_generic, "ht_test.bin");
+		assert(mapped != NULL && lepk_ht_count(mapped) == 501 && "lepk_ht_map_load failed.");
+		for (int i = 0; i < 1000; i++) {
+			int *data = lepk_ht_find(mapped, &i);
+			assert((i % 2 ? data != NULL && *data == i * 2 : data == NULL || i == 2) && "lepk_ht_map_load failed.");
+		}
+		assert(memcmp(lepk__ht_keys(mapped), lepk__ht_keys(table), 501 * sizeof(int)) == 0 && "lepk_ht_map_load failed.");
+		lepk_ht_destroy(mapped);
+		/* The index ends the file, its last slot pointing past the entries. */
+		FILE *file = fopen("ht_test.bin", "r+b");
+		fseek(file, -4, SEEK_END);
+		fwrite("\xff\xff\xff\xff", 4, 1, file);
+		fclose(file);
+		assert(lepk_ht_map_load(lepk_ht_hash_generic, lepk_ht_compare_generic, "ht_test.bin") == NULL && "lepk_ht_map_load accepted a corrupt index.");
+		remove("ht_test.bin");
+#endif /* LEPK_HT_POSIX */
+
+#ifdef LEPK_HT_STATS
+		LepkHtStats stats;
+		lepk_ht_stats(table, &stats);
+		unsigned long hits = 0;
+		for (int i = 0; i < LEPK_HT_STATS_PROBES; i++) {
+			hits += stats.hit_probes[i];
+		}
+		assert(hits > 0 && stats.compares >= hits && stats.resizes > 0 && "lepk_ht_stats failed.");
+		assert(stats.load_factor > 0.0f && stats.load_factor < 1.0f && stats.bytes > 501 * 2 * sizeof(int) && "lepk_ht_stats failed.");
+#endif /* LEPK_HT_STATS */
+
+#ifdef LEPK_DA_H
+		int *da = lepk_da_create(sizeof(int));
+		lepk_ht_values(table, da);
+		assert(lepk_da_count(da) == 501 && memcmp(da, lepk__ht_values(table), 501 * sizeof(int)) == 0 && "lepk_ht_values failed.");
+		lepk_da_destroy(da);
+#endif /* LEPK_DA_H */
+		lepk_ht_destroy(table);
+	}
 }
 
 #endif /* LEPK_HT_TEST */
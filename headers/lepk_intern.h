@@ -0,0 +1,123 @@
+/* Version: 1.0 */
+
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2022 Linus Erik Pontus Kåreblom
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * String interning.
+ *
+ * Add:
+ *     #define LEPK_INTERN_IMPLEMENTATION
+ * in one C or C++ file, before #include "lepk_intern.h", to create the implementation.
+ *
+ * If LEPK_INTERN_STATIC is defined the implementation will be local to a single file only.
+ *
+ * Use:
+ *     #define LEPK_INTERN_CHUNK_SIZE [int]
+ * to define the size of the arena chunks strings are copied into.
+ *
+ * Built on lepk_ht.h, which needs its implementation somewhere too.
+ */
+
+/*
+ * === Documentation ===
+ * Usage:
+ * LepkIntern *interner = lepk_intern_create();
+ * unsigned int a = lepk_intern(interner, "hello", 5);
+ * unsigned int b = lepk_intern_cstr(interner, "hello");
+ * assert(a == b);
+ * printf("%s\n", lepk_intern_string(interner, a));
+ * lepk_intern_destroy(interner);
+ *
+ * Strings are copied into the interner and NUL terminated, the pointers stay valid until it's destroyed.
+ * IDs are handed out in order starting at 0.
+ */
+
+#ifndef LEPK_INTERN_H
+#define LEPK_INTERN_H
+
+#ifndef LEPK_INTERN_STATIC
+#define LEPKINTERN extern
+#else /* LEPK_INTERN_STATIC */
+#define LEPKINTERN static
+#endif /* LEPK_INTERN_STATIC */
+
+#include "lepk_ht.h"
+
+/* Returned when looking up a string that isn't interned. */
+#define LEPK_INTERN_NONE 0xffffffffu
+
+/* String interner. */
+typedef struct LepkIntern LepkIntern;
+
+/* Create an interner. */
+LEPKINTERN LepkIntern *lepk_intern_create(void);
+/* Destroy an interner and every string in it. */
+LEPKINTERN void lepk_intern_destroy(LepkIntern *interner);
+
+/* Intern length bytes of string and return its ID. */
+LEPKINTERN unsigned int lepk_intern(LepkIntern *interner, const char *string, unsigned long length);
+/* Intern a NUL terminated string and return its ID. */
+LEPKINTERN unsigned int lepk_intern_cstr(LepkIntern *interner, const char *string);
+/* ID of string, LEPK_INTERN_NONE if it isn't interned. */
+LEPKINTERN unsigned int lepk_intern_find(LepkIntern *interner, const char *string, unsigned long length);
+
+/* NUL terminated string with ID. */
+LEPKINTERN const char *lepk_intern_string(const LepkIntern *interner, unsigned int id);
+/* Length of string with ID. */
+LEPKINTERN unsigned long lepk_intern_length(const LepkIntern *interner, unsigned int id);
+/* Amount of interned strings. */
+LEPKINTERN unsigned long lepk_intern_count(const LepkIntern *interner);
+
+#ifdef LEPK_INTERN_TEST
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+static void lepk_intern_test(void) {
+	LepkIntern *interner = lepk_intern_create();
+
+	unsigned int hello = lepk_intern(interner, "hello world", 5);
+	unsigned int world = lepk_intern_cstr(interner, "world");
+	assert(hello == 0 && world == 1 && "lepk_intern failed.");
+	assert(lepk_intern_cstr(interner, "hello") == hello && "lepk_intern deduplication failed.");
+	assert(lepk_intern_find(interner, "hell", 4) == LEPK_INTERN_NONE && "lepk_intern_find failed.");
+	assert(strcmp(lepk_intern_string(interner, world), "world") == 0 && lepk_intern_length(interner, hello) == 5 && "lepk_intern_string failed.");
+
+	/* Enough strings to fill a couple of arena chunks. */
+	char buffer[32];
+	for (int i = 0; i < 20000; i++) {
+		int length = sprintf(buffer, "identifier_%d", i);
+		assert(lepk_intern(interner, buffer, length) == (unsigned int) i + 2 && "lepk_intern failed.");
+	}
+	assert(strcmp(lepk_intern_string(interner, 2 + 1234), "identifier_1234") == 0 && "lepk_intern_string failed.");
+	assert(lepk_intern_count(interner) == 20002 && "lepk_intern_count failed.");
+
+	lepk_intern_destroy(interner);
+}
+
+#endif /* LEPK_INTERN_TEST */
+
+#endif /* LEPK_INTERN_H */
@@ -0,0 +1,189 @@
+/* Version: 1.0 */
+
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2022 Linus Erik Pontus Kåreblom
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Persistent key-value store with a write-ahead log.
+ *
+ * Add:
+ *     #define LEPK_KV_IMPLEMENTATION
+ * in one C or C++ file, before #include "lepk_kv.h", to create the implementation.
+ *
+ * If LEPK_KV_STATIC is defined the implementation will be local to a single file only.
+ *
+ * Use:
+ *     #define LEPK_KV_COMPACT_MIN [int]
+ * to set how many bytes the log has to reach, and outgrow the snapshot by, before a commit compacts it. 16 MiB if not defined.
+ *
+ * Requires lepk_ht.h and lepk_file.h with LEPK_FILE_POSIX, its atomic writes and groups only exist on POSIX systems.
+ * In strict ISO C mode, like -std=c99, define _GNU_SOURCE before the first system header.
+ */
+
+/*
+ * === Documentation ===
+ * Keys and values are byte strings, indexed in memory by a lepk_ht. A store at "path" keeps two files:
+ * path.log      Every set and remove, appended through a LepkFileWriter, each record with a CRC-32C.
+ * path.snap     Every pair at the last compaction.
+ * Opening maps the snapshot and indexes its pairs where they lie, without copying them, then replays the log on top.
+ * Replay stops at the first record that is cut short or fails its checksum, which is where a crash interrupted writing.
+ *
+ * Mutations are made durable by commits, each one a single flush or sync however many mutations it covers.
+ * A store commits by itself every group mutations, 1 committing every mutation before it returns.
+ * Larger groups trade the last few mutations before a crash for fewer syncs. durability decides what a commit does:
+ * LEPK_FILE_DURABILITY_NONE     Hands the log to the OS, committed mutations survive the program crashing.
+ * LEPK_FILE_DURABILITY_DATA     Syncs the log, committed mutations survive losing power.
+ * LEPK_FILE_DURABILITY_FULL     The same as DATA.
+ * Past NONE a new log or snapshot is always put in place with a directory sync, once per creation or compaction,
+ * since losing its rename would lose every commit made to it since.
+ *
+ * Compacting writes every pair to a new snapshot and starts an empty log. It happens on commit once the log
+ * is over LEPK_KV_COMPACT_MIN and bigger than the snapshot, or on lepk_kv_compact. The snapshot is built
+ * in memory first, so compacting needs room for one more copy of the pairs.
+ *
+ * Usage:
+ * LepkKv *kv = lepk_kv_open("sessions", LEPK_FILE_DURABILITY_DATA, 32, NULL);
+ * lepk_kv_set(kv, "user:1", 6, token, token_length);
+ * unsigned long length;
+ * const char *stored = lepk_kv_get(kv, "user:1", 6, &length);
+ * lepk_kv_close(kv);
+ */
+
+#ifndef LEPK_KV_H
+#define LEPK_KV_H
+
+#ifndef LEPK_KV_STATIC
+#define LEPKKV extern
+#else /* LEPK_KV_STATIC */
+#define LEPKKV static
+#endif /* LEPK_KV_STATIC */
+
+#include <stdbool.h>
+
+#include "lepk_ht.h"
+#include "lepk_file.h"
+
+#ifndef LEPK_FILE_POSIX
+#error "lepk_kv.h needs lepk_file.h's POSIX functions, define _GNU_SOURCE before the first system header."
+#endif /* LEPK_FILE_POSIX */
+
+/* Key-value store. */
+typedef struct LepkKv LepkKv;
+
+/*
+ * Open the store at filepath, creating it if it doesn't exist, committing every group mutations.
+ * NULL return value means function failed, read status for more specific error.
+ */
+LEPKKV LepkKv *lepk_kv_open(const char *filepath, LepkFileDurability durability, unsigned long group, LepkFileStatus *status);
+/* Commit and close the store. The store is freed even if the commit fails. */
+LEPKKV LepkFileStatus lepk_kv_close(LepkKv *kv);
+
+/* Retrieve pair count from store. */
+LEPKKV unsigned long lepk_kv_count(const LepkKv *kv);
+/* Set the pair in store. If it can't be logged the store is left as it was. */
+LEPKKV LepkFileStatus lepk_kv_set(LepkKv *kv, const void *key, unsigned long key_length, const void *value, unsigned long value_length);
+/* Value stored for key, NULL if key isn't in the store. value_length is optional. Valid until the store is modified. */
+LEPKKV const void *lepk_kv_get(LepkKv *kv, const void *key, unsigned long key_length, unsigned long *value_length);
+/* Remove pair from store. Removing a missing key does nothing, and so does a remove that can't be logged. */
+LEPKKV LepkFileStatus lepk_kv_remove(LepkKv *kv, const void *key, unsigned long key_length);
+/*
+ * Pair after the one iterator points at, start with iterator set to 0. Returns false after the last pair.
+ * The store must not be modified while iterating.
+ */
+LEPKKV bool lepk_kv_next(LepkKv *kv, unsigned long *iterator, const void **key, unsigned long *key_length, const void **value, unsigned long *value_length);
+
+/* Make every mutation so far durable. */
+LEPKKV LepkFileStatus lepk_kv_commit(LepkKv *kv);
+/*
+ * Write every pair to a new snapshot and start an empty log. If it fails once the snapshot is in place the
+ * store can still be read, but mutations fail with LEPK_FILE_STATUS_WRITE_FAILED until it's reopened.
+ */
+LEPKKV LepkFileStatus lepk_kv_compact(LepkKv *kv);
+
+#ifdef LEPK_KV_TEST
+
+#include <assert.h>
+#include <string.h>
+
+static void lepk_kv_test(void) {
+	LepkFileStatus status;
+	remove("kv_test.log");
+	remove("kv_test.snap");
+
+	LepkKv *kv = lepk_kv_open("kv_test", LEPK_FILE_DURABILITY_NONE, 4, &status);
+	assert(kv != NULL && status == LEPK_FILE_STATUS_OK && lepk_kv_count(kv) == 0 && "lepk_kv_open failed.");
+
+	char key[16];
+	for (int i = 0; i < 100; i++) {
+		int length = sprintf(key, "key%d", i);
+		status = lepk_kv_set(kv, key, length, &i, sizeof(int));
+		assert(status == LEPK_FILE_STATUS_OK && "lepk_kv_set failed.");
+	}
+	lepk_kv_set(kv, "key7", 4, "seven", 5);
+	lepk_kv_remove(kv, "key8", 4);
+	lepk_kv_remove(kv, "missing", 7);
+	lepk_kv_set(kv, "", 0, "", 0);
+
+	unsigned long length;
+	const char *value = lepk_kv_get(kv, "key7", 4, &length);
+	assert(value != NULL && length == 5 && memcmp(value, "seven", 5) == 0 && "lepk_kv_get failed.");
+	assert(lepk_kv_get(kv, "key8", 4, NULL) == NULL && lepk_kv_count(kv) == 100 && "lepk_kv_remove failed.");
+	lepk_kv_close(kv);
+
+	/* Once from the log, once from a snapshot and once from a snapshot and a log with a torn record at the end. */
+	for (int run = 0; run < 3; run++) {
+		kv = lepk_kv_open("kv_test", LEPK_FILE_DURABILITY_FULL, 1, &status);
+		assert(kv != NULL && status == LEPK_FILE_STATUS_OK && lepk_kv_count(kv) == 100ul + run && "lepk_kv_open failed.");
+		value = lepk_kv_get(kv, "key42", 5, &length);
+		assert(value != NULL && length == sizeof(int) && memcmp(value, &(int) { 42 }, sizeof(int)) == 0 && "lepk_kv_open failed.");
+		value = lepk_kv_get(kv, "key7", 4, &length);
+		assert(value != NULL && length == 5 && lepk_kv_get(kv, "key8", 4, NULL) == NULL && lepk_kv_get(kv, "", 0, &length) != NULL && length == 0 && "lepk_kv_open failed.");
+
+		unsigned long iterator = 0;
+		unsigned long pairs = 0;
+		const void *pair_key;
+		unsigned long key_length;
+		while (lepk_kv_next(kv, &iterator, &pair_key, &key_length, (const void **) &value, &length)) {
+			pairs++;
+		}
+		assert(pairs == lepk_kv_count(kv) && "lepk_kv_next failed.");
+
+		if (run == 0) {
+			status = lepk_kv_compact(kv);
+			assert(status == LEPK_FILE_STATUS_OK && lepk_kv_get(kv, "key99", 5, NULL) != NULL && "lepk_kv_compact failed.");
+		}
+		sprintf(key, "new%d", run);
+		lepk_kv_set(kv, key, strlen(key), "", 0);
+		lepk_kv_close(kv);
+		if (run == 1) {
+			lepk_file_append("kv_test.log", "\x10\x00\x00\x00torn", 8, LEPK_FILE_MODE_BINARY);
+		}
+	}
+
+	remove("kv_test.log");
+	remove("kv_test.snap");
+}
+
+#endif /* LEPK_KV_TEST */
+#endif /* LEPK_KV_H */
@@ -0,0 +1,137 @@
+/* Version: 1.0 */
+
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2022 Linus Erik Pontus Kåreblom
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Minimal perfect hashing for static key sets.
+ *
+ * Add:
+ *     #define LEPK_MPH_IMPLEMENTATION
+ * in one C or C++ file, before #include "lepk_mph.h", to create the implementation.
+ *
+ * If LEPK_MPH_STATIC is defined the implementation will be local to a single file only.
+ */
+
+/*
+ * === Documentation ===
+ * Built once from a fixed set of keys, every key maps to its own position in [0, count),
+ * so a lookup is one hash and one probe with no empty slots.
+ * Keys are fixed size and compared byte by byte, pad structs with zeroes.
+ *
+ * Usage:
+ * int keys[3] = { 10, 20, 30 };
+ * const char *names[3] = { "ten", "twenty", "thirty" };
+ * LepkMph *mph = lepk_mph_create(keys, sizeof(int), names, sizeof(const char *), 3);
+ * const char **name = (const char **) lepk_mph_get(mph, &keys[1]);
+ *
+ * Storing and loading, using lepk_file.h:
+ * unsigned long length;
+ * void *image = lepk_mph_serialize(mph, &length);
+ * lepk_file_write("keys.mph", image, length, LEPK_FILE_MODE_BINARY);
+ * char *content = lepk_file_read("keys.mph", NULL);
+ * LepkMph *loaded = lepk_mph_load(content, 0);
+ *
+ * lepk_mph_emit_c turns the same image into C source, so a table built by a tool can be compiled into a program
+ * and loaded with lepk_mph_load(name, sizeof(name)).
+ * The image uses the byte order of the machine that built it.
+ */
+
+#ifndef LEPK_MPH_H
+#define LEPK_MPH_H
+
+#ifndef LEPK_MPH_STATIC
+#define LEPKMPH extern
+#else /* LEPK_MPH_STATIC */
+#define LEPKMPH static
+#endif /* LEPK_MPH_STATIC */
+
+/* Minimal perfect hash function with the keys and data it was built from. */
+typedef struct LepkMph LepkMph;
+
+/* Build from count keys of key_size bytes each and their data, data can be NULL. NULL if keys contain duplicates. */
+LEPKMPH LepkMph *lepk_mph_create(const void *keys, unsigned long key_size, const void *data, unsigned long data_size, unsigned long count);
+/* Destroy a perfect hash. */
+LEPKMPH void lepk_mph_destroy(LepkMph *mph);
+
+/* Amount of keys. */
+LEPKMPH unsigned long lepk_mph_count(const LepkMph *mph);
+/* Position of key in [0, count). Keys outside the set map to some position too. */
+LEPKMPH unsigned long lepk_mph_index(const LepkMph *mph, const void *key);
+/* Data stored for key, NULL if key isn't in the set. */
+LEPKMPH const void *lepk_mph_get(const LepkMph *mph, const void *key);
+
+/* Serialize to a malloc'd image of length bytes. */
+LEPKMPH void *lepk_mph_serialize(const LepkMph *mph, unsigned long *length);
+/* Load a serialized image, the buffer is copied. Length 0 trusts the size stored in the image. NULL if the image is invalid. */
+LEPKMPH LepkMph *lepk_mph_load(const void *buffer, unsigned long length);
+/* Serialize to malloc'd C source declaring "static const unsigned char name[]", length is set to the length of the text. */
+LEPKMPH char *lepk_mph_emit_c(const LepkMph *mph, const char *name, unsigned long *length);
+
+#ifdef LEPK_MPH_TEST
+
+#include <assert.h>
+#include <malloc.h>
+#include <string.h>
+
+static void lepk_mph_test(void) {
+	unsigned long keys[1000];
+	unsigned long data[1000];
+	for (unsigned long i = 0; i < 1000; i++) {
+		keys[i] = i * 7919;
+		data[i] = i;
+	}
+
+	LepkMph *mph = lepk_mph_create(keys, sizeof(unsigned long), data, sizeof(unsigned long), 1000);
+	assert(mph != NULL && lepk_mph_count(mph) == 1000 && "lepk_mph_create failed.");
+
+	char seen[1000] = { 0 };
+	for (unsigned long i = 0; i < 1000; i++) {
+		unsigned long index = lepk_mph_index(mph, &keys[i]);
+		assert(index < 1000 && !seen[index] && "lepk_mph_index isn't minimal and perfect.");
+		seen[index] = 1;
+		assert(*(const unsigned long *) lepk_mph_get(mph, &keys[i]) == i && "lepk_mph_get failed.");
+	}
+	unsigned long missing = 3;
+	assert(lepk_mph_get(mph, &missing) == NULL && "lepk_mph_get found a missing key.");
+
+	unsigned long length;
+	void *image = lepk_mph_serialize(mph, &length);
+	LepkMph *loaded = lepk_mph_load(image, length);
+	assert(loaded != NULL && *(const unsigned long *) lepk_mph_get(loaded, &keys[500]) == 500 && "lepk_mph_load failed.");
+	char *source = lepk_mph_emit_c(loaded, "table", &length);
+	assert(strncmp(source, "static const unsigned char table[", 33) == 0 && "lepk_mph_emit_c failed.");
+
+	free(source);
+	free(image);
+	lepk_mph_destroy(loaded);
+	lepk_mph_destroy(mph);
+
+	keys[1] = keys[0];
+	assert(lepk_mph_create(keys, sizeof(unsigned long), NULL, 0, 1000) == NULL && "lepk_mph_create accepted duplicates.");
+}
+
+#endif /* LEPK_MPH_TEST */
+
+#endif /* LEPK_MPH_H */
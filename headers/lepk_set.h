@@ -0,0 +1,160 @@
+/* Version: 1.0 */
+
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2022 Linus Erik Pontus Kåreblom
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Hash set.
+ *
+ * Add:
+ *     #define LEPK_SET_IMPLEMENTATION
+ * in one C or C++ file, before #include "lepk_set.h", to create the implementation.
+ *
+ * If LEPK_SET_STATIC is defined the implementation will be local to a single file only.
+ *
+ * Use:
+ *     #define LEPK_SET_FINGERPRINT_BITS [8 or 16]
+ * to define how many hash bits are kept per slot. 16 filters more compares at twice the overhead.
+ *     #define LEPK_SET_MAX_LOAD [float]
+ * to define the load factor sets resize at.
+ *
+ * Uses the hashing and compare callbacks from lepk_ht.h.
+ */
+
+/*
+ * === Documentation ===
+ * Keys are stored inline in one open addressed array, next to a fingerprint per slot,
+ * so a set costs key_size plus 1 or 2 bytes per slot and nothing else.
+ * Full hashes aren't kept, growing calls the hashing function again for every key.
+ *
+ * Usage:
+ * LepkSet *set = lepk_set_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int));
+ * lepk_set_add(set, 4);
+ * if (lepk_set_contains(set, 4)) { ... }
+ *
+ * Iterating, in no particular order:
+ * unsigned long iterator = 0;
+ * const int *key;
+ * while ((key = lepk_set_next(set, &iterator)) != NULL) { ... }
+ *
+ * The set algebra functions modify the first set in place. Both sets must use the same key size and callbacks.
+ */
+
+#ifndef LEPK_SET_H
+#define LEPK_SET_H
+
+#ifndef LEPK_SET_STATIC
+#define LEPKSET extern
+#else /* LEPK_SET_STATIC */
+#define LEPKSET static
+#endif /* LEPK_SET_STATIC */
+
+#include <stdbool.h>
+
+#include "lepk_ht.h"
+
+/* Hash set. */
+typedef struct LepkSet LepkSet;
+
+/* Create a hash set. */
+LEPKSET LepkSet *lepk_set_create(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size);
+/* Destroy a hash set. */
+LEPKSET void lepk_set_destroy(LepkSet *set);
+
+/* Retrieve key count from set. */
+LEPKSET unsigned long lepk_set_count(const LepkSet *set);
+/* Memory held by the set in bytes. */
+LEPKSET unsigned long lepk_set_bytes(const LepkSet *set);
+/* Make room for capacity keys in total without resizing. */
+LEPKSET void lepk_set_reserve(LepkSet *set, unsigned long capacity);
+/* Remove every key, keeping the memory around for reuse. */
+LEPKSET void lepk_set_clear(LepkSet *set);
+
+/* Add key to set. Returns false if it was already there. */
+LEPKSET bool lepk__set_add(LepkSet *set, const void *key);
+/* Check if key is in set. */
+LEPKSET bool lepk__set_contains(const LepkSet *set, const void *key);
+/* Remove key from set. Returns false if it wasn't there. */
+LEPKSET bool lepk__set_remove(LepkSet *set, const void *key);
+/* Next key after iterator, which starts at 0. NULL when every key has been visited. */
+LEPKSET const void *lepk_set_next(const LepkSet *set, unsigned long *iterator);
+
+/* Add every key in other to set. */
+LEPKSET void lepk_set_union(LepkSet *set, const LepkSet *other);
+/* Remove every key from set that isn't in other. */
+LEPKSET void lepk_set_intersect(LepkSet *set, const LepkSet *other);
+/* Remove every key in other from set. */
+LEPKSET void lepk_set_difference(LepkSet *set, const LepkSet *other);
+
+#define lepk_set_add(set, key) lepk__set_add(set, &(__typeof__(key)) { key })
+#define lepk_set_contains(set, key) lepk__set_contains(set, &(__typeof__(key)) { key })
+#define lepk_set_remove(set, key) lepk__set_remove(set, &(__typeof__(key)) { key })
+
+#ifdef LEPK_SET_TEST
+
+#include <assert.h>
+
+static void lepk_set_test(void) {
+	LepkSet *set = lepk_set_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int));
+	LepkSet *other = lepk_set_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int));
+	for (int i = 0; i < 1000; i++) {
+		assert(lepk_set_add(set, i) && "lepk_set_add failed.");
+		lepk_set_add(other, i * 2);
+	}
+	assert(!lepk_set_add(set, 10) && lepk_set_count(set) == 1000 && "lepk_set_add added a duplicate.");
+	for (int i = 0; i < 1000; i += 2) {
+		assert(lepk_set_remove(set, i) && "lepk_set_remove failed.");
+	}
+	assert(!lepk_set_remove(set, 0) && lepk_set_count(set) == 500 && "lepk_set_remove failed.");
+	for (int i = 0; i < 1000; i++) {
+		assert(lepk_set_contains(set, i) == (i % 2 == 1) && "lepk_set_contains failed.");
+	}
+
+	unsigned long iterator = 0;
+	const int *key;
+	long sum = 0;
+	while ((key = lepk_set_next(set, &iterator)) != NULL) {
+		sum += *key;
+	}
+	assert(sum == 250000 && "lepk_set_next failed.");
+
+	/* set: odd numbers below 1000, other: even numbers below 2000. */
+	lepk_set_union(set, other);
+	assert(lepk_set_count(set) == 1500 && lepk_set_contains(set, 1998) && lepk_set_contains(set, 3) && "lepk_set_union failed.");
+	lepk_set_difference(set, other);
+	assert(lepk_set_count(set) == 500 && !lepk_set_contains(set, 2) && lepk_set_contains(set, 3) && "lepk_set_difference failed.");
+	lepk_set_add(set, 4);
+	lepk_set_intersect(set, other);
+	assert(lepk_set_count(set) == 1 && lepk_set_contains(set, 4) && "lepk_set_intersect failed.");
+	assert(lepk_set_bytes(other) >= 1000 * sizeof(int) && "lepk_set_bytes failed.");
+
+	lepk_set_clear(other);
+	assert(lepk_set_count(other) == 0 && !lepk_set_contains(other, 4) && "lepk_set_clear failed.");
+	lepk_set_destroy(other);
+	lepk_set_destroy(set);
+}
+
+#endif /* LEPK_SET_TEST */
+
+#endif /* LEPK_SET_H */
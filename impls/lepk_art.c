@@ -0,0 +1,812 @@
+#include "lepk_art.h"
+
+#include <malloc.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
+#undef LEPKART
+#ifndef LEPK_ART_STATIC
+#define LEPKART
+#else /* LEPK_ART_STATIC */
+#define LEPKART static
+#endif /* LEPK_ART_STATIC */
+
+/* Compressed path bytes stored in a node, longer paths are checked against a leaf. */
+#define LEPK__ART_PREFIX 8
+
+/* Children are tagged pointers, leaves have the lowest bit set. */
+#define LEPK__ART_IS_LEAF(child) (((uintptr_t) (child)) & 1)
+#define LEPK__ART_LEAF(child) ((Lepk__ArtLeaf *) ((uintptr_t) (child) & ~(uintptr_t) 1))
+#define LEPK__ART_TAG(leaf) ((void *) ((uintptr_t) (leaf) | 1))
+
+typedef enum {
+	LEPK__ART_NODE4,
+	LEPK__ART_NODE16,
+	LEPK__ART_NODE48,
+	LEPK__ART_NODE256,
+} Lepk__ArtType;
+
+/* Followed by the data, then the key. */
+typedef struct {
+	size_t length;
+} Lepk__ArtLeaf;
+
+/*
+ * Every key below a node continues with the same prefix_length bytes after the byte leading to it,
+ * the first LEPK__ART_PREFIX of them are stored in prefix.
+ */
+typedef struct {
+	uint8_t type;
+	uint16_t count;
+	uint32_t prefix_length;
+	unsigned char prefix[LEPK__ART_PREFIX];
+	/* Key ending right after the prefix, NULL if there is none. */
+	Lepk__ArtLeaf *leaf;
+} Lepk__ArtNode;
+
+/* Keys are sorted in the two smallest nodes. */
+typedef struct {
+	Lepk__ArtNode node;
+	unsigned char keys[4];
+	void *children[4];
+} Lepk__ArtNode4;
+
+typedef struct {
+	Lepk__ArtNode node;
+	unsigned char keys[16];
+	void *children[16];
+} Lepk__ArtNode16;
+
+typedef struct {
+	Lepk__ArtNode node;
+	/* Position in children plus one for every byte, 0 if there's no child. */
+	unsigned char index[256];
+	void *children[48];
+} Lepk__ArtNode48;
+
+typedef struct {
+	Lepk__ArtNode node;
+	void *children[256];
+} Lepk__ArtNode256;
+
+struct LepkArt {
+	size_t data_size;
+	size_t count;
+	size_t bytes;
+	/* Node or tagged leaf, NULL when empty. */
+	void *root;
+};
+
+static const size_t lepk__art_node_sizes[] = {
+	sizeof(Lepk__ArtNode4),
+	sizeof(Lepk__ArtNode16),
+	sizeof(Lepk__ArtNode48),
+	sizeof(Lepk__ArtNode256),
+};
+
+static size_t lepk__art_data_offset(void) {
+	return (sizeof(Lepk__ArtLeaf) + 7) & ~(size_t) 7;
+}
+
+static void *lepk__art_leaf_data(const Lepk__ArtLeaf *leaf) {
+	return (unsigned char *) leaf + lepk__art_data_offset();
+}
+
+static const unsigned char *lepk__art_leaf_key(const LepkArt *art, const Lepk__ArtLeaf *leaf) {
+	return (const unsigned char *) leaf + lepk__art_data_offset() + art->data_size;
+}
+
+static size_t lepk__art_leaf_size(const LepkArt *art, size_t length) {
+	return lepk__art_data_offset() + art->data_size + length;
+}
+
+static Lepk__ArtLeaf *lepk__art_leaf_create(LepkArt *art, const void *key, size_t length, const void *data) {
+	Lepk__ArtLeaf *leaf = malloc(lepk__art_leaf_size(art, length));
+	leaf->length = length;
+	memcpy(lepk__art_leaf_data(leaf), data, art->data_size);
+	memcpy((unsigned char *) lepk__art_leaf_key(art, leaf), key, length);
+	art->bytes += lepk__art_leaf_size(art, length);
+	art->count++;
+	return leaf;
+}
+
+static void lepk__art_leaf_destroy(LepkArt *art, Lepk__ArtLeaf *leaf, void *output) {
+	if (output != NULL) {
+		memcpy(output, lepk__art_leaf_data(leaf), art->data_size);
+	}
+	art->bytes -= lepk__art_leaf_size(art, leaf->length);
+	art->count--;
+	free(leaf);
+}
+
+static bool lepk__art_leaf_matches(const LepkArt *art, const Lepk__ArtLeaf *leaf, const void *key, size_t length) {
+	return leaf->length == length && memcmp(lepk__art_leaf_key(art, leaf), key, length) == 0;
+}
+
+/* Whether key starts with the key of leaf. */
+static bool lepk__art_leaf_prefixes(const LepkArt *art, const Lepk__ArtLeaf *leaf, const void *key, size_t length) {
+	return leaf->length <= length && memcmp(lepk__art_leaf_key(art, leaf), key, leaf->length) == 0;
+}
+
+static Lepk__ArtNode *lepk__art_node_create(LepkArt *art, Lepk__ArtType type) {
+	Lepk__ArtNode *node = calloc(1, lepk__art_node_sizes[type]);
+	node->type = type;
+	art->bytes += lepk__art_node_sizes[type];
+	return node;
+}
+
+static void lepk__art_node_free(LepkArt *art, Lepk__ArtNode *node) {
+	art->bytes -= lepk__art_node_sizes[node->type];
+	free(node);
+}
+
+/* Slot holding the child for byte, NULL if there is none. */
+static void **lepk__art_find_child(const Lepk__ArtNode *node, unsigned char byte) {
+	switch (node->type) {
+		case LEPK__ART_NODE4: {
+			Lepk__ArtNode4 *n = (Lepk__ArtNode4 *) node;
+			for (size_t i = 0; i < node->count; i++) {
+				if (n->keys[i] == byte) {
+					return &n->children[i];
+				}
+			}
+			return NULL;
+		}
+		case LEPK__ART_NODE16: {
+			Lepk__ArtNode16 *n = (Lepk__ArtNode16 *) node;
+#ifdef __SSE2__
+			__m128i equal = _mm_cmpeq_epi8(_mm_set1_epi8((char) byte), _mm_loadu_si128((const __m128i *) n->keys));
+			int mask = _mm_movemask_epi8(equal) & ((1 << node->count) - 1);
+			return mask != 0 ? &n->children[__builtin_ctz(mask)] : NULL;
+#else /* __SSE2__ */
+			for (size_t i = 0; i < node->count; i++) {
+				if (n->keys[i] == byte) {
+					return &n->children[i];
+				}
+			}
+			return NULL;
+#endif /* __SSE2__ */
+		}
+		case LEPK__ART_NODE48: {
+			Lepk__ArtNode48 *n = (Lepk__ArtNode48 *) node;
+			return n->index[byte] != 0 ? &n->children[n->index[byte] - 1] : NULL;
+		}
+		default: {
+			Lepk__ArtNode256 *n = (Lepk__ArtNode256 *) node;
+			return n->children[byte] != NULL ? &n->children[byte] : NULL;
+		}
+	}
+}
+
+/* Copy the header of node into a new node of another type. */
+static Lepk__ArtNode *lepk__art_node_resize(LepkArt *art, const Lepk__ArtNode *node, Lepk__ArtType type) {
+	Lepk__ArtNode *resized = lepk__art_node_create(art, type);
+	resized->count = node->count;
+	resized->prefix_length = node->prefix_length;
+	memcpy(resized->prefix, node->prefix, LEPK__ART_PREFIX);
+	resized->leaf = node->leaf;
+	return resized;
+}
+
+/* Insert child into the sorted arrays of a node with room for it. */
+static void lepk__art_sorted_insert(unsigned char *keys, void **children, size_t count, unsigned char byte, void *child) {
+	size_t i = 0;
+	while (i < count && keys[i] < byte) {
+		i++;
+	}
+	memmove(keys + i + 1, keys + i, count - i);
+	memmove(children + i + 1, children + i, (count - i) * sizeof(void *));
+	keys[i] = byte;
+	children[i] = child;
+}
+
+/* Add child for byte to the node in slot, growing it into the next type if it's full. */
+static void lepk__art_add_child(LepkArt *art, void **slot, unsigned char byte, void *child) {
+	Lepk__ArtNode *node = *slot;
+
+	switch (node->type) {
+		case LEPK__ART_NODE4: {
+			Lepk__ArtNode4 *n = (Lepk__ArtNode4 *) node;
+			if (node->count < 4) {
+				lepk__art_sorted_insert(n->keys, n->children, node->count, byte, child);
+				break;
+			}
+			Lepk__ArtNode16 *grown = (Lepk__ArtNode16 *) lepk__art_node_resize(art, node, LEPK__ART_NODE16);
+			memcpy(grown->keys, n->keys, 4);
+			memcpy(grown->children, n->children, 4 * sizeof(void *));
+			lepk__art_node_free(art, node);
+			*slot = grown;
+			lepk__art_add_child(art, slot, byte, child);
+			return;
+		}
+		case LEPK__ART_NODE16: {
+			Lepk__ArtNode16 *n = (Lepk__ArtNode16 *) node;
+			if (node->count < 16) {
+				lepk__art_sorted_insert(n->keys, n->children, node->count, byte, child);
+				break;
+			}
+			Lepk__ArtNode48 *grown = (Lepk__ArtNode48 *) lepk__art_node_resize(art, node, LEPK__ART_NODE48);
+			for (size_t i = 0; i < 16; i++) {
+				grown->index[n->keys[i]] = (unsigned char) (i + 1);
+				grown->children[i] = n->children[i];
+			}
+			lepk__art_node_free(art, node);
+			*slot = grown;
+			lepk__art_add_child(art, slot, byte, child);
+			return;
+		}
+		case LEPK__ART_NODE48: {
+			Lepk__ArtNode48 *n = (Lepk__ArtNode48 *) node;
+			if (node->count < 48) {
+				size_t i = 0;
+				while (n->children[i] != NULL) {
+					i++;
+				}
+				n->children[i] = child;
+				n->index[byte] = (unsigned char) (i + 1);
+				break;
+			}
+			Lepk__ArtNode256 *grown = (Lepk__ArtNode256 *) lepk__art_node_resize(art, node, LEPK__ART_NODE256);
+			for (size_t i = 0; i < 256; i++) {
+				if (n->index[i] != 0) {
+					grown->children[i] = n->children[n->index[i] - 1];
+				}
+			}
+			lepk__art_node_free(art, node);
+			*slot = grown;
+			lepk__art_add_child(art, slot, byte, child);
+			return;
+		}
+		default:
+			((Lepk__ArtNode256 *) node)->children[byte] = child;
+			break;
+	}
+	node->count++;
+}
+
+/* Remove the child for byte from the node in slot, shrinking it into the previous type once it's small enough. */
+static void lepk__art_remove_child(LepkArt *art, void **slot, unsigned char byte) {
+	Lepk__ArtNode *node = *slot;
+
+	switch (node->type) {
+		case LEPK__ART_NODE4:
+		case LEPK__ART_NODE16: {
+			unsigned char *keys = node->type == LEPK__ART_NODE4 ? ((Lepk__ArtNode4 *) node)->keys : ((Lepk__ArtNode16 *) node)->keys;
+			void **children = node->type == LEPK__ART_NODE4 ? ((Lepk__ArtNode4 *) node)->children : ((Lepk__ArtNode16 *) node)->children;
+			size_t i = 0;
+			while (keys[i] != byte) {
+				i++;
+			}
+			memmove(keys + i, keys + i + 1, node->count - i - 1);
+			memmove(children + i, children + i + 1, (node->count - i - 1) * sizeof(void *));
+			node->count--;
+
+			if (node->type == LEPK__ART_NODE16 && node->count <= 3) {
+				Lepk__ArtNode4 *shrunk = (Lepk__ArtNode4 *) lepk__art_node_resize(art, node, LEPK__ART_NODE4);
+				memcpy(shrunk->keys, keys, node->count);
+				memcpy(shrunk->children, children, node->count * sizeof(void *));
+				lepk__art_node_free(art, node);
+				*slot = shrunk;
+			}
+			return;
+		}
+		case LEPK__ART_NODE48: {
+			Lepk__ArtNode48 *n = (Lepk__ArtNode48 *) node;
+			n->children[n->index[byte] - 1] = NULL;
+			n->index[byte] = 0;
+			node->count--;
+
+			if (node->count <= 12) {
+				Lepk__ArtNode16 *shrunk = (Lepk__ArtNode16 *) lepk__art_node_resize(art, node, LEPK__ART_NODE16);
+				size_t count = 0;
+				for (size_t i = 0; i < 256; i++) {
+					if (n->index[i] != 0) {
+						shrunk->keys[count] = (unsigned char) i;
+						shrunk->children[count++] = n->children[n->index[i] - 1];
+					}
+				}
+				lepk__art_node_free(art, node);
+				*slot = shrunk;
+			}
+			return;
+		}
+		default: {
+			Lepk__ArtNode256 *n = (Lepk__ArtNode256 *) node;
+			n->children[byte] = NULL;
+			node->count--;
+
+			if (node->count <= 37) {
+				Lepk__ArtNode48 *shrunk = (Lepk__ArtNode48 *) lepk__art_node_resize(art, node, LEPK__ART_NODE48);
+				size_t count = 0;
+				for (size_t i = 0; i < 256; i++) {
+					if (n->children[i] != NULL) {
+						shrunk->children[count] = n->children[i];
+						shrunk->index[i] = (unsigned char) ++count;
+					}
+				}
+				lepk__art_node_free(art, node);
+				*slot = shrunk;
+			}
+			return;
+		}
+	}
+}
+
+/* Smallest key below child, every key below a node contains its whole prefix. */
+static const Lepk__ArtLeaf *lepk__art_minimum(const void *child) {
+	while (!LEPK__ART_IS_LEAF(child)) {
+		const Lepk__ArtNode *node = child;
+		if (node->leaf != NULL) {
+			return node->leaf;
+		}
+		switch (node->type) {
+			case LEPK__ART_NODE4:
+				child = ((const Lepk__ArtNode4 *) node)->children[0];
+				break;
+			case LEPK__ART_NODE16:
+				child = ((const Lepk__ArtNode16 *) node)->children[0];
+				break;
+			case LEPK__ART_NODE48: {
+				const Lepk__ArtNode48 *n = (const Lepk__ArtNode48 *) node;
+				size_t i = 0;
+				while (n->index[i] == 0) {
+					i++;
+				}
+				child = n->children[n->index[i] - 1];
+				break;
+			}
+			default: {
+				const Lepk__ArtNode256 *n = (const Lepk__ArtNode256 *) node;
+				size_t i = 0;
+				while (n->children[i] == NULL) {
+					i++;
+				}
+				child = n->children[i];
+				break;
+			}
+		}
+	}
+	return LEPK__ART_LEAF(child);
+}
+
+/*
+ * Bytes of the stored prefix of node matching key from depth. Bytes past LEPK__ART_PREFIX aren't checked,
+ * whatever is found below has to be compared against the whole key.
+ */
+static size_t lepk__art_check_prefix(const Lepk__ArtNode *node, const unsigned char *key, size_t length, size_t depth) {
+	size_t stored = node->prefix_length < LEPK__ART_PREFIX ? node->prefix_length : LEPK__ART_PREFIX;
+	size_t i = 0;
+	while (i < stored && depth + i < length && node->prefix[i] == key[depth + i]) {
+		i++;
+	}
+	return i;
+}
+
+/* Whether the stored bytes of the prefix of node all match key from depth. */
+static bool lepk__art_prefix_matches(const Lepk__ArtNode *node, const unsigned char *key, size_t length, size_t depth) {
+	size_t stored = node->prefix_length < LEPK__ART_PREFIX ? node->prefix_length : LEPK__ART_PREFIX;
+	return lepk__art_check_prefix(node, key, length, depth) == stored;
+}
+
+/* Bytes of the whole prefix of node matching key from depth, reading past the stored bytes from a leaf below. */
+static size_t lepk__art_prefix_mismatch(const LepkArt *art, const Lepk__ArtNode *node, const unsigned char *key, size_t length, size_t depth) {
+	size_t i = lepk__art_check_prefix(node, key, length, depth);
+	if (i < LEPK__ART_PREFIX || node->prefix_length <= LEPK__ART_PREFIX) {
+		return i;
+	}
+
+	const unsigned char *full = lepk__art_leaf_key(art, lepk__art_minimum(node));
+	while (i < node->prefix_length && depth + i < length && full[depth + i] == key[depth + i]) {
+		i++;
+	}
+	return i;
+}
+
+/* Place leaf in a node whose prefix ends at depth, as its own leaf or as a child. */
+static void lepk__art_attach(LepkArt *art, void **slot, Lepk__ArtLeaf *leaf, size_t depth) {
+	Lepk__ArtNode *node = *slot;
+	if (leaf->length == depth) {
+		node->leaf = leaf;
+	} else {
+		lepk__art_add_child(art, slot, lepk__art_leaf_key(art, leaf)[depth], LEPK__ART_TAG(leaf));
+	}
+}
+
+static void lepk__art_insert(LepkArt *art, void **slot, const unsigned char *key, size_t length, size_t depth, const void *data) {
+	if (*slot == NULL) {
+		*slot = LEPK__ART_TAG(lepk__art_leaf_create(art, key, length, data));
+		return;
+	}
+
+	if (LEPK__ART_IS_LEAF(*slot)) {
+		Lepk__ArtLeaf *existing = LEPK__ART_LEAF(*slot);
+		if (lepk__art_leaf_matches(art, existing, key, length)) {
+			memcpy(lepk__art_leaf_data(existing), data, art->data_size);
+			return;
+		}
+
+		/* Split the leaf into a node over the bytes both keys share. */
+		const unsigned char *other = lepk__art_leaf_key(art, existing);
+		size_t shared = 0;
+		while (depth + shared < length && depth + shared < existing->length && key[depth + shared] == other[depth + shared]) {
+			shared++;
+		}
+
+		void *node = lepk__art_node_create(art, LEPK__ART_NODE4);
+		((Lepk__ArtNode *) node)->prefix_length = shared;
+		memcpy(((Lepk__ArtNode *) node)->prefix, key + depth, shared < LEPK__ART_PREFIX ? shared : LEPK__ART_PREFIX);
+		lepk__art_attach(art, &node, existing, depth + shared);
+		lepk__art_attach(art, &node, lepk__art_leaf_create(art, key, length, data), depth + shared);
+		*slot = node;
+		return;
+	}
+
+	Lepk__ArtNode *node = *slot;
+	if (node->prefix_length != 0) {
+		size_t shared = lepk__art_prefix_mismatch(art, node, key, length, depth);
+		if (shared < node->prefix_length) {
+			/* Key leaves the prefix partway, split it with a new node over the shared part. */
+			void *parent = lepk__art_node_create(art, LEPK__ART_NODE4);
+			((Lepk__ArtNode *) parent)->prefix_length = shared;
+			memcpy(((Lepk__ArtNode *) parent)->prefix, node->prefix, shared < LEPK__ART_PREFIX ? shared : LEPK__ART_PREFIX);
+
+			unsigned char byte;
+			size_t rest = node->prefix_length - shared - 1;
+			if (node->prefix_length <= LEPK__ART_PREFIX) {
+				byte = node->prefix[shared];
+				memmove(node->prefix, node->prefix + shared + 1, rest);
+			} else {
+				const unsigned char *full = lepk__art_leaf_key(art, lepk__art_minimum(node));
+				byte = full[depth + shared];
+				memcpy(node->prefix, full + depth + shared + 1, rest < LEPK__ART_PREFIX ? rest : LEPK__ART_PREFIX);
+			}
+			node->prefix_length = rest;
+
+			lepk__art_add_child(art, &parent, byte, node);
+			lepk__art_attach(art, &parent, lepk__art_leaf_create(art, key, length, data), depth + shared);
+			*slot = parent;
+			return;
+		}
+		depth += node->prefix_length;
+	}
+
+	if (depth == length) {
+		if (node->leaf != NULL) {
+			memcpy(lepk__art_leaf_data(node->leaf), data, art->data_size);
+		} else {
+			node->leaf = lepk__art_leaf_create(art, key, length, data);
+		}
+		return;
+	}
+
+	void **child = lepk__art_find_child(node, key[depth]);
+	if (child != NULL) {
+		lepk__art_insert(art, child, key, length, depth + 1, data);
+	} else {
+		lepk__art_add_child(art, slot, key[depth], LEPK__ART_TAG(lepk__art_leaf_create(art, key, length, data)));
+	}
+}
+
+/* Replace a node left with a single entry by that entry, merging prefixes when it's a node. */
+static void lepk__art_collapse(LepkArt *art, void **slot) {
+	Lepk__ArtNode *node = *slot;
+
+	if (node->count == 0) {
+		*slot = LEPK__ART_TAG(node->leaf);
+		lepk__art_node_free(art, node);
+		return;
+	}
+	if (node->count != 1 || node->leaf != NULL) {
+		return;
+	}
+
+	/* Only Node4 gets this small. */
+	Lepk__ArtNode4 *n = (Lepk__ArtNode4 *) node;
+	void *child = n->children[0];
+	if (!LEPK__ART_IS_LEAF(child)) {
+		/* The child's path becomes this prefix, the byte leading to the child, then its own prefix. */
+		Lepk__ArtNode *below = child;
+		unsigned char prefix[LEPK__ART_PREFIX];
+		size_t length = 0;
+		for (size_t i = 0; i < node->prefix_length && length < LEPK__ART_PREFIX; i++) {
+			prefix[length++] = node->prefix[i];
+		}
+		if (length < LEPK__ART_PREFIX) {
+			prefix[length++] = n->keys[0];
+		}
+		for (size_t i = 0; i < below->prefix_length && length < LEPK__ART_PREFIX; i++) {
+			prefix[length++] = below->prefix[i];
+		}
+		memcpy(below->prefix, prefix, length);
+		below->prefix_length += node->prefix_length + 1;
+	}
+
+	*slot = child;
+	lepk__art_node_free(art, node);
+}
+
+static bool lepk__art_erase(LepkArt *art, void **slot, const unsigned char *key, size_t length, size_t depth, void *output) {
+	if (*slot == NULL) {
+		return false;
+	}
+	if (LEPK__ART_IS_LEAF(*slot)) {
+		if (!lepk__art_leaf_matches(art, LEPK__ART_LEAF(*slot), key, length)) {
+			return false;
+		}
+		lepk__art_leaf_destroy(art, LEPK__ART_LEAF(*slot), output);
+		*slot = NULL;
+		return true;
+	}
+
+	Lepk__ArtNode *node = *slot;
+	if (!lepk__art_prefix_matches(node, key, length, depth)) {
+		return false;
+	}
+	depth += node->prefix_length;
+	if (depth > length) {
+		return false;
+	}
+
+	if (depth == length) {
+		if (node->leaf == NULL || !lepk__art_leaf_matches(art, node->leaf, key, length)) {
+			return false;
+		}
+		lepk__art_leaf_destroy(art, node->leaf, output);
+		node->leaf = NULL;
+		lepk__art_collapse(art, slot);
+		return true;
+	}
+
+	void **child = lepk__art_find_child(node, key[depth]);
+	if (child == NULL) {
+		return false;
+	}
+	if (LEPK__ART_IS_LEAF(*child)) {
+		if (!lepk__art_leaf_matches(art, LEPK__ART_LEAF(*child), key, length)) {
+			return false;
+		}
+		lepk__art_leaf_destroy(art, LEPK__ART_LEAF(*child), output);
+		lepk__art_remove_child(art, slot, key[depth]);
+		lepk__art_collapse(art, slot);
+		return true;
+	}
+	/* Nodes below collapse themselves instead of emptying, so this node keeps its child. */
+	return lepk__art_erase(art, child, key, length, depth + 1, output);
+}
+
+static void lepk__art_free(LepkArt *art, void *child) {
+	if (child == NULL) {
+		return;
+	}
+	if (LEPK__ART_IS_LEAF(child)) {
+		lepk__art_leaf_destroy(art, LEPK__ART_LEAF(child), NULL);
+		return;
+	}
+
+	Lepk__ArtNode *node = child;
+	if (node->leaf != NULL) {
+		lepk__art_leaf_destroy(art, node->leaf, NULL);
+	}
+	switch (node->type) {
+		case LEPK__ART_NODE4:
+			for (size_t i = 0; i < node->count; i++) {
+				lepk__art_free(art, ((Lepk__ArtNode4 *) node)->children[i]);
+			}
+			break;
+		case LEPK__ART_NODE16:
+			for (size_t i = 0; i < node->count; i++) {
+				lepk__art_free(art, ((Lepk__ArtNode16 *) node)->children[i]);
+			}
+			break;
+		case LEPK__ART_NODE48:
+			for (size_t i = 0; i < 48; i++) {
+				lepk__art_free(art, ((Lepk__ArtNode48 *) node)->children[i]);
+			}
+			break;
+		default:
+			for (size_t i = 0; i < 256; i++) {
+				lepk__art_free(art, ((Lepk__ArtNode256 *) node)->children[i]);
+			}
+			break;
+	}
+	lepk__art_node_free(art, node);
+}
+
+/* Visit every key below child in order. Returns false if visiting was stopped. */
+static bool lepk__art_visit(const LepkArt *art, const void *child, LepkArtVisit visit, void *user) {
+	if (LEPK__ART_IS_LEAF(child)) {
+		const Lepk__ArtLeaf *leaf = LEPK__ART_LEAF(child);
+		return visit(lepk__art_leaf_key(art, leaf), leaf->length, lepk__art_leaf_data(leaf), user);
+	}
+
+	const Lepk__ArtNode *node = child;
+	if (node->leaf != NULL && !visit(lepk__art_leaf_key(art, node->leaf), node->leaf->length, lepk__art_leaf_data(node->leaf), user)) {
+		return false;
+	}
+	switch (node->type) {
+		case LEPK__ART_NODE4:
+			for (size_t i = 0; i < node->count; i++) {
+				if (!lepk__art_visit(art, ((const Lepk__ArtNode4 *) node)->children[i], visit, user)) {
+					return false;
+				}
+			}
+			break;
+		case LEPK__ART_NODE16:
+			for (size_t i = 0; i < node->count; i++) {
+				if (!lepk__art_visit(art, ((const Lepk__ArtNode16 *) node)->children[i], visit, user)) {
+					return false;
+				}
+			}
+			break;
+		case LEPK__ART_NODE48: {
+			const Lepk__ArtNode48 *n = (const Lepk__ArtNode48 *) node;
+			for (size_t i = 0; i < 256; i++) {
+				if (n->index[i] != 0 && !lepk__art_visit(art, n->children[n->index[i] - 1], visit, user)) {
+					return false;
+				}
+			}
+			break;
+		}
+		default: {
+			const Lepk__ArtNode256 *n = (const Lepk__ArtNode256 *) node;
+			for (size_t i = 0; i < 256; i++) {
+				if (n->children[i] != NULL && !lepk__art_visit(art, n->children[i], visit, user)) {
+					return false;
+				}
+			}
+			break;
+		}
+	}
+	return true;
+}
+
+LEPKART LepkArt *lepk_art_create(unsigned long data_size) {
+	LepkArt *art = malloc(sizeof(LepkArt));
+	art->data_size = data_size;
+	art->count = 0;
+	art->bytes = sizeof(LepkArt);
+	art->root = NULL;
+	return art;
+}
+
+LEPKART void lepk_art_destroy(LepkArt *art) {
+	lepk__art_free(art, art->root);
+	free(art);
+}
+
+LEPKART unsigned long lepk_art_count(const LepkArt *art) {
+	return art->count;
+}
+
+LEPKART unsigned long lepk_art_bytes(const LepkArt *art) {
+	return art->bytes;
+}
+
+LEPKART void lepk_art_clear(LepkArt *art) {
+	lepk__art_free(art, art->root);
+	art->root = NULL;
+}
+
+LEPKART void lepk_art_set(LepkArt *art, const void *key, unsigned long length, const void *data) {
+	lepk__art_insert(art, &art->root, key, length, 0, data);
+}
+
+LEPKART bool lepk_art_get(const LepkArt *art, const void *key, unsigned long length, void *output) {
+	assert(output != NULL && "Output pointer can't be NULL.");
+	void *data = lepk_art_find(art, key, length);
+	if (data == NULL) {
+		return false;
+	}
+	memcpy(output, data, art->data_size);
+	return true;
+}
+
+LEPKART bool lepk_art_remove(LepkArt *art, const void *key, unsigned long length, void *output) {
+	return lepk__art_erase(art, &art->root, key, length, 0, output);
+}
+
+LEPKART void *lepk_art_find(const LepkArt *art, const void *key, unsigned long length) {
+	const unsigned char *_key = key;
+	const void *child = art->root;
+	size_t depth = 0;
+
+	while (child != NULL && !LEPK__ART_IS_LEAF(child)) {
+		const Lepk__ArtNode *node = child;
+		if (!lepk__art_prefix_matches(node, _key, length, depth)) {
+			return NULL;
+		}
+		depth += node->prefix_length;
+		if (depth >= length) {
+			const Lepk__ArtLeaf *leaf = depth == length ? node->leaf : NULL;
+			return leaf != NULL && lepk__art_leaf_matches(art, leaf, key, length) ? lepk__art_leaf_data(leaf) : NULL;
+		}
+
+		void **slot = lepk__art_find_child(node, _key[depth++]);
+		child = slot != NULL ? *slot : NULL;
+	}
+
+	/* Skipped prefix bytes are only checked here. */
+	if (child == NULL || !lepk__art_leaf_matches(art, LEPK__ART_LEAF(child), key, length)) {
+		return NULL;
+	}
+	return lepk__art_leaf_data(LEPK__ART_LEAF(child));
+}
+
+LEPKART void *lepk_art_longest_prefix(const LepkArt *art, const void *key, unsigned long length, unsigned long *matched) {
+	const unsigned char *_key = key;
+	const void *child = art->root;
+	const Lepk__ArtLeaf *best = NULL;
+	size_t depth = 0;
+
+	while (child != NULL) {
+		if (LEPK__ART_IS_LEAF(child)) {
+			if (lepk__art_leaf_prefixes(art, LEPK__ART_LEAF(child), key, length)) {
+				best = LEPK__ART_LEAF(child);
+			}
+			break;
+		}
+
+		const Lepk__ArtNode *node = child;
+		if (!lepk__art_prefix_matches(node, _key, length, depth)) {
+			break;
+		}
+		depth += node->prefix_length;
+		if (depth > length) {
+			break;
+		}
+		/* Every candidate is compared in full, a mismatch in skipped prefix bytes only means nothing longer matches. */
+		if (node->leaf != NULL && lepk__art_leaf_prefixes(art, node->leaf, key, length)) {
+			best = node->leaf;
+		}
+		if (depth == length) {
+			break;
+		}
+
+		void **slot = lepk__art_find_child(node, _key[depth++]);
+		child = slot != NULL ? *slot : NULL;
+	}
+
+	if (best == NULL) {
+		return NULL;
+	}
+	if (matched != NULL) {
+		*matched = best->length;
+	}
+	return lepk__art_leaf_data(best);
+}
+
+LEPKART void lepk_art_each_prefix(const LepkArt *art, const void *prefix, unsigned long length, LepkArtVisit visit, void *user) {
+	const unsigned char *_prefix = prefix;
+	const void *child = art->root;
+	size_t depth = 0;
+
+	while (child != NULL) {
+		if (LEPK__ART_IS_LEAF(child)) {
+			const Lepk__ArtLeaf *leaf = LEPK__ART_LEAF(child);
+			if (leaf->length >= length && memcmp(lepk__art_leaf_key(art, leaf), prefix, length) == 0) {
+				visit(lepk__art_leaf_key(art, leaf), leaf->length, lepk__art_leaf_data(leaf), user);
+			}
+			return;
+		}
+
+		const Lepk__ArtNode *node = child;
+		size_t shared = lepk__art_prefix_mismatch(art, node, _prefix, length, depth);
+		if (depth + shared == length) {
+			/* The prefix ends inside or right after this node's prefix, everything below starts with it. */
+			lepk__art_visit(art, node, visit, user);
+			return;
+		}
+		if (shared < node->prefix_length) {
+			return;
+		}
+		depth += node->prefix_length;
+
+		void **slot = lepk__art_find_child(node, _prefix[depth++]);
+		child = slot != NULL ? *slot : NULL;
+	}
+}
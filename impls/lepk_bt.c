@@ -0,0 +1,505 @@
+#include "lepk_bt.h"
+
+#include <malloc.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
+#undef LEPKBT
+#ifndef LEPK_BT_STATIC
+#define LEPKBT
+#else /* LEPK_BT_STATIC */
+#define LEPKBT static
+#endif /* LEPK_BT_STATIC */
+
+#ifndef LEPK_BT_NODE_SIZE
+#define LEPK_BT_NODE_SIZE 256
+#endif /* LEPK_BT_NODE_SIZE */
+
+/* Fewest keys a node holds before splitting, however large the keys are. */
+#define LEPK__BT_MIN_ORDER 4
+/* Nodes start on their own cache line. */
+#define LEPK__BT_ALIGN 64
+
+/*
+ * Followed by the keys, then child pointers in inner nodes or data in leaves.
+ * Nodes have room for one pair more than the order, so inserting can overflow a node before it's split.
+ */
+typedef struct Lepk__BtNode {
+	uint32_t count;
+	bool leaf;
+	/* Next leaf in order, NULL in the last leaf and in inner nodes. */
+	struct Lepk__BtNode *next;
+} Lepk__BtNode;
+
+/* Keys start 16 byte aligned for SIMD loads. */
+#define LEPK__BT_KEYS_OFFSET ((sizeof(Lepk__BtNode) + 15) & ~(size_t) 15)
+
+/*
+ * Inner nodes hold count keys and count + 1 children, the key between two children is
+ * no greater than every key in the right one. Keys in inner nodes may be left over from removed pairs.
+ * Every node but the root holds at least half the order.
+ */
+struct LepkBt {
+	LepkHtCompare compare;
+
+	size_t key_size;
+	size_t data_size;
+	size_t count;
+
+	/* Most keys a node holds. */
+	size_t order;
+	/* Where the children or data start in a node. */
+	size_t tail_offset;
+	size_t inner_size;
+	size_t leaf_size;
+	size_t inner_nodes;
+	size_t leaf_nodes;
+
+	Lepk__BtNode *root;
+	/* Separator moving up while splitting. */
+	unsigned char *separator;
+};
+
+static unsigned char *lepk__bt_key(const LepkBt *tree, const Lepk__BtNode *node, size_t i) {
+	return (unsigned char *) node + LEPK__BT_KEYS_OFFSET + i * tree->key_size;
+}
+
+static unsigned char *lepk__bt_data(const LepkBt *tree, const Lepk__BtNode *node, size_t i) {
+	return (unsigned char *) node + tree->tail_offset + i * tree->data_size;
+}
+
+static Lepk__BtNode **lepk__bt_children(const LepkBt *tree, const Lepk__BtNode *node) {
+	return (Lepk__BtNode **) ((unsigned char *) node + tree->tail_offset);
+}
+
+static Lepk__BtNode *lepk__bt_alloc(LepkBt *tree, bool leaf) {
+	Lepk__BtNode *node = memalign(LEPK__BT_ALIGN, leaf ? tree->leaf_size : tree->inner_size);
+	node->count = 0;
+	node->leaf = leaf;
+	node->next = NULL;
+	if (leaf) {
+		tree->leaf_nodes++;
+	} else {
+		tree->inner_nodes++;
+	}
+	return node;
+}
+
+static void lepk__bt_free(LepkBt *tree, Lepk__BtNode *node) {
+	if (node->leaf) {
+		tree->leaf_nodes--;
+	} else {
+		tree->inner_nodes--;
+	}
+	free(node);
+}
+
+static void lepk__bt_free_subtree(LepkBt *tree, Lepk__BtNode *node) {
+	if (!node->leaf) {
+		Lepk__BtNode **children = lepk__bt_children(tree, node);
+		for (size_t i = 0; i <= node->count; i++) {
+			lepk__bt_free_subtree(tree, children[i]);
+		}
+	}
+	lepk__bt_free(tree, node);
+}
+
+/*
+ * Amount of keys in node less than key, so the position key would be inserted at.
+ * equal is set if the key at that position equals key.
+ */
+static size_t lepk__bt_search(const LepkBt *tree, const Lepk__BtNode *node, const void *key, bool *equal) {
+	size_t count = node->count;
+	const unsigned char *keys = lepk__bt_key(tree, node, 0);
+	size_t i = 0;
+
+	if (tree->compare == lepk_bt_compare_int32) {
+		int32_t wanted;
+		memcpy(&wanted, key, sizeof(int32_t));
+#ifdef __SSE2__
+		__m128i wanted4 = _mm_set1_epi32(wanted);
+		for (; i + 4 <= count; i += 4) {
+			__m128i current = _mm_loadu_si128((const __m128i *) (keys + i * sizeof(int32_t)));
+			int less = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(current, wanted4)));
+			if (less != 0xf) {
+				/* Keys are sorted, so the ones less than key are the lowest lanes. */
+				i += __builtin_ctz(~less);
+				break;
+			}
+		}
+#endif /* __SSE2__ */
+		int32_t current = 0;
+		for (; i < count; i++) {
+			memcpy(&current, keys + i * sizeof(int32_t), sizeof(int32_t));
+			if (current >= wanted) {
+				break;
+			}
+		}
+		*equal = i < count && current == wanted;
+		return i;
+	}
+
+	if (tree->compare == lepk_bt_compare_int64) {
+		int64_t wanted;
+		int64_t current = 0;
+		memcpy(&wanted, key, sizeof(int64_t));
+		for (; i < count; i++) {
+			memcpy(&current, keys + i * sizeof(int64_t), sizeof(int64_t));
+			if (current >= wanted) {
+				break;
+			}
+		}
+		*equal = i < count && current == wanted;
+		return i;
+	}
+
+	size_t high = count;
+	while (i < high) {
+		size_t middle = i + (high - i) / 2;
+		if (tree->compare(keys + middle * tree->key_size, key, tree->key_size) < 0) {
+			i = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	*equal = i < count && tree->compare(keys + i * tree->key_size, key, tree->key_size) == 0;
+	return i;
+}
+
+/* Leaf key belongs in, with the position it has or would have there. */
+static Lepk__BtNode *lepk__bt_descend(const LepkBt *tree, const void *key, size_t *position, bool *equal) {
+	Lepk__BtNode *node = tree->root;
+	while (!node->leaf) {
+		size_t i = lepk__bt_search(tree, node, key, equal);
+		node = lepk__bt_children(tree, node)[i + *equal];
+	}
+	*position = lepk__bt_search(tree, node, key, equal);
+	return node;
+}
+
+/* Split an overflowing node in half, returning the new right half. Its separator is written to tree->separator. */
+static Lepk__BtNode *lepk__bt_split(LepkBt *tree, Lepk__BtNode *node) {
+	Lepk__BtNode *right = lepk__bt_alloc(tree, node->leaf);
+	size_t half = node->count / 2;
+
+	if (node->leaf) {
+		right->count = node->count - half;
+		memcpy(lepk__bt_key(tree, right, 0), lepk__bt_key(tree, node, half), right->count * tree->key_size);
+		memcpy(lepk__bt_data(tree, right, 0), lepk__bt_data(tree, node, half), right->count * tree->data_size);
+		memcpy(tree->separator, lepk__bt_key(tree, right, 0), tree->key_size);
+		right->next = node->next;
+		node->next = right;
+	} else {
+		/* The middle key moves up instead of being copied. */
+		right->count = node->count - half - 1;
+		memcpy(tree->separator, lepk__bt_key(tree, node, half), tree->key_size);
+		memcpy(lepk__bt_key(tree, right, 0), lepk__bt_key(tree, node, half + 1), right->count * tree->key_size);
+		memcpy(lepk__bt_children(tree, right), lepk__bt_children(tree, node) + half + 1, (right->count + 1) * sizeof(Lepk__BtNode *));
+	}
+	node->count = half;
+
+	return right;
+}
+
+/* Set key in the subtree at node. Returns the new right sibling if node had to be split. */
+static Lepk__BtNode *lepk__bt_insert(LepkBt *tree, Lepk__BtNode *node, const void *key, const void *data) {
+	bool equal;
+	size_t i = lepk__bt_search(tree, node, key, &equal);
+	size_t after = node->count - i;
+
+	if (node->leaf) {
+		if (equal) {
+			memcpy(lepk__bt_data(tree, node, i), data, tree->data_size);
+			return NULL;
+		}
+		memmove(lepk__bt_key(tree, node, i + 1), lepk__bt_key(tree, node, i), after * tree->key_size);
+		memmove(lepk__bt_data(tree, node, i + 1), lepk__bt_data(tree, node, i), after * tree->data_size);
+		memcpy(lepk__bt_key(tree, node, i), key, tree->key_size);
+		memcpy(lepk__bt_data(tree, node, i), data, tree->data_size);
+		node->count++;
+		tree->count++;
+	} else {
+		Lepk__BtNode **children = lepk__bt_children(tree, node);
+		i += equal;
+		after -= equal;
+		Lepk__BtNode *right = lepk__bt_insert(tree, children[i], key, data);
+		if (right == NULL) {
+			return NULL;
+		}
+		memmove(lepk__bt_key(tree, node, i + 1), lepk__bt_key(tree, node, i), after * tree->key_size);
+		memmove(children + i + 2, children + i + 1, after * sizeof(Lepk__BtNode *));
+		memcpy(lepk__bt_key(tree, node, i), tree->separator, tree->key_size);
+		children[i + 1] = right;
+		node->count++;
+	}
+
+	return node->count > tree->order ? lepk__bt_split(tree, node) : NULL;
+}
+
+/* Move the last pair of the left sibling of the child at i into it. */
+static void lepk__bt_borrow_left(LepkBt *tree, Lepk__BtNode *parent, size_t i) {
+	Lepk__BtNode **children = lepk__bt_children(tree, parent);
+	Lepk__BtNode *child = children[i];
+	Lepk__BtNode *left = children[i - 1];
+
+	memmove(lepk__bt_key(tree, child, 1), lepk__bt_key(tree, child, 0), child->count * tree->key_size);
+	if (child->leaf) {
+		memmove(lepk__bt_data(tree, child, 1), lepk__bt_data(tree, child, 0), child->count * tree->data_size);
+		memcpy(lepk__bt_key(tree, child, 0), lepk__bt_key(tree, left, left->count - 1), tree->key_size);
+		memcpy(lepk__bt_data(tree, child, 0), lepk__bt_data(tree, left, left->count - 1), tree->data_size);
+		memcpy(lepk__bt_key(tree, parent, i - 1), lepk__bt_key(tree, child, 0), tree->key_size);
+	} else {
+		/* Rotate through the parent: its separator comes down, the left sibling's last key goes up. */
+		Lepk__BtNode **child_children = lepk__bt_children(tree, child);
+		memmove(child_children + 1, child_children, (child->count + 1) * sizeof(Lepk__BtNode *));
+		child_children[0] = lepk__bt_children(tree, left)[left->count];
+		memcpy(lepk__bt_key(tree, child, 0), lepk__bt_key(tree, parent, i - 1), tree->key_size);
+		memcpy(lepk__bt_key(tree, parent, i - 1), lepk__bt_key(tree, left, left->count - 1), tree->key_size);
+	}
+
+	left->count--;
+	child->count++;
+}
+
+/* Move the first pair of the right sibling of the child at i into it. */
+static void lepk__bt_borrow_right(LepkBt *tree, Lepk__BtNode *parent, size_t i) {
+	Lepk__BtNode **children = lepk__bt_children(tree, parent);
+	Lepk__BtNode *child = children[i];
+	Lepk__BtNode *right = children[i + 1];
+
+	if (child->leaf) {
+		memcpy(lepk__bt_key(tree, child, child->count), lepk__bt_key(tree, right, 0), tree->key_size);
+		memcpy(lepk__bt_data(tree, child, child->count), lepk__bt_data(tree, right, 0), tree->data_size);
+		memmove(lepk__bt_key(tree, right, 0), lepk__bt_key(tree, right, 1), (right->count - 1) * tree->key_size);
+		memmove(lepk__bt_data(tree, right, 0), lepk__bt_data(tree, right, 1), (right->count - 1) * tree->data_size);
+		memcpy(lepk__bt_key(tree, parent, i), lepk__bt_key(tree, right, 0), tree->key_size);
+	} else {
+		Lepk__BtNode **right_children = lepk__bt_children(tree, right);
+		memcpy(lepk__bt_key(tree, child, child->count), lepk__bt_key(tree, parent, i), tree->key_size);
+		lepk__bt_children(tree, child)[child->count + 1] = right_children[0];
+		memcpy(lepk__bt_key(tree, parent, i), lepk__bt_key(tree, right, 0), tree->key_size);
+		memmove(lepk__bt_key(tree, right, 0), lepk__bt_key(tree, right, 1), (right->count - 1) * tree->key_size);
+		memmove(right_children, right_children + 1, right->count * sizeof(Lepk__BtNode *));
+	}
+
+	right->count--;
+	child->count++;
+}
+
+/* Merge the child at i + 1 into the child at i, removing their separator from parent. */
+static void lepk__bt_merge(LepkBt *tree, Lepk__BtNode *parent, size_t i) {
+	Lepk__BtNode **children = lepk__bt_children(tree, parent);
+	Lepk__BtNode *left = children[i];
+	Lepk__BtNode *right = children[i + 1];
+
+	if (left->leaf) {
+		memcpy(lepk__bt_key(tree, left, left->count), lepk__bt_key(tree, right, 0), right->count * tree->key_size);
+		memcpy(lepk__bt_data(tree, left, left->count), lepk__bt_data(tree, right, 0), right->count * tree->data_size);
+		left->count += right->count;
+		left->next = right->next;
+	} else {
+		memcpy(lepk__bt_key(tree, left, left->count), lepk__bt_key(tree, parent, i), tree->key_size);
+		memcpy(lepk__bt_key(tree, left, left->count + 1), lepk__bt_key(tree, right, 0), right->count * tree->key_size);
+		memcpy(lepk__bt_children(tree, left) + left->count + 1, lepk__bt_children(tree, right), (right->count + 1) * sizeof(Lepk__BtNode *));
+		left->count += right->count + 1;
+	}
+	lepk__bt_free(tree, right);
+
+	size_t after = parent->count - i - 1;
+	memmove(lepk__bt_key(tree, parent, i), lepk__bt_key(tree, parent, i + 1), after * tree->key_size);
+	memmove(children + i + 1, children + i + 2, after * sizeof(Lepk__BtNode *));
+	parent->count--;
+}
+
+/* Remove key from the subtree at node, refilling any child left with less than half the order. */
+static bool lepk__bt_erase(LepkBt *tree, Lepk__BtNode *node, const void *key, void *output) {
+	bool equal;
+	size_t i = lepk__bt_search(tree, node, key, &equal);
+
+	if (node->leaf) {
+		if (!equal) {
+			return false;
+		}
+		if (output != NULL) {
+			memcpy(output, lepk__bt_data(tree, node, i), tree->data_size);
+		}
+		size_t after = node->count - i - 1;
+		memmove(lepk__bt_key(tree, node, i), lepk__bt_key(tree, node, i + 1), after * tree->key_size);
+		memmove(lepk__bt_data(tree, node, i), lepk__bt_data(tree, node, i + 1), after * tree->data_size);
+		node->count--;
+		tree->count--;
+		return true;
+	}
+
+	i += equal;
+	Lepk__BtNode **children = lepk__bt_children(tree, node);
+	if (!lepk__bt_erase(tree, children[i], key, output)) {
+		return false;
+	}
+
+	size_t min = tree->order / 2;
+	if (children[i]->count >= min) {
+		return true;
+	}
+	if (i > 0 && children[i - 1]->count > min) {
+		lepk__bt_borrow_left(tree, node, i);
+	} else if (i < node->count && children[i + 1]->count > min) {
+		lepk__bt_borrow_right(tree, node, i);
+	} else {
+		lepk__bt_merge(tree, node, i > 0 ? i - 1 : i);
+	}
+	return true;
+}
+
+LEPKBT LepkBt *lepk_bt_create(LepkHtCompare compare, unsigned long key_size, unsigned long data_size) {
+	LepkBt *tree = malloc(sizeof(LepkBt));
+
+	tree->compare = compare;
+	tree->key_size = key_size;
+	tree->data_size = data_size;
+	tree->count = 0;
+
+	tree->order = LEPK_BT_NODE_SIZE / key_size;
+	if (tree->order < LEPK__BT_MIN_ORDER) {
+		tree->order = LEPK__BT_MIN_ORDER;
+	}
+	tree->tail_offset = (LEPK__BT_KEYS_OFFSET + (tree->order + 1) * key_size + 7) & ~(size_t) 7;
+	tree->inner_size = tree->tail_offset + (tree->order + 2) * sizeof(Lepk__BtNode *);
+	tree->leaf_size = tree->tail_offset + (tree->order + 1) * data_size;
+	tree->inner_nodes = 0;
+	tree->leaf_nodes = 0;
+
+	tree->root = lepk__bt_alloc(tree, true);
+	tree->separator = malloc(key_size);
+
+	return tree;
+}
+
+LEPKBT void lepk_bt_destroy(LepkBt *tree) {
+	lepk__bt_free_subtree(tree, tree->root);
+	free(tree->separator);
+	free(tree);
+}
+
+LEPKBT unsigned long lepk_bt_count(const LepkBt *tree) {
+	return tree->count;
+}
+
+LEPKBT unsigned long lepk_bt_bytes(const LepkBt *tree) {
+	return sizeof(LepkBt) + tree->key_size + tree->inner_nodes * tree->inner_size + tree->leaf_nodes * tree->leaf_size;
+}
+
+LEPKBT void lepk_bt_clear(LepkBt *tree) {
+	lepk__bt_free_subtree(tree, tree->root);
+	tree->root = lepk__bt_alloc(tree, true);
+	tree->count = 0;
+}
+
+LEPKBT void lepk__bt_set(LepkBt *tree, const void *key, const void *data) {
+	Lepk__BtNode *right = lepk__bt_insert(tree, tree->root, key, data);
+	if (right == NULL) {
+		return;
+	}
+
+	/* The root split, grow the tree by one level. */
+	Lepk__BtNode *root = lepk__bt_alloc(tree, false);
+	root->count = 1;
+	memcpy(lepk__bt_key(tree, root, 0), tree->separator, tree->key_size);
+	lepk__bt_children(tree, root)[0] = tree->root;
+	lepk__bt_children(tree, root)[1] = right;
+	tree->root = root;
+}
+
+LEPKBT bool lepk__bt_get(const LepkBt *tree, const void *key, void *output) {
+	assert(output != NULL && "Output pointer can't be NULL.");
+	void *data = lepk_bt_find(tree, key);
+	if (data == NULL) {
+		return false;
+	}
+	memcpy(output, data, tree->data_size);
+	return true;
+}
+
+LEPKBT bool lepk__bt_remove(LepkBt *tree, const void *key, void *output) {
+	if (!lepk__bt_erase(tree, tree->root, key, output)) {
+		return false;
+	}
+
+	/* The root lost its last separator, shrink the tree by one level. */
+	if (!tree->root->leaf && tree->root->count == 0) {
+		Lepk__BtNode *root = tree->root;
+		tree->root = lepk__bt_children(tree, root)[0];
+		lepk__bt_free(tree, root);
+	}
+	return true;
+}
+
+LEPKBT void *lepk_bt_find(const LepkBt *tree, const void *key) {
+	size_t i;
+	bool equal;
+	Lepk__BtNode *leaf = lepk__bt_descend(tree, key, &i, &equal);
+	return equal ? lepk__bt_data(tree, leaf, i) : NULL;
+}
+
+LEPKBT LepkBtIterator lepk_bt_begin(const LepkBt *tree) {
+	Lepk__BtNode *node = tree->root;
+	while (!node->leaf) {
+		node = lepk__bt_children(tree, node)[0];
+	}
+
+	LepkBtIterator iterator = { tree, node, 0 };
+	return iterator;
+}
+
+LEPKBT LepkBtIterator lepk__bt_lower_bound(const LepkBt *tree, const void *key) {
+	size_t i;
+	bool equal;
+	Lepk__BtNode *leaf = lepk__bt_descend(tree, key, &i, &equal);
+
+	LepkBtIterator iterator = { tree, leaf, i };
+	return iterator;
+}
+
+LEPKBT bool lepk_bt_next(LepkBtIterator *iterator, const void **key, void **data) {
+	Lepk__BtNode *node = iterator->node;
+	while (node != NULL && iterator->index >= node->count) {
+		node = node->next;
+		iterator->index = 0;
+	}
+	iterator->node = node;
+	if (node == NULL) {
+		return false;
+	}
+
+	if (key != NULL) {
+		*key = lepk__bt_key(iterator->tree, node, iterator->index);
+	}
+	if (data != NULL) {
+		*data = lepk__bt_data(iterator->tree, node, iterator->index);
+	}
+	iterator->index++;
+	return true;
+}
+
+LEPKBT int lepk_bt_compare_int32(const void *a, const void *b, unsigned long size) {
+	(void) size;
+	int32_t x;
+	int32_t y;
+	memcpy(&x, a, sizeof(int32_t));
+	memcpy(&y, b, sizeof(int32_t));
+	return (x > y) - (x < y);
+}
+
+LEPKBT int lepk_bt_compare_int64(const void *a, const void *b, unsigned long size) {
+	(void) size;
+	int64_t x;
+	int64_t y;
+	memcpy(&x, a, sizeof(int64_t));
+	memcpy(&y, b, sizeof(int64_t));
+	return (x > y) - (x < y);
+}
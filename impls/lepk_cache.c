@@ -0,0 +1,401 @@
+#include "lepk_cache.h"
+
+#include <malloc.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#undef LEPKCACHE
+#ifndef LEPK_CACHE_STATIC
+#define LEPKCACHE
+#else /* LEPK_CACHE_STATIC */
+#define LEPKCACHE static
+#endif /* LEPK_CACHE_STATIC */
+
+#ifndef LEPK_CACHE_SHARDS
+#define LEPK_CACHE_SHARDS 16
+#endif /* LEPK_CACHE_SHARDS */
+
+/* End of a list. */
+#define LEPK__CACHE_NONE UINT32_MAX
+/* Smallest amount of nodes. */
+#define LEPK__CACHE_MIN_CAP 8
+/* Alignment of the data in a node. */
+#define LEPK__CACHE_ALIGN 8
+
+/* Followed by the key and data. */
+typedef struct {
+	/* Recency list for LRU, free nodes use next for the free list. */
+	uint32_t prev;
+	uint32_t next;
+	size_t cost;
+	bool alive;
+	/* Used since the clock hand last passed. */
+	bool referenced;
+} Lepk__CacheNode;
+
+/*
+ * The table maps keys to positions in nodes, which are stored in one array and reused through a free list.
+ * The array doubles as the clock for CLOCK. For LRU the most recently used node is head.
+ */
+struct LepkCache {
+	LepkHt *table;
+	LepkCachePolicy policy;
+
+	size_t key_size;
+	size_t data_size;
+	/* Offset of the data in a node, and size of a node, both aligned to LEPK__CACHE_ALIGN. */
+	size_t data_offset;
+	size_t node_size;
+
+	unsigned char *nodes;
+	size_t node_count;
+	size_t node_cap;
+	uint32_t free_list;
+
+	uint32_t head;
+	uint32_t tail;
+	size_t hand;
+
+	size_t count;
+	size_t cost;
+	size_t budget;
+
+	LepkCacheEvict evict;
+	void *user;
+	LepkCacheStats stats;
+};
+
+typedef struct {
+	pthread_mutex_t lock;
+	LepkCache *cache;
+} Lepk__CacheShard;
+
+struct LepkCacheSharded {
+	LepkHtHash hash;
+	size_t key_size;
+	Lepk__CacheShard shards[LEPK_CACHE_SHARDS];
+};
+
+static size_t lepk__cache_align(size_t size) {
+	return (size + LEPK__CACHE_ALIGN - 1) & ~(size_t) (LEPK__CACHE_ALIGN - 1);
+}
+
+static Lepk__CacheNode *lepk__cache_node(const LepkCache *cache, uint32_t node) {
+	return (Lepk__CacheNode *) (cache->nodes + node * cache->node_size);
+}
+
+static unsigned char *lepk__cache_key(const LepkCache *cache, uint32_t node) {
+	return cache->nodes + node * cache->node_size + sizeof(Lepk__CacheNode);
+}
+
+static unsigned char *lepk__cache_data(const LepkCache *cache, uint32_t node) {
+	return cache->nodes + node * cache->node_size + cache->data_offset;
+}
+
+static void lepk__cache_unlink(LepkCache *cache, uint32_t node) {
+	Lepk__CacheNode *_node = lepk__cache_node(cache, node);
+	if (_node->prev != LEPK__CACHE_NONE) {
+		lepk__cache_node(cache, _node->prev)->next = _node->next;
+	} else {
+		cache->head = _node->next;
+	}
+	if (_node->next != LEPK__CACHE_NONE) {
+		lepk__cache_node(cache, _node->next)->prev = _node->prev;
+	} else {
+		cache->tail = _node->prev;
+	}
+}
+
+static void lepk__cache_push_head(LepkCache *cache, uint32_t node) {
+	Lepk__CacheNode *_node = lepk__cache_node(cache, node);
+	_node->prev = LEPK__CACHE_NONE;
+	_node->next = cache->head;
+	if (cache->head != LEPK__CACHE_NONE) {
+		lepk__cache_node(cache, cache->head)->prev = node;
+	} else {
+		cache->tail = node;
+	}
+	cache->head = node;
+}
+
+/* Mark node as just used. */
+static void lepk__cache_touch(LepkCache *cache, uint32_t node) {
+	if (cache->policy == LEPK_CACHE_CLOCK) {
+		lepk__cache_node(cache, node)->referenced = true;
+	} else if (cache->head != node) {
+		lepk__cache_unlink(cache, node);
+		lepk__cache_push_head(cache, node);
+	}
+}
+
+static uint32_t lepk__cache_alloc_node(LepkCache *cache) {
+	if (cache->free_list != LEPK__CACHE_NONE) {
+		uint32_t node = cache->free_list;
+		cache->free_list = lepk__cache_node(cache, node)->next;
+		return node;
+	}
+
+	if (cache->node_count == cache->node_cap) {
+		assert(cache->node_cap < LEPK__CACHE_NONE / 2 && "lepk_cache can't hold that many entries.");
+		cache->node_cap *= 2;
+		cache->nodes = realloc(cache->nodes, cache->node_cap * cache->node_size);
+	}
+	return cache->node_count++;
+}
+
+/* Drop node from the table, the list and the cost. */
+static void lepk__cache_release(LepkCache *cache, uint32_t node) {
+	Lepk__CacheNode *_node = lepk__cache_node(cache, node);
+	lepk__ht_remove(cache->table, lepk__cache_key(cache, node), NULL);
+	if (cache->policy == LEPK_CACHE_LRU) {
+		lepk__cache_unlink(cache, node);
+	}
+
+	cache->cost -= _node->cost;
+	cache->count--;
+	_node->alive = false;
+	_node->next = cache->free_list;
+	cache->free_list = node;
+}
+
+/* Node to evict next, the tail for LRU, for CLOCK the first node the hand finds unreferenced. */
+static uint32_t lepk__cache_victim(LepkCache *cache) {
+	if (cache->policy == LEPK_CACHE_LRU) {
+		return cache->tail;
+	}
+
+	/* Clears at most one full turn of referenced bits before finding one. */
+	for (;;) {
+		uint32_t node = cache->hand;
+		cache->hand = cache->hand + 1 < cache->node_count ? cache->hand + 1 : 0;
+
+		Lepk__CacheNode *_node = lepk__cache_node(cache, node);
+		if (!_node->alive) {
+			continue;
+		}
+		if (_node->referenced) {
+			_node->referenced = false;
+			continue;
+		}
+		return node;
+	}
+}
+
+static void lepk__cache_evict(LepkCache *cache) {
+	while (cache->cost > cache->budget && cache->count > 0) {
+		uint32_t node = lepk__cache_victim(cache);
+		if (cache->evict != NULL) {
+			cache->evict(lepk__cache_key(cache, node), lepk__cache_data(cache, node), cache->user);
+		}
+		lepk__cache_release(cache, node);
+		cache->stats.evictions++;
+	}
+}
+
+LEPKCACHE LepkCache *lepk_cache_create(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size, unsigned long data_size, LepkCachePolicy policy, unsigned long budget) {
+	LepkCache *cache = malloc(sizeof(LepkCache));
+
+	cache->table = lepk_ht_create(hash, compare, key_size, sizeof(uint32_t));
+	cache->policy = policy;
+
+	cache->key_size = key_size;
+	cache->data_size = data_size;
+	cache->data_offset = lepk__cache_align(sizeof(Lepk__CacheNode) + key_size);
+	cache->node_size = lepk__cache_align(cache->data_offset + data_size);
+
+	cache->node_count = 0;
+	cache->node_cap = LEPK__CACHE_MIN_CAP;
+	cache->nodes = malloc(cache->node_cap * cache->node_size);
+	cache->free_list = LEPK__CACHE_NONE;
+
+	cache->head = LEPK__CACHE_NONE;
+	cache->tail = LEPK__CACHE_NONE;
+	cache->hand = 0;
+
+	cache->count = 0;
+	cache->cost = 0;
+	cache->budget = budget;
+
+	cache->evict = NULL;
+	cache->user = NULL;
+	memset(&cache->stats, 0, sizeof(LepkCacheStats));
+
+	return cache;
+}
+
+LEPKCACHE void lepk_cache_destroy(LepkCache *cache) {
+	lepk_ht_destroy(cache->table);
+	free(cache->nodes);
+	free(cache);
+}
+
+LEPKCACHE unsigned long lepk_cache_count(const LepkCache *cache) {
+	return cache->count;
+}
+
+LEPKCACHE unsigned long lepk_cache_cost(const LepkCache *cache) {
+	return cache->cost;
+}
+
+LEPKCACHE void lepk_cache_on_evict(LepkCache *cache, LepkCacheEvict callback, void *user) {
+	cache->evict = callback;
+	cache->user = user;
+}
+
+LEPKCACHE void lepk_cache_stats(const LepkCache *cache, LepkCacheStats *stats) {
+	*stats = cache->stats;
+}
+
+LEPKCACHE void *lepk_cache_get(LepkCache *cache, const void *key) {
+	uint32_t *node = lepk_ht_find(cache->table, key);
+	if (node == NULL) {
+		cache->stats.misses++;
+		return NULL;
+	}
+
+	cache->stats.hits++;
+	lepk__cache_touch(cache, *node);
+	return lepk__cache_data(cache, *node);
+}
+
+LEPKCACHE void lepk__cache_put(LepkCache *cache, const void *key, const void *data) {
+	lepk__cache_put_cost(cache, key, data, 1);
+}
+
+LEPKCACHE void lepk__cache_put_cost(LepkCache *cache, const void *key, const void *data, unsigned long cost) {
+	bool inserted;
+	uint32_t *slot = lepk_ht_get_or_insert(cache->table, key, &inserted);
+
+	uint32_t node;
+	if (inserted) {
+		node = lepk__cache_alloc_node(cache);
+		*slot = node;
+
+		Lepk__CacheNode *_node = lepk__cache_node(cache, node);
+		_node->alive = true;
+		/* New pairs have to be used again to get a second chance. */
+		_node->referenced = false;
+		_node->cost = 0;
+		memcpy(lepk__cache_key(cache, node), key, cache->key_size);
+		if (cache->policy == LEPK_CACHE_LRU) {
+			lepk__cache_push_head(cache, node);
+		}
+		cache->count++;
+	} else {
+		node = *slot;
+		lepk__cache_touch(cache, node);
+	}
+
+	Lepk__CacheNode *_node = lepk__cache_node(cache, node);
+	cache->cost += cost - _node->cost;
+	_node->cost = cost;
+	memcpy(lepk__cache_data(cache, node), data, cache->data_size);
+
+	lepk__cache_evict(cache);
+}
+
+LEPKCACHE bool lepk__cache_remove(LepkCache *cache, const void *key, void *output) {
+	uint32_t *node = lepk_ht_find(cache->table, key);
+	if (node == NULL) {
+		return false;
+	}
+
+	uint32_t _node = *node;
+	if (output != NULL) {
+		memcpy(output, lepk__cache_data(cache, _node), cache->data_size);
+	}
+	lepk__cache_release(cache, _node);
+	return true;
+}
+
+static Lepk__CacheShard *lepk__cache_shard(LepkCacheSharded *cache, const void *key) {
+	/* Each shard's table hashes the key again, taking the shard from the low bits would leave every key in it sharing them. */
+	uint64_t mixed = (uint64_t) cache->hash(key, cache->key_size) * 0x9e3779b97f4a7c15ull;
+	return &cache->shards[(mixed >> 40) & (LEPK_CACHE_SHARDS - 1)];
+}
+
+LEPKCACHE LepkCacheSharded *lepk_cache_sharded_create(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size, unsigned long data_size, LepkCachePolicy policy, unsigned long budget) {
+	LepkCacheSharded *cache = malloc(sizeof(LepkCacheSharded));
+	cache->hash = hash;
+	cache->key_size = key_size;
+
+	for (size_t i = 0; i < LEPK_CACHE_SHARDS; i++) {
+		/* Spread the remainder so the budgets add up. */
+		size_t shard_budget = budget / LEPK_CACHE_SHARDS + (i < budget % LEPK_CACHE_SHARDS);
+		pthread_mutex_init(&cache->shards[i].lock, NULL);
+		cache->shards[i].cache = lepk_cache_create(hash, compare, key_size, data_size, policy, shard_budget);
+	}
+
+	return cache;
+}
+
+LEPKCACHE void lepk_cache_sharded_destroy(LepkCacheSharded *cache) {
+	for (size_t i = 0; i < LEPK_CACHE_SHARDS; i++) {
+		pthread_mutex_destroy(&cache->shards[i].lock);
+		lepk_cache_destroy(cache->shards[i].cache);
+	}
+	free(cache);
+}
+
+LEPKCACHE unsigned long lepk_cache_sharded_count(LepkCacheSharded *cache) {
+	unsigned long count = 0;
+	for (size_t i = 0; i < LEPK_CACHE_SHARDS; i++) {
+		pthread_mutex_lock(&cache->shards[i].lock);
+		count += cache->shards[i].cache->count;
+		pthread_mutex_unlock(&cache->shards[i].lock);
+	}
+	return count;
+}
+
+LEPKCACHE void lepk_cache_sharded_on_evict(LepkCacheSharded *cache, LepkCacheEvict callback, void *user) {
+	for (size_t i = 0; i < LEPK_CACHE_SHARDS; i++) {
+		pthread_mutex_lock(&cache->shards[i].lock);
+		lepk_cache_on_evict(cache->shards[i].cache, callback, user);
+		pthread_mutex_unlock(&cache->shards[i].lock);
+	}
+}
+
+LEPKCACHE void lepk_cache_sharded_stats(LepkCacheSharded *cache, LepkCacheStats *stats) {
+	memset(stats, 0, sizeof(LepkCacheStats));
+	for (size_t i = 0; i < LEPK_CACHE_SHARDS; i++) {
+		pthread_mutex_lock(&cache->shards[i].lock);
+		stats->hits += cache->shards[i].cache->stats.hits;
+		stats->misses += cache->shards[i].cache->stats.misses;
+		stats->evictions += cache->shards[i].cache->stats.evictions;
+		pthread_mutex_unlock(&cache->shards[i].lock);
+	}
+}
+
+LEPKCACHE bool lepk__cache_sharded_get(LepkCacheSharded *cache, const void *key, void *output) {
+	assert(output != NULL && "Output pointer can't be NULL.");
+	Lepk__CacheShard *shard = lepk__cache_shard(cache, key);
+
+	pthread_mutex_lock(&shard->lock);
+	void *data = lepk_cache_get(shard->cache, key);
+	if (data != NULL) {
+		memcpy(output, data, shard->cache->data_size);
+	}
+	pthread_mutex_unlock(&shard->lock);
+
+	return data != NULL;
+}
+
+LEPKCACHE void lepk__cache_sharded_put(LepkCacheSharded *cache, const void *key, const void *data, unsigned long cost) {
+	Lepk__CacheShard *shard = lepk__cache_shard(cache, key);
+
+	pthread_mutex_lock(&shard->lock);
+	lepk__cache_put_cost(shard->cache, key, data, cost);
+	pthread_mutex_unlock(&shard->lock);
+}
+
+LEPKCACHE bool lepk__cache_sharded_remove(LepkCacheSharded *cache, const void *key, void *output) {
+	Lepk__CacheShard *shard = lepk__cache_shard(cache, key);
+
+	pthread_mutex_lock(&shard->lock);
+	bool removed = lepk__cache_remove(shard->cache, key, output);
+	pthread_mutex_unlock(&shard->lock);
+
+	return removed;
+}
@@ -0,0 +1,378 @@
+#include "lepk_cht.h"
+
+#include <malloc.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#undef LEPKCHT
+#ifndef LEPK_CHT_STATIC
+#define LEPKCHT
+#else /* LEPK_CHT_STATIC */
+#define LEPKCHT static
+#endif /* LEPK_CHT_STATIC */
+
+#define LEPK_CHT_MAX_LOAD 0.75f
+#define LEPK__CHT_CACHE_LINE 64
+
+#ifndef LEPK_CHT_SHARDS
+#define LEPK_CHT_SHARDS 64
+#endif /* LEPK_CHT_SHARDS */
+
+#ifndef LEPK_CHT_MAX_THREADS
+#define LEPK_CHT_MAX_THREADS 128
+#endif /* LEPK_CHT_MAX_THREADS */
+
+typedef enum {
+	LEPK__CHT_SLOT_EMPTY,
+	LEPK__CHT_SLOT_ALIVE,
+	LEPK__CHT_SLOT_DEAD,
+} Lepk__ChtSlotState;
+
+/* One open addressed array, allocated as a single block. */
+typedef struct Lepk__ChtArray Lepk__ChtArray;
+struct Lepk__ChtArray {
+	size_t cap;
+	size_t *hashes;
+	unsigned char *states;
+	unsigned char *keys;
+	unsigned char *data;
+
+	/* Epoch the array was replaced in, only used once retired. */
+	unsigned long retired_epoch;
+	Lepk__ChtArray *next;
+};
+
+typedef struct {
+	/* Held by writers. */
+	pthread_mutex_t lock;
+	/* Odd while a writer is modifying the shard. */
+	unsigned long seq;
+	Lepk__ChtArray *array;
+	size_t count;
+	/* Alive and dead slots. */
+	size_t used;
+	/* Arrays replaced by a resize that readers might still be using. */
+	Lepk__ChtArray *retired;
+} Lepk__ChtShard;
+
+/* Epoch a reader entered in, 0 when outside a read. Padded to not share cache lines. */
+typedef struct {
+	unsigned long epoch;
+	unsigned char pad[LEPK__CHT_CACHE_LINE - sizeof(unsigned long)];
+} Lepk__ChtReader;
+
+struct LepkCht {
+	LepkHtHash hash;
+	LepkHtCompare compare;
+
+	size_t key_size;
+	size_t data_size;
+
+	unsigned long epoch;
+	Lepk__ChtReader readers[LEPK_CHT_MAX_THREADS];
+	Lepk__ChtShard shards[LEPK_CHT_SHARDS];
+};
+
+/*
+ * Reader slots are handed out per thread and given back when the thread exits.
+ */
+
+static unsigned char lepk__cht_thread_used[LEPK_CHT_MAX_THREADS];
+static __thread long lepk__cht_thread_id = -1;
+static pthread_key_t lepk__cht_thread_key;
+static pthread_once_t lepk__cht_thread_once = PTHREAD_ONCE_INIT;
+
+static void lepk__cht_thread_release(void *id) {
+	__atomic_store_n(&lepk__cht_thread_used[(size_t) id - 1], 0, __ATOMIC_RELEASE);
+}
+
+static void lepk__cht_thread_init(void) {
+	pthread_key_create(&lepk__cht_thread_key, lepk__cht_thread_release);
+}
+
+static size_t lepk__cht_thread(void) {
+	if (lepk__cht_thread_id >= 0) {
+		return lepk__cht_thread_id;
+	}
+
+	pthread_once(&lepk__cht_thread_once, lepk__cht_thread_init);
+	for (size_t i = 0; i < LEPK_CHT_MAX_THREADS; i++) {
+		if (__atomic_exchange_n(&lepk__cht_thread_used[i], 1, __ATOMIC_ACQ_REL) == 0) {
+			lepk__cht_thread_id = i;
+			pthread_setspecific(lepk__cht_thread_key, (void *) (i + 1));
+			return i;
+		}
+	}
+
+	assert(false && "Too many threads using lepk_cht, increase LEPK_CHT_MAX_THREADS.");
+	return 0;
+}
+
+static Lepk__ChtReader *lepk__cht_read_begin(LepkCht *table) {
+	Lepk__ChtReader *reader = &table->readers[lepk__cht_thread()];
+	__atomic_store_n(&reader->epoch, __atomic_load_n(&table->epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return reader;
+}
+
+static void lepk__cht_read_end(Lepk__ChtReader *reader) {
+	__atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/* No reader entered before epoch is still reading. */
+static bool lepk__cht_quiescent(const LepkCht *table, unsigned long epoch) {
+	for (size_t i = 0; i < LEPK_CHT_MAX_THREADS; i++) {
+		unsigned long reader_epoch = __atomic_load_n(&table->readers[i].epoch, __ATOMIC_ACQUIRE);
+		if (reader_epoch != 0 && reader_epoch < epoch) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Free retired arrays no reader can reach anymore. Shard lock must be held. */
+static void lepk__cht_reclaim(LepkCht *table, Lepk__ChtShard *shard) {
+	Lepk__ChtArray **link = &shard->retired;
+	while (*link != NULL) {
+		Lepk__ChtArray *array = *link;
+		if (lepk__cht_quiescent(table, array->retired_epoch)) {
+			*link = array->next;
+			free(array);
+		} else {
+			link = &array->next;
+		}
+	}
+}
+
+static size_t lepk__cht_align(size_t size) {
+	return (size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+}
+
+static Lepk__ChtArray *lepk__cht_array_create(const LepkCht *table, size_t cap) {
+	size_t header = lepk__cht_align(sizeof(Lepk__ChtArray));
+	size_t hashes = lepk__cht_align(cap * sizeof(size_t));
+	size_t states = lepk__cht_align(cap);
+	size_t keys = lepk__cht_align(cap * table->key_size);
+
+	unsigned char *block = calloc(1, header + hashes + states + keys + cap * table->data_size);
+	Lepk__ChtArray *array = (Lepk__ChtArray *) block;
+	array->cap = cap;
+	array->hashes = (size_t *) (block + header);
+	array->states = block + header + hashes;
+	array->keys = block + header + hashes + states;
+	array->data = block + header + hashes + states + keys;
+	return array;
+}
+
+/* Slot index of key in array, or cap if it's missing. */
+static size_t lepk__cht_find(const LepkCht *table, const Lepk__ChtArray *array, size_t hash, const void *key) {
+	size_t mask = array->cap - 1;
+	size_t index = hash & mask;
+
+	/* Bounded so a torn read can't spin forever. */
+	for (size_t i = 0; i < array->cap; i++) {
+		unsigned char state = __atomic_load_n(&array->states[index], __ATOMIC_ACQUIRE);
+		if (state == LEPK__CHT_SLOT_EMPTY) {
+			break;
+		}
+		if (state == LEPK__CHT_SLOT_ALIVE &&
+				__atomic_load_n(&array->hashes[index], __ATOMIC_RELAXED) == hash &&
+				table->compare(key, array->keys + index * table->key_size, table->key_size) == 0) {
+			return index;
+		}
+		index = (index + 1) & mask;
+	}
+
+	return array->cap;
+}
+
+static size_t lepk__cht_free_slot(const Lepk__ChtArray *array, size_t hash) {
+	size_t mask = array->cap - 1;
+	size_t index = hash & mask;
+	while (array->states[index] == LEPK__CHT_SLOT_ALIVE) {
+		index = (index + 1) & mask;
+	}
+	return index;
+}
+
+/* Sequence counter writes, shard lock must be held. */
+static void lepk__cht_write_begin(Lepk__ChtShard *shard) {
+	__atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void lepk__cht_write_end(Lepk__ChtShard *shard) {
+	__atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_RELEASE);
+}
+
+static Lepk__ChtShard *lepk__cht_shard(LepkCht *table, size_t hash) {
+	/* Fibonacci hashing, the top bits don't overlap with the ones picking the slot. */
+	uint64_t mixed = (uint64_t) hash * 0x9e3779b97f4a7c15ull;
+	return &table->shards[(mixed >> 40) & (LEPK_CHT_SHARDS - 1)];
+}
+
+/* Rehash shard into a new array and retire the old one. Shard lock must be held. */
+static void lepk__cht_resize(LepkCht *table, Lepk__ChtShard *shard) {
+	Lepk__ChtArray *old = shard->array;
+
+	/* Tombstones fill a shard as much as entries do. Mostly tombstones just need copying out at the same size. */
+	size_t cap = old->cap;
+	if (shard->count * 2 >= shard->used) {
+		cap *= 2;
+	}
+
+	Lepk__ChtArray *array = lepk__cht_array_create(table, cap);
+	for (size_t i = 0; i < old->cap; i++) {
+		if (old->states[i] != LEPK__CHT_SLOT_ALIVE) {
+			continue;
+		}
+		size_t index = lepk__cht_free_slot(array, old->hashes[i]);
+		array->hashes[index] = old->hashes[i];
+		memcpy(array->keys + index * table->key_size, old->keys + i * table->key_size, table->key_size);
+		memcpy(array->data + index * table->data_size, old->data + i * table->data_size, table->data_size);
+		array->states[index] = LEPK__CHT_SLOT_ALIVE;
+	}
+
+	/* The old array isn't modified anymore, readers still in it see a consistent table. */
+	__atomic_store_n(&shard->array, array, __ATOMIC_RELEASE);
+	shard->used = shard->count;
+
+	old->retired_epoch = __atomic_add_fetch(&table->epoch, 1, __ATOMIC_SEQ_CST);
+	old->next = shard->retired;
+	shard->retired = old;
+	lepk__cht_reclaim(table, shard);
+}
+
+LEPKCHT LepkCht *lepk_cht_create(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size, unsigned long data_size) {
+	assert((LEPK_CHT_SHARDS & (LEPK_CHT_SHARDS - 1)) == 0 && "LEPK_CHT_SHARDS must be a power of two.");
+
+	LepkCht *table = memalign(LEPK__CHT_CACHE_LINE, sizeof(LepkCht));
+	memset(table, 0, sizeof(LepkCht));
+
+	table->hash = hash;
+	table->compare = compare;
+	table->key_size = key_size;
+	table->data_size = data_size;
+	table->epoch = 1;
+
+	for (size_t i = 0; i < LEPK_CHT_SHARDS; i++) {
+		Lepk__ChtShard *shard = &table->shards[i];
+		pthread_mutex_init(&shard->lock, NULL);
+		shard->array = lepk__cht_array_create(table, 8);
+	}
+
+	return table;
+}
+
+LEPKCHT void lepk_cht_destroy(LepkCht *table) {
+	for (size_t i = 0; i < LEPK_CHT_SHARDS; i++) {
+		Lepk__ChtShard *shard = &table->shards[i];
+		while (shard->retired != NULL) {
+			Lepk__ChtArray *next = shard->retired->next;
+			free(shard->retired);
+			shard->retired = next;
+		}
+		free(shard->array);
+		pthread_mutex_destroy(&shard->lock);
+	}
+	free(table);
+}
+
+LEPKCHT unsigned long lepk_cht_count(const LepkCht *table) {
+	unsigned long count = 0;
+	for (size_t i = 0; i < LEPK_CHT_SHARDS; i++) {
+		count += __atomic_load_n(&table->shards[i].count, __ATOMIC_RELAXED);
+	}
+	return count;
+}
+
+LEPKCHT void lepk__cht_set(LepkCht *table, const void *key, const void *data) {
+	size_t hash = table->hash(key, table->key_size);
+	Lepk__ChtShard *shard = lepk__cht_shard(table, hash);
+
+	pthread_mutex_lock(&shard->lock);
+
+	size_t index = lepk__cht_find(table, shard->array, hash, key);
+	if (index == shard->array->cap) {
+		if (shard->used >= (size_t) (shard->array->cap * LEPK_CHT_MAX_LOAD)) {
+			lepk__cht_resize(table, shard);
+		}
+
+		Lepk__ChtArray *array = shard->array;
+		index = lepk__cht_free_slot(array, hash);
+		if (array->states[index] == LEPK__CHT_SLOT_EMPTY) {
+			shard->used++;
+		}
+		__atomic_store_n(&shard->count, shard->count + 1, __ATOMIC_RELAXED);
+
+		lepk__cht_write_begin(shard);
+		array->hashes[index] = hash;
+		memcpy(array->keys + index * table->key_size, key, table->key_size);
+		memcpy(array->data + index * table->data_size, data, table->data_size);
+		__atomic_store_n(&array->states[index], LEPK__CHT_SLOT_ALIVE, __ATOMIC_RELEASE);
+		lepk__cht_write_end(shard);
+	} else {
+		lepk__cht_write_begin(shard);
+		memcpy(shard->array->data + index * table->data_size, data, table->data_size);
+		lepk__cht_write_end(shard);
+	}
+
+	pthread_mutex_unlock(&shard->lock);
+}
+
+LEPKCHT bool lepk__cht_get(LepkCht *table, const void *key, void *output) {
+	assert(output != NULL && "Output pointer can't be NULL.");
+
+	size_t hash = table->hash(key, table->key_size);
+	Lepk__ChtShard *shard = lepk__cht_shard(table, hash);
+	Lepk__ChtReader *reader = lepk__cht_read_begin(table);
+
+	bool found;
+	for (;;) {
+		unsigned long seq = __atomic_load_n(&shard->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			continue;
+		}
+
+		Lepk__ChtArray *array = __atomic_load_n(&shard->array, __ATOMIC_ACQUIRE);
+		size_t index = lepk__cht_find(table, array, hash, key);
+		found = index != array->cap;
+		if (found) {
+			memcpy(output, array->data + index * table->data_size, table->data_size);
+		}
+
+		/* Retry if a writer got in between. */
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&shard->seq, __ATOMIC_RELAXED) == seq) {
+			break;
+		}
+	}
+
+	lepk__cht_read_end(reader);
+	return found;
+}
+
+LEPKCHT bool lepk__cht_remove(LepkCht *table, const void *key, void *output) {
+	size_t hash = table->hash(key, table->key_size);
+	Lepk__ChtShard *shard = lepk__cht_shard(table, hash);
+
+	pthread_mutex_lock(&shard->lock);
+
+	Lepk__ChtArray *array = shard->array;
+	size_t index = lepk__cht_find(table, array, hash, key);
+	bool found = index != array->cap;
+	if (found) {
+		if (output != NULL) {
+			memcpy(output, array->data + index * table->data_size, table->data_size);
+		}
+		lepk__cht_write_begin(shard);
+		__atomic_store_n(&array->states[index], LEPK__CHT_SLOT_DEAD, __ATOMIC_RELEASE);
+		lepk__cht_write_end(shard);
+		__atomic_store_n(&shard->count, shard->count - 1, __ATOMIC_RELAXED);
+	}
+
+	pthread_mutex_unlock(&shard->lock);
+	return found;
+}
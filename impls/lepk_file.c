@@ -2,9 +2,156 @@
 
 #include <stdio.h>
 #include <malloc.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
+/* The crc32 instruction, compiled in for x86-64 and used if the CPU turns out to have SSE4.2. */
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define LEPK__FILE_CRC_HARDWARE
+#endif /* defined(__x86_64__) && defined(__GNUC__) */
+
+#ifdef LEPK_FILE_POSIX
+#include <errno.h>
+#include <pthread.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Copying inside the kernel, copy_file_range through a raw system call so old C libraries without a wrapper work too. */
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sendfile.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif /* __linux__ */
+
+/* io_uring through raw system calls, opening and closing files on it needs Linux 5.6. */
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#ifdef IORING_FEAT_RW_CUR_POS
+#define LEPK__FILE_URING
+#endif /* IORING_FEAT_RW_CUR_POS */
+#endif /* __has_include(<linux/io_uring.h>) */
+#endif /* defined(__linux__) && defined(__has_include) */
+
+/* Files past 2 GiB, 32 bit systems only have a 64 bit off_t with _FILE_OFFSET_BITS defined as 64. */
+typedef char lepk__file_off_t_check[sizeof(off_t) >= 8 ? 1 : -1];
+#endif /* LEPK_FILE_POSIX */
 
 #define LEPK__FILE_SET_STATUS(p, s) do {if ((p)) { *(p) = (s); }} while (0)
 
+#ifndef LEPK_FILE_WRITER_BUFFER
+#define LEPK_FILE_WRITER_BUFFER (1 << 18)
+#endif /* LEPK_FILE_WRITER_BUFFER */
+
+#ifndef LEPK_FILE_READER_CHUNK
+#define LEPK_FILE_READER_CHUNK (1 << 20)
+#endif /* LEPK_FILE_READER_CHUNK */
+
+/* Chunks a reader reading ahead cycles through, one being processed and the rest being filled. */
+#define LEPK__FILE_RING 3
+
+#ifndef LEPK_FILE_BATCH_THREADS
+#define LEPK_FILE_BATCH_THREADS 8
+#endif /* LEPK_FILE_BATCH_THREADS */
+
+/* Bytes a thread of a parallel read takes at a time. */
+#define LEPK__FILE_PARALLEL_BLOCK ((uint64_t) 4 << 20)
+
+/* Bytes a copy hands the kernel per call, and buffer size of copies done by hand. */
+#define LEPK__FILE_COPY_CHUNK ((uint64_t) 1 << 30)
+#define LEPK__FILE_COPY_BUFFER (1 << 20)
+
+/* Length of a copy running until the end of the source. */
+#define LEPK__FILE_TO_END UINT64_MAX
+
+/* Submission queue size of batch reads, half as many files are in flight since each has a read and a close queued at once. */
+#define LEPK__FILE_URING_ENTRIES 256
+
+/* Vectors handed to a single writev call, well below any IOV_MAX. */
+#define LEPK__FILE_VECTORS 64
+
+/* CRC-32C (Castagnoli) polynomial, bit reversed. */
+#define LEPK__FILE_CRC_POLYNOMIAL 0x82f63b78
+
+/* Bytes each of the three interleaved streams of the crc32 instruction covers before they're joined. */
+#define LEPK__FILE_CRC_STRIPE 4096
+
+/* Bytes a content hash takes in at a time, one 8 byte word per lane. */
+#define LEPK__FILE_HASH_STRIPE 32
+
+struct LepkFileWriter {
+#ifdef LEPK_FILE_POSIX
+	int fd;
+#else /* LEPK_FILE_POSIX */
+	FILE *file;
+#endif /* LEPK_FILE_POSIX */
+	uint64_t offset;
+
+	char *buffer;
+	size_t length;
+	size_t cap;
+};
+
+#ifdef LEPK_FILE_POSIX
+/* Atomic write waiting to be committed, its contents already in a temporary file. */
+typedef struct {
+	char *path;
+	char *temp;
+	int fd;
+} Lepk__FilePending;
+
+struct LepkFileGroup {
+	LepkFileDurability durability;
+	Lepk__FilePending *pending;
+	size_t count;
+	size_t cap;
+};
+
+typedef struct {
+	char *data;
+	size_t length;
+	LepkFileStatus status;
+	/* Read and not handed out yet, only changed with the reader's lock held. */
+	bool full;
+} Lepk__FileChunk;
+
+struct LepkFileReader {
+	int fd;
+	size_t chunk_size;
+
+	Lepk__FileChunk chunks[LEPK__FILE_RING];
+	/* Chunks in use, 1 without read ahead. */
+	int ring;
+	/* Chunk being processed and how far into it. */
+	int current;
+	size_t position;
+	bool started;
+	bool end;
+	LepkFileStatus status;
+
+	/* Record spanning chunks, pieced together. */
+	char *carry;
+	size_t carry_length;
+	size_t carry_cap;
+
+	bool read_ahead;
+	bool stop;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t filled;
+	pthread_cond_t emptied;
+};
+#endif /* LEPK_FILE_POSIX */
+
 LEPKFILEIMPL char *lepk_file_read(const char *filepath, LepkFileStatus *status) {
 	FILE *f = fopen(filepath, "rb");
 	if (f == NULL) {
@@ -76,3 +223,1787 @@ LEPKFILEIMPL LepkFileStatus lepk_file_remove(const char *filepath) {
 LEPKFILEIMPL bool lepk_file_exists(const char *filepath) {
 	return fopen(filepath, "r") != NULL;
 }
+
+#ifdef LEPK_FILE_POSIX
+/* Read everything left in fd onto the heap, for files that can't be mapped. */
+static LepkFileStatus lepk__file_read_all(int fd, LepkFileView *view) {
+	size_t cap = 1 << 16;
+	size_t length = 0;
+	char *buffer = malloc(cap);
+	if (buffer == NULL) {
+		return LEPK_FILE_STATUS_OUT_OF_MEMORY;
+	}
+
+	for (;;) {
+		if (length == cap) {
+			char *grown = realloc(buffer, cap * 2);
+			if (grown == NULL) {
+				free(buffer);
+				return LEPK_FILE_STATUS_OUT_OF_MEMORY;
+			}
+			buffer = grown;
+			cap *= 2;
+		}
+
+		ssize_t got = read(fd, buffer + length, cap - length);
+		if (got < 0 && errno == EINTR) {
+			continue;
+		}
+		if (got < 0) {
+			free(buffer);
+			return LEPK_FILE_STATUS_READ_FAILED;
+		}
+		if (got == 0) {
+			break;
+		}
+		length += got;
+	}
+
+	view->data = buffer;
+	view->length = length;
+	view->mapped = false;
+	return LEPK_FILE_STATUS_OK;
+}
+
+#else /* LEPK_FILE_POSIX */
+/* Read everything left in file onto the heap, there's nothing to map it with. */
+static LepkFileStatus lepk__file_read_all(FILE *file, LepkFileView *view) {
+	size_t cap = 1 << 16;
+	size_t length = 0;
+	char *buffer = malloc(cap);
+	if (buffer == NULL) {
+		return LEPK_FILE_STATUS_OUT_OF_MEMORY;
+	}
+
+	for (;;) {
+		if (length == cap) {
+			char *grown = realloc(buffer, cap * 2);
+			if (grown == NULL) {
+				free(buffer);
+				return LEPK_FILE_STATUS_OUT_OF_MEMORY;
+			}
+			buffer = grown;
+			cap *= 2;
+		}
+
+		size_t got = fread(buffer + length, 1, cap - length, file);
+		if (got == 0 && ferror(file)) {
+			free(buffer);
+			return LEPK_FILE_STATUS_READ_FAILED;
+		}
+		if (got == 0) {
+			break;
+		}
+		length += got;
+	}
+
+	view->data = buffer;
+	view->length = length;
+	view->mapped = false;
+	return LEPK_FILE_STATUS_OK;
+}
+#endif /* LEPK_FILE_POSIX */
+
+LEPKFILEIMPL LepkFileStatus lepk_file_map(const char *filepath, LepkFileAdvice advice, LepkFileView *view) {
+#ifdef LEPK_FILE_POSIX
+	int fd = open(filepath, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return LEPK_FILE_STATUS_READ_FAILED;
+	}
+	/* Special files can't be mapped, and files claiming to be empty may still have contents when read. */
+	if (!S_ISREG(info.st_mode) || info.st_size == 0) {
+		LepkFileStatus status = lepk__file_read_all(fd, view);
+		close(fd);
+		return status;
+	}
+
+	void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return LEPK_FILE_STATUS_READ_FAILED;
+	}
+
+	static const int advices[] = { MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED };
+	madvise(data, info.st_size, advices[advice]);
+
+	view->data = data;
+	view->length = info.st_size;
+	view->mapped = true;
+	return LEPK_FILE_STATUS_OK;
+#else /* LEPK_FILE_POSIX */
+	(void) advice;
+	FILE *file = fopen(filepath, "rb");
+	if (file == NULL) {
+		return LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE;
+	}
+	LepkFileStatus status = lepk__file_read_all(file, view);
+	fclose(file);
+	return status;
+#endif /* LEPK_FILE_POSIX */
+}
+
+LEPKFILEIMPL void lepk_file_unmap(LepkFileView *view) {
+	if (view->mapped) {
+#ifdef LEPK_FILE_POSIX
+		munmap((void *) view->data, view->length);
+#endif /* LEPK_FILE_POSIX */
+	} else {
+		free((void *) view->data);
+	}
+	view->data = NULL;
+	view->length = 0;
+}
+
+#ifdef LEPK_FILE_POSIX
+/* Write everything vectors describe, picking up after short writes. Vectors are consumed in the process. */
+static LepkFileStatus lepk__file_writev_all(int fd, struct iovec *vectors, int count) {
+	while (count > 0) {
+		ssize_t written = writev(fd, vectors, count);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+		if (written < 0) {
+			return LEPK_FILE_STATUS_WRITE_FAILED;
+		}
+
+		while (count > 0 && (size_t) written >= vectors->iov_len) {
+			written -= vectors->iov_len;
+			vectors++;
+			count--;
+		}
+		if (count > 0) {
+			vectors->iov_base = (char *) vectors->iov_base + written;
+			vectors->iov_len -= written;
+		}
+	}
+	return LEPK_FILE_STATUS_OK;
+}
+#endif /* LEPK_FILE_POSIX */
+
+LEPKFILEIMPL LepkFileWriter *lepk_file_writer_open(const char *filepath, bool append, unsigned long buffer_size, LepkFileStatus *status) {
+	LepkFileWriter *writer = malloc(sizeof(LepkFileWriter));
+	if (writer == NULL) {
+		LEPK__FILE_SET_STATUS(status, LEPK_FILE_STATUS_OUT_OF_MEMORY);
+		return NULL;
+	}
+	writer->cap = buffer_size != 0 ? buffer_size : LEPK_FILE_WRITER_BUFFER;
+	writer->length = 0;
+	writer->buffer = malloc(writer->cap);
+	if (writer->buffer == NULL) {
+		free(writer);
+		LEPK__FILE_SET_STATUS(status, LEPK_FILE_STATUS_OUT_OF_MEMORY);
+		return NULL;
+	}
+
+#ifdef LEPK_FILE_POSIX
+	writer->fd = open(filepath, O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0666);
+	struct stat info;
+	if (writer->fd < 0 || fstat(writer->fd, &info) != 0) {
+		if (writer->fd >= 0) {
+			close(writer->fd);
+		}
+		free(writer->buffer);
+		free(writer);
+		LEPK__FILE_SET_STATUS(status, LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE);
+		return NULL;
+	}
+	writer->offset = append ? (uint64_t) info.st_size : 0;
+#else /* LEPK_FILE_POSIX */
+	writer->file = fopen(filepath, append ? "ab" : "wb");
+	long end = 0;
+	if (writer->file == NULL || (append && (fseek(writer->file, 0, SEEK_END) != 0 || (end = ftell(writer->file)) < 0))) {
+		if (writer->file != NULL) {
+			fclose(writer->file);
+		}
+		free(writer->buffer);
+		free(writer);
+		LEPK__FILE_SET_STATUS(status, LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE);
+		return NULL;
+	}
+	/* The writer's own buffer is the only one. */
+	setvbuf(writer->file, NULL, _IONBF, 0);
+	writer->offset = end;
+#endif /* LEPK_FILE_POSIX */
+
+	LEPK__FILE_SET_STATUS(status, LEPK_FILE_STATUS_OK);
+	return writer;
+}
+
+LEPKFILEIMPL LepkFileStatus lepk_file_writer_write(LepkFileWriter *writer, const void *data, unsigned long length) {
+	LepkFileFragment fragment = { data, length };
+	return lepk_file_writer_writev(writer, &fragment, 1);
+}
+
+LEPKFILEIMPL LepkFileStatus lepk_file_writer_writev(LepkFileWriter *writer, const LepkFileFragment *fragments, unsigned long count) {
+	size_t total = 0;
+	for (unsigned long i = 0; i < count; i++) {
+		total += fragments[i].length;
+	}
+	writer->offset += total;
+
+	/* Common case, small writes just gather in the buffer. */
+	if (total <= writer->cap - writer->length) {
+		for (unsigned long i = 0; i < count; i++) {
+			if (fragments[i].length != 0) {
+				memcpy(writer->buffer + writer->length, fragments[i].data, fragments[i].length);
+				writer->length += fragments[i].length;
+			}
+		}
+		return LEPK_FILE_STATUS_OK;
+	}
+
+	/* Too big to gather, send the buffer and the fragments straight to the file without copying them. */
+#ifdef LEPK_FILE_POSIX
+	struct iovec vectors[LEPK__FILE_VECTORS];
+	int used = 0;
+	if (writer->length != 0) {
+		vectors[used].iov_base = writer->buffer;
+		vectors[used].iov_len = writer->length;
+		used++;
+	}
+	writer->length = 0;
+
+	for (unsigned long i = 0; i < count; i++) {
+		if (fragments[i].length == 0) {
+			continue;
+		}
+		vectors[used].iov_base = (void *) fragments[i].data;
+		vectors[used].iov_len = fragments[i].length;
+		used++;
+
+		if (used == LEPK__FILE_VECTORS) {
+			if (lepk__file_writev_all(writer->fd, vectors, used) != LEPK_FILE_STATUS_OK) {
+				return LEPK_FILE_STATUS_WRITE_FAILED;
+			}
+			used = 0;
+		}
+	}
+	return lepk__file_writev_all(writer->fd, vectors, used);
+#else /* LEPK_FILE_POSIX */
+	if (lepk_file_writer_flush(writer) != LEPK_FILE_STATUS_OK) {
+		return LEPK_FILE_STATUS_WRITE_FAILED;
+	}
+	for (unsigned long i = 0; i < count; i++) {
+		if (fragments[i].length != 0 && fwrite(fragments[i].data, fragments[i].length, 1, writer->file) != 1) {
+			return LEPK_FILE_STATUS_WRITE_FAILED;
+		}
+	}
+	return LEPK_FILE_STATUS_OK;
+#endif /* LEPK_FILE_POSIX */
+}
+
+LEPKFILEIMPL LepkFileStatus lepk_file_writer_flush(LepkFileWriter *writer) {
+#ifdef LEPK_FILE_POSIX
+	struct iovec vector = { writer->buffer, writer->length };
+	writer->length = 0;
+	return lepk__file_writev_all(writer->fd, &vector, vector.iov_len != 0);
+#else /* LEPK_FILE_POSIX */
+	size_t length = writer->length;
+	writer->length = 0;
+	if (length != 0 && fwrite(writer->buffer, length, 1, writer->file) != 1) {
+		return LEPK_FILE_STATUS_WRITE_FAILED;
+	}
+	return LEPK_FILE_STATUS_OK;
+#endif /* LEPK_FILE_POSIX */
+}
+
+LEPKFILEIMPL LepkFileStatus lepk_file_writer_sync(LepkFileWriter *writer) {
+	if (lepk_file_writer_flush(writer) != LEPK_FILE_STATUS_OK) {
+		return LEPK_FILE_STATUS_WRITE_FAILED;
+	}
+#ifdef LEPK_FILE_POSIX
+	/* Only the data and the metadata needed to read it back, not timestamps. */
+	if (fdatasync(writer->fd) != 0) {
+		return LEPK_FILE_STATUS_WRITE_FAILED;
+	}
+#endif /* LEPK_FILE_POSIX */
+	return LEPK_FILE_STATUS_OK;
+}
+
+LEPKFILEIMPL uint64_t lepk_file_writer_offset(const LepkFileWriter *writer) {
+	return writer->offset;
+}
+
+LEPKFILEIMPL LepkFileStatus lepk_file_writer_close(LepkFileWriter *writer) {
+	LepkFileStatus status = lepk_file_writer_flush(writer);
+#ifdef LEPK_FILE_POSIX
+	if (close(writer->fd) != 0 && status == LEPK_FILE_STATUS_OK) {
+#else /* LEPK_FILE_POSIX */
+	if (fclose(writer->file) != 0 && status == LEPK_FILE_STATUS_OK) {
+#endif /* LEPK_FILE_POSIX */
+		status = LEPK_FILE_STATUS_WRITE_FAILED;
+	}
+
+	free(writer->buffer);
+	free(writer);
+	return status;
+}
+
+#ifdef LEPK_FILE_POSIX
+/* Fill chunk with as much of fd as fits, so only the last chunk is short. */
+static void lepk__file_chunk_fill(int fd, Lepk__FileChunk *chunk, size_t chunk_size) {
+	chunk->length = 0;
+	chunk->status = LEPK_FILE_STATUS_OK;
+	while (chunk->length < chunk_size) {
+		ssize_t got = read(fd, chunk->data + chunk->length, chunk_size - chunk->length);
+		if (got < 0 && errno == EINTR) {
+			continue;
+		}
+		if (got < 0) {
+			chunk->status = LEPK_FILE_STATUS_READ_FAILED;
+			return;
+		}
+		if (got == 0) {
+			return;
+		}
+		chunk->length += got;
+	}
+}
+
+/* Fill chunks in ring order ahead of the consumer until the end of the file. */
+static void *lepk__file_reader_thread(void *arg) {
+	LepkFileReader *reader = arg;
+	for (int i = 0;; i = (i + 1) % reader->ring) {
+		Lepk__FileChunk *chunk = &reader->chunks[i];
+
+		pthread_mutex_lock(&reader->lock);
+		while (chunk->full && !reader->stop) {
+			pthread_cond_wait(&reader->emptied, &reader->lock);
+		}
+		bool stop = reader->stop;
+		pthread_mutex_unlock(&reader->lock);
+		if (stop) {
+			break;
+		}
+
+		lepk__file_chunk_fill(reader->fd, chunk, reader->chunk_size);
+
+		pthread_mutex_lock(&reader->lock);
+		chunk->full = true;
+		pthread_cond_signal(&reader->filled);
+		pthread_mutex_unlock(&reader->lock);
+
+		/* An empty or failed chunk ends the file for the consumer. */
+		if (chunk->length == 0 || chunk->status != LEPK_FILE_STATUS_OK) {
+			break;
+		}
+	}
+	return NULL;
+}
+
+/* Give the current chunk back and move on to the next. Returns false at the end of the file or if reading failed. */
+static bool lepk__file_reader_advance(LepkFileReader *reader) {
+	if (reader->end) {
+		return false;
+	}
+
+	if (reader->read_ahead) {
+		pthread_mutex_lock(&reader->lock);
+		if (reader->started) {
+			reader->chunks[reader->current].full = false;
+			pthread_cond_signal(&reader->emptied);
+			reader->current = (reader->current + 1) % reader->ring;
+		}
+		while (!reader->chunks[reader->current].full) {
+			pthread_cond_wait(&reader->filled, &reader->lock);
+		}
+		pthread_mutex_unlock(&reader->lock);
+	} else {
+		lepk__file_chunk_fill(reader->fd, &reader->chunks[0], reader->chunk_size);
+	}
+	reader->started = true;
+	reader->position = 0;
+
+	Lepk__FileChunk *chunk = &reader->chunks[reader->current];
+	if (chunk->length == 0 || chunk->status != LEPK_FILE_STATUS_OK) {
+		reader->status = chunk->status;
+		reader->end = true;
+		return false;
+	}
+	return true;
+}
+
+/* Append to the record being pieced together. */
+static bool lepk__file_reader_carry(LepkFileReader *reader, const char *data, size_t length) {
+	if (reader->carry_length + length > reader->carry_cap) {
+		size_t cap = reader->carry_cap != 0 ? reader->carry_cap : 256;
+		while (cap < reader->carry_length + length) {
+			cap *= 2;
+		}
+		char *carry = realloc(reader->carry, cap);
+		if (carry == NULL) {
+			reader->status = LEPK_FILE_STATUS_OUT_OF_MEMORY;
+			reader->end = true;
+			return false;
+		}
+		reader->carry = carry;
+		reader->carry_cap = cap;
+	}
+	memcpy(reader->carry + reader->carry_length, data, length);
+	reader->carry_length += length;
+	return true;
+}
+
+/* First delimiter in data, NULL if there is none. */
+static const char *lepk__file_find(const char *data, size_t length, char delimiter) {
+#ifdef __SSE2__
+	/* 64 bytes per step, a combined mask first so the common no match case is one branch. */
+	__m128i needle = _mm_set1_epi8(delimiter);
+	size_t i = 0;
+	for (; i + 64 <= length; i += 64) {
+		__m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (data + i)), needle);
+		__m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (data + i + 16)), needle);
+		__m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (data + i + 32)), needle);
+		__m128i d = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (data + i + 48)), needle);
+		if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d))) == 0) {
+			continue;
+		}
+
+		uint64_t mask = (uint64_t) _mm_movemask_epi8(a) | (uint64_t) _mm_movemask_epi8(b) << 16 |
+			(uint64_t) _mm_movemask_epi8(c) << 32 | (uint64_t) _mm_movemask_epi8(d) << 48;
+		return data + i + __builtin_ctzll(mask);
+	}
+	for (; i + 16 <= length; i += 16) {
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (data + i)), needle));
+		if (mask != 0) {
+			return data + i + __builtin_ctz(mask);
+		}
+	}
+	return memchr(data + i, delimiter, length - i);
+#else /* __SSE2__ */
+	return memchr(data, delimiter, length);
+#endif /* __SSE2__ */
+}
+
+LEPKFILEIMPL LepkFileReader *lepk_file_reader_open(const char *filepath, unsigned long chunk_size, bool read_ahead, LepkFileStatus *status) {
+	LepkFileReader *reader = calloc(1, sizeof(LepkFileReader));
+	if (reader == NULL) {
+		LEPK__FILE_SET_STATUS(status, LEPK_FILE_STATUS_OUT_OF_MEMORY);
+		return NULL;
+	}
+	reader->chunk_size = chunk_size != 0 ? chunk_size : LEPK_FILE_READER_CHUNK;
+	reader->read_ahead = read_ahead;
+	reader->ring = read_ahead ? LEPK__FILE_RING : 1;
+	reader->status = LEPK_FILE_STATUS_OK;
+
+	for (int i = 0; i < reader->ring; i++) {
+		reader->chunks[i].data = malloc(reader->chunk_size);
+		if (reader->chunks[i].data == NULL) {
+			for (int j = 0; j < i; j++) {
+				free(reader->chunks[j].data);
+			}
+			free(reader);
+			LEPK__FILE_SET_STATUS(status, LEPK_FILE_STATUS_OUT_OF_MEMORY);
+			return NULL;
+		}
+	}
+
+	reader->fd = open(filepath, O_RDONLY | O_CLOEXEC);
+	if (reader->fd < 0) {
+		for (int i = 0; i < reader->ring; i++) {
+			free(reader->chunks[i].data);
+		}
+		free(reader);
+		LEPK__FILE_SET_STATUS(status, LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE);
+		return NULL;
+	}
+	posix_fadvise(reader->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	if (read_ahead) {
+		pthread_mutex_init(&reader->lock, NULL);
+		pthread_cond_init(&reader->filled, NULL);
+		pthread_cond_init(&reader->emptied, NULL);
+		if (pthread_create(&reader->thread, NULL, lepk__file_reader_thread, reader) != 0) {
+			/* No thread, read on demand instead. */
+			pthread_mutex_destroy(&reader->lock);
+			pthread_cond_destroy(&reader->filled);
+			pthread_cond_destroy(&reader->emptied);
+			reader->read_ahead = false;
+			for (int i = 1; i < reader->ring; i++) {
+				free(reader->chunks[i].data);
+				reader->chunks[i].data = NULL;
+			}
+			reader->ring = 1;
+		}
+	}
+
+	LEPK__FILE_SET_STATUS(status, LEPK_FILE_STATUS_OK);
+	return reader;
+}
+
+LEPKFILEIMPL bool lepk_file_reader_next(LepkFileReader *reader, const char **data, unsigned long *length) {
+	Lepk__FileChunk *chunk = &reader->chunks[reader->current];
+	if (!reader->started || reader->position == chunk->length) {
+		if (!lepk__file_reader_advance(reader)) {
+			return false;
+		}
+		chunk = &reader->chunks[reader->current];
+	}
+
+	*data = chunk->data + reader->position;
+	*length = chunk->length - reader->position;
+	reader->position = chunk->length;
+	return true;
+}
+
+LEPKFILEIMPL bool lepk_file_reader_line(LepkFileReader *reader, char delimiter, const char **line, unsigned long *length) {
+	reader->carry_length = 0;
+	bool carrying = false;
+
+	for (;;) {
+		Lepk__FileChunk *chunk = &reader->chunks[reader->current];
+		if (!reader->started || reader->position == chunk->length) {
+			if (!lepk__file_reader_advance(reader)) {
+				/* Last record, not ended by a delimiter. */
+				if (carrying && reader->status == LEPK_FILE_STATUS_OK) {
+					*line = reader->carry;
+					*length = reader->carry_length;
+					return true;
+				}
+				return false;
+			}
+			chunk = &reader->chunks[reader->current];
+		}
+
+		const char *start = chunk->data + reader->position;
+		size_t left = chunk->length - reader->position;
+		const char *found = lepk__file_find(start, left, delimiter);
+		if (found == NULL) {
+			/* Runs into the next chunk, keep what's here before the chunk is given back. */
+			if (!lepk__file_reader_carry(reader, start, left)) {
+				return false;
+			}
+			carrying = true;
+			reader->position = chunk->length;
+			continue;
+		}
+
+		size_t record = found - start;
+		reader->position += record + 1;
+		if (!carrying) {
+			*line = start;
+			*length = record;
+			return true;
+		}
+		if (!lepk__file_reader_carry(reader, start, record)) {
+			return false;
+		}
+		*line = reader->carry;
+		*length = reader->carry_length;
+		return true;
+	}
+}
+
+LEPKFILEIMPL LepkFileStatus lepk_file_reader_status(const LepkFileReader *reader) {
+	return reader->status;
+}
+
+LEPKFILEIMPL void lepk_file_reader_close(LepkFileReader *reader) {
+	if (reader->read_ahead) {
+		pthread_mutex_lock(&reader->lock);
+		reader->stop = true;
+		pthread_cond_signal(&reader->emptied);
+		pthread_mutex_unlock(&reader->lock);
+		pthread_join(reader->thread, NULL);
+
+		pthread_mutex_destroy(&reader->lock);
+		pthread_cond_destroy(&reader->filled);
+		pthread_cond_destroy(&reader->emptied);
+	}
+
+	close(reader->fd);
+	for (int i = 0; i < reader->ring; i++) {
+		free(reader->chunks[i].data);
+	}
+	free(reader->carry);
+	free(reader);
+}
+
+/* Run work on threads threads, the calling thread being one of them. Fewer run if threads can't be started. */
+static void lepk__file_run_threads(void *(*work)(void *), void *arg, unsigned long threads) {
+	pthread_t *ids = malloc(threads * sizeof(pthread_t));
+	unsigned long started = 0;
+	while (ids != NULL && started + 1 < threads && pthread_create(&ids[started], NULL, work, arg) == 0) {
+		started++;
+	}
+	work(arg);
+	for (unsigned long i = 0; i < started; i++) {
+		pthread_join(ids[i], NULL);
+	}
+	free(ids);
+}
+
+/* Read one file of a batch with plain system calls. */
+static void lepk__file_batch_read_one(LepkFileBatchRead *read_entry) {
+	read_entry->length = 0;
+	int fd = open(read_entry->filepath, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		read_entry->status = LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE;
+		return;
+	}
+
+	ssize_t got;
+	do {
+		got = read(fd, read_entry->buffer, read_entry->capacity);
+	} while (got < 0 && errno == EINTR);
+	read_entry->status = got < 0 ? LEPK_FILE_STATUS_READ_FAILED : LEPK_FILE_STATUS_OK;
+	read_entry->length = got < 0 ? 0 : got;
+	close(fd);
+}
+
+typedef struct {
+	LepkFileBatchRead *reads;
+	unsigned long count;
+	/* Next read to be taken by a thread. */
+	unsigned long next;
+} Lepk__FileBatch;
+
+static void *lepk__file_batch_thread(void *arg) {
+	Lepk__FileBatch *batch = arg;
+	for (;;) {
+		unsigned long i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+		if (i >= batch->count) {
+			return NULL;
+		}
+		lepk__file_batch_read_one(&batch->reads[i]);
+	}
+}
+
+/* Fallback where io_uring isn't there, threads taking one file at a time. */
+static void lepk__file_batch_threads(LepkFileBatchRead *reads, unsigned long count, unsigned long threads) {
+	Lepk__FileBatch batch = { reads, count, 0 };
+	lepk__file_run_threads(lepk__file_batch_thread, &batch, threads < count ? threads : count);
+}
+
+#ifdef LEPK__FILE_URING
+
+/* Mapped rings of an io_uring. */
+typedef struct {
+	int fd;
+	unsigned entries;
+
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	size_t sqes_size;
+} Lepk__FileUring;
+
+/* Operations of a batch read, kept in the low bits of an entry's user data. */
+enum {
+	LEPK__FILE_URING_OPEN,
+	LEPK__FILE_URING_READ,
+	LEPK__FILE_URING_CLOSE,
+};
+
+static void lepk__file_uring_destroy(Lepk__FileUring *ring) {
+	if (ring->sqes != NULL) {
+		munmap(ring->sqes, ring->sqes_size);
+	}
+	if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+		munmap(ring->cq_ring, ring->cq_ring_size);
+	}
+	if (ring->sq_ring != NULL) {
+		munmap(ring->sq_ring, ring->sq_ring_size);
+	}
+	close(ring->fd);
+}
+
+/* Set up a ring, false if the kernel doesn't have io_uring, has it disabled or is too old to open files on it. */
+static bool lepk__file_uring_create(Lepk__FileUring *ring, unsigned entries) {
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	memset(ring, 0, sizeof(Lepk__FileUring));
+
+	ring->fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+	if (ring->fd < 0) {
+		return false;
+	}
+	if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+		close(ring->fd);
+		return false;
+	}
+	ring->entries = params.sq_entries;
+
+	ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_ring_size > ring->sq_ring_size) {
+			ring->sq_ring_size = ring->cq_ring_size;
+		}
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED) {
+		ring->sq_ring = NULL;
+		lepk__file_uring_destroy(ring);
+		return false;
+	}
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ring = ring->sq_ring;
+	} else {
+		ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED) {
+			ring->cq_ring = NULL;
+			lepk__file_uring_destroy(ring);
+			return false;
+		}
+	}
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		lepk__file_uring_destroy(ring);
+		return false;
+	}
+
+	char *sq = ring->sq_ring;
+	char *cq = ring->cq_ring;
+	ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+	ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+	ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+	ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+	ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+	ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+	return true;
+}
+
+/* Queue an operation on file index. The caller keeps the queue from overflowing. */
+static struct io_uring_sqe *lepk__file_uring_push(Lepk__FileUring *ring, int opcode, int fd, unsigned long index, int operation) {
+	unsigned tail = *ring->sq_tail;
+	unsigned slot = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[slot];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->user_data = (uint64_t) index << 2 | operation;
+	ring->sq_array[slot] = slot;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	return sqe;
+}
+
+/* Descriptor table entries of batch reads not opened yet, being opened and already closed. */
+#define LEPK__FILE_URING_UNOPENED -1
+#define LEPK__FILE_URING_FINISHED -2
+#define LEPK__FILE_URING_OPENING -3
+
+/*
+ * Returns false if the ring stopped working. It first waits for whatever the kernel already took,
+ * the files left unfinished in fds are closed and up to the caller to redo.
+ */
+static bool lepk__file_batch_uring(Lepk__FileUring *ring, LepkFileBatchRead *reads, unsigned long count, int *fds) {
+	unsigned long next = 0;
+	unsigned long done = 0;
+	unsigned in_flight = 0;
+	unsigned pending = 0;
+	/* Once broken nothing more is queued, the submitted entries are only waited for. */
+	bool broken = false;
+	unsigned long submitted_total = 0;
+	unsigned long reaped = 0;
+
+	while (broken ? reaped < submitted_total : done < count) {
+		while (!broken && next < count && in_flight < ring->entries / 2) {
+			struct io_uring_sqe *sqe = lepk__file_uring_push(ring, IORING_OP_OPENAT, AT_FDCWD, next, LEPK__FILE_URING_OPEN);
+			sqe->addr = (uint64_t) (uintptr_t) reads[next].filepath;
+			sqe->open_flags = O_RDONLY | O_CLOEXEC;
+			fds[next] = LEPK__FILE_URING_OPENING;
+			next++;
+			in_flight++;
+			pending++;
+		}
+
+		long submitted = syscall(__NR_io_uring_enter, ring->fd, broken ? 0 : pending, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		if (submitted < 0) {
+			if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+				continue;
+			}
+			if (broken) {
+				break;
+			}
+			broken = true;
+			continue;
+		}
+		pending -= submitted;
+		submitted_total += submitted;
+
+		unsigned head = *ring->cq_head;
+		unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++) {
+			struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+			unsigned long index = cqe->user_data >> 2;
+			LepkFileBatchRead *read_entry = &reads[index];
+			reaped++;
+
+			switch (cqe->user_data & 3) {
+			case LEPK__FILE_URING_OPEN:
+				read_entry->length = 0;
+				if (cqe->res < 0) {
+					read_entry->status = LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE;
+					fds[index] = LEPK__FILE_URING_FINISHED;
+					done++;
+					in_flight--;
+					break;
+				}
+				if (broken) {
+					close(cqe->res);
+					fds[index] = LEPK__FILE_URING_UNOPENED;
+					in_flight--;
+					break;
+				}
+
+				/* The close is hard linked so it runs even if the read fails. */
+				fds[index] = cqe->res;
+				struct io_uring_sqe *sqe = lepk__file_uring_push(ring, IORING_OP_READ, fds[index], index, LEPK__FILE_URING_READ);
+				sqe->addr = (uint64_t) (uintptr_t) read_entry->buffer;
+				sqe->len = read_entry->capacity < 0x7ffff000ul ? read_entry->capacity : 0x7ffff000ul;
+				sqe->off = 0;
+				sqe->flags = IOSQE_IO_HARDLINK;
+				lepk__file_uring_push(ring, IORING_OP_CLOSE, fds[index], index, LEPK__FILE_URING_CLOSE);
+				pending += 2;
+				break;
+			case LEPK__FILE_URING_READ:
+				read_entry->status = cqe->res < 0 ? LEPK_FILE_STATUS_READ_FAILED : LEPK_FILE_STATUS_OK;
+				read_entry->length = cqe->res < 0 ? 0 : cqe->res;
+				break;
+			default:
+				fds[index] = LEPK__FILE_URING_FINISHED;
+				done++;
+				in_flight--;
+				break;
+			}
+		}
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+	}
+	if (!broken) {
+		return true;
+	}
+
+	/*
+	 * The last pending entries never reached the kernel. A descriptor is only closed here if its close
+	 * is one of them, anything the kernel took may already have been closed and the number reused.
+	 */
+	unsigned tail = *ring->sq_tail;
+	for (unsigned i = tail - pending; i != tail; i++) {
+		struct io_uring_sqe *sqe = &ring->sqes[ring->sq_array[i & *ring->sq_mask]];
+		unsigned long index = sqe->user_data >> 2;
+		if ((sqe->user_data & 3) == LEPK__FILE_URING_CLOSE) {
+			close(fds[index]);
+		}
+		if ((sqe->user_data & 3) != LEPK__FILE_URING_READ) {
+			fds[index] = LEPK__FILE_URING_UNOPENED;
+		}
+	}
+
+	/* If waiting failed too the kernel still has these, they can't be redone or closed safely. */
+	for (unsigned long i = 0; reaped < submitted_total && i < count; i++) {
+		if (fds[i] >= 0 || fds[i] == LEPK__FILE_URING_OPENING) {
+			reads[i].status = LEPK_FILE_STATUS_READ_FAILED;
+			reads[i].length = 0;
+			fds[i] = LEPK__FILE_URING_FINISHED;
+		}
+	}
+	return false;
+}
+
+#endif /* LEPK__FILE_URING */
+
+LEPKFILEIMPL LepkFileStatus lepk_file_read_batch(LepkFileBatchRead *reads, unsigned long count, unsigned long threads) {
+#ifdef LEPK__FILE_URING
+	Lepk__FileUring ring;
+	if (threads == 0 && count > 1 && lepk__file_uring_create(&ring, LEPK__FILE_URING_ENTRIES)) {
+		int *fds = malloc(count * sizeof(int));
+		for (unsigned long i = 0; fds != NULL && i < count; i++) {
+			fds[i] = LEPK__FILE_URING_UNOPENED;
+		}
+		bool worked = fds != NULL && lepk__file_batch_uring(&ring, reads, count, fds);
+		lepk__file_uring_destroy(&ring);
+
+		if (!worked) {
+			/* Redo whatever the ring didn't finish. */
+			for (unsigned long i = 0; i < count; i++) {
+				if (fds == NULL || fds[i] != LEPK__FILE_URING_FINISHED) {
+					lepk__file_batch_read_one(&reads[i]);
+				}
+			}
+		}
+		free(fds);
+	} else
+#endif /* LEPK__FILE_URING */
+	lepk__file_batch_threads(reads, count, threads != 0 ? threads : LEPK_FILE_BATCH_THREADS);
+
+	for (unsigned long i = 0; i < count; i++) {
+		if (reads[i].status != LEPK_FILE_STATUS_OK) {
+			return reads[i].status;
+		}
+	}
+	return LEPK_FILE_STATUS_OK;
+}
+
+typedef struct {
+	int fd;
+	char *data;
+	uint64_t length;
+	/* Offset of the next block to be taken by a thread. */
+	uint64_t next;
+	LepkFileStatus status;
+} Lepk__FileParallel;
+
+static void *lepk__file_parallel_thread(void *arg) {
+	Lepk__FileParallel *load = arg;
+	for (;;) {
+		uint64_t offset = __atomic_fetch_add(&load->next, LEPK__FILE_PARALLEL_BLOCK, __ATOMIC_RELAXED);
+		if (offset >= load->length) {
+			return NULL;
+		}
+
+		uint64_t end = load->length - offset > LEPK__FILE_PARALLEL_BLOCK ? offset + LEPK__FILE_PARALLEL_BLOCK : load->length;
+		while (offset < end) {
+			ssize_t got = pread(load->fd, load->data + offset, end - offset, (off_t) offset);
+			if (got < 0 && errno == EINTR) {
+				continue;
+			}
+			/* Nothing read means the file shrank under us. */
+			if (got <= 0) {
+				__atomic_store_n(&load->status, LEPK_FILE_STATUS_READ_FAILED, __ATOMIC_RELAXED);
+				return NULL;
+			}
+			offset += got;
+		}
+	}
+}
+
+LEPKFILEIMPL LepkFileStatus lepk_file_read_parallel(const char *filepath, unsigned long threads, bool huge_pages, LepkFileView *view) {
+	int fd = open(filepath, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return LEPK_FILE_STATUS_READ_FAILED;
+	}
+	if (!S_ISREG(info.st_mode) || info.st_size == 0) {
+		LepkFileStatus status = lepk__file_read_all(fd, view);
+		close(fd);
+		return status;
+	}
+	if ((uint64_t) info.st_size > SIZE_MAX) {
+		close(fd);
+		return LEPK_FILE_STATUS_OUT_OF_MEMORY;
+	}
+
+	Lepk__FileParallel load = { fd, NULL, info.st_size, 0, LEPK_FILE_STATUS_OK };
+	bool mapped = false;
+	if (huge_pages) {
+		/* Anonymous memory, transparent huge pages only back mappings. */
+		void *data = mmap(NULL, load.length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (data != MAP_FAILED) {
+			load.data = data;
+			mapped = true;
+#ifdef MADV_HUGEPAGE
+			madvise(load.data, load.length, MADV_HUGEPAGE);
+#endif /* MADV_HUGEPAGE */
+		}
+	}
+	/* Huge pages are only a hint, if the mapping fails the heap does too. */
+	if (load.data == NULL) {
+		load.data = malloc(load.length);
+	}
+	if (load.data == NULL) {
+		close(fd);
+		return LEPK_FILE_STATUS_OUT_OF_MEMORY;
+	}
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? cpus : 1;
+	}
+	uint64_t blocks = (load.length + LEPK__FILE_PARALLEL_BLOCK - 1) / LEPK__FILE_PARALLEL_BLOCK;
+	lepk__file_run_threads(lepk__file_parallel_thread, &load, threads < blocks ? threads : blocks);
+	close(fd);
+
+	view->data = load.data;
+	view->length = load.length;
+	view->mapped = mapped;
+	if (load.status != LEPK_FILE_STATUS_OK) {
+		lepk_file_unmap(view);
+	}
+	return load.status;
+}
+
+/* Ways of copying between files, tried in order until one works for the pair. */
+enum {
+	LEPK__FILE_COPY_RANGE,
+	LEPK__FILE_COPY_SENDFILE,
+	LEPK__FILE_COPY_BY_HAND,
+};
+
+/* Copy with read and write, for files the kernel can't copy between. */
+static ssize_t lepk__file_copy_by_hand(int in, uint64_t in_offset, int out, uint64_t out_offset, size_t length, char **buffer) {
+	if (*buffer == NULL) {
+		*buffer = malloc(LEPK__FILE_COPY_BUFFER);
+		if (*buffer == NULL) {
+			return -1;
+		}
+	}
+
+	ssize_t got = pread(in, *buffer, length < LEPK__FILE_COPY_BUFFER ? length : LEPK__FILE_COPY_BUFFER, (off_t) in_offset);
+	for (ssize_t written = 0; written < got;) {
+		ssize_t put = pwrite(out, *buffer + written, got - written, (off_t) (out_offset + written));
+		if (put < 0 && errno != EINTR) {
+			return -1;
+		}
+		written += put > 0 ? put : 0;
+	}
+	return got;
+}
+
+/*
+ * Copy length bytes of in at in_offset to out at out_offset, or everything up to the end of in
+ * if length is LEPK__FILE_TO_END. Bytes copied are added to copied.
+ */
+static LepkFileStatus lepk__file_copy_fd(int in, uint64_t in_offset, int out, uint64_t out_offset, uint64_t length, uint64_t *copied) {
+	/* copy_file_range takes the size special files report at face value, and they mostly report 0. */
+	int method = length != LEPK__FILE_TO_END ? LEPK__FILE_COPY_RANGE : LEPK__FILE_COPY_SENDFILE;
+	char *buffer = NULL;
+	uint64_t done = 0;
+	while (done < length) {
+		size_t chunk = length - done < LEPK__FILE_COPY_CHUNK ? length - done : LEPK__FILE_COPY_CHUNK;
+		ssize_t result = -1;
+
+		switch (method) {
+		case LEPK__FILE_COPY_RANGE: {
+#ifdef __NR_copy_file_range
+			/* Reflinks or copies server side where the filesystem can, never touches user space. */
+			off_t in_position = in_offset + done;
+			off_t out_position = out_offset + done;
+			result = syscall(__NR_copy_file_range, in, &in_position, out, &out_position, chunk, 0);
+#else
+			/* Left over from earlier calls otherwise, and an EINTR would retry this forever. */
+			errno = ENOSYS;
+#endif /* __NR_copy_file_range */
+		} break;
+		case LEPK__FILE_COPY_SENDFILE: {
+#ifdef __linux__
+			/* Writes at out's position rather than taking an offset. */
+			off_t in_position = in_offset + done;
+			if (lseek(out, out_offset + done, SEEK_SET) >= 0) {
+				result = sendfile(out, in, &in_position, chunk);
+			}
+#else
+			errno = ENOSYS;
+#endif /* __linux__ */
+		} break;
+		default:
+			result = lepk__file_copy_by_hand(in, in_offset + done, out, out_offset + done, chunk, &buffer);
+			break;
+		}
+
+		if (result < 0 && errno == EINTR) {
+			continue;
+		}
+		if (result < 0) {
+			/* Not supported between these files, try the next way. */
+			if (method == LEPK__FILE_COPY_BY_HAND) {
+				free(buffer);
+				*copied += done;
+				return LEPK_FILE_STATUS_WRITE_FAILED;
+			}
+			method++;
+			continue;
+		}
+		if (result == 0) {
+			break;
+		}
+		done += result;
+	}
+
+	free(buffer);
+	*copied += done;
+	/* Source ended early. */
+	if (length != LEPK__FILE_TO_END && done < length) {
+		return LEPK_FILE_STATUS_READ_FAILED;
+	}
+	return LEPK_FILE_STATUS_OK;
+}
+
+/* Length to copy from the start of in to its end. Special files don't know theirs. */
+static uint64_t lepk__file_copy_length(int in) {
+	struct stat info;
+	if (fstat(in, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+		return LEPK__FILE_TO_END;
+	}
+	return info.st_size;
+}
+
+/*
+ * Empty out, opened without O_TRUNC, unless it is the file source names. Truncating first would
+ * destroy a source that is also the destination before anything is read from it.
+ */
+static LepkFileStatus lepk__file_copy_truncate(int out, const char *const *sources, unsigned long count) {
+	struct stat destination;
+	if (fstat(out, &destination) != 0) {
+		return LEPK_FILE_STATUS_WRITE_FAILED;
+	}
+	for (unsigned long i = 0; i < count; i++) {
+		struct stat source;
+		if (stat(sources[i], &source) == 0 && source.st_dev == destination.st_dev && source.st_ino == destination.st_ino) {
+			return LEPK_FILE_STATUS_SAME_FILE;
+		}
+	}
+	return ftruncate(out, 0) == 0 ? LEPK_FILE_STATUS_OK : LEPK_FILE_STATUS_WRITE_FAILED;
+}
+
+LEPKFILEIMPL LepkFileStatus lepk_file_copy(const char *source, const char *destination) {
+	int in = open(source, O_RDONLY | O_CLOEXEC);
+	if (in < 0) {
+		return LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE;
+	}
+	int out = open(destination, O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+	if (out < 0) {
+		close(in);
+		return LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE;
+	}
+
+	LepkFileStatus status = lepk__file_copy_truncate(out, &source, 1);
+#ifdef FICLONE
+	/* Share the source's extents outright on filesystems with copy on write. */
+	if (status == LEPK_FILE_STATUS_OK && ioctl(out, FICLONE, in) != 0)
+#else /* FICLONE */
+	if (status == LEPK_FILE_STATUS_OK)
+#endif /* FICLONE */
+	{
+		uint64_t copied = 0;
+		status = lepk__file_copy_fd(in, 0, out, 0, lepk__file_copy_length(in), &copied);
+	}
+
+	close(in);
+	if (close(out) != 0 && status == LEPK_FILE_STATUS_OK) {
+		status = LEPK_FILE_STATUS_WRITE_FAILED;
+	}
+	return status;
+}
+
+LEPKFILEIMPL LepkFileStatus lepk_file_concat(const char *destination, const char *const *sources, unsigned long count) {
+	int out = open(destination, O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+	if (out < 0) {
+		return LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE;
+	}
+
+	LepkFileStatus status = lepk__file_copy_truncate(out, sources, count);
+	uint64_t offset = 0;
+	for (unsigned long i = 0; i < count && status == LEPK_FILE_STATUS_OK; i++) {
+		int in = open(sources[i], O_RDONLY | O_CLOEXEC);
+		if (in < 0) {
+			status = LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE;
+			break;
+		}
+		status = lepk__file_copy_fd(in, 0, out, offset, lepk__file_copy_length(in), &offset);
+		close(in);
+	}
+
+	if (close(out) != 0 && status == LEPK_FILE_STATUS_OK) {
+		status = LEPK_FILE_STATUS_WRITE_FAILED;
+	}
+	return status;
+}
+
+LEPKFILEIMPL LepkFileStatus lepk_file_copy_range(const char *source, uint64_t source_offset, const char *destination, uint64_t destination_offset, uint64_t length) {
+	int in = open(source, O_RDONLY | O_CLOEXEC);
+	if (in < 0) {
+		return LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE;
+	}
+	int out = open(destination, O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+	if (out < 0) {
+		close(in);
+		return LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE;
+	}
+
+	uint64_t copied = 0;
+	LepkFileStatus status = lepk__file_copy_fd(in, source_offset, out, destination_offset, length, &copied);
+
+	close(in);
+	if (close(out) != 0 && status == LEPK_FILE_STATUS_OK) {
+		status = LEPK_FILE_STATUS_WRITE_FAILED;
+	}
+	return status;
+}
+
+/* Temporary file name in filepath's directory, so renaming it over filepath never crosses filesystems. */
+static char *lepk__file_temp_path(const char *filepath) {
+	static unsigned long counter;
+	unsigned long id = __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+
+	size_t length = strlen(filepath) + 64;
+	char *temp = malloc(length);
+	if (temp != NULL) {
+		snprintf(temp, length, "%s.%ld.%lu.tmp", filepath, (long) getpid(), id);
+	}
+	return temp;
+}
+
+static void lepk__file_pending_drop(Lepk__FilePending *pending) {
+	if (pending->fd >= 0) {
+		close(pending->fd);
+	}
+	if (pending->temp != NULL) {
+		unlink(pending->temp);
+	}
+	free(pending->temp);
+	free(pending->path);
+}
+
+/* Write content into a new temporary file for filepath, kept open in pending until it's committed. */
+static LepkFileStatus lepk__file_pending_write(Lepk__FilePending *pending, const char *filepath, const char *content, size_t length) {
+	pending->fd = -1;
+	pending->temp = NULL;
+	pending->path = malloc(strlen(filepath) + 1);
+	if (pending->path == NULL) {
+		return LEPK_FILE_STATUS_OUT_OF_MEMORY;
+	}
+	strcpy(pending->path, filepath);
+	pending->temp = lepk__file_temp_path(filepath);
+	if (pending->temp == NULL) {
+		lepk__file_pending_drop(pending);
+		return LEPK_FILE_STATUS_OUT_OF_MEMORY;
+	}
+
+	pending->fd = open(pending->temp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+	if (pending->fd < 0) {
+		free(pending->temp);
+		pending->temp = NULL;
+		lepk__file_pending_drop(pending);
+		return LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE;
+	}
+
+	struct iovec vector = { (void *) content, length };
+	if (lepk__file_writev_all(pending->fd, &vector, length != 0) != LEPK_FILE_STATUS_OK) {
+		lepk__file_pending_drop(pending);
+		return LEPK_FILE_STATUS_WRITE_FAILED;
+	}
+	return LEPK_FILE_STATUS_OK;
+}
+
+/* Length of the directory part of filepath, 0 if it's in the working directory. */
+static size_t lepk__file_directory_length(const char *filepath) {
+	const char *slash = strrchr(filepath, '/');
+	if (slash == NULL) {
+		return 0;
+	}
+	/* Keep the slash of the root directory. */
+	return slash == filepath ? 1 : (size_t) (slash - filepath);
+}
+
+/* Sync the directory filepath is in, making renames in it durable. */
+static LepkFileStatus lepk__file_directory_sync(const char *filepath) {
+	size_t length = lepk__file_directory_length(filepath);
+	char *directory = malloc(length + 2);
+	if (directory == NULL) {
+		return LEPK_FILE_STATUS_OUT_OF_MEMORY;
+	}
+	if (length == 0) {
+		strcpy(directory, ".");
+	} else {
+		memcpy(directory, filepath, length);
+		directory[length] = '\0';
+	}
+
+	int fd = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	free(directory);
+	LepkFileStatus status = fd >= 0 && fsync(fd) == 0 ? LEPK_FILE_STATUS_OK : LEPK_FILE_STATUS_WRITE_FAILED;
+	if (fd >= 0) {
+		close(fd);
+	}
+	return status;
+}
+
+/* Sync, rename and drop count pending writes. Nothing is renamed if any of the contents failed to reach the disk. */
+static LepkFileStatus lepk__file_pending_commit(Lepk__FilePending *pending, size_t count, LepkFileDurability durability) {
+	LepkFileStatus status = LEPK_FILE_STATUS_OK;
+
+	if (durability >= LEPK_FILE_DURABILITY_DATA) {
+#if defined(SYNC_FILE_RANGE_WRITE) && defined(_GNU_SOURCE)
+		/* Start writing every file out before waiting on any, so the disk sees them all at once. glibc only declares it for _GNU_SOURCE. */
+		for (size_t i = 0; i < count; i++) {
+			sync_file_range(pending[i].fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+		}
+#endif /* defined(SYNC_FILE_RANGE_WRITE) && defined(_GNU_SOURCE) */
+		for (size_t i = 0; i < count; i++) {
+			if (fdatasync(pending[i].fd) != 0) {
+				status = LEPK_FILE_STATUS_WRITE_FAILED;
+			}
+		}
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (close(pending[i].fd) != 0) {
+			status = LEPK_FILE_STATUS_WRITE_FAILED;
+		}
+		pending[i].fd = -1;
+	}
+
+	for (size_t i = 0; i < count && status == LEPK_FILE_STATUS_OK; i++) {
+		if (rename(pending[i].temp, pending[i].path) != 0) {
+			status = LEPK_FILE_STATUS_WRITE_FAILED;
+			break;
+		}
+		free(pending[i].temp);
+		pending[i].temp = NULL;
+	}
+
+	if (status == LEPK_FILE_STATUS_OK && durability == LEPK_FILE_DURABILITY_FULL) {
+		for (size_t i = 0; i < count && status == LEPK_FILE_STATUS_OK; i++) {
+			/* Runs of writes to the same directory share its sync. */
+			size_t length = lepk__file_directory_length(pending[i].path);
+			if (i > 0 && length == lepk__file_directory_length(pending[i - 1].path) && strncmp(pending[i].path, pending[i - 1].path, length) == 0) {
+				continue;
+			}
+			status = lepk__file_directory_sync(pending[i].path);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		lepk__file_pending_drop(&pending[i]);
+	}
+	return status;
+}
+
+LEPKFILEIMPL LepkFileStatus lepk_file_write_atomic(const char *filepath, const char *content, unsigned long length, LepkFileDurability durability) {
+	Lepk__FilePending pending;
+	LepkFileStatus status = lepk__file_pending_write(&pending, filepath, content, length);
+	if (status != LEPK_FILE_STATUS_OK) {
+		return status;
+	}
+	return lepk__file_pending_commit(&pending, 1, durability);
+}
+
+LEPKFILEIMPL LepkFileGroup *lepk_file_group_create(LepkFileDurability durability) {
+	LepkFileGroup *group = malloc(sizeof(LepkFileGroup));
+	if (group == NULL) {
+		return NULL;
+	}
+
+	group->durability = durability;
+	group->pending = NULL;
+	group->count = 0;
+	group->cap = 0;
+	return group;
+}
+
+LEPKFILEIMPL LepkFileStatus lepk_file_group_write(LepkFileGroup *group, const char *filepath, const char *content, unsigned long length) {
+	if (group->count == group->cap) {
+		size_t cap = group->cap != 0 ? group->cap * 2 : 8;
+		Lepk__FilePending *pending = realloc(group->pending, cap * sizeof(Lepk__FilePending));
+		if (pending == NULL) {
+			return LEPK_FILE_STATUS_OUT_OF_MEMORY;
+		}
+		group->pending = pending;
+		group->cap = cap;
+	}
+
+	LepkFileStatus status = lepk__file_pending_write(&group->pending[group->count], filepath, content, length);
+	if (status == LEPK_FILE_STATUS_OK) {
+		group->count++;
+	}
+	return status;
+}
+
+LEPKFILEIMPL LepkFileStatus lepk_file_group_commit(LepkFileGroup *group) {
+	LepkFileStatus status = lepk__file_pending_commit(group->pending, group->count, group->durability);
+	group->count = 0;
+	return status;
+}
+
+LEPKFILEIMPL void lepk_file_group_destroy(LepkFileGroup *group) {
+	for (size_t i = 0; i < group->count; i++) {
+		lepk__file_pending_drop(&group->pending[i]);
+	}
+	free(group->pending);
+	free(group);
+}
+#endif /* LEPK_FILE_POSIX */
+
+/* Powers of x kept, x^(2^n) for every bit of 8 * length. They don't repeat with any short period modulo the polynomial. */
+#define LEPK__FILE_CRC_POWERS (64 + 3)
+
+/* Tables of the slicing-by-8 CRC, 8 bytes at a time, and powers of x used to shift a CRC over bytes after it. */
+static uint32_t lepk__file_crc_tables[8][256];
+static uint32_t lepk__file_crc_powers[LEPK__FILE_CRC_POWERS];
+static uint32_t lepk__file_crc_stripe_shift;
+static bool lepk__file_crc_hardware;
+#ifdef LEPK_FILE_POSIX
+static pthread_once_t lepk__file_crc_once = PTHREAD_ONCE_INIT;
+#else /* LEPK_FILE_POSIX */
+static bool lepk__file_crc_built;
+#endif /* LEPK_FILE_POSIX */
+
+/* Product of two polynomials modulo the CRC polynomial, bit reversed like the CRC itself. */
+static uint32_t lepk__file_crc_multiply(uint32_t a, uint32_t b) {
+	uint32_t product = 0;
+	for (uint32_t bit = (uint32_t) 1 << 31; bit != 0; bit >>= 1) {
+		if (a & bit) {
+			product ^= b;
+		}
+		b = b & 1 ? (b >> 1) ^ LEPK__FILE_CRC_POLYNOMIAL : b >> 1;
+	}
+	return product;
+}
+
+/* x to the power of 8 * length, multiplying a CRC by it is the same as running it over length zero bytes. */
+static uint32_t lepk__file_crc_shift(uint64_t length) {
+	uint32_t power = (uint32_t) 1 << 31;
+	for (unsigned int k = 3; length != 0; length >>= 1, k++) {
+		if (length & 1) {
+			power = lepk__file_crc_multiply(lepk__file_crc_powers[k], power);
+		}
+	}
+	return power;
+}
+
+static void lepk__file_crc_init(void) {
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t entry = i;
+		for (int bit = 0; bit < 8; bit++) {
+			entry = entry & 1 ? (entry >> 1) ^ LEPK__FILE_CRC_POLYNOMIAL : entry >> 1;
+		}
+		lepk__file_crc_tables[0][i] = entry;
+	}
+	for (int table = 1; table < 8; table++) {
+		for (int i = 0; i < 256; i++) {
+			uint32_t previous = lepk__file_crc_tables[table - 1][i];
+			lepk__file_crc_tables[table][i] = (previous >> 8) ^ lepk__file_crc_tables[0][previous & 0xff];
+		}
+	}
+
+	/* x^1, then each power of x squared. */
+	lepk__file_crc_powers[0] = (uint32_t) 1 << 30;
+	for (int i = 1; i < LEPK__FILE_CRC_POWERS; i++) {
+		lepk__file_crc_powers[i] = lepk__file_crc_multiply(lepk__file_crc_powers[i - 1], lepk__file_crc_powers[i - 1]);
+	}
+	lepk__file_crc_stripe_shift = lepk__file_crc_shift(LEPK__FILE_CRC_STRIPE);
+
+#ifdef LEPK__FILE_CRC_HARDWARE
+	lepk__file_crc_hardware = __builtin_cpu_supports("sse4.2");
+#endif /* LEPK__FILE_CRC_HARDWARE */
+}
+
+/* Build the tables on first use. Without pthreads nothing guards them, so the first call mustn't race another. */
+static void lepk__file_crc_start(void) {
+#ifdef LEPK_FILE_POSIX
+	pthread_once(&lepk__file_crc_once, lepk__file_crc_init);
+#else /* LEPK_FILE_POSIX */
+	if (!lepk__file_crc_built) {
+		lepk__file_crc_init();
+		lepk__file_crc_built = true;
+	}
+#endif /* LEPK_FILE_POSIX */
+}
+
+/* Slicing-by-8 on the raw CRC register, eight table lookups per 8 bytes. */
+static uint32_t lepk__file_crc_software(uint32_t crc, const unsigned char *bytes, size_t length) {
+	uint32_t (*tables)[256] = lepk__file_crc_tables;
+	for (; length >= 8; bytes += 8, length -= 8) {
+		uint32_t low = crc ^ ((uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24);
+		uint32_t high = (uint32_t) bytes[4] | (uint32_t) bytes[5] << 8 | (uint32_t) bytes[6] << 16 | (uint32_t) bytes[7] << 24;
+		crc = tables[7][low & 0xff] ^ tables[6][(low >> 8) & 0xff] ^ tables[5][(low >> 16) & 0xff] ^ tables[4][low >> 24] ^
+			tables[3][high & 0xff] ^ tables[2][(high >> 8) & 0xff] ^ tables[1][(high >> 16) & 0xff] ^ tables[0][high >> 24];
+	}
+	for (; length != 0; bytes++, length--) {
+		crc = tables[0][(crc ^ *bytes) & 0xff] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+#ifdef LEPK__FILE_CRC_HARDWARE
+/*
+ * The crc32 instruction on the raw CRC register. Each one waits for the last, but three independent ones
+ * can be in flight at once, so long inputs are run as three stripes side by side and joined after.
+ */
+__attribute__((target("sse4.2")))
+static uint32_t lepk__file_crc_sse42(uint32_t crc, const unsigned char *bytes, size_t length) {
+	for (; length >= 3 * LEPK__FILE_CRC_STRIPE; bytes += 3 * LEPK__FILE_CRC_STRIPE, length -= 3 * LEPK__FILE_CRC_STRIPE) {
+		uint64_t first = crc;
+		uint64_t second = 0;
+		uint64_t third = 0;
+		for (size_t i = 0; i < LEPK__FILE_CRC_STRIPE; i += 8) {
+			uint64_t words[3];
+			memcpy(&words[0], bytes + i, 8);
+			memcpy(&words[1], bytes + LEPK__FILE_CRC_STRIPE + i, 8);
+			memcpy(&words[2], bytes + 2 * LEPK__FILE_CRC_STRIPE + i, 8);
+			first = _mm_crc32_u64(first, words[0]);
+			second = _mm_crc32_u64(second, words[1]);
+			third = _mm_crc32_u64(third, words[2]);
+		}
+		crc = lepk__file_crc_multiply(lepk__file_crc_stripe_shift, (uint32_t) first) ^ (uint32_t) second;
+		crc = lepk__file_crc_multiply(lepk__file_crc_stripe_shift, crc) ^ (uint32_t) third;
+	}
+
+	uint64_t wide = crc;
+	for (; length >= 8; bytes += 8, length -= 8) {
+		uint64_t word;
+		memcpy(&word, bytes, 8);
+		wide = _mm_crc32_u64(wide, word);
+	}
+	crc = (uint32_t) wide;
+	for (; length != 0; bytes++, length--) {
+		crc = _mm_crc32_u8(crc, *bytes);
+	}
+	return crc;
+}
+#endif /* LEPK__FILE_CRC_HARDWARE */
+
+LEPKFILEIMPL uint32_t lepk_file_crc32c(uint32_t crc, const void *data, unsigned long length) {
+	lepk__file_crc_start();
+#ifdef LEPK__FILE_CRC_HARDWARE
+	if (lepk__file_crc_hardware) {
+		return ~lepk__file_crc_sse42(~crc, data, length);
+	}
+#endif /* LEPK__FILE_CRC_HARDWARE */
+	return ~lepk__file_crc_software(~crc, data, length);
+}
+
+LEPKFILEIMPL uint32_t lepk_file_crc32c_combine(uint32_t first, uint32_t second, uint64_t second_length) {
+	lepk__file_crc_start();
+	return lepk__file_crc_multiply(lepk__file_crc_shift(second_length), first) ^ second;
+}
+
+#ifdef LEPK_FILE_POSIX
+typedef struct {
+	const char *data;
+	uint64_t length;
+	/* Offset of the next block to be taken by a thread. */
+	uint64_t next;
+	/* CRC of every block on its own. */
+	uint32_t *crcs;
+} Lepk__FileChecksum;
+
+static void *lepk__file_checksum_thread(void *arg) {
+	Lepk__FileChecksum *checksum = arg;
+	for (;;) {
+		uint64_t offset = __atomic_fetch_add(&checksum->next, LEPK__FILE_PARALLEL_BLOCK, __ATOMIC_RELAXED);
+		if (offset >= checksum->length) {
+			return NULL;
+		}
+		uint64_t length = checksum->length - offset > LEPK__FILE_PARALLEL_BLOCK ? LEPK__FILE_PARALLEL_BLOCK : checksum->length - offset;
+		checksum->crcs[offset / LEPK__FILE_PARALLEL_BLOCK] = lepk_file_crc32c(0, checksum->data + offset, length);
+	}
+}
+#endif /* LEPK_FILE_POSIX */
+
+LEPKFILEIMPL LepkFileStatus lepk_file_checksum(const char *filepath, unsigned long threads, uint32_t *crc) {
+	LepkFileView view;
+	LepkFileStatus status = lepk_file_map(filepath, LEPK_FILE_ADVICE_SEQUENTIAL, &view);
+	if (status != LEPK_FILE_STATUS_OK) {
+		return status;
+	}
+
+#ifndef LEPK_FILE_POSIX
+	/* No threads to spread it over, one block after another. */
+	(void) threads;
+	*crc = 0;
+	for (uint64_t offset = 0; offset < view.length; offset += LEPK__FILE_PARALLEL_BLOCK) {
+		uint64_t length = view.length - offset > LEPK__FILE_PARALLEL_BLOCK ? LEPK__FILE_PARALLEL_BLOCK : view.length - offset;
+		*crc = lepk_file_crc32c(*crc, view.data + offset, length);
+	}
+	lepk_file_unmap(&view);
+	return LEPK_FILE_STATUS_OK;
+#else /* LEPK_FILE_POSIX */
+	uint64_t blocks = (view.length + LEPK__FILE_PARALLEL_BLOCK - 1) / LEPK__FILE_PARALLEL_BLOCK;
+	Lepk__FileChecksum checksum = { view.data, view.length, 0, malloc(blocks * sizeof(uint32_t) + 1) };
+	if (checksum.crcs == NULL) {
+		lepk_file_unmap(&view);
+		return LEPK_FILE_STATUS_OUT_OF_MEMORY;
+	}
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? cpus : 1;
+	}
+	if (blocks != 0) {
+		lepk__file_run_threads(lepk__file_checksum_thread, &checksum, threads < blocks ? threads : blocks);
+	}
+
+	/* Blocks are joined in file order, each shifting what came before it. */
+	*crc = 0;
+	for (uint64_t i = 0; i < blocks; i++) {
+		uint64_t length = i + 1 < blocks ? LEPK__FILE_PARALLEL_BLOCK : view.length - i * LEPK__FILE_PARALLEL_BLOCK;
+		*crc = lepk_file_crc32c_combine(*crc, checksum.crcs[i], length);
+	}
+	free(checksum.crcs);
+	lepk_file_unmap(&view);
+	return LEPK_FILE_STATUS_OK;
+#endif /* LEPK_FILE_POSIX */
+}
+
+/* Primes of xxHash64, which the content hash's rounds are modelled after. */
+#define LEPK__FILE_PRIME_1 0x9e3779b185ebca87ull
+#define LEPK__FILE_PRIME_2 0xc2b2ae3d27d4eb4full
+#define LEPK__FILE_PRIME_3 0x165667b19e3779f9ull
+#define LEPK__FILE_PRIME_4 0x85ebca77c2b2ae63ull
+#define LEPK__FILE_PRIME_5 0x27d4eb2f165667c5ull
+
+static inline uint64_t lepk__file_rotate(uint64_t value, int bits) {
+	return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t lepk__file_read64(const unsigned char *bytes) {
+	uint64_t word;
+	memcpy(&word, bytes, sizeof(uint64_t));
+	return word;
+}
+
+static inline uint64_t lepk__file_hash_round(uint64_t lane, uint64_t word) {
+	lane += word * LEPK__FILE_PRIME_2;
+	return lepk__file_rotate(lane, 31) * LEPK__FILE_PRIME_1;
+}
+
+static inline uint64_t lepk__file_hash_merge(uint64_t hash, uint64_t lane) {
+	hash ^= lepk__file_hash_round(0, lane);
+	return hash * LEPK__FILE_PRIME_1 + LEPK__FILE_PRIME_4;
+}
+
+static inline uint64_t lepk__file_hash_avalanche(uint64_t hash) {
+	hash ^= hash >> 33;
+	hash *= LEPK__FILE_PRIME_2;
+	hash ^= hash >> 29;
+	hash *= LEPK__FILE_PRIME_3;
+	return hash ^ (hash >> 32);
+}
+
+/* Four independent lanes, each taking one word of every stripe, so the multiplies overlap. */
+static void lepk__file_hash_stripes(uint64_t *lanes, const unsigned char *bytes, size_t count) {
+	uint64_t first = lanes[0];
+	uint64_t second = lanes[1];
+	uint64_t third = lanes[2];
+	uint64_t fourth = lanes[3];
+	for (size_t i = 0; i < count; i++, bytes += LEPK__FILE_HASH_STRIPE) {
+		first = lepk__file_hash_round(first, lepk__file_read64(bytes));
+		second = lepk__file_hash_round(second, lepk__file_read64(bytes + 8));
+		third = lepk__file_hash_round(third, lepk__file_read64(bytes + 16));
+		fourth = lepk__file_hash_round(fourth, lepk__file_read64(bytes + 24));
+	}
+	lanes[0] = first;
+	lanes[1] = second;
+	lanes[2] = third;
+	lanes[3] = fourth;
+}
+
+LEPKFILEIMPL void lepk_file_hasher_init(LepkFileHasher *hasher, uint64_t seed) {
+	hasher->lanes[0] = seed + LEPK__FILE_PRIME_1 + LEPK__FILE_PRIME_2;
+	hasher->lanes[1] = seed + LEPK__FILE_PRIME_2;
+	hasher->lanes[2] = seed;
+	hasher->lanes[3] = seed - LEPK__FILE_PRIME_1;
+	hasher->seed = seed;
+	hasher->length = 0;
+	hasher->buffered = 0;
+}
+
+LEPKFILEIMPL void lepk_file_hasher_update(LepkFileHasher *hasher, const void *data, unsigned long length) {
+	if (length == 0) {
+		return;
+	}
+	const unsigned char *bytes = data;
+	hasher->length += length;
+
+	/* Top up a stripe left over from the last update first. */
+	if (hasher->buffered != 0) {
+		size_t fill = LEPK__FILE_HASH_STRIPE - hasher->buffered;
+		if (length < fill) {
+			memcpy(hasher->stripe + hasher->buffered, bytes, length);
+			hasher->buffered += length;
+			return;
+		}
+		memcpy(hasher->stripe + hasher->buffered, bytes, fill);
+		lepk__file_hash_stripes(hasher->lanes, hasher->stripe, 1);
+		hasher->buffered = 0;
+		bytes += fill;
+		length -= fill;
+	}
+
+	size_t stripes = length / LEPK__FILE_HASH_STRIPE;
+	lepk__file_hash_stripes(hasher->lanes, bytes, stripes);
+	hasher->buffered = length - stripes * LEPK__FILE_HASH_STRIPE;
+	memcpy(hasher->stripe, bytes + stripes * LEPK__FILE_HASH_STRIPE, hasher->buffered);
+}
+
+LEPKFILEIMPL LepkFileHash lepk_file_hasher_final(const LepkFileHasher *hasher) {
+	const uint64_t *lanes = hasher->lanes;
+	uint64_t low;
+	uint64_t high;
+	/* The halves merge the lanes in opposite orders. */
+	if (hasher->length >= LEPK__FILE_HASH_STRIPE) {
+		low = lepk__file_rotate(lanes[0], 1) + lepk__file_rotate(lanes[1], 7) + lepk__file_rotate(lanes[2], 12) + lepk__file_rotate(lanes[3], 18);
+		high = lepk__file_rotate(lanes[3], 1) + lepk__file_rotate(lanes[2], 7) + lepk__file_rotate(lanes[1], 12) + lepk__file_rotate(lanes[0], 18);
+		for (int i = 0; i < 4; i++) {
+			low = lepk__file_hash_merge(low, lanes[i]);
+			high = lepk__file_hash_merge(high, lanes[3 - i]);
+		}
+	} else {
+		low = hasher->seed + LEPK__FILE_PRIME_5;
+		high = hasher->seed + LEPK__FILE_PRIME_3;
+	}
+	low += hasher->length;
+	high += hasher->length;
+
+	/* Whatever didn't fill a stripe, 8, 4 and then 1 byte at a time into both halves with different mixing. */
+	const unsigned char *bytes = hasher->stripe;
+	size_t remaining = hasher->buffered;
+	for (; remaining >= 8; bytes += 8, remaining -= 8) {
+		uint64_t word = lepk__file_hash_round(0, lepk__file_read64(bytes));
+		low = lepk__file_rotate(low ^ word, 27) * LEPK__FILE_PRIME_1 + LEPK__FILE_PRIME_4;
+		high = lepk__file_rotate(high ^ word, 31) * LEPK__FILE_PRIME_2 + LEPK__FILE_PRIME_3;
+	}
+	if (remaining >= 4) {
+		uint32_t word;
+		memcpy(&word, bytes, sizeof(uint32_t));
+		low = lepk__file_rotate(low ^ (word * LEPK__FILE_PRIME_1), 23) * LEPK__FILE_PRIME_2 + LEPK__FILE_PRIME_3;
+		high = lepk__file_rotate(high ^ (word * LEPK__FILE_PRIME_3), 19) * LEPK__FILE_PRIME_1 + LEPK__FILE_PRIME_4;
+		bytes += 4;
+		remaining -= 4;
+	}
+	for (; remaining != 0; bytes++, remaining--) {
+		low = lepk__file_rotate(low ^ (*bytes * LEPK__FILE_PRIME_5), 11) * LEPK__FILE_PRIME_1;
+		high = lepk__file_rotate(high ^ (*bytes * LEPK__FILE_PRIME_1), 13) * LEPK__FILE_PRIME_5;
+	}
+
+	LepkFileHash hash = { lepk__file_hash_avalanche(low), lepk__file_hash_avalanche(high) };
+	return hash;
+}
+
+LEPKFILEIMPL LepkFileHash lepk_file_hash(const void *data, unsigned long length, uint64_t seed) {
+	LepkFileHasher hasher;
+	lepk_file_hasher_init(&hasher, seed);
+	lepk_file_hasher_update(&hasher, data, length);
+	return lepk_file_hasher_final(&hasher);
+}
+
+LEPKFILEIMPL LepkFileStatus lepk_file_digest(const char *filepath, uint64_t seed, LepkFileHash *hash) {
+	LepkFileView view;
+	LepkFileStatus status = lepk_file_map(filepath, LEPK_FILE_ADVICE_SEQUENTIAL, &view);
+	if (status != LEPK_FILE_STATUS_OK) {
+		return status;
+	}
+	*hash = lepk_file_hash(view.data, view.length, seed);
+	lepk_file_unmap(&view);
+	return LEPK_FILE_STATUS_OK;
+}
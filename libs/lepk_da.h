@@ -1,4 +1,4 @@
-/* Version: 1.1 */
+/* Version: 1.2 */
 
 /*
  * MIT License
@@ -184,7 +184,7 @@ typedef unsigned char Lepk__U8;
 LEPKDAIMPL void *lepk_da_create(unsigned long size) {
 	assert(size != 0 && "Size can't be 0.");
 
-	Lepk__DaHeader *head = head = malloc(size + sizeof(Lepk__DaHeader) * LEPK_DA_START_CAP);
+	Lepk__DaHeader *head = malloc(sizeof(Lepk__DaHeader) + size * LEPK_DA_START_CAP);
 	head->count = 0;
 	head->cap = LEPK_DA_START_CAP;
 	head->size = size;
@@ -363,9 +363,24 @@ LEPKDAIMPL void lepk__da_push_array(void **da, const void *array, unsigned int a
 	}
 
 	Lepk__DaHeader *head = LEPK__HEAD_FROM_DA(*da);
-	for (Lepk__U8 i = 0; i < array_length; i++) {
-		lepk__da_insert_fast(da, (Lepk__U8 *) array + i * head->size, head->count);
+
+	/* Resize once for the whole array. */
+	if (head->count + array_length > head->cap) {
+		while (head->count + array_length > head->cap) {
+			head->cap *= 2;
+		}
+		Lepk__DaHeader *realloced_head = realloc(head, head->cap * head->size + sizeof(Lepk__DaHeader));
+		if (realloced_head == NULL) {
+			free(head);
+			*da = NULL;
+			return;
+		}
+		head = realloced_head;
+		*da = LEPK__DA_FROM_HEAD(head);
 	}
+
+	memcpy((Lepk__U8 *) *da + head->count * head->size, array, array_length * head->size);
+	head->count += array_length;
 }
 #endif /*LEPK_DA_IMPLEMENTATION*/
 #endif /* LEPK_DA_H */
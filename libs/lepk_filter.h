@@ -0,0 +1,607 @@
+/* Version: 1.0 */
+
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2022 Linus Erik Pontus Kåreblom
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Probabilistic membership filters: a blocked Bloom filter and a cuckoo filter.
+ *
+ * Add:
+ *     #define LEPK_FILTER_IMPLEMENTATION
+ * in one C or C++ file, before #include "lepk_filter.h", to create the implementation.
+ *
+ * If LEPK_FILTER_STATIC is defined the implementation will be local to a single file only.
+ *
+ * Uses the hashing callbacks from lepk_ht.h.
+ */
+
+/*
+ * === Documentation ===
+ * Filters answer "definitely not in the set" or "probably in the set", in a few bits per key.
+ * Put one in front of a lepk_ht whose lookups mostly miss, and most misses never touch the table.
+ * Both are sized from the amount of keys they should hold and a target false positive rate.
+ *
+ * The Bloom filter sets 8 bits in a single 32 byte block per key, so a lookup is one cache miss.
+ * Keys can't be removed from it.
+ * The cuckoo filter stores a fingerprint per key in one of two buckets and supports removing,
+ * but adding fails once it's close to full.
+ *
+ * Usage:
+ * LepkBloom *bloom = lepk_bloom_create(lepk_ht_hash_generic, sizeof(int), 10000, 0.01);
+ * lepk_bloom_add(bloom, &key);
+ * if (lepk_bloom_contains(bloom, &key)) {
+ *     found = lepk_ht_find(table, &key);
+ * }
+ *
+ * Storing and loading, using lepk_file.h:
+ * unsigned long length;
+ * void *image = lepk_bloom_serialize(bloom, &length);
+ * lepk_file_write("keys.bloom", image, length, LEPK_FILE_MODE_BINARY);
+ * char *content = lepk_file_read("keys.bloom", NULL);
+ * LepkBloom *loaded = lepk_bloom_load(lepk_ht_hash_generic, content, 0);
+ *
+ * The hashing function isn't stored, load with the one the filter was created with.
+ * Images use the byte order of the machine that built them.
+ */
+
+#ifndef LEPK_FILTER_H
+#define LEPK_FILTER_H
+
+#ifndef LEPK_FILTER_STATIC
+#define LEPKFILTER extern
+#else /* LEPK_FILTER_STATIC */
+#define LEPKFILTER static
+#endif /* LEPK_FILTER_STATIC */
+
+#include <stdbool.h>
+
+#include "lepk_ht.h"
+
+/* Blocked Bloom filter. */
+typedef struct LepkBloom LepkBloom;
+/* Cuckoo filter. */
+typedef struct LepkCuckoo LepkCuckoo;
+
+/* Create a Bloom filter for capacity keys of key_size bytes, with false positive rate fpr between 0 and 1. */
+LEPKFILTER LepkBloom *lepk_bloom_create(LepkHtHash hash, unsigned long key_size, unsigned long capacity, double fpr);
+/* Destroy a Bloom filter. */
+LEPKFILTER void lepk_bloom_destroy(LepkBloom *bloom);
+/* Add key to the filter. */
+LEPKFILTER void lepk_bloom_add(LepkBloom *bloom, const void *key);
+/* False if key was never added, true if it probably was. */
+LEPKFILTER bool lepk_bloom_contains(const LepkBloom *bloom, const void *key);
+/* Forget every key. */
+LEPKFILTER void lepk_bloom_clear(LepkBloom *bloom);
+/* Memory held by the filter in bytes. */
+LEPKFILTER unsigned long lepk_bloom_bytes(const LepkBloom *bloom);
+/* Serialize to a malloc'd image of length bytes. */
+LEPKFILTER void *lepk_bloom_serialize(const LepkBloom *bloom, unsigned long *length);
+/* Load a serialized image, the buffer is copied. Length 0 trusts the size stored in the image. NULL if the image is invalid. */
+LEPKFILTER LepkBloom *lepk_bloom_load(LepkHtHash hash, const void *buffer, unsigned long length);
+
+/* Create a cuckoo filter for capacity keys of key_size bytes, with false positive rate fpr between 0 and 1. */
+LEPKFILTER LepkCuckoo *lepk_cuckoo_create(LepkHtHash hash, unsigned long key_size, unsigned long capacity, double fpr);
+/* Destroy a cuckoo filter. */
+LEPKFILTER void lepk_cuckoo_destroy(LepkCuckoo *cuckoo);
+/* Retrieve key count from the filter. */
+LEPKFILTER unsigned long lepk_cuckoo_count(const LepkCuckoo *cuckoo);
+/* Add key to the filter. Returns false if the filter is full, the key is still found but nothing more can be added. */
+LEPKFILTER bool lepk_cuckoo_add(LepkCuckoo *cuckoo, const void *key);
+/* False if key isn't in the filter, true if it probably is. */
+LEPKFILTER bool lepk_cuckoo_contains(const LepkCuckoo *cuckoo, const void *key);
+/* Remove key from the filter. Only remove keys that were added, or another key may be removed in its place. */
+LEPKFILTER bool lepk_cuckoo_remove(LepkCuckoo *cuckoo, const void *key);
+/* Memory held by the filter in bytes. */
+LEPKFILTER unsigned long lepk_cuckoo_bytes(const LepkCuckoo *cuckoo);
+/* Serialize to a malloc'd image of length bytes. */
+LEPKFILTER void *lepk_cuckoo_serialize(const LepkCuckoo *cuckoo, unsigned long *length);
+/* Load a serialized image, the buffer is copied. Length 0 trusts the size stored in the image. NULL if the image is invalid. */
+LEPKFILTER LepkCuckoo *lepk_cuckoo_load(LepkHtHash hash, const void *buffer, unsigned long length);
+
+#ifdef LEPK_FILTER_TEST
+
+#include <assert.h>
+#include <malloc.h>
+
+static void lepk_filter_test(void) {
+	LepkBloom *bloom = lepk_bloom_create(lepk_ht_hash_generic, sizeof(int), 10000, 0.01);
+	LepkCuckoo *cuckoo = lepk_cuckoo_create(lepk_ht_hash_generic, sizeof(int), 10000, 0.01);
+	for (int i = 0; i < 10000; i++) {
+		lepk_bloom_add(bloom, &i);
+		assert(lepk_cuckoo_add(cuckoo, &i) && "lepk_cuckoo_add failed.");
+	}
+	assert(lepk_cuckoo_count(cuckoo) == 10000 && "lepk_cuckoo_count failed.");
+
+	int bloom_positives = 0;
+	int cuckoo_positives = 0;
+	for (int i = 0; i < 20000; i++) {
+		bool bloom_found = lepk_bloom_contains(bloom, &i);
+		bool cuckoo_found = lepk_cuckoo_contains(cuckoo, &i);
+		if (i < 10000) {
+			assert(bloom_found && cuckoo_found && "lepk filter lost a key.");
+		} else {
+			bloom_positives += bloom_found;
+			cuckoo_positives += cuckoo_found;
+		}
+	}
+	assert(bloom_positives < 300 && "lepk_bloom false positive rate too high.");
+	assert(cuckoo_positives < 300 && "lepk_cuckoo false positive rate too high.");
+
+	for (int i = 0; i < 10000; i += 2) {
+		assert(lepk_cuckoo_remove(cuckoo, &i) && "lepk_cuckoo_remove failed.");
+	}
+	assert(lepk_cuckoo_count(cuckoo) == 5000 && lepk_cuckoo_contains(cuckoo, &(int) { 1 }) && "lepk_cuckoo_remove failed.");
+
+	unsigned long length;
+	void *image = lepk_bloom_serialize(bloom, &length);
+	LepkBloom *loaded_bloom = lepk_bloom_load(lepk_ht_hash_generic, image, length);
+	assert(loaded_bloom != NULL && lepk_bloom_contains(loaded_bloom, &(int) { 1234 }) && "lepk_bloom_load failed.");
+	assert(lepk_bloom_load(lepk_ht_hash_generic, image, length - 1) == NULL && "lepk_bloom_load accepted a short image.");
+	free(image);
+
+	image = lepk_cuckoo_serialize(cuckoo, &length);
+	LepkCuckoo *loaded_cuckoo = lepk_cuckoo_load(lepk_ht_hash_generic, image, 0);
+	assert(loaded_cuckoo != NULL && lepk_cuckoo_count(loaded_cuckoo) == 5000 && lepk_cuckoo_contains(loaded_cuckoo, &(int) { 1235 }) && "lepk_cuckoo_load failed.");
+	assert(lepk_bloom_load(lepk_ht_hash_generic, image, 0) == NULL && "lepk_bloom_load accepted a cuckoo filter.");
+	/* Size, buckets and fingerprint size of the image header, consistent with each other but not usable. */
+	memcpy((char *) image + 8, &(uint64_t) { 64 + 1 * 4 * 3 }, sizeof(uint64_t));
+	memcpy((char *) image + 24, &(uint64_t) { 1 }, sizeof(uint64_t));
+	memcpy((char *) image + 40, &(uint64_t) { 3 }, sizeof(uint64_t));
+	assert(lepk_cuckoo_load(lepk_ht_hash_generic, image, 0) == NULL && "lepk_cuckoo_load accepted a bad fingerprint size.");
+	memcpy((char *) image + 8, &(uint64_t) { 64 + 3 * 4 * 4 }, sizeof(uint64_t));
+	memcpy((char *) image + 24, &(uint64_t) { 3 }, sizeof(uint64_t));
+	memcpy((char *) image + 40, &(uint64_t) { 4 }, sizeof(uint64_t));
+	assert(lepk_cuckoo_load(lepk_ht_hash_generic, image, 0) == NULL && "lepk_cuckoo_load accepted buckets that aren't a power of two.");
+	free(image);
+
+	lepk_bloom_clear(bloom);
+	assert(!lepk_bloom_contains(bloom, &(int) { 1234 }) && "lepk_bloom_clear failed.");
+
+	lepk_cuckoo_destroy(loaded_cuckoo);
+	lepk_bloom_destroy(loaded_bloom);
+	lepk_cuckoo_destroy(cuckoo);
+	lepk_bloom_destroy(bloom);
+}
+
+#endif /* LEPK_FILTER_TEST */
+
+#ifdef LEPK_FILTER_IMPLEMENTATION
+#include <malloc.h>
+#include <math.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
+#undef LEPKFILTER
+#ifndef LEPK_FILTER_STATIC
+#define LEPKFILTER
+#else /* LEPK_FILTER_STATIC */
+#define LEPKFILTER static
+#endif /* LEPK_FILTER_STATIC */
+
+/* "LBLM" */
+#define LEPK__BLOOM_MAGIC 0x4d4c424cu
+/* "LCKF" */
+#define LEPK__CUCKOO_MAGIC 0x464b434cu
+/* Bumped when keys hash to other places, images of older versions would miss keys they hold. */
+#define LEPK__FILTER_VERSION 2
+/* Images are aligned to cache lines, and so are the bits following the header. */
+#define LEPK__FILTER_CACHE_LINE 64
+
+/* Bits set per key, one in every 32 bit word of a block. */
+#define LEPK__BLOOM_WORDS 8
+/* Fingerprints per cuckoo bucket. */
+#define LEPK__CUCKOO_BUCKET 4
+/* Cuckoo buckets are sized for this load, pushing much further makes adding fail early. */
+#define LEPK__CUCKOO_MAX_LOAD 0.9
+/* Fingerprints moved around before adding gives up. */
+#define LEPK__CUCKOO_MAX_KICKS 500
+
+/* Start of a serialized image, padded to a cache line and followed by the blocks or buckets. */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t size;
+	uint64_t key_size;
+	/* Blocks for Bloom filters, buckets for cuckoo filters. */
+	uint64_t buckets;
+	/* Cuckoo only. */
+	uint64_t count;
+	uint64_t fingerprint_size;
+	/* Fingerprint that didn't fit when the cuckoo filter filled up, 0 if none, and the bucket it belongs to. */
+	uint64_t victim;
+	uint64_t victim_bucket;
+} Lepk__FilterHeader;
+
+/* The image is the filter, serializing is a copy. */
+struct LepkBloom {
+	LepkHtHash hash;
+	Lepk__FilterHeader *header;
+	uint32_t *blocks;
+};
+
+struct LepkCuckoo {
+	LepkHtHash hash;
+	Lepk__FilterHeader *header;
+	unsigned char *slots;
+	/* State for picking which fingerprint to kick out. */
+	uint64_t random;
+};
+
+/* Odd constants turning one 32 bit hash into a bit position per word. */
+static const uint32_t lepk__bloom_salts[LEPK__BLOOM_WORDS] = {
+	0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+	0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u,
+};
+
+/*
+ * Fibonacci hashing spreads the hash's bits upwards, but the low bits of a product only depend on the low bits multiplied.
+ * Folding the high half in first makes the low half, which picks the bloom bits, depend on all of it too.
+ */
+static uint64_t lepk__filter_hash(LepkHtHash hash, const void *key, size_t key_size) {
+	uint64_t value = hash(key, key_size);
+	return (value ^ value >> 32) * 0x9e3779b97f4a7c15ull;
+}
+
+static Lepk__FilterHeader *lepk__filter_image(uint32_t magic, size_t key_size, size_t buckets, size_t fingerprint_size, size_t bytes) {
+	size_t size = LEPK__FILTER_CACHE_LINE + bytes;
+	Lepk__FilterHeader *header = memalign(LEPK__FILTER_CACHE_LINE, size);
+	memset(header, 0, size);
+
+	header->magic = magic;
+	header->version = LEPK__FILTER_VERSION;
+	header->size = size;
+	header->key_size = key_size;
+	header->buckets = buckets;
+	header->fingerprint_size = fingerprint_size;
+	return header;
+}
+
+/* Copy of a valid image with the given magic, NULL if it's invalid. */
+static Lepk__FilterHeader *lepk__filter_load(uint32_t magic, const void *buffer, size_t length) {
+	Lepk__FilterHeader header;
+	if (length != 0 && length < sizeof(Lepk__FilterHeader)) {
+		return NULL;
+	}
+	memcpy(&header, buffer, sizeof(Lepk__FilterHeader));
+
+	if (header.magic != magic || header.version != LEPK__FILTER_VERSION || header.buckets == 0) {
+		return NULL;
+	}
+	/* Lookups index with these without checking, cuckoo buckets are picked by masking. */
+	if (magic == LEPK__CUCKOO_MAGIC && (
+			(header.fingerprint_size != 1 && header.fingerprint_size != 2 && header.fingerprint_size != 4) ||
+			(header.buckets & (header.buckets - 1)) != 0 || header.victim_bucket >= header.buckets)) {
+		return NULL;
+	}
+
+	uint64_t bucket_size = magic == LEPK__BLOOM_MAGIC ?
+		LEPK__BLOOM_WORDS * sizeof(uint32_t) :
+		LEPK__CUCKOO_BUCKET * header.fingerprint_size;
+	if (header.buckets > (UINT64_MAX - LEPK__FILTER_CACHE_LINE) / bucket_size ||
+			header.size != LEPK__FILTER_CACHE_LINE + header.buckets * bucket_size ||
+			(length != 0 && length < header.size)) {
+		return NULL;
+	}
+
+	Lepk__FilterHeader *image = memalign(LEPK__FILTER_CACHE_LINE, header.size);
+	memcpy(image, buffer, header.size);
+	return image;
+}
+
+static void *lepk__filter_serialize(const Lepk__FilterHeader *header, unsigned long *length) {
+	void *image = malloc(header->size);
+	memcpy(image, header, header->size);
+	*length = header->size;
+	return image;
+}
+
+/*
+ * === Blocked Bloom filter ===
+ * The top half of the hash picks a 32 byte block, the bottom half multiplied by each salt
+ * picks one bit in each of the block's 8 words.
+ */
+
+static LepkBloom *lepk__bloom_wrap(LepkHtHash hash, Lepk__FilterHeader *header) {
+	LepkBloom *bloom = malloc(sizeof(LepkBloom));
+	bloom->hash = hash;
+	bloom->header = header;
+	bloom->blocks = (uint32_t *) ((unsigned char *) header + LEPK__FILTER_CACHE_LINE);
+	return bloom;
+}
+
+static uint32_t *lepk__bloom_block(const LepkBloom *bloom, uint64_t hash) {
+	/* Multiply and shift maps into [0, buckets) without needing a power of two. */
+	uint64_t block = ((hash >> 32) * bloom->header->buckets) >> 32;
+	return bloom->blocks + block * LEPK__BLOOM_WORDS;
+}
+
+static void lepk__bloom_mask(uint64_t hash, uint32_t *mask) {
+	for (int i = 0; i < LEPK__BLOOM_WORDS; i++) {
+		mask[i] = 1u << (((uint32_t) hash * lepk__bloom_salts[i]) >> 27);
+	}
+}
+
+LEPKFILTER LepkBloom *lepk_bloom_create(LepkHtHash hash, unsigned long key_size, unsigned long capacity, double fpr) {
+	assert(fpr > 0.0 && fpr < 1.0 && "False positive rate must be between 0 and 1.");
+
+	/*
+	 * Classic Bloom filter sizing for 8 hash functions, plus a twentieth for the uneven fill of blocks.
+	 * Keeps the measured rate below fpr from 0.01% to 10%.
+	 */
+	double bits_per_key = -LEPK__BLOOM_WORDS / log(1.0 - pow(fpr, 1.0 / LEPK__BLOOM_WORDS)) * 1.05;
+	size_t bits = (size_t) ceil(bits_per_key * (capacity > 0 ? capacity : 1));
+	size_t block_bits = LEPK__BLOOM_WORDS * 32;
+	size_t blocks = (bits + block_bits - 1) / block_bits;
+	assert(blocks <= UINT32_MAX && "lepk_bloom can't be that big.");
+
+	return lepk__bloom_wrap(hash, lepk__filter_image(LEPK__BLOOM_MAGIC, key_size, blocks, 0, blocks * block_bits / 8));
+}
+
+LEPKFILTER void lepk_bloom_destroy(LepkBloom *bloom) {
+	free(bloom->header);
+	free(bloom);
+}
+
+LEPKFILTER void lepk_bloom_add(LepkBloom *bloom, const void *key) {
+	uint64_t hash = lepk__filter_hash(bloom->hash, key, bloom->header->key_size);
+	uint32_t *block = lepk__bloom_block(bloom, hash);
+	uint32_t mask[LEPK__BLOOM_WORDS];
+	lepk__bloom_mask(hash, mask);
+
+	for (int i = 0; i < LEPK__BLOOM_WORDS; i++) {
+		block[i] |= mask[i];
+	}
+}
+
+LEPKFILTER bool lepk_bloom_contains(const LepkBloom *bloom, const void *key) {
+	uint64_t hash = lepk__filter_hash(bloom->hash, key, bloom->header->key_size);
+	const uint32_t *block = lepk__bloom_block(bloom, hash);
+	uint32_t mask[LEPK__BLOOM_WORDS];
+	lepk__bloom_mask(hash, mask);
+
+#ifdef __SSE2__
+	/* Blocks are 32 byte aligned, test both halves at once. */
+	__m128i low = _mm_load_si128((const __m128i *) block);
+	__m128i high = _mm_load_si128((const __m128i *) (block + 4));
+	__m128i low_mask = _mm_loadu_si128((const __m128i *) mask);
+	__m128i high_mask = _mm_loadu_si128((const __m128i *) (mask + 4));
+	__m128i missing = _mm_or_si128(_mm_andnot_si128(low, low_mask), _mm_andnot_si128(high, high_mask));
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(missing, _mm_setzero_si128())) == 0xffff;
+#else /* __SSE2__ */
+	uint32_t missing = 0;
+	for (int i = 0; i < LEPK__BLOOM_WORDS; i++) {
+		missing |= mask[i] & ~block[i];
+	}
+	return missing == 0;
+#endif /* __SSE2__ */
+}
+
+LEPKFILTER void lepk_bloom_clear(LepkBloom *bloom) {
+	memset(bloom->blocks, 0, bloom->header->size - LEPK__FILTER_CACHE_LINE);
+}
+
+LEPKFILTER unsigned long lepk_bloom_bytes(const LepkBloom *bloom) {
+	return sizeof(LepkBloom) + bloom->header->size;
+}
+
+LEPKFILTER void *lepk_bloom_serialize(const LepkBloom *bloom, unsigned long *length) {
+	return lepk__filter_serialize(bloom->header, length);
+}
+
+LEPKFILTER LepkBloom *lepk_bloom_load(LepkHtHash hash, const void *buffer, unsigned long length) {
+	Lepk__FilterHeader *header = lepk__filter_load(LEPK__BLOOM_MAGIC, buffer, length);
+	return header != NULL ? lepk__bloom_wrap(hash, header) : NULL;
+}
+
+/*
+ * === Cuckoo filter ===
+ * Partial key cuckoo hashing: a key's second bucket is its first one xor a hash of its fingerprint,
+ * so a fingerprint can be moved to its other bucket without knowing the key.
+ * Fingerprints are 1, 2 or 4 bytes, 0 marks an empty slot.
+ */
+
+static LepkCuckoo *lepk__cuckoo_wrap(LepkHtHash hash, Lepk__FilterHeader *header) {
+	LepkCuckoo *cuckoo = malloc(sizeof(LepkCuckoo));
+	cuckoo->hash = hash;
+	cuckoo->header = header;
+	cuckoo->slots = (unsigned char *) header + LEPK__FILTER_CACHE_LINE;
+	cuckoo->random = 0x2545f4914f6cdd1dull;
+	return cuckoo;
+}
+
+static uint32_t lepk__cuckoo_get(const LepkCuckoo *cuckoo, size_t slot) {
+	switch (cuckoo->header->fingerprint_size) {
+		case 1: return ((const uint8_t *) cuckoo->slots)[slot];
+		case 2: return ((const uint16_t *) cuckoo->slots)[slot];
+		default: return ((const uint32_t *) cuckoo->slots)[slot];
+	}
+}
+
+static void lepk__cuckoo_set(LepkCuckoo *cuckoo, size_t slot, uint32_t fingerprint) {
+	switch (cuckoo->header->fingerprint_size) {
+		case 1: ((uint8_t *) cuckoo->slots)[slot] = (uint8_t) fingerprint; break;
+		case 2: ((uint16_t *) cuckoo->slots)[slot] = (uint16_t) fingerprint; break;
+		default: ((uint32_t *) cuckoo->slots)[slot] = fingerprint; break;
+	}
+}
+
+static uint32_t lepk__cuckoo_fingerprint(const LepkCuckoo *cuckoo, uint64_t hash) {
+	uint32_t fingerprint = (uint32_t) (hash >> (64 - cuckoo->header->fingerprint_size * 8));
+	return fingerprint != 0 ? fingerprint : 1;
+}
+
+static size_t lepk__cuckoo_other(const LepkCuckoo *cuckoo, size_t bucket, uint32_t fingerprint) {
+	return (bucket ^ (fingerprint * 0x5bd1e995u)) & (cuckoo->header->buckets - 1);
+}
+
+static bool lepk__cuckoo_bucket_contains(const LepkCuckoo *cuckoo, size_t bucket, uint32_t fingerprint) {
+	for (size_t i = 0; i < LEPK__CUCKOO_BUCKET; i++) {
+		if (lepk__cuckoo_get(cuckoo, bucket * LEPK__CUCKOO_BUCKET + i) == fingerprint) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool lepk__cuckoo_bucket_insert(LepkCuckoo *cuckoo, size_t bucket, uint32_t fingerprint) {
+	for (size_t i = 0; i < LEPK__CUCKOO_BUCKET; i++) {
+		if (lepk__cuckoo_get(cuckoo, bucket * LEPK__CUCKOO_BUCKET + i) == 0) {
+			lepk__cuckoo_set(cuckoo, bucket * LEPK__CUCKOO_BUCKET + i, fingerprint);
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool lepk__cuckoo_bucket_remove(LepkCuckoo *cuckoo, size_t bucket, uint32_t fingerprint) {
+	for (size_t i = 0; i < LEPK__CUCKOO_BUCKET; i++) {
+		if (lepk__cuckoo_get(cuckoo, bucket * LEPK__CUCKOO_BUCKET + i) == fingerprint) {
+			lepk__cuckoo_set(cuckoo, bucket * LEPK__CUCKOO_BUCKET + i, 0);
+			return true;
+		}
+	}
+	return false;
+}
+
+LEPKFILTER LepkCuckoo *lepk_cuckoo_create(LepkHtHash hash, unsigned long key_size, unsigned long capacity, double fpr) {
+	assert(fpr > 0.0 && fpr < 1.0 && "False positive rate must be between 0 and 1.");
+
+	/* A lookup compares against two full buckets, so the rate is about 2 * 4 / 2^bits. */
+	double bits = log2(2.0 * LEPK__CUCKOO_BUCKET / fpr);
+	size_t fingerprint_size = bits <= 8.0 ? 1 : bits <= 16.0 ? 2 : 4;
+
+	size_t buckets = 1;
+	while (buckets * LEPK__CUCKOO_BUCKET * LEPK__CUCKOO_MAX_LOAD < capacity) {
+		buckets *= 2;
+	}
+
+	return lepk__cuckoo_wrap(hash, lepk__filter_image(LEPK__CUCKOO_MAGIC, key_size, buckets, fingerprint_size, buckets * LEPK__CUCKOO_BUCKET * fingerprint_size));
+}
+
+LEPKFILTER void lepk_cuckoo_destroy(LepkCuckoo *cuckoo) {
+	free(cuckoo->header);
+	free(cuckoo);
+}
+
+LEPKFILTER unsigned long lepk_cuckoo_count(const LepkCuckoo *cuckoo) {
+	return cuckoo->header->count;
+}
+
+LEPKFILTER bool lepk_cuckoo_add(LepkCuckoo *cuckoo, const void *key) {
+	Lepk__FilterHeader *header = cuckoo->header;
+	if (header->victim != 0) {
+		return false;
+	}
+
+	uint64_t hash = lepk__filter_hash(cuckoo->hash, key, header->key_size);
+	uint32_t fingerprint = lepk__cuckoo_fingerprint(cuckoo, hash);
+	size_t bucket = hash & (header->buckets - 1);
+	size_t other = lepk__cuckoo_other(cuckoo, bucket, fingerprint);
+
+	header->count++;
+	if (lepk__cuckoo_bucket_insert(cuckoo, bucket, fingerprint) || lepk__cuckoo_bucket_insert(cuckoo, other, fingerprint)) {
+		return true;
+	}
+
+	/* Both buckets full, kick a random fingerprint to its other bucket until one fits. */
+	bucket = cuckoo->random & 1 ? bucket : other;
+	for (int kick = 0; kick < LEPK__CUCKOO_MAX_KICKS; kick++) {
+		cuckoo->random ^= cuckoo->random << 13;
+		cuckoo->random ^= cuckoo->random >> 7;
+		cuckoo->random ^= cuckoo->random << 17;
+
+		size_t slot = bucket * LEPK__CUCKOO_BUCKET + cuckoo->random % LEPK__CUCKOO_BUCKET;
+		uint32_t kicked = lepk__cuckoo_get(cuckoo, slot);
+		lepk__cuckoo_set(cuckoo, slot, fingerprint);
+		fingerprint = kicked;
+
+		bucket = lepk__cuckoo_other(cuckoo, bucket, fingerprint);
+		if (lepk__cuckoo_bucket_insert(cuckoo, bucket, fingerprint)) {
+			return true;
+		}
+	}
+
+	/* Keep the homeless fingerprint so no added key stops being found. */
+	header->victim = fingerprint;
+	header->victim_bucket = bucket;
+	return false;
+}
+
+LEPKFILTER bool lepk_cuckoo_contains(const LepkCuckoo *cuckoo, const void *key) {
+	const Lepk__FilterHeader *header = cuckoo->header;
+	uint64_t hash = lepk__filter_hash(cuckoo->hash, key, header->key_size);
+	uint32_t fingerprint = lepk__cuckoo_fingerprint(cuckoo, hash);
+	size_t bucket = hash & (header->buckets - 1);
+	size_t other = lepk__cuckoo_other(cuckoo, bucket, fingerprint);
+
+	if (header->victim == fingerprint && (header->victim_bucket == bucket || header->victim_bucket == other)) {
+		return true;
+	}
+	return lepk__cuckoo_bucket_contains(cuckoo, bucket, fingerprint) || lepk__cuckoo_bucket_contains(cuckoo, other, fingerprint);
+}
+
+LEPKFILTER bool lepk_cuckoo_remove(LepkCuckoo *cuckoo, const void *key) {
+	Lepk__FilterHeader *header = cuckoo->header;
+	uint64_t hash = lepk__filter_hash(cuckoo->hash, key, header->key_size);
+	uint32_t fingerprint = lepk__cuckoo_fingerprint(cuckoo, hash);
+	size_t bucket = hash & (header->buckets - 1);
+	size_t other = lepk__cuckoo_other(cuckoo, bucket, fingerprint);
+
+	if (header->victim == fingerprint && (header->victim_bucket == bucket || header->victim_bucket == other)) {
+		header->victim = 0;
+	} else if (!lepk__cuckoo_bucket_remove(cuckoo, bucket, fingerprint) && !lepk__cuckoo_bucket_remove(cuckoo, other, fingerprint)) {
+		return false;
+	}
+	header->count--;
+
+	/* Room was made, try to give the victim a home again. */
+	if (header->victim != 0) {
+		uint32_t victim = (uint32_t) header->victim;
+		if (lepk__cuckoo_bucket_insert(cuckoo, header->victim_bucket, victim) ||
+				lepk__cuckoo_bucket_insert(cuckoo, lepk__cuckoo_other(cuckoo, header->victim_bucket, victim), victim)) {
+			header->victim = 0;
+		}
+	}
+	return true;
+}
+
+LEPKFILTER unsigned long lepk_cuckoo_bytes(const LepkCuckoo *cuckoo) {
+	return sizeof(LepkCuckoo) + cuckoo->header->size;
+}
+
+LEPKFILTER void *lepk_cuckoo_serialize(const LepkCuckoo *cuckoo, unsigned long *length) {
+	return lepk__filter_serialize(cuckoo->header, length);
+}
+
+LEPKFILTER LepkCuckoo *lepk_cuckoo_load(LepkHtHash hash, const void *buffer, unsigned long length) {
+	Lepk__FilterHeader *header = lepk__filter_load(LEPK__CUCKOO_MAGIC, buffer, length);
+	return header != NULL ? lepk__cuckoo_wrap(hash, header) : NULL;
+}
+#endif /*LEPK_FILTER_IMPLEMENTATION*/
+#endif /* LEPK_FILTER_H */
@@ -1,4 +1,4 @@
-/* Version: 1.0 */
+/* Version: 1.8 */
 
 /*
  * MIT License
@@ -32,11 +32,51 @@
  * in one C or C++ file, before #include "lepk_ht.h", to create the implementation.
  *
  * If LEPK_HT_STATIS is defined the implementation will be local to a single file only.
+ *
+ * Use:
+ *     #define LEPK_HT_BATCH [int]
+ * to define how many keys the batch functions prefetch together.
+ *     #define LEPK_HT_MAX_LOAD [float]
+ * to define the default max load factor of new tables.
+ *     #define LEPK_HT_SMALL [int]
+ * to define up to how many pairs a table is searched linearly instead of hashed, 0 always hashes.
+ *     #define LEPK_HT_STATS
+ * before every include to enable lepk_ht_stats. Compiled out by default since it's counted on every probe.
+ *     #define LEPK_HT_STATS_PROBES [int]
+ * to define how many probe lengths the stats histograms track.
+ *     #define LEPK_HT_NO_POSIX
+ * to leave out lepk_ht_save and lepk_ht_map_load, which need mmap and are only there on Unix-like systems.
  */
 
 /*
- * TODO: ACTUALLY MAKE THE THING WORK.
- * Currently, when getting an entry, if it collided and the object at the original collision point has been removed a dead entry is returned instead of the actual entry.
+ * === Documentation ===
+ * Keys and data are copied into the table and stored densely in insertion order.
+ * Iterating is a plain loop over the arrays, which stay valid until the table is modified:
+ * const int *keys = lepk__ht_keys(table);
+ * int *values = lepk__ht_values(table);
+ * for (unsigned long i = 0; i < lepk_ht_count(table); i++) {
+ *     printf("%d: %d\n", keys[i], values[i]);
+ * }
+ *
+ * Tables with at most LEPK_HT_SMALL pairs have no index and never call the hashing function,
+ * lookups compare against every key. Keys of 4 or 8 bytes using lepk_ht_compare_generic are compared
+ * without calling it, several at a time with SSE2. The table switches to hashing once it grows past the limit
+ * and back again on lepk_ht_shrink_to_fit.
+ *
+ * On Unix-like systems, tables that are expensive to build can be saved once and mapped at startup instead:
+ * lepk_ht_save(table, "table.bin");
+ * LepkHt *mapped = lepk_ht_map_load(lepk_ht_hash_generic, lepk_ht_compare_generic, "table.bin");
+ * The file holds the entry arrays and the index as they are in memory, so it only loads on machines
+ * with the same word size and byte order, which the file header checks along with a fingerprint of the hash function.
+ * Mapped tables support every lookup and iteration function but can't be modified.
+ *
+ * Read-modify-write without probing twice:
+ * int *counter = lepk_ht_get_or_insert(table, &key, NULL);
+ * (*counter)++;
+ *
+ * With lepk_da.h included, every key or value can be pushed to a dynamic array in one go:
+ * int *da = lepk_da_create(sizeof(int));
+ * lepk_ht_keys(table, da);
  */
 
 #ifndef LEPK_HT_H
@@ -48,27 +88,119 @@
 #define LEPKHT static
 #endif /* LEPK_HT_STATIC */
 
+#include <stdbool.h>
+
+#if defined(__unix__) && !defined(LEPK_HT_NO_POSIX)
+#define LEPK_HT_POSIX
+#endif /* defined(__unix__) && !defined(LEPK_HT_NO_POSIX) */
+
+#ifdef LEPK_HT_STATS
+#include <stdio.h>
+
+#ifndef LEPK_HT_STATS_PROBES
+#define LEPK_HT_STATS_PROBES 16
+#endif /* LEPK_HT_STATS_PROBES */
+#endif /* LEPK_HT_STATS */
+
 /* Hash Table. */
 typedef struct LepkHt LepkHt;
 /* Hasing function. */
 typedef unsigned long (*LepkHtHash)(const void *key, unsigned long size);
 /* Compare funciton. */
 typedef int (*LepkHtCompare)(const void *a, const void *b, unsigned long size);
+/* Upsert callback, data is zeroed if the key was just inserted. */
+typedef void (*LepkHtUpsert)(void *data, bool inserted, void *user);
+
+#ifdef LEPK_HT_STATS
+/* Table statistics, counters start when the table is created. */
+typedef struct {
+	/* Slots probed by lookups that found their key, the last bucket collects longer probes. */
+	unsigned long hit_probes[LEPK_HT_STATS_PROBES];
+	/* Slots probed by lookups that missed. A lookup during incremental rehash may probe both indices. */
+	unsigned long miss_probes[LEPK_HT_STATS_PROBES];
+	/* Calls to the compare function. */
+	unsigned long compares;
+	/* Index resizes and rebuilds. */
+	unsigned long resizes;
+	/* Processor time spent rehashing, in seconds. */
+	double resize_time;
+
+	float load_factor;
+	/* Removed or migrated index slots still lengthening probes. */
+	unsigned long dead_slots;
+	/* Removed entries waiting to be compacted. */
+	unsigned long holes;
+	/* Memory held by the table. */
+	unsigned long bytes;
+} LepkHtStats;
+#endif /* LEPK_HT_STATS */
 
 /* Create a hash table. */
 LEPKHT LepkHt *lepk_ht_create(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size, unsigned long data_size);
+/* Create a hash table that fits capacity pairs without resizing. */
+LEPKHT LepkHt *lepk_ht_create_with_capacity(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size, unsigned long data_size, unsigned long capacity);
 /* Destroy a hash table. */
 LEPKHT void lepk_ht_destroy(LepkHt *table);
 
 /* Retrieve item count from hash table. */
 LEPKHT unsigned long lepk_ht_count(const LepkHt *table);
+/*
+ * Set how many buckets are migrated per operation while the table is resizing.
+ * 0 (default) rehashes the whole table at once, anything else spreads the resize over the following operations.
+ */
+LEPKHT void lepk_ht_rehash_step(LepkHt *table, unsigned long step);
+/* Set the load factor, between 0 and 1, the table resizes at. */
+LEPKHT void lepk_ht_max_load(LepkHt *table, float max_load);
+/* Make room for capacity pairs in total without resizing. */
+LEPKHT void lepk_ht_reserve(LepkHt *table, unsigned long capacity);
+/* Free all memory not needed for the pairs currently in the table. */
+LEPKHT void lepk_ht_shrink_to_fit(LepkHt *table);
+/* Remove every pair, keeping the memory around for reuse. */
+LEPKHT void lepk_ht_clear(LepkHt *table);
+#ifdef LEPK_HT_STATS
+/* Retrieve statistics of a table. */
+LEPKHT void lepk_ht_stats(const LepkHt *table, LepkHtStats *stats);
+/* Write human readable statistics of a table to file. */
+LEPKHT void lepk_ht_stats_report(const LepkHt *table, FILE *file);
+#endif /* LEPK_HT_STATS */
 
 /* Set the pair in hash table. */
 LEPKHT void lepk__ht_set(LepkHt *table, const void *key, const void *data);
-/* Get pair from hash table. */
-LEPKHT void lepk__ht_get(LepkHt *table, const void *key, void *output);
+/* Get pair from hash table. Returns false, leaving output untouched, if key isn't in the table. */
+LEPKHT bool lepk__ht_get(LepkHt *table, const void *key, void *output);
 /* Remove pair from hash table. */
 LEPKHT void lepk__ht_remove(LepkHt *table, const void *key, void *output);
+/* Pointer to the data stored for key, NULL if key isn't in the table. Valid until the table is modified. */
+LEPKHT void *lepk_ht_find(LepkHt *table, const void *key);
+/* Pointer to the data stored for key, zeroed data is inserted if key is missing. inserted is optional. */
+LEPKHT void *lepk_ht_get_or_insert(LepkHt *table, const void *key, bool *inserted);
+/* Call callback on the data stored for key, inserting it first if missing. */
+LEPKHT void lepk_ht_upsert(LepkHt *table, const void *key, LepkHtUpsert callback, void *user);
+/*
+ * Get count pairs at once, faster than looping over lepk__ht_get for large tables.
+ * keys and outputs are arrays of count keys and data. found is optional and set per key.
+ * Returns how many keys were found.
+ */
+LEPKHT unsigned long lepk_ht_get_batch(LepkHt *table, const void *keys, unsigned long count, void *outputs, bool *found);
+/* Set count pairs at once. keys and data are arrays of count keys and data. */
+LEPKHT void lepk_ht_set_batch(LepkHt *table, const void *keys, const void *data, unsigned long count);
+/* All keys in insertion order, lepk_ht_count long. */
+LEPKHT const void *lepk__ht_keys(LepkHt *table);
+/* All data in insertion order, lepk_ht_count long. */
+LEPKHT void *lepk__ht_values(LepkHt *table);
+#ifdef LEPK_HT_POSIX
+/*
+ * Write table to filepath in a form lepk_ht_map_load can map straight back in.
+ * Keys and data are written as plain bytes, so they must not hold pointers. Returns false if writing failed.
+ */
+LEPKHT bool lepk_ht_save(LepkHt *table, const char *filepath);
+/*
+ * Map a table written by lepk_ht_save, lookups read straight from the file without rehashing or copying anything.
+ * hash must be the function the table was saved with, which is checked. compare must agree with it.
+ * Returns NULL if the file can't be mapped or doesn't match. The table is read-only, destroying it unmaps the file.
+ */
+LEPKHT LepkHt *lepk_ht_map_load(LepkHtHash hash, LepkHtCompare compare, const char *filepath);
+#endif /* LEPK_HT_POSIX */
 
 /* Pre-written hashing function for strings. */
 LEPKHT unsigned long lepk_ht_hash_string(const void *key, unsigned long size);
@@ -82,9 +214,17 @@ LEPKHT int lepk_ht_compare_generic(const void *a, const void *b, unsigned long s
 #define lepk_ht_set(table, key, data) do { __typeof__(key) lepk__ht_temp_key = key; __typeof__(data) lepk__ht_temp_data = data; lepk__ht_set(table, &lepk__ht_temp_key, &lepk__ht_temp_data); } while (0)
 #define lepk_ht_get(table, key, output) do { __typeof__(key) lepk__ht_temp_key = key; lepk__ht_get(table, &lepk__ht_temp_key, output); } while (0)
 #define lepk_ht_remove(table, key, output) do { __typeof__(key) lepk__ht_temp_key = key; lepk__ht_remove(table, &lepk__ht_temp_key, output); } while (0)
+/* Push all keys to the end of a lepk_da dynamic array. */
+#define lepk_ht_keys(table, da) lepk_da_push_array(da, lepk__ht_keys(table), lepk_ht_count(table))
+/* Push all data to the end of a lepk_da dynamic array. */
+#define lepk_ht_values(table, da) lepk_da_push_array(da, lepk__ht_values(table), lepk_ht_count(table))
 
 #ifdef LEPK_HT_TEST
 
+static void lepk__ht_test_upsert(void *data, bool inserted, void *user) {
+	*(int *) data = inserted ? *(int *) user : *(int *) data + *(int *) user;
+}
+
 static void lepk_ht_test(void) {
 	LepkHt *table = lepk_ht_create(lepk_ht_hash_string, lepk_ht_compare_string, sizeof(const char *), sizeof(int));
 	lepk_ht_set(table, "key", 8);
@@ -92,6 +232,121 @@ static void lepk_ht_test(void) {
 	lepk_ht_get(table, "key", &output);
 	assert(output == 8 && "lepk_ht failed.");
 	lepk_ht_destroy(table);
+
+	{
+		LepkHt *table = lepk_ht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int), sizeof(int));
+		lepk_ht_rehash_step(table, 4);
+		for (int i = 0; i < 1000; i++) {
+			lepk_ht_set(table, i, i * 2);
+		}
+		for (int i = 0; i < 1000; i += 2) {
+			lepk_ht_remove(table, i, NULL);
+		}
+		assert(lepk_ht_count(table) == 500 && "lepk_ht_rehash_step count failed.");
+		for (int i = 0; i < 1000; i++) {
+			int output = -1;
+			lepk_ht_get(table, i, &output);
+			assert(output == (i % 2 ? i * 2 : -1) && "lepk_ht_rehash_step failed.");
+		}
+
+		const int *keys = lepk__ht_keys(table);
+		const int *values = lepk__ht_values(table);
+		for (int i = 0; i < 500; i++) {
+			assert(keys[i] == i * 2 + 1 && values[i] == keys[i] * 2 && "lepk__ht_keys failed.");
+		}
+
+		int batch_keys[4] = { 1, 2, 3, 999 };
+		int batch_outputs[4] = { 0 };
+		bool batch_found[4];
+		assert(lepk_ht_get_batch(table, batch_keys, 4, batch_outputs, batch_found) == 3 && "lepk_ht_get_batch failed.");
+		assert(batch_outputs[0] == 2 && batch_outputs[2] == 6 && batch_outputs[3] == 1998 && !batch_found[1] && "lepk_ht_get_batch failed.");
+		lepk_ht_set_batch(table, batch_keys, batch_outputs, 4);
+		assert(lepk_ht_count(table) == 501 && "lepk_ht_set_batch failed.");
+
+		int key = 1;
+		assert(*(int *) lepk_ht_find(table, &key) == 2 && "lepk_ht_find failed.");
+		key = 1000;
+		assert(lepk_ht_find(table, &key) == NULL && "lepk_ht_find failed.");
+		bool inserted;
+		int *data = lepk_ht_get_or_insert(table, &key, &inserted);
+		assert(inserted && *data == 0 && "lepk_ht_get_or_insert failed.");
+		*data = 5;
+		int add = 3;
+		lepk_ht_upsert(table, &key, lepk__ht_test_upsert, &add);
+		assert(lepk__ht_get(table, &key, &output) && output == 8 && "lepk_ht_upsert failed.");
+		lepk_ht_remove(table, 1000, NULL);
+
+		LepkHt *copy = lepk_ht_create_with_capacity(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int), sizeof(int), 1000);
+		lepk_ht_max_load(copy, 0.5f);
+		lepk_ht_set_batch(copy, lepk__ht_keys(table), lepk__ht_values(table), lepk_ht_count(table));
+		lepk_ht_reserve(copy, 4000);
+		for (int i = 0; i < 200; i++) {
+			lepk_ht_remove(copy, i * 2 + 1, NULL);
+		}
+		lepk_ht_shrink_to_fit(copy);
+		assert(lepk_ht_count(copy) == 301 && lepk__ht_get(copy, &batch_keys[3], &output) && output == 1998 && "lepk_ht_shrink_to_fit failed.");
+		lepk_ht_clear(copy);
+		assert(lepk_ht_count(copy) == 0 && !lepk__ht_get(copy, &batch_keys[3], &output) && "lepk_ht_clear failed.");
+		lepk_ht_set(copy, 4, 8);
+		assert(lepk__ht_get(copy, &(int) { 4 }, &output) && output == 8 && "lepk_ht_clear failed.");
+		lepk_ht_destroy(copy);
+
+		LepkHt *small = lepk_ht_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int), sizeof(int));
+		for (int i = 0; i < 20; i++) {
+			lepk_ht_set(small, i, i * 3);
+			if (i == 2) {
+				lepk_ht_remove(small, 1, NULL);
+			}
+		}
+		assert(lepk_ht_count(small) == 19 && ((const int *) lepk__ht_keys(small))[1] == 2 && "lepk_ht small map failed.");
+		for (int i = 4; i < 20; i++) {
+			lepk_ht_remove(small, i, NULL);
+		}
+		lepk_ht_shrink_to_fit(small);
+		lepk_ht_set(small, 0, 7);
+		assert(lepk_ht_count(small) == 3 && *(int *) lepk_ht_find(small, &(int) { 0 }) == 7 && "lepk_ht small map failed.");
+		assert(*(int *) lepk_ht_find(small, &(int) { 3 }) == 9 && lepk_ht_find(small, &(int) { 1 }) == NULL && "lepk_ht small map failed.");
+		lepk_ht_destroy(small);
+
+#ifdef LEPK_HT_POSIX
+		assert(lepk_ht_save(table, "ht_test.bin") && "lepk_ht_save failed.");
+		assert(lepk_ht_map_load(lepk_ht_hash_string, lepk_ht_compare_generic, "ht_test.bin") == NULL && "lepk_ht_map_load failed.");
+		LepkHt *mapped = lepk_ht_map_load(lepk_ht_hash_generic, lepk_ht_compare_generic, "ht_test.bin");
+		assert(mapped != NULL && lepk_ht_count(mapped) == 501 && "lepk_ht_map_load failed.");
+		for (int i = 0; i < 1000; i++) {
+			int *data = lepk_ht_find(mapped, &i);
+			assert((i % 2 ? data != NULL && *data == i * 2 : data == NULL || i == 2) && "lepk_ht_map_load failed.");
+		}
+		assert(memcmp(lepk__ht_keys(mapped), lepk__ht_keys(table), 501 * sizeof(int)) == 0 && "lepk_ht_map_load failed.");
+		lepk_ht_destroy(mapped);
+		/* The index ends the file, its last slot pointing past the entries. */
+		FILE *file = fopen("ht_test.bin", "r+b");
+		fseek(file, -4, SEEK_END);
+		fwrite("\xff\xff\xff\xff", 4, 1, file);
+		fclose(file);
+		assert(lepk_ht_map_load(lepk_ht_hash_generic, lepk_ht_compare_generic, "ht_test.bin") == NULL && "lepk_ht_map_load accepted a corrupt index.");
+		remove("ht_test.bin");
+#endif /* LEPK_HT_POSIX */
+
+#ifdef LEPK_HT_STATS
+		LepkHtStats stats;
+		lepk_ht_stats(table, &stats);
+		unsigned long hits = 0;
+		for (int i = 0; i < LEPK_HT_STATS_PROBES; i++) {
+			hits += stats.hit_probes[i];
+		}
+		assert(hits > 0 && stats.compares >= hits && stats.resizes > 0 && "lepk_ht_stats failed.");
+		assert(stats.load_factor > 0.0f && stats.load_factor < 1.0f && stats.bytes > 501 * 2 * sizeof(int) && "lepk_ht_stats failed.");
+#endif /* LEPK_HT_STATS */
+
+#ifdef LEPK_DA_H
+		int *da = lepk_da_create(sizeof(int));
+		lepk_ht_values(table, da);
+		assert(lepk_da_count(da) == 501 && memcmp(da, lepk__ht_values(table), 501 * sizeof(int)) == 0 && "lepk_ht_values failed.");
+		lepk_da_destroy(da);
+#endif /* LEPK_DA_H */
+		lepk_ht_destroy(table);
+	}
 }
 
 #endif /* LEPK_HT_TEST */
@@ -102,6 +357,22 @@ static void lepk_ht_test(void) {
 #include <string.h>
 #include <assert.h>
 #include <stdint.h>
+#include <stdio.h>
+
+#ifdef LEPK_HT_POSIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif /* LEPK_HT_POSIX */
+
+#ifdef LEPK_HT_STATS
+#include <time.h>
+#endif /* LEPK_HT_STATS */
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
 
 #undef LEPKHT
 #ifndef LEPK_HT_STATIC
@@ -110,50 +381,427 @@ static void lepk_ht_test(void) {
 #define LEPKHT static
 #endif /* LEPK_HT_STATIC */
 
+#ifndef LEPK_HT_MAX_LOAD
 #define LEPK_HT_MAX_LOAD 0.75f
+#endif /* LEPK_HT_MAX_LOAD */
+
+/* Smallest amount of entries and index slots. */
+#define LEPK__HT_MIN_CAP 8
+/* Smallest amount of entries in a small table. */
+#define LEPK__HT_SMALL_MIN_CAP 4
+
+/* Tables with up to this many pairs are searched linearly, without hashing or an index. */
+#ifndef LEPK_HT_SMALL
+#define LEPK_HT_SMALL 8
+#endif /* LEPK_HT_SMALL */
+
+/* Keys hashed and prefetched together by the batch functions. */
+#ifndef LEPK_HT_BATCH
+#define LEPK_HT_BATCH 16
+#endif /* LEPK_HT_BATCH */
 
-typedef struct Lepk__HtEntry {
-	void *key;
-	void *data;
-	size_t hash;
-	bool dead;
-} Lepk__HtEntry;
+#if defined(__GNUC__) || defined(__clang__)
+#define LEPK__HT_PREFETCH(address) __builtin_prefetch(address)
+#else /* defined(__GNUC__) || defined(__clang__) */
+#define LEPK__HT_PREFETCH(address) ((void) (address))
+#endif /* defined(__GNUC__) || defined(__clang__) */
 
+#ifdef LEPK_HT_STATS
+#define LEPK__HT_STAT(statement) statement
+#else /* LEPK_HT_STATS */
+#define LEPK__HT_STAT(statement)
+#endif /* LEPK_HT_STATS */
+
+/* Index slot never used, ends a probe sequence. Zero so fresh indices can come straight from calloc. */
+#define LEPK__HT_INDEX_EMPTY 0
+/* Index slot removed or migrated, probe sequences continue past it. */
+#define LEPK__HT_INDEX_DEAD 1
+/* Added to entry positions stored in the index. */
+#define LEPK__HT_INDEX_OFFSET 2
+/* Hash stored for removed entries. Real hashes of this value are remapped. */
+#define LEPK__HT_HASH_HOLE 0
+
+#ifdef LEPK_HT_POSIX
+/* "LPHT" at the start of saved tables. */
+#define LEPK__HT_FILE_MAGIC 0x5448504cu
+#define LEPK__HT_FILE_VERSION 1
+
+/* Header of a saved table. Hashes, keys, data and index follow, each starting 8 byte aligned. */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	/* sizeof(size_t) of the writer, the width of the stored hashes. */
+	uint32_t word_size;
+	uint32_t padding;
+	/* Hash of a fixed key, tells whether the reader hashes like the writer did. */
+	uint64_t fingerprint;
+	uint64_t key_size;
+	uint64_t data_size;
+	uint64_t count;
+	/* Index slots, 0 for small tables. */
+	uint64_t cap;
+	/* Bytes in the whole file. */
+	uint64_t size;
+} Lepk__HtFileHeader;
+#endif /* LEPK_HT_POSIX */
+
+/*
+ * Entries are stored densely in insertion order, split into hash, key and data arrays.
+ * The index is an open addressed table of 32 bit positions into the entries.
+ * Removing leaves a hole in the entries which is compacted away before iterating.
+ *
+ * Small tables have no index and no hashes (both NULL), their entries never have holes
+ * and are searched linearly until the table grows past LEPK_HT_SMALL pairs.
+ */
 struct LepkHt {
 	LepkHtHash hash;
 	LepkHtCompare compare;
 
 	size_t key_size;
 	size_t data_size;
-	size_t cap;
 	size_t count;
-	Lepk__HtEntry *entires;
+
+	/* Entries, including holes. */
+	size_t entry_count;
+	size_t entry_cap;
+	/* NULL while the table is small. */
+	size_t *hashes;
+	unsigned char *keys;
+	unsigned char *data;
+
+	size_t cap;
+	/* Alive and dead slots in index. */
+	size_t used;
+	/* NULL while the table is small. */
+	uint32_t *index;
+	/* Index is resized when used reaches cap * max_load. */
+	float max_load;
+
+	/* Buckets migrated per operation, 0 resizes the whole index at once. */
+	size_t rehash_step;
+	/* Index being migrated into index, NULL when not resizing. */
+	uint32_t *old_index;
+	size_t old_cap;
+	size_t migrate_index;
+
+	/* File the arrays point into, NULL unless loaded by lepk_ht_map_load. */
+	void *mapping;
+	size_t mapping_size;
+
+#ifdef LEPK_HT_STATS
+	unsigned long hit_probes[LEPK_HT_STATS_PROBES];
+	unsigned long miss_probes[LEPK_HT_STATS_PROBES];
+	unsigned long compares;
+	unsigned long resizes;
+	clock_t resize_clock;
+#endif /* LEPK_HT_STATS */
 };
 
-static Lepk__HtEntry *lepk__ht_find_entry(Lepk__HtEntry *entires, LepkHtCompare compare, unsigned long hash, unsigned long cap, const void *key, unsigned long key_size) {
-	size_t index = hash % cap;
-	Lepk__HtEntry *entry = &entires[index];
+static uint32_t *lepk__ht_alloc_index(size_t cap) {
+	return calloc(cap, sizeof(uint32_t));
+}
+
+static size_t lepk__ht_hash(const LepkHt *table, const void *key) {
+	size_t hash = table->hash(key, table->key_size);
+	return hash == LEPK__HT_HASH_HOLE ? hash + 1 : hash;
+}
 
-	/* No entry at index. */
-	if (entry->dead) {
-		return entry;
-	}
+#ifdef LEPK_HT_STATS
+/* Count a probe sequence of length slots in histogram, the last bucket collects everything longer. */
+static void lepk__ht_stat_probe(unsigned long *histogram, size_t length) {
+	histogram[length < LEPK_HT_STATS_PROBES ? length - 1 : LEPK_HT_STATS_PROBES - 1]++;
+}
+#endif /* LEPK_HT_STATS */
+
+/*
+ * Slot in index holding key, cap if key isn't in index.
+ * If free_slot isn't NULL it's set to the first slot the key could be inserted at.
+ */
+static size_t lepk__ht_find_slot(LepkHt *table, const uint32_t *index, size_t cap, size_t hash, const void *key, size_t *free_slot) {
+	size_t slot = hash & (cap - 1);
+	size_t first_dead = cap;
+	LEPK__HT_STAT(size_t length = 0;)
 
-	/* Entry at current location. */
 	for (;;) {
-		entry = &entires[index];
-		/* printf("%s\n", entry->dead ? "dead" : "alive"); */
+		uint32_t entry = index[slot] - LEPK__HT_INDEX_OFFSET;
+		LEPK__HT_STAT(length++;)
 
-		/* Found entry with same key or an empty slot. */
-		if (entry->dead || compare(key, entry->key, key_size) == 0) {
-			return entry;
+		if (index[slot] == LEPK__HT_INDEX_EMPTY) {
+			if (free_slot != NULL) {
+				*free_slot = first_dead != cap ? first_dead : slot;
+			}
+			LEPK__HT_STAT(lepk__ht_stat_probe(table->miss_probes, length);)
+			return cap;
 		}
+		if (index[slot] == LEPK__HT_INDEX_DEAD) {
+			if (first_dead == cap) {
+				first_dead = slot;
+			}
+		} else if (table->hashes[entry] == hash) {
+			LEPK__HT_STAT(table->compares++;)
+			if (table->compare(key, table->keys + entry * table->key_size, table->key_size) == 0) {
+				LEPK__HT_STAT(lepk__ht_stat_probe(table->hit_probes, length);)
+				return slot;
+			}
+		}
+
+		slot = (slot + 1) & (cap - 1);
+	}
+}
 
-		index = (index + 1) & (cap - 1);
+/* First slot in index a new entry with hash can be placed in. */
+static size_t lepk__ht_free_slot(const uint32_t *index, size_t cap, size_t hash) {
+	size_t slot = hash & (cap - 1);
+	while (index[slot] >= LEPK__HT_INDEX_OFFSET) {
+		slot = (slot + 1) & (cap - 1);
 	}
+	return slot;
+}
+
+/* Point a free slot in the current index at entry. */
+static void lepk__ht_index_entry(LepkHt *table, uint32_t entry) {
+	size_t slot = lepk__ht_free_slot(table->index, table->cap, table->hashes[entry]);
+	if (table->index[slot] == LEPK__HT_INDEX_EMPTY) {
+		table->used++;
+	}
+	table->index[slot] = entry + LEPK__HT_INDEX_OFFSET;
+}
+
+/* Move up to step buckets from the old index into the current one. */
+static void lepk__ht_migrate(LepkHt *table, size_t step) {
+	if (table->old_index == NULL) {
+		return;
+	}
+
+	LEPK__HT_STAT(clock_t start = clock();)
+	size_t end = table->migrate_index + step;
+	if (end > table->old_cap) {
+		end = table->old_cap;
+	}
+
+	for (; table->migrate_index < end; table->migrate_index++) {
+		uint32_t *slot = &table->old_index[table->migrate_index];
+		if (*slot < LEPK__HT_INDEX_OFFSET) {
+			continue;
+		}
+
+		lepk__ht_index_entry(table, *slot - LEPK__HT_INDEX_OFFSET);
+		/* Keep probe sequences of unmigrated entries intact. */
+		*slot = LEPK__HT_INDEX_DEAD;
+	}
+	LEPK__HT_STAT(table->resize_clock += clock() - start;)
+
+	if (table->migrate_index == table->old_cap) {
+		free(table->old_index);
+		table->old_index = NULL;
+		table->old_cap = 0;
+		table->migrate_index = 0;
+	}
+}
+
+static void lepk__ht_resize(LepkHt *table) {
+	/* Finish any ongoing migration before starting a new one. */
+	lepk__ht_migrate(table, table->old_cap);
+
+	/* Only grow if the load comes from alive slots, otherwise just flush dead ones. */
+	size_t new_cap = table->cap;
+	if (table->count * 2 >= table->used) {
+		new_cap *= 2;
+	}
+
+	LEPK__HT_STAT(table->resizes++;)
+	table->old_index = table->index;
+	table->old_cap = table->cap;
+	table->migrate_index = 0;
+
+	table->index = lepk__ht_alloc_index(new_cap);
+	table->cap = new_cap;
+	table->used = 0;
+
+	if (table->rehash_step == 0) {
+		lepk__ht_migrate(table, table->old_cap);
+	}
+}
+
+/* Throw away the index and build a new one with cap slots, all at once. */
+static void lepk__ht_reindex(LepkHt *table, size_t cap) {
+	lepk__ht_migrate(table, table->old_cap);
+	LEPK__HT_STAT(table->resizes++;)
+	LEPK__HT_STAT(clock_t start = clock();)
+
+	if (cap == table->cap) {
+		memset(table->index, 0, cap * sizeof(uint32_t));
+	} else {
+		free(table->index);
+		table->index = lepk__ht_alloc_index(cap);
+		table->cap = cap;
+	}
+
+	table->used = 0;
+	for (size_t i = 0; i < table->entry_count; i++) {
+		if (table->hashes[i] != LEPK__HT_HASH_HOLE) {
+			lepk__ht_index_entry(table, i);
+		}
+	}
+	LEPK__HT_STAT(table->resize_clock += clock() - start;)
+}
+
+/* Squeeze out holes left by removals, keeping insertion order, and rebuild the index. */
+static void lepk__ht_compact(LepkHt *table) {
+	if (table->entry_count == table->count) {
+		return;
+	}
+
+	lepk__ht_migrate(table, table->old_cap);
+
+	size_t count = 0;
+	for (size_t i = 0; i < table->entry_count; i++) {
+		if (table->hashes[i] == LEPK__HT_HASH_HOLE) {
+			continue;
+		}
+		if (i != count) {
+			table->hashes[count] = table->hashes[i];
+			memcpy(table->keys + count * table->key_size, table->keys + i * table->key_size, table->key_size);
+			memcpy(table->data + count * table->data_size, table->data + i * table->data_size, table->data_size);
+		}
+		count++;
+	}
+	table->entry_count = count;
+
+	lepk__ht_reindex(table, table->cap);
+}
+
+/* Resize entry arrays to exactly cap entries. */
+static void lepk__ht_realloc_entries(LepkHt *table, size_t cap) {
+	assert(cap <= UINT32_MAX - LEPK__HT_INDEX_OFFSET && "lepk_ht can't hold that many entries.");
+	table->entry_cap = cap;
+	if (table->hashes != NULL) {
+		table->hashes = realloc(table->hashes, cap * sizeof(size_t));
+	}
+	table->keys = realloc(table->keys, cap * table->key_size);
+	table->data = realloc(table->data, cap * table->data_size);
+}
+
+/* Smallest index that fits capacity entries without resizing. */
+static size_t lepk__ht_index_cap(const LepkHt *table, size_t capacity) {
+	size_t cap = LEPK__HT_MIN_CAP;
+	while ((size_t) (cap * table->max_load) < capacity) {
+		cap *= 2;
+	}
+	return cap;
+}
+
+/* Make room for one more entry. */
+static void lepk__ht_grow_entries(LepkHt *table) {
+	/* Mostly holes, reuse the space instead. */
+	if ((table->entry_count - table->count) * 2 >= table->entry_count) {
+		lepk__ht_compact(table);
+		return;
+	}
+
+	lepk__ht_realloc_entries(table, table->entry_cap * 2);
+}
+
+/* Entry holding key in a small table, entry_count if it's missing. Fixed size keys skip the compare function. */
+static size_t lepk__ht_small_find(LepkHt *table, const void *key) {
+	size_t count = table->entry_count;
+	size_t i = 0;
+
+	if (table->compare == lepk_ht_compare_generic && table->key_size == sizeof(uint32_t)) {
+		uint32_t wanted;
+		memcpy(&wanted, key, sizeof(uint32_t));
+#ifdef __SSE2__
+		__m128i wanted4 = _mm_set1_epi32((int) wanted);
+		for (; i + 4 <= count; i += 4) {
+			__m128i keys = _mm_loadu_si128((const __m128i *) (table->keys + i * sizeof(uint32_t)));
+			int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(keys, wanted4)));
+			if (mask != 0) {
+				return i + __builtin_ctz(mask);
+			}
+		}
+#endif /* __SSE2__ */
+		for (; i < count; i++) {
+			uint32_t current;
+			memcpy(&current, table->keys + i * sizeof(uint32_t), sizeof(uint32_t));
+			if (current == wanted) {
+				return i;
+			}
+		}
+		return count;
+	}
+
+	if (table->compare == lepk_ht_compare_generic && table->key_size == sizeof(uint64_t)) {
+		uint64_t wanted;
+		memcpy(&wanted, key, sizeof(uint64_t));
+#ifdef __SSE2__
+		/* No 64 bit compare in SSE2, both 32 bit halves have to match. */
+		__m128i wanted2 = _mm_set1_epi64x((long long) wanted);
+		for (; i + 2 <= count; i += 2) {
+			__m128i keys = _mm_loadu_si128((const __m128i *) (table->keys + i * sizeof(uint64_t)));
+			__m128i equal = _mm_cmpeq_epi32(keys, wanted2);
+			equal = _mm_and_si128(equal, _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+			int mask = _mm_movemask_pd(_mm_castsi128_pd(equal));
+			if (mask != 0) {
+				return i + __builtin_ctz(mask);
+			}
+		}
+#endif /* __SSE2__ */
+		for (; i < count; i++) {
+			uint64_t current;
+			memcpy(&current, table->keys + i * sizeof(uint64_t), sizeof(uint64_t));
+			if (current == wanted) {
+				return i;
+			}
+		}
+		return count;
+	}
+
+	for (; i < count; i++) {
+		LEPK__HT_STAT(table->compares++;)
+		if (table->compare(key, table->keys + i * table->key_size, table->key_size) == 0) {
+			return i;
+		}
+	}
+	return count;
+}
+
+/* Switch a small table to the hashed layout, with an index fitting capacity entries. */
+static void lepk__ht_leave_small(LepkHt *table, size_t capacity) {
+	if (table->entry_cap < LEPK__HT_MIN_CAP) {
+		lepk__ht_realloc_entries(table, LEPK__HT_MIN_CAP);
+	}
+
+	table->hashes = malloc(table->entry_cap * sizeof(size_t));
+	for (size_t i = 0; i < table->entry_count; i++) {
+		table->hashes[i] = lepk__ht_hash(table, table->keys + i * table->key_size);
+	}
+
+	table->cap = lepk__ht_index_cap(table, capacity);
+	table->index = lepk__ht_alloc_index(table->cap);
+	table->used = 0;
+	for (size_t i = 0; i < table->entry_count; i++) {
+		lepk__ht_index_entry(table, i);
+	}
+}
+
+/* Switch back to the small layout, dropping the index and hashes. */
+static void lepk__ht_enter_small(LepkHt *table) {
+	lepk__ht_compact(table);
+	lepk__ht_migrate(table, table->old_cap);
+
+	free(table->index);
+	free(table->hashes);
+	table->index = NULL;
+	table->hashes = NULL;
+	table->cap = 0;
+	table->used = 0;
 }
 
 LEPKHT LepkHt *lepk_ht_create(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size, unsigned long data_size) {
+	return lepk_ht_create_with_capacity(hash, compare, key_size, data_size, 0);
+}
+
+LEPKHT LepkHt *lepk_ht_create_with_capacity(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size, unsigned long data_size, unsigned long capacity) {
 	LepkHt *table = malloc(sizeof(LepkHt));
 
 	table->hash = hash;
@@ -161,27 +809,54 @@ LEPKHT LepkHt *lepk_ht_create(LepkHtHash hash, LepkHtCompare compare, unsigned l
 
 	table->key_size = key_size;
 	table->data_size = data_size;
-	table->cap = 8;
 	table->count = 0;
-	table->entires = malloc(table->cap * sizeof(Lepk__HtEntry));
 
-	for (size_t i = 0; i < table->cap; i++) {
-		table->entires[i].key = NULL;
-		table->entires[i].data = NULL;
-		table->entires[i].hash = 0;
-		table->entires[i].dead = true;
-	}
+	bool small = capacity <= LEPK_HT_SMALL;
+	size_t min_cap = small ? LEPK__HT_SMALL_MIN_CAP : LEPK__HT_MIN_CAP;
+	table->entry_count = 0;
+	table->entry_cap = capacity > min_cap ? capacity : min_cap;
+	table->hashes = small ? NULL : malloc(table->entry_cap * sizeof(size_t));
+	table->keys = malloc(table->entry_cap * key_size);
+	table->data = malloc(table->entry_cap * data_size);
+
+	table->max_load = LEPK_HT_MAX_LOAD;
+	table->cap = small ? 0 : lepk__ht_index_cap(table, capacity);
+	table->used = 0;
+	table->index = small ? NULL : lepk__ht_alloc_index(table->cap);
+
+	table->rehash_step = 0;
+	table->old_index = NULL;
+	table->old_cap = 0;
+	table->migrate_index = 0;
+
+	table->mapping = NULL;
+	table->mapping_size = 0;
+
+#ifdef LEPK_HT_STATS
+	memset(table->hit_probes, 0, sizeof(table->hit_probes));
+	memset(table->miss_probes, 0, sizeof(table->miss_probes));
+	table->compares = 0;
+	table->resizes = 0;
+	table->resize_clock = 0;
+#endif /* LEPK_HT_STATS */
 
 	return table;
 }
 
 LEPKHT void lepk_ht_destroy(LepkHt *table) {
-	for (size_t i = 0; i < table->cap; i++) {
-		Lepk__HtEntry *entry = &table->entires[i];
-		if (entry->key  != NULL) { free(entry->key);  }
-		if (entry->data != NULL) { free(entry->data); }
+#ifdef LEPK_HT_POSIX
+	if (table->mapping != NULL) {
+		munmap(table->mapping, table->mapping_size);
+		free(table);
+		return;
 	}
-	free(table->entires);
+#endif /* LEPK_HT_POSIX */
+
+	free(table->hashes);
+	free(table->keys);
+	free(table->data);
+	free(table->index);
+	free(table->old_index);
 	free(table);
 }
 
@@ -189,66 +864,562 @@ LEPKHT unsigned long lepk_ht_count(const LepkHt *table) {
 	return table->count;
 }
 
-LEPKHT void lepk__ht_set(LepkHt *table, const void *key, const void *data) {
-	/* Resize table if needed. */
-	if (table->count >= (size_t) (table->cap * LEPK_HT_MAX_LOAD)) {
-		size_t new_cap = table->cap * 2;
-
-		Lepk__HtEntry *new_entires = malloc(new_cap * sizeof(Lepk__HtEntry));
-		for (size_t i = 0; i < new_cap; i++) {
-			new_entires[i].key = NULL;
-			new_entires[i].data = NULL;
-			new_entires[i].hash = 0;
-			new_entires[i].dead = true;
+#ifdef LEPK_HT_STATS
+static size_t lepk__ht_count_dead(const uint32_t *index, size_t cap) {
+	size_t dead = 0;
+	for (size_t i = 0; i < cap; i++) {
+		dead += index[i] == LEPK__HT_INDEX_DEAD;
+	}
+	return dead;
+}
+
+LEPKHT void lepk_ht_stats(const LepkHt *table, LepkHtStats *stats) {
+	memcpy(stats->hit_probes, table->hit_probes, sizeof(stats->hit_probes));
+	memcpy(stats->miss_probes, table->miss_probes, sizeof(stats->miss_probes));
+	stats->compares = table->compares;
+	stats->resizes = table->resizes;
+	stats->resize_time = (double) table->resize_clock / CLOCKS_PER_SEC;
+
+	stats->load_factor = table->cap != 0 ? (float) table->used / table->cap : 0.0f;
+	stats->dead_slots = lepk__ht_count_dead(table->index, table->cap);
+	if (table->old_index != NULL) {
+		stats->dead_slots += lepk__ht_count_dead(table->old_index, table->old_cap);
+	}
+	stats->holes = table->entry_count - table->count;
+	stats->bytes = sizeof(LepkHt) +
+		table->entry_cap * ((table->hashes != NULL ? sizeof(size_t) : 0) + table->key_size + table->data_size) +
+		(table->cap + table->old_cap) * sizeof(uint32_t);
+}
+
+LEPKHT void lepk_ht_stats_report(const LepkHt *table, FILE *file) {
+	LepkHtStats stats;
+	lepk_ht_stats(table, &stats);
+
+	fprintf(file, "count: %lu, load factor: %.3f, dead slots: %lu, holes: %lu, bytes: %lu\n",
+			lepk_ht_count(table), stats.load_factor, stats.dead_slots, stats.holes, stats.bytes);
+	fprintf(file, "compares: %lu, resizes: %lu, resize time: %.6fs\n", stats.compares, stats.resizes, stats.resize_time);
+	fprintf(file, "probe length   hits       misses\n");
+	for (int i = 0; i < LEPK_HT_STATS_PROBES; i++) {
+		fprintf(file, "%3d%-11s %-10lu %lu\n", i + 1, i == LEPK_HT_STATS_PROBES - 1 ? "+" : "", stats.hit_probes[i], stats.miss_probes[i]);
+	}
+}
+#endif /* LEPK_HT_STATS */
+
+LEPKHT void lepk_ht_rehash_step(LepkHt *table, unsigned long step) {
+	table->rehash_step = step;
+	if (step == 0) {
+		lepk__ht_migrate(table, table->old_cap);
+	}
+}
+
+LEPKHT void lepk_ht_max_load(LepkHt *table, float max_load) {
+	assert(max_load > 0.0f && max_load < 1.0f && "Max load must be between 0 and 1.");
+	table->max_load = max_load;
+}
+
+LEPKHT void lepk_ht_reserve(LepkHt *table, unsigned long capacity) {
+	assert(table->mapping == NULL && "Mapped tables are read-only.");
+	if (capacity > table->entry_cap) {
+		lepk__ht_realloc_entries(table, capacity);
+	}
+	if (table->index == NULL) {
+		if (capacity > LEPK_HT_SMALL) {
+			lepk__ht_leave_small(table, capacity);
 		}
-		/* Loop through old entires and place then in the new list. */
-		for (size_t i = 0; i < table->cap; i++) {
-			Lepk__HtEntry *entry = &table->entires[i];
-			if (!entry->dead) {
-				Lepk__HtEntry *new_entry = lepk__ht_find_entry(new_entires, table->compare, entry->hash, new_cap, entry->key, table->key_size);
-				memcpy(new_entry, entry, sizeof(Lepk__HtEntry));
-			}
+		return;
+	}
+	size_t cap = lepk__ht_index_cap(table, capacity);
+	if (cap > table->cap) {
+		lepk__ht_reindex(table, cap);
+	}
+}
+
+LEPKHT void lepk_ht_shrink_to_fit(LepkHt *table) {
+	assert(table->mapping == NULL && "Mapped tables are read-only.");
+	if (table->count <= LEPK_HT_SMALL) {
+		if (table->index != NULL) {
+			lepk__ht_enter_small(table);
 		}
+		lepk__ht_realloc_entries(table, table->count > LEPK__HT_SMALL_MIN_CAP ? table->count : LEPK__HT_SMALL_MIN_CAP);
+		return;
+	}
 
-		table->cap = new_cap;
-		free(table->entires);
-		table->entires = new_entires;
+	lepk__ht_compact(table);
+	lepk__ht_realloc_entries(table, table->count > LEPK__HT_MIN_CAP ? table->count : LEPK__HT_MIN_CAP);
+	lepk__ht_reindex(table, lepk__ht_index_cap(table, table->count));
+}
+
+LEPKHT void lepk_ht_clear(LepkHt *table) {
+	assert(table->mapping == NULL && "Mapped tables are read-only.");
+	free(table->old_index);
+	table->old_index = NULL;
+	table->old_cap = 0;
+	table->migrate_index = 0;
+
+	if (table->index != NULL) {
+		memset(table->index, 0, table->cap * sizeof(uint32_t));
 	}
+	table->used = 0;
+	table->entry_count = 0;
+	table->count = 0;
+}
 
-	size_t hash = table->hash(key, table->key_size);
-	Lepk__HtEntry *entry = lepk__ht_find_entry(table->entires, table->compare, hash, table->cap, key, table->key_size);
-	if (entry->dead) {
-		table->count++;
+LEPKHT const void *lepk__ht_keys(LepkHt *table) {
+	lepk__ht_compact(table);
+	return table->keys;
+}
+
+LEPKHT void *lepk__ht_values(LepkHt *table) {
+	lepk__ht_compact(table);
+	return table->data;
+}
+
+/*
+ * Entry holding key in either index, entry_count if it's missing. Moves it into the current index if found in the old one.
+ * free_slot works like in lepk__ht_find_slot for the current index.
+ */
+static size_t lepk__ht_lookup(LepkHt *table, size_t hash, const void *key, size_t *free_slot) {
+	size_t slot = lepk__ht_find_slot(table, table->index, table->cap, hash, key, free_slot);
+	if (slot != table->cap) {
+		return table->index[slot] - LEPK__HT_INDEX_OFFSET;
+	}
+
+	if (table->old_index != NULL) {
+		slot = lepk__ht_find_slot(table, table->old_index, table->old_cap, hash, key, NULL);
+		if (slot != table->old_cap) {
+			uint32_t entry = table->old_index[slot] - LEPK__HT_INDEX_OFFSET;
+			table->old_index[slot] = LEPK__HT_INDEX_DEAD;
+			lepk__ht_index_entry(table, entry);
+			return entry;
+		}
 	}
 
-	entry->data = malloc(table->data_size);
-	memcpy(entry->data, data, table->data_size);
-	entry->key = malloc(table->key_size);
-	memcpy(entry->key, key, table->key_size);
-	entry->hash = hash;
-	entry->dead = false;
+	return table->entry_count;
 }
 
-LEPKHT void lepk__ht_get(LepkHt *table, const void *key, void *output) {
+/* Entry holding key, a new one with uninitialized data is added if it's missing. The key is only probed for once. */
+static size_t lepk__ht_insert(LepkHt *table, size_t hash, const void *key, bool *inserted) {
+	size_t slot;
+	size_t entry = lepk__ht_lookup(table, hash, key, &slot);
+	*inserted = entry == table->entry_count;
+	if (!*inserted) {
+		return entry;
+	}
+
+	/* Both of these move things around in the index. */
+	bool stale = false;
+	if (table->used >= (size_t) (table->cap * table->max_load)) {
+		lepk__ht_resize(table);
+		stale = true;
+	}
+	if (table->entry_count == table->entry_cap) {
+		lepk__ht_grow_entries(table);
+		stale = true;
+	}
+	if (stale) {
+		slot = lepk__ht_free_slot(table->index, table->cap, hash);
+	}
+
+	entry = table->entry_count++;
+	table->hashes[entry] = hash;
+	memcpy(table->keys + entry * table->key_size, key, table->key_size);
+	if (table->index[slot] == LEPK__HT_INDEX_EMPTY) {
+		table->used++;
+	}
+	table->index[slot] = entry + LEPK__HT_INDEX_OFFSET;
+	table->count++;
+
+	return entry;
+}
+
+/* Entry holding key, entry_count if it's missing. */
+static size_t lepk__ht_find_entry(LepkHt *table, const void *key) {
+	if (table->index == NULL) {
+		return lepk__ht_small_find(table, key);
+	}
+	return lepk__ht_lookup(table, lepk__ht_hash(table, key), key, NULL);
+}
+
+/* lepk__ht_insert for any table, small ones are switched to the hashed layout when they outgrow LEPK_HT_SMALL. */
+static size_t lepk__ht_insert_key(LepkHt *table, const void *key, bool *inserted) {
+	assert(table->mapping == NULL && "Mapped tables are read-only.");
+	if (table->index != NULL) {
+		return lepk__ht_insert(table, lepk__ht_hash(table, key), key, inserted);
+	}
+
+	size_t entry = lepk__ht_small_find(table, key);
+	*inserted = entry == table->entry_count;
+	if (!*inserted) {
+		return entry;
+	}
+
+	if (table->count == LEPK_HT_SMALL) {
+		lepk__ht_leave_small(table, table->count + 1);
+		return lepk__ht_insert(table, lepk__ht_hash(table, key), key, inserted);
+	}
+	if (table->entry_count == table->entry_cap) {
+		lepk__ht_grow_entries(table);
+	}
+
+	entry = table->entry_count++;
+	memcpy(table->keys + entry * table->key_size, key, table->key_size);
+	table->count++;
+	return entry;
+}
+
+static void lepk__ht_set_hashed(LepkHt *table, size_t hash, const void *key, const void *data) {
+	bool inserted;
+	size_t entry = lepk__ht_insert(table, hash, key, &inserted);
+	memcpy(table->data + entry * table->data_size, data, table->data_size);
+}
+
+LEPKHT void lepk__ht_set(LepkHt *table, const void *key, const void *data) {
+	lepk__ht_migrate(table, table->rehash_step);
+
+	bool inserted;
+	size_t entry = lepk__ht_insert_key(table, key, &inserted);
+	memcpy(table->data + entry * table->data_size, data, table->data_size);
+}
+
+LEPKHT bool lepk__ht_get(LepkHt *table, const void *key, void *output) {
 	assert(output != NULL && "Output pointer can't be NULL.");
-	Lepk__HtEntry *entry = lepk__ht_find_entry(table->entires, table->compare, table->hash(key, table->key_size), table->cap, key, table->key_size);
-	if (entry->dead) {
-		return;
+	lepk__ht_migrate(table, table->rehash_step);
+
+	size_t entry = lepk__ht_find_entry(table, key);
+	if (entry == table->entry_count) {
+		return false;
+	}
+	memcpy(output, table->data + entry * table->data_size, table->data_size);
+	return true;
+}
+
+LEPKHT void *lepk_ht_find(LepkHt *table, const void *key) {
+	lepk__ht_migrate(table, table->rehash_step);
+
+	size_t entry = lepk__ht_find_entry(table, key);
+	if (entry == table->entry_count) {
+		return NULL;
+	}
+	return table->data + entry * table->data_size;
+}
+
+LEPKHT void *lepk_ht_get_or_insert(LepkHt *table, const void *key, bool *inserted) {
+	lepk__ht_migrate(table, table->rehash_step);
+
+	bool _inserted;
+	size_t entry = lepk__ht_insert_key(table, key, &_inserted);
+	void *data = table->data + entry * table->data_size;
+	if (_inserted) {
+		memset(data, 0, table->data_size);
+	}
+	if (inserted != NULL) {
+		*inserted = _inserted;
+	}
+	return data;
+}
+
+LEPKHT void lepk_ht_upsert(LepkHt *table, const void *key, LepkHtUpsert callback, void *user) {
+	bool inserted;
+	void *data = lepk_ht_get_or_insert(table, key, &inserted);
+	callback(data, inserted, user);
+}
+
+/*
+ * Group prefetching: hash a group of keys and prefetch their index slots,
+ * then prefetch the entries the slots point at, and only then compare keys.
+ * The cache misses of a whole group overlap instead of being waited on one by one.
+ */
+static void lepk__ht_prefetch_batch(const LepkHt *table, const unsigned char *keys, size_t count, size_t *hashes) {
+	size_t mask = table->cap - 1;
+
+	for (size_t i = 0; i < count; i++) {
+		hashes[i] = lepk__ht_hash(table, keys + i * table->key_size);
+		LEPK__HT_PREFETCH(&table->index[hashes[i] & mask]);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		uint32_t slot = table->index[hashes[i] & mask];
+		if (slot >= LEPK__HT_INDEX_OFFSET) {
+			size_t entry = slot - LEPK__HT_INDEX_OFFSET;
+			LEPK__HT_PREFETCH(&table->hashes[entry]);
+			LEPK__HT_PREFETCH(table->keys + entry * table->key_size);
+			LEPK__HT_PREFETCH(table->data + entry * table->data_size);
+		}
+	}
+}
+
+LEPKHT unsigned long lepk_ht_get_batch(LepkHt *table, const void *keys, unsigned long count, void *outputs, bool *found) {
+	assert(outputs != NULL && "Output pointer can't be NULL.");
+	const unsigned char *_keys = keys;
+	unsigned char *_outputs = outputs;
+	size_t hashes[LEPK_HT_BATCH];
+	unsigned long found_count = 0;
+
+	for (size_t start = 0; start < count; start += LEPK_HT_BATCH) {
+		size_t group = count - start < LEPK_HT_BATCH ? count - start : LEPK_HT_BATCH;
+		lepk__ht_migrate(table, table->rehash_step * group);
+		if (table->index != NULL) {
+			lepk__ht_prefetch_batch(table, _keys + start * table->key_size, group, hashes);
+		}
+
+		for (size_t i = 0; i < group; i++) {
+			const unsigned char *key = _keys + (start + i) * table->key_size;
+			size_t entry = table->index != NULL ? lepk__ht_lookup(table, hashes[i], key, NULL) : lepk__ht_small_find(table, key);
+			bool hit = entry != table->entry_count;
+			if (hit) {
+				memcpy(_outputs + (start + i) * table->data_size, table->data + entry * table->data_size, table->data_size);
+				found_count++;
+			}
+			if (found != NULL) {
+				found[start + i] = hit;
+			}
+		}
+	}
+
+	return found_count;
+}
+
+LEPKHT void lepk_ht_set_batch(LepkHt *table, const void *keys, const void *data, unsigned long count) {
+	const unsigned char *_keys = keys;
+	const unsigned char *_data = data;
+	size_t hashes[LEPK_HT_BATCH];
+	assert(table->mapping == NULL && "Mapped tables are read-only.");
+
+	/* Grow past the small layout up front instead of halfway through the first group. */
+	if (table->index == NULL && table->count + count > LEPK_HT_SMALL) {
+		lepk__ht_leave_small(table, table->count + count);
+	}
+
+	for (size_t start = 0; start < count; start += LEPK_HT_BATCH) {
+		size_t group = count - start < LEPK_HT_BATCH ? count - start : LEPK_HT_BATCH;
+		lepk__ht_migrate(table, table->rehash_step * group);
+		if (table->index == NULL) {
+			for (size_t i = 0; i < group; i++) {
+				lepk__ht_set(table, _keys + (start + i) * table->key_size, _data + (start + i) * table->data_size);
+			}
+			continue;
+		}
+		lepk__ht_prefetch_batch(table, _keys + start * table->key_size, group, hashes);
+
+		for (size_t i = 0; i < group; i++) {
+			lepk__ht_set_hashed(table, hashes[i], _keys + (start + i) * table->key_size, _data + (start + i) * table->data_size);
+		}
 	}
-	memcpy(output, entry->data, table->data_size);
 }
 
 LEPKHT void lepk__ht_remove(LepkHt *table, const void *key, void *output) {
-	Lepk__HtEntry *entry = lepk__ht_find_entry(table->entires, table->compare, table->hash(key, table->key_size), table->cap, key, table->key_size);
-	if (entry->dead) {
+	assert(table->mapping == NULL && "Mapped tables are read-only.");
+	lepk__ht_migrate(table, table->rehash_step);
+
+	if (table->index == NULL) {
+		size_t entry = lepk__ht_small_find(table, key);
+		if (entry == table->entry_count) {
+			return;
+		}
+		if (output != NULL) {
+			memcpy(output, table->data + entry * table->data_size, table->data_size);
+		}
+
+		/* Few enough entries to close the gap right away, keeping insertion order. */
+		size_t after = table->entry_count - entry - 1;
+		memmove(table->keys + entry * table->key_size, table->keys + (entry + 1) * table->key_size, after * table->key_size);
+		memmove(table->data + entry * table->data_size, table->data + (entry + 1) * table->data_size, after * table->data_size);
+		table->entry_count--;
+		table->count--;
+		return;
+	}
+
+	size_t hash = lepk__ht_hash(table, key);
+	size_t slot = lepk__ht_find_slot(table, table->index, table->cap, hash, key, NULL);
+	uint32_t *index = table->index;
+	if (slot == table->cap && table->old_index != NULL) {
+		slot = lepk__ht_find_slot(table, table->old_index, table->old_cap, hash, key, NULL);
+		index = slot == table->old_cap ? NULL : table->old_index;
+	} else if (slot == table->cap) {
+		index = NULL;
+	}
+	if (index == NULL) {
 		return;
 	}
+
+	uint32_t entry = index[slot] - LEPK__HT_INDEX_OFFSET;
 	if (output != NULL) {
-		memcpy(output, entry->data, table->data_size);
+		memcpy(output, table->data + entry * table->data_size, table->data_size);
 	}
-	entry->dead = true;
+	index[slot] = LEPK__HT_INDEX_DEAD;
+	table->hashes[entry] = LEPK__HT_HASH_HOLE;
 	table->count--;
+
+	/* Holes at the end can simply be dropped. */
+	while (table->entry_count > 0 && table->hashes[table->entry_count - 1] == LEPK__HT_HASH_HOLE) {
+		table->entry_count--;
+	}
+}
+
+#ifdef LEPK_HT_POSIX
+/* Hash of a fixed key of key_size bytes. The last byte is zero so string hashes stop there. */
+static uint64_t lepk__ht_fingerprint(LepkHtHash hash, size_t key_size) {
+	/* Keys too big to build only come from corrupt files. */
+	unsigned char *key = key_size < SIZE_MAX ? malloc(key_size + 1) : NULL;
+	if (key == NULL) {
+		return 0;
+	}
+	for (size_t i = 0; i < key_size; i++) {
+		key[i] = (unsigned char) (i * 2 + 1);
+	}
+	key[key_size > 0 ? key_size - 1 : 0] = 0;
+
+	uint64_t fingerprint = hash(key, key_size);
+	free(key);
+	return fingerprint;
+}
+
+static size_t lepk__ht_file_align(size_t offset) {
+	return (offset + 7) & ~(size_t) 7;
+}
+
+/* Move offset past count items of size bytes, false if that doesn't fit in a size_t. */
+static bool lepk__ht_file_extend(size_t *offset, uint64_t count, uint64_t size) {
+	if (size != 0 && count > (SIZE_MAX - *offset) / size) {
+		return false;
+	}
+	*offset += count * size;
+	return true;
+}
+
+/* Where hashes, keys, data and index start in a saved table, followed by the file size. False if it's too big to address. */
+static bool lepk__ht_file_layout(const Lepk__HtFileHeader *header, size_t offsets[5]) {
+	uint64_t count = header->count;
+	size_t offset = sizeof(Lepk__HtFileHeader);
+	offsets[0] = offset;
+	if (!lepk__ht_file_extend(&offset, header->cap != 0 ? count : 0, sizeof(size_t))) {
+		return false;
+	}
+	offsets[1] = offset;
+	if (!lepk__ht_file_extend(&offset, count, header->key_size) || offset > SIZE_MAX - 7) {
+		return false;
+	}
+	offset = offsets[2] = lepk__ht_file_align(offset);
+	if (!lepk__ht_file_extend(&offset, count, header->data_size) || offset > SIZE_MAX - 7) {
+		return false;
+	}
+	offset = offsets[3] = lepk__ht_file_align(offset);
+	if (!lepk__ht_file_extend(&offset, header->cap, sizeof(uint32_t))) {
+		return false;
+	}
+	offsets[4] = offset;
+	return true;
+}
+
+/* Write size bytes of data at offset, zero filling from position up to it. data may be NULL if size is 0. */
+static bool lepk__ht_file_write(FILE *file, size_t *position, size_t offset, const void *data, size_t size) {
+	static const unsigned char zeros[8] = { 0 };
+	if (fwrite(zeros, 1, offset - *position, file) != offset - *position || (size != 0 && fwrite(data, 1, size, file) != size)) {
+		return false;
+	}
+	*position = offset + size;
+	return true;
+}
+
+LEPKHT bool lepk_ht_save(LepkHt *table, const char *filepath) {
+	/* Without holes or a migration in progress the arrays can be written as they are. */
+	lepk__ht_compact(table);
+	lepk__ht_migrate(table, table->old_cap);
+
+	Lepk__HtFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = LEPK__HT_FILE_MAGIC;
+	header.version = LEPK__HT_FILE_VERSION;
+	header.word_size = sizeof(size_t);
+	header.fingerprint = lepk__ht_fingerprint(table->hash, table->key_size);
+	header.key_size = table->key_size;
+	header.data_size = table->data_size;
+	header.count = table->count;
+	header.cap = table->cap;
+
+	size_t offsets[5];
+	if (!lepk__ht_file_layout(&header, offsets)) {
+		return false;
+	}
+	header.size = offsets[4];
+
+	FILE *file = fopen(filepath, "wb");
+	if (file == NULL) {
+		return false;
+	}
+
+	size_t position = 0;
+	bool ok = lepk__ht_file_write(file, &position, 0, &header, sizeof(header)) &&
+		lepk__ht_file_write(file, &position, offsets[0], table->hashes, offsets[1] - offsets[0]) &&
+		lepk__ht_file_write(file, &position, offsets[1], table->keys, table->count * table->key_size) &&
+		lepk__ht_file_write(file, &position, offsets[2], table->data, table->count * table->data_size) &&
+		lepk__ht_file_write(file, &position, offsets[3], table->index, table->cap * sizeof(uint32_t));
+
+	return fclose(file) == 0 && ok;
+}
+
+LEPKHT LepkHt *lepk_ht_map_load(LepkHtHash hash, LepkHtCompare compare, const char *filepath) {
+	int fd = open(filepath, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(Lepk__HtFileHeader)) {
+		close(fd);
+		return NULL;
+	}
+	size_t size = info.st_size;
+	unsigned char *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return NULL;
+	}
+
+	const Lepk__HtFileHeader *header = (const Lepk__HtFileHeader *) mapping;
+	size_t offsets[5];
+	bool valid = header->magic == LEPK__HT_FILE_MAGIC && header->version == LEPK__HT_FILE_VERSION &&
+		header->word_size == sizeof(size_t) && header->size == size &&
+		header->count <= UINT32_MAX - LEPK__HT_INDEX_OFFSET && (header->cap & (header->cap - 1)) == 0;
+	if (valid) {
+		valid = lepk__ht_file_layout(header, offsets) && offsets[4] == size &&
+			header->fingerprint == lepk__ht_fingerprint(hash, header->key_size);
+	}
+	/* Lookups trust the index, every slot has to be empty, dead or an entry, and probes have to end at an empty one. */
+	if (valid && header->cap != 0) {
+		const uint32_t *index = (const uint32_t *) (mapping + offsets[3]);
+		bool empty = false;
+		for (size_t i = 0; i < header->cap && valid; i++) {
+			empty |= index[i] == LEPK__HT_INDEX_EMPTY;
+			valid = index[i] < header->count + LEPK__HT_INDEX_OFFSET;
+		}
+		valid = valid && empty;
+	}
+	if (!valid) {
+		munmap(mapping, size);
+		return NULL;
+	}
+
+	LepkHt *table = lepk_ht_create(hash, compare, header->key_size, header->data_size);
+	free(table->hashes);
+	free(table->keys);
+	free(table->data);
+	free(table->index);
+
+	table->count = header->count;
+	table->entry_count = header->count;
+	table->entry_cap = header->count;
+	table->hashes = header->cap != 0 ? (size_t *) (mapping + offsets[0]) : NULL;
+	table->keys = mapping + offsets[1];
+	table->data = mapping + offsets[2];
+	table->cap = header->cap;
+	table->used = header->count;
+	table->index = header->cap != 0 ? (uint32_t *) (mapping + offsets[3]) : NULL;
+	table->mapping = mapping;
+	table->mapping_size = size;
+
+	return table;
 }
+#endif /* LEPK_HT_POSIX */
 
 LEPKHT unsigned long lepk_ht_hash_string(const void *key, unsigned long size) {
 	(void) size;
@@ -270,7 +1441,7 @@ LEPKHT int lepk_ht_compare_string(const void *a, const void *b, unsigned long si
 LEPKHT unsigned long lepk_ht_hash_generic(const void *key, unsigned long size) {
 	size_t hash = 2166136261lu;
 	for (size_t i = 0; i < size; i++) {
-		hash ^= *(uint8_t *) key + i;
+		hash ^= ((const uint8_t *) key)[i];
 		hash *= 16777619;
 	}
 	return hash;
@@ -0,0 +1,284 @@
+/* Version: 1.0 */
+
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2022 Linus Erik Pontus Kåreblom
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * String interning.
+ *
+ * Add:
+ *     #define LEPK_INTERN_IMPLEMENTATION
+ * in one C or C++ file, before #include "lepk_intern.h", to create the implementation.
+ *
+ * If LEPK_INTERN_STATIC is defined the implementation will be local to a single file only.
+ *
+ * Use:
+ *     #define LEPK_INTERN_CHUNK_SIZE [int]
+ * to define the size of the arena chunks strings are copied into.
+ *
+ * Built on lepk_ht.h, which needs its implementation somewhere too.
+ */
+
+/*
+ * === Documentation ===
+ * Usage:
+ * LepkIntern *interner = lepk_intern_create();
+ * unsigned int a = lepk_intern(interner, "hello", 5);
+ * unsigned int b = lepk_intern_cstr(interner, "hello");
+ * assert(a == b);
+ * printf("%s\n", lepk_intern_string(interner, a));
+ * lepk_intern_destroy(interner);
+ *
+ * Strings are copied into the interner and NUL terminated, the pointers stay valid until it's destroyed.
+ * IDs are handed out in order starting at 0.
+ */
+
+#ifndef LEPK_INTERN_H
+#define LEPK_INTERN_H
+
+#ifndef LEPK_INTERN_STATIC
+#define LEPKINTERN extern
+#else /* LEPK_INTERN_STATIC */
+#define LEPKINTERN static
+#endif /* LEPK_INTERN_STATIC */
+
+#include "lepk_ht.h"
+
+/* Returned when looking up a string that isn't interned. */
+#define LEPK_INTERN_NONE 0xffffffffu
+
+/* String interner. */
+typedef struct LepkIntern LepkIntern;
+
+/* Create an interner. */
+LEPKINTERN LepkIntern *lepk_intern_create(void);
+/* Destroy an interner and every string in it. */
+LEPKINTERN void lepk_intern_destroy(LepkIntern *interner);
+
+/* Intern length bytes of string and return its ID. */
+LEPKINTERN unsigned int lepk_intern(LepkIntern *interner, const char *string, unsigned long length);
+/* Intern a NUL terminated string and return its ID. */
+LEPKINTERN unsigned int lepk_intern_cstr(LepkIntern *interner, const char *string);
+/* ID of string, LEPK_INTERN_NONE if it isn't interned. */
+LEPKINTERN unsigned int lepk_intern_find(LepkIntern *interner, const char *string, unsigned long length);
+
+/* NUL terminated string with ID. */
+LEPKINTERN const char *lepk_intern_string(const LepkIntern *interner, unsigned int id);
+/* Length of string with ID. */
+LEPKINTERN unsigned long lepk_intern_length(const LepkIntern *interner, unsigned int id);
+/* Amount of interned strings. */
+LEPKINTERN unsigned long lepk_intern_count(const LepkIntern *interner);
+
+#ifdef LEPK_INTERN_TEST
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+static void lepk_intern_test(void) {
+	LepkIntern *interner = lepk_intern_create();
+
+	unsigned int hello = lepk_intern(interner, "hello world", 5);
+	unsigned int world = lepk_intern_cstr(interner, "world");
+	assert(hello == 0 && world == 1 && "lepk_intern failed.");
+	assert(lepk_intern_cstr(interner, "hello") == hello && "lepk_intern deduplication failed.");
+	assert(lepk_intern_find(interner, "hell", 4) == LEPK_INTERN_NONE && "lepk_intern_find failed.");
+	assert(strcmp(lepk_intern_string(interner, world), "world") == 0 && lepk_intern_length(interner, hello) == 5 && "lepk_intern_string failed.");
+
+	/* Enough strings to fill a couple of arena chunks. */
+	char buffer[32];
+	for (int i = 0; i < 20000; i++) {
+		int length = sprintf(buffer, "identifier_%d", i);
+		assert(lepk_intern(interner, buffer, length) == (unsigned int) i + 2 && "lepk_intern failed.");
+	}
+	assert(strcmp(lepk_intern_string(interner, 2 + 1234), "identifier_1234") == 0 && "lepk_intern_string failed.");
+	assert(lepk_intern_count(interner) == 20002 && "lepk_intern_count failed.");
+
+	lepk_intern_destroy(interner);
+}
+
+#endif /* LEPK_INTERN_TEST */
+
+#ifdef LEPK_INTERN_IMPLEMENTATION
+#include <malloc.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#undef LEPKINTERN
+#ifndef LEPK_INTERN_STATIC
+#define LEPKINTERN
+#else /* LEPK_INTERN_STATIC */
+#define LEPKINTERN static
+#endif /* LEPK_INTERN_STATIC */
+
+#ifndef LEPK_INTERN_CHUNK_SIZE
+#define LEPK_INTERN_CHUNK_SIZE (64 * 1024)
+#endif /* LEPK_INTERN_CHUNK_SIZE */
+
+/* Arena chunk, strings are copied into data back to back. */
+typedef struct Lepk__InternChunk Lepk__InternChunk;
+struct Lepk__InternChunk {
+	Lepk__InternChunk *next;
+	size_t used;
+	size_t cap;
+	char data[];
+};
+
+/* Key stored in the hash table, hash is computed once when the string is first seen. */
+typedef struct {
+	const char *string;
+	size_t length;
+	size_t hash;
+} Lepk__InternKey;
+
+struct LepkIntern {
+	/* Lepk__InternKey -> ID. */
+	LepkHt *table;
+	/* ID -> Lepk__InternKey. */
+	Lepk__InternKey *strings;
+	size_t count;
+	size_t cap;
+	/* Current chunk first. */
+	Lepk__InternChunk *chunks;
+};
+
+static unsigned long lepk__intern_hash(const void *key, unsigned long size) {
+	(void) size;
+	return ((const Lepk__InternKey *) key)->hash;
+}
+
+static int lepk__intern_compare(const void *a, const void *b, unsigned long size) {
+	(void) size;
+	const Lepk__InternKey *x = a;
+	const Lepk__InternKey *y = b;
+	if (x->length != y->length) {
+		return 1;
+	}
+	return memcmp(x->string, y->string, x->length);
+}
+
+static Lepk__InternKey lepk__intern_key(const char *string, unsigned long length) {
+	/* Same FNV-1a as lepk_ht_hash_string, without the strlen. */
+	size_t hash = 2166136261lu;
+	for (unsigned long i = 0; i < length; i++) {
+		hash ^= (unsigned char) string[i];
+		hash *= 16777619;
+	}
+	return (Lepk__InternKey) { string, length, hash };
+}
+
+/* Copy string into the arena, NUL terminated. */
+static const char *lepk__intern_copy(LepkIntern *interner, const char *string, size_t length) {
+	Lepk__InternChunk *chunk = interner->chunks;
+	if (chunk == NULL || chunk->cap - chunk->used < length + 1) {
+		size_t cap = length + 1 > LEPK_INTERN_CHUNK_SIZE ? length + 1 : LEPK_INTERN_CHUNK_SIZE;
+		chunk = malloc(sizeof(Lepk__InternChunk) + cap);
+		chunk->used = 0;
+		chunk->cap = cap;
+		chunk->next = interner->chunks;
+		interner->chunks = chunk;
+	}
+
+	char *copy = chunk->data + chunk->used;
+	memcpy(copy, string, length);
+	copy[length] = '\0';
+	chunk->used += length + 1;
+	return copy;
+}
+
+LEPKINTERN LepkIntern *lepk_intern_create(void) {
+	LepkIntern *interner = malloc(sizeof(LepkIntern));
+	interner->table = lepk_ht_create(lepk__intern_hash, lepk__intern_compare, sizeof(Lepk__InternKey), sizeof(uint32_t));
+	interner->count = 0;
+	interner->cap = 64;
+	interner->strings = malloc(interner->cap * sizeof(Lepk__InternKey));
+	interner->chunks = NULL;
+	return interner;
+}
+
+LEPKINTERN void lepk_intern_destroy(LepkIntern *interner) {
+	while (interner->chunks != NULL) {
+		Lepk__InternChunk *next = interner->chunks->next;
+		free(interner->chunks);
+		interner->chunks = next;
+	}
+	lepk_ht_destroy(interner->table);
+	free(interner->strings);
+	free(interner);
+}
+
+LEPKINTERN unsigned int lepk_intern_find(LepkIntern *interner, const char *string, unsigned long length) {
+	Lepk__InternKey key = lepk__intern_key(string, length);
+	uint32_t id = LEPK_INTERN_NONE;
+	lepk__ht_get(interner->table, &key, &id);
+	return id;
+}
+
+LEPKINTERN unsigned int lepk_intern(LepkIntern *interner, const char *string, unsigned long length) {
+	Lepk__InternKey key = lepk__intern_key(string, length);
+	bool inserted;
+	uint32_t *id = lepk_ht_get_or_insert(interner->table, &key, &inserted);
+	if (!inserted) {
+		return *id;
+	}
+
+	assert(interner->count < LEPK_INTERN_NONE && "lepk_intern ran out of IDs.");
+	if (interner->count == interner->cap) {
+		interner->cap *= 2;
+		interner->strings = realloc(interner->strings, interner->cap * sizeof(Lepk__InternKey));
+	}
+
+	/*
+	 * The table stored the caller's pointer, point it at the copy instead. Nothing is ever removed,
+	 * so entries never move and the key sits at the same index as the ID.
+	 */
+	key.string = lepk__intern_copy(interner, string, length);
+	size_t entry = id - (uint32_t *) lepk__ht_values(interner->table);
+	((Lepk__InternKey *) lepk__ht_keys(interner->table))[entry].string = key.string;
+
+	*id = interner->count++;
+	interner->strings[*id] = key;
+	return *id;
+}
+
+LEPKINTERN unsigned int lepk_intern_cstr(LepkIntern *interner, const char *string) {
+	return lepk_intern(interner, string, strlen(string));
+}
+
+LEPKINTERN const char *lepk_intern_string(const LepkIntern *interner, unsigned int id) {
+	assert(id < interner->count && "Invalid intern ID.");
+	return interner->strings[id].string;
+}
+
+LEPKINTERN unsigned long lepk_intern_length(const LepkIntern *interner, unsigned int id) {
+	assert(id < interner->count && "Invalid intern ID.");
+	return interner->strings[id].length;
+}
+
+LEPKINTERN unsigned long lepk_intern_count(const LepkIntern *interner) {
+	return interner->count;
+}
+#endif /*LEPK_INTERN_IMPLEMENTATION*/
+#endif /* LEPK_INTERN_H */
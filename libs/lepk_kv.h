@@ -0,0 +1,707 @@
+/* Version: 1.0 */
+
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2022 Linus Erik Pontus Kåreblom
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Persistent key-value store with a write-ahead log.
+ *
+ * Add:
+ *     #define LEPK_KV_IMPLEMENTATION
+ * in one C or C++ file, before #include "lepk_kv.h", to create the implementation.
+ *
+ * If LEPK_KV_STATIC is defined the implementation will be local to a single file only.
+ *
+ * Use:
+ *     #define LEPK_KV_COMPACT_MIN [int]
+ * to set how many bytes the log has to reach, and outgrow the snapshot by, before a commit compacts it. 16 MiB if not defined.
+ *
+ * Requires lepk_ht.h and lepk_file.h with LEPK_FILE_POSIX, its atomic writes and groups only exist on POSIX systems.
+ * In strict ISO C mode, like -std=c99, define _GNU_SOURCE before the first system header.
+ */
+
+/*
+ * === Documentation ===
+ * Keys and values are byte strings, indexed in memory by a lepk_ht. A store at "path" keeps two files:
+ * path.log      Every set and remove, appended through a LepkFileWriter, each record with a CRC-32C.
+ * path.snap     Every pair at the last compaction.
+ * Opening maps the snapshot and indexes its pairs where they lie, without copying them, then replays the log on top.
+ * Replay stops at the first record that is cut short or fails its checksum, which is where a crash interrupted writing.
+ *
+ * Mutations are made durable by commits, each one a single flush or sync however many mutations it covers.
+ * A store commits by itself every group mutations, 1 committing every mutation before it returns.
+ * Larger groups trade the last few mutations before a crash for fewer syncs. durability decides what a commit does:
+ * LEPK_FILE_DURABILITY_NONE     Hands the log to the OS, committed mutations survive the program crashing.
+ * LEPK_FILE_DURABILITY_DATA     Syncs the log, committed mutations survive losing power.
+ * LEPK_FILE_DURABILITY_FULL     The same as DATA.
+ * Past NONE a new log or snapshot is always put in place with a directory sync, once per creation or compaction,
+ * since losing its rename would lose every commit made to it since.
+ *
+ * Compacting writes every pair to a new snapshot and starts an empty log. It happens on commit once the log
+ * is over LEPK_KV_COMPACT_MIN and bigger than the snapshot, or on lepk_kv_compact. The snapshot is built
+ * in memory first, so compacting needs room for one more copy of the pairs.
+ *
+ * Usage:
+ * LepkKv *kv = lepk_kv_open("sessions", LEPK_FILE_DURABILITY_DATA, 32, NULL);
+ * lepk_kv_set(kv, "user:1", 6, token, token_length);
+ * unsigned long length;
+ * const char *stored = lepk_kv_get(kv, "user:1", 6, &length);
+ * lepk_kv_close(kv);
+ */
+
+#ifndef LEPK_KV_H
+#define LEPK_KV_H
+
+#ifndef LEPK_KV_STATIC
+#define LEPKKV extern
+#else /* LEPK_KV_STATIC */
+#define LEPKKV static
+#endif /* LEPK_KV_STATIC */
+
+#include <stdbool.h>
+
+#include "lepk_ht.h"
+#include "lepk_file.h"
+
+#ifndef LEPK_FILE_POSIX
+#error "lepk_kv.h needs lepk_file.h's POSIX functions, define _GNU_SOURCE before the first system header."
+#endif /* LEPK_FILE_POSIX */
+
+/* Key-value store. */
+typedef struct LepkKv LepkKv;
+
+/*
+ * Open the store at filepath, creating it if it doesn't exist, committing every group mutations.
+ * NULL return value means function failed, read status for more specific error.
+ */
+LEPKKV LepkKv *lepk_kv_open(const char *filepath, LepkFileDurability durability, unsigned long group, LepkFileStatus *status);
+/* Commit and close the store. The store is freed even if the commit fails. */
+LEPKKV LepkFileStatus lepk_kv_close(LepkKv *kv);
+
+/* Retrieve pair count from store. */
+LEPKKV unsigned long lepk_kv_count(const LepkKv *kv);
+/* Set the pair in store. If it can't be logged the store is left as it was. */
+LEPKKV LepkFileStatus lepk_kv_set(LepkKv *kv, const void *key, unsigned long key_length, const void *value, unsigned long value_length);
+/* Value stored for key, NULL if key isn't in the store. value_length is optional. Valid until the store is modified. */
+LEPKKV const void *lepk_kv_get(LepkKv *kv, const void *key, unsigned long key_length, unsigned long *value_length);
+/* Remove pair from store. Removing a missing key does nothing, and so does a remove that can't be logged. */
+LEPKKV LepkFileStatus lepk_kv_remove(LepkKv *kv, const void *key, unsigned long key_length);
+/*
+ * Pair after the one iterator points at, start with iterator set to 0. Returns false after the last pair.
+ * The store must not be modified while iterating.
+ */
+LEPKKV bool lepk_kv_next(LepkKv *kv, unsigned long *iterator, const void **key, unsigned long *key_length, const void **value, unsigned long *value_length);
+
+/* Make every mutation so far durable. */
+LEPKKV LepkFileStatus lepk_kv_commit(LepkKv *kv);
+/*
+ * Write every pair to a new snapshot and start an empty log. If it fails once the snapshot is in place the
+ * store can still be read, but mutations fail with LEPK_FILE_STATUS_WRITE_FAILED until it's reopened.
+ */
+LEPKKV LepkFileStatus lepk_kv_compact(LepkKv *kv);
+
+#ifdef LEPK_KV_TEST
+
+#include <assert.h>
+#include <string.h>
+
+static void lepk_kv_test(void) {
+	LepkFileStatus status;
+	remove("kv_test.log");
+	remove("kv_test.snap");
+
+	LepkKv *kv = lepk_kv_open("kv_test", LEPK_FILE_DURABILITY_NONE, 4, &status);
+	assert(kv != NULL && status == LEPK_FILE_STATUS_OK && lepk_kv_count(kv) == 0 && "lepk_kv_open failed.");
+
+	char key[16];
+	for (int i = 0; i < 100; i++) {
+		int length = sprintf(key, "key%d", i);
+		status = lepk_kv_set(kv, key, length, &i, sizeof(int));
+		assert(status == LEPK_FILE_STATUS_OK && "lepk_kv_set failed.");
+	}
+	lepk_kv_set(kv, "key7", 4, "seven", 5);
+	lepk_kv_remove(kv, "key8", 4);
+	lepk_kv_remove(kv, "missing", 7);
+	lepk_kv_set(kv, "", 0, "", 0);
+
+	unsigned long length;
+	const char *value = lepk_kv_get(kv, "key7", 4, &length);
+	assert(value != NULL && length == 5 && memcmp(value, "seven", 5) == 0 && "lepk_kv_get failed.");
+	assert(lepk_kv_get(kv, "key8", 4, NULL) == NULL && lepk_kv_count(kv) == 100 && "lepk_kv_remove failed.");
+	lepk_kv_close(kv);
+
+	/* Once from the log, once from a snapshot and once from a snapshot and a log with a torn record at the end. */
+	for (int run = 0; run < 3; run++) {
+		kv = lepk_kv_open("kv_test", LEPK_FILE_DURABILITY_FULL, 1, &status);
+		assert(kv != NULL && status == LEPK_FILE_STATUS_OK && lepk_kv_count(kv) == 100ul + run && "lepk_kv_open failed.");
+		value = lepk_kv_get(kv, "key42", 5, &length);
+		assert(value != NULL && length == sizeof(int) && memcmp(value, &(int) { 42 }, sizeof(int)) == 0 && "lepk_kv_open failed.");
+		value = lepk_kv_get(kv, "key7", 4, &length);
+		assert(value != NULL && length == 5 && lepk_kv_get(kv, "key8", 4, NULL) == NULL && lepk_kv_get(kv, "", 0, &length) != NULL && length == 0 && "lepk_kv_open failed.");
+
+		unsigned long iterator = 0;
+		unsigned long pairs = 0;
+		const void *pair_key;
+		unsigned long key_length;
+		while (lepk_kv_next(kv, &iterator, &pair_key, &key_length, (const void **) &value, &length)) {
+			pairs++;
+		}
+		assert(pairs == lepk_kv_count(kv) && "lepk_kv_next failed.");
+
+		if (run == 0) {
+			status = lepk_kv_compact(kv);
+			assert(status == LEPK_FILE_STATUS_OK && lepk_kv_get(kv, "key99", 5, NULL) != NULL && "lepk_kv_compact failed.");
+		}
+		sprintf(key, "new%d", run);
+		lepk_kv_set(kv, key, strlen(key), "", 0);
+		lepk_kv_close(kv);
+		if (run == 1) {
+			lepk_file_append("kv_test.log", "\x10\x00\x00\x00torn", 8, LEPK_FILE_MODE_BINARY);
+		}
+	}
+
+	remove("kv_test.log");
+	remove("kv_test.snap");
+}
+
+#endif /* LEPK_KV_TEST */
+#ifdef LEPK_KV_IMPLEMENTATION
+#include <malloc.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#undef LEPKKV
+#ifndef LEPK_KV_STATIC
+#define LEPKKV
+#else /* LEPK_KV_STATIC */
+#define LEPKKV static
+#endif /* LEPK_KV_STATIC */
+
+#ifndef LEPK_KV_COMPACT_MIN
+#define LEPK_KV_COMPACT_MIN (16 << 20)
+#endif /* LEPK_KV_COMPACT_MIN */
+
+/* "LPKL" and "LPKS" in little endian. */
+#define LEPK__KV_LOG_MAGIC 0x4c4b504c
+#define LEPK__KV_SNAPSHOT_MAGIC 0x534b504c
+#define LEPK__KV_VERSION 1
+
+/* Starts the log. A log from an older generation than the snapshot is already in it. */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t generation;
+} Lepk__KvLogHeader;
+
+/* Followed by the key and the value. */
+typedef struct {
+	/* CRC-32C of the rest of the record, key and value included. */
+	uint32_t checksum;
+	uint32_t operation;
+	uint32_t key_length;
+	uint32_t value_length;
+} Lepk__KvRecord;
+
+enum {
+	LEPK__KV_SET = 1,
+	LEPK__KV_REMOVE = 2,
+};
+
+/* Followed by count pairs, each a key length, a value length, the key and the value. */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t generation;
+	uint64_t count;
+} Lepk__KvSnapshotHeader;
+
+/* Index key, pointing at the key's bytes. */
+typedef struct {
+	const char *data;
+	size_t length;
+} Lepk__KvKey;
+
+/* Index data. */
+typedef struct {
+	const char *data;
+	size_t length;
+	/* Heap block holding key and value, NULL if they lie in the snapshot. */
+	char *block;
+} Lepk__KvValue;
+
+struct LepkKv {
+	LepkHt *index;
+	LepkFileView snapshot;
+	bool has_snapshot;
+
+	LepkFileWriter *log;
+	uint64_t generation;
+	LepkFileDurability durability;
+	size_t group;
+	/* Mutations since the last commit. */
+	size_t uncommitted;
+
+	char *log_path;
+	char *snapshot_path;
+};
+
+static uint32_t lepk__kv_record_checksum(const Lepk__KvRecord *record, const void *key, const void *value) {
+	uint32_t crc = lepk_file_crc32c(0, &record->operation, sizeof(Lepk__KvRecord) - sizeof(uint32_t));
+	crc = lepk_file_crc32c(crc, key, record->key_length);
+	return lepk_file_crc32c(crc, value, record->value_length);
+}
+
+static unsigned long lepk__kv_hash(const void *key, unsigned long size) {
+	(void) size;
+	const Lepk__KvKey *slice = key;
+	return lepk_ht_hash_generic(slice->data, slice->length);
+}
+
+static int lepk__kv_compare(const void *a, const void *b, unsigned long size) {
+	(void) size;
+	const Lepk__KvKey *first = a;
+	const Lepk__KvKey *second = b;
+	if (first->length != second->length) {
+		return first->length < second->length ? -1 : 1;
+	}
+	return memcmp(first->data, second->data, first->length);
+}
+
+static char *lepk__kv_path(const char *filepath, const char *extension) {
+	char *path = malloc(strlen(filepath) + strlen(extension) + 1);
+	if (path != NULL) {
+		strcpy(path, filepath);
+		strcat(path, extension);
+	}
+	return path;
+}
+
+/* Drop the pair stored for key, if any. */
+static void lepk__kv_erase(LepkKv *kv, const Lepk__KvKey *key) {
+	Lepk__KvValue old;
+	if (lepk__ht_get(kv->index, key, &old)) {
+		lepk__ht_remove(kv->index, key, NULL);
+		free(old.block);
+	}
+}
+
+/* Copy the pair onto the heap and index it. key and value may point into the pair they replace. */
+static void lepk__kv_insert(LepkKv *kv, const void *key, size_t key_length, const void *value, size_t value_length) {
+	char *block = malloc(key_length + value_length + 1);
+	if (key_length != 0) {
+		memcpy(block, key, key_length);
+	}
+	if (value_length != 0) {
+		memcpy(block + key_length, value, value_length);
+	}
+
+	Lepk__KvKey stored_key = { block, key_length };
+	Lepk__KvValue stored_value = { block + key_length, value_length, block };
+	lepk__kv_erase(kv, &stored_key);
+	lepk__ht_set(kv->index, &stored_key, &stored_value);
+}
+
+/* Index every pair of a mapped snapshot where it lies. Returns false if the snapshot is malformed. */
+static bool lepk__kv_index_snapshot(LepkKv *kv, const LepkFileView *snapshot) {
+	Lepk__KvSnapshotHeader header;
+	if (snapshot->length < sizeof(header)) {
+		return false;
+	}
+	memcpy(&header, snapshot->data, sizeof(header));
+	if (header.magic != LEPK__KV_SNAPSHOT_MAGIC || header.version != LEPK__KV_VERSION) {
+		return false;
+	}
+	/* Every pair takes at least its two lengths, a larger count is corrupt and would only reserve a huge index. */
+	if (header.count > (snapshot->length - sizeof(header)) / (2 * sizeof(uint32_t))) {
+		return false;
+	}
+
+	lepk_ht_reserve(kv->index, header.count);
+	uint64_t offset = sizeof(header);
+	for (uint64_t i = 0; i < header.count; i++) {
+		uint32_t lengths[2];
+		if (snapshot->length - offset < sizeof(lengths)) {
+			return false;
+		}
+		memcpy(lengths, snapshot->data + offset, sizeof(lengths));
+		offset += sizeof(lengths);
+		if (snapshot->length - offset < (uint64_t) lengths[0] + lengths[1]) {
+			return false;
+		}
+
+		Lepk__KvKey key = { snapshot->data + offset, lengths[0] };
+		Lepk__KvValue value = { snapshot->data + offset + lengths[0], lengths[1], NULL };
+		lepk__ht_set(kv->index, &key, &value);
+		offset += (uint64_t) lengths[0] + lengths[1];
+	}
+
+	kv->generation = header.generation;
+	return true;
+}
+
+/* Apply every intact record of a log. Returns how many bytes of it are intact, 0 if it doesn't belong to the snapshot. */
+static uint64_t lepk__kv_replay(LepkKv *kv, const LepkFileView *log) {
+	Lepk__KvLogHeader header;
+	if (log->length < sizeof(header)) {
+		return 0;
+	}
+	memcpy(&header, log->data, sizeof(header));
+	if (header.magic != LEPK__KV_LOG_MAGIC || header.version != LEPK__KV_VERSION || header.generation != kv->generation) {
+		return 0;
+	}
+
+	uint64_t offset = sizeof(header);
+	for (;;) {
+		Lepk__KvRecord record;
+		if (log->length - offset < sizeof(record)) {
+			return offset;
+		}
+		memcpy(&record, log->data + offset, sizeof(record));
+		const char *key = log->data + offset + sizeof(record);
+		if (log->length - offset - sizeof(record) < (uint64_t) record.key_length + record.value_length) {
+			return offset;
+		}
+		if (record.checksum != lepk__kv_record_checksum(&record, key, key + record.key_length)) {
+			return offset;
+		}
+
+		if (record.operation == LEPK__KV_SET) {
+			lepk__kv_insert(kv, key, record.key_length, key + record.key_length, record.value_length);
+		} else if (record.operation == LEPK__KV_REMOVE) {
+			Lepk__KvKey probe = { key, record.key_length };
+			lepk__kv_erase(kv, &probe);
+		} else {
+			return offset;
+		}
+		offset += sizeof(record) + record.key_length + record.value_length;
+	}
+}
+
+/*
+ * Durability a new log or snapshot is put in place with. Syncing the data isn't enough past NONE,
+ * a rename lost to a power cut would take every commit made to the file since with it.
+ */
+static LepkFileDurability lepk__kv_install_durability(const LepkKv *kv) {
+	return kv->durability == LEPK_FILE_DURABILITY_NONE ? LEPK_FILE_DURABILITY_NONE : LEPK_FILE_DURABILITY_FULL;
+}
+
+/* Replace the log with header and the first length bytes of data, then open it for appending. */
+static LepkFileStatus lepk__kv_start_log(LepkKv *kv, const char *data, uint64_t length) {
+	Lepk__KvLogHeader header = { LEPK__KV_LOG_MAGIC, LEPK__KV_VERSION, kv->generation };
+	LepkFileStatus status;
+	if (length == 0) {
+		status = lepk_file_write_atomic(kv->log_path, (const char *) &header, sizeof(header), lepk__kv_install_durability(kv));
+	} else {
+		status = lepk_file_write_atomic(kv->log_path, data, length, lepk__kv_install_durability(kv));
+	}
+	if (status != LEPK_FILE_STATUS_OK) {
+		return status;
+	}
+
+	kv->log = lepk_file_writer_open(kv->log_path, true, 0, &status);
+	return status;
+}
+
+/* Append a record to the log. */
+static LepkFileStatus lepk__kv_log(LepkKv *kv, uint32_t operation, const void *key, size_t key_length, const void *value, size_t value_length) {
+	if (kv->log == NULL) {
+		return LEPK_FILE_STATUS_WRITE_FAILED;
+	}
+	assert(key_length <= UINT32_MAX && value_length <= UINT32_MAX && "Keys and values must be shorter than 4 GiB.");
+
+	Lepk__KvRecord record = { 0, operation, (uint32_t) key_length, (uint32_t) value_length };
+	record.checksum = lepk__kv_record_checksum(&record, key, value);
+	LepkFileFragment fragments[] = {
+		{ &record, sizeof(record) },
+		{ key, key_length },
+		{ value, value_length },
+	};
+	return lepk_file_writer_writev(kv->log, fragments, 3);
+}
+
+/* Count a logged mutation, committing if the group is full. */
+static LepkFileStatus lepk__kv_mutated(LepkKv *kv) {
+	if (++kv->uncommitted >= kv->group) {
+		return lepk_kv_commit(kv);
+	}
+	return LEPK_FILE_STATUS_OK;
+}
+
+/* Free every heap block of index and the index. */
+static void lepk__kv_free_index(LepkHt *index) {
+	const Lepk__KvValue *values = lepk__ht_values(index);
+	for (size_t i = 0; i < lepk_ht_count(index); i++) {
+		free(values[i].block);
+	}
+	lepk_ht_destroy(index);
+}
+
+static void lepk__kv_free(LepkKv *kv) {
+	if (kv->index != NULL) {
+		lepk__kv_free_index(kv->index);
+	}
+	if (kv->has_snapshot) {
+		lepk_file_unmap(&kv->snapshot);
+	}
+	free(kv->log_path);
+	free(kv->snapshot_path);
+	free(kv);
+}
+
+LEPKKV LepkKv *lepk_kv_open(const char *filepath, LepkFileDurability durability, unsigned long group, LepkFileStatus *status) {
+	LepkKv *kv = calloc(1, sizeof(LepkKv));
+	if (kv == NULL) {
+		if (status != NULL) {
+			*status = LEPK_FILE_STATUS_OUT_OF_MEMORY;
+		}
+		return NULL;
+	}
+	kv->durability = durability;
+	kv->group = group != 0 ? group : 1;
+	kv->log_path = lepk__kv_path(filepath, ".log");
+	kv->snapshot_path = lepk__kv_path(filepath, ".snap");
+	kv->index = lepk_ht_create(lepk__kv_hash, lepk__kv_compare, sizeof(Lepk__KvKey), sizeof(Lepk__KvValue));
+
+	LepkFileStatus result = LEPK_FILE_STATUS_OK;
+	if (kv->log_path == NULL || kv->snapshot_path == NULL) {
+		result = LEPK_FILE_STATUS_OUT_OF_MEMORY;
+	}
+
+	/* Pairs in the snapshot are indexed in place, so it's read in lazily as they're looked up. */
+	if (result == LEPK_FILE_STATUS_OK) {
+		LepkFileStatus mapped = lepk_file_map(kv->snapshot_path, LEPK_FILE_ADVICE_RANDOM, &kv->snapshot);
+		if (mapped == LEPK_FILE_STATUS_OK) {
+			kv->has_snapshot = true;
+			if (!lepk__kv_index_snapshot(kv, &kv->snapshot)) {
+				result = LEPK_FILE_STATUS_READ_FAILED;
+			}
+		} else if (mapped != LEPK_FILE_STATUS_UNABLE_TO_OPEN_CREATE) {
+			result = mapped;
+		}
+	}
+
+	if (result == LEPK_FILE_STATUS_OK) {
+		LepkFileView log;
+		if (lepk_file_map(kv->log_path, LEPK_FILE_ADVICE_SEQUENTIAL, &log) == LEPK_FILE_STATUS_OK) {
+			uint64_t intact = lepk__kv_replay(kv, &log);
+			/* Cut off whatever a crash left half written, so new records aren't appended after it. */
+			if (intact != 0 && intact == log.length) {
+				kv->log = lepk_file_writer_open(kv->log_path, true, 0, &result);
+			} else {
+				result = lepk__kv_start_log(kv, log.data, intact);
+			}
+			lepk_file_unmap(&log);
+		} else {
+			result = lepk__kv_start_log(kv, NULL, 0);
+		}
+	}
+
+	if (result != LEPK_FILE_STATUS_OK) {
+		if (kv->log != NULL) {
+			lepk_file_writer_close(kv->log);
+		}
+		lepk__kv_free(kv);
+		kv = NULL;
+	}
+	if (status != NULL) {
+		*status = result;
+	}
+	return kv;
+}
+
+LEPKKV LepkFileStatus lepk_kv_close(LepkKv *kv) {
+	LepkFileStatus status = lepk_kv_commit(kv);
+	if (kv->log != NULL && lepk_file_writer_close(kv->log) != LEPK_FILE_STATUS_OK) {
+		status = LEPK_FILE_STATUS_WRITE_FAILED;
+	}
+	lepk__kv_free(kv);
+	return status;
+}
+
+LEPKKV unsigned long lepk_kv_count(const LepkKv *kv) {
+	return lepk_ht_count(kv->index);
+}
+
+LEPKKV LepkFileStatus lepk_kv_set(LepkKv *kv, const void *key, unsigned long key_length, const void *value, unsigned long value_length) {
+	/* Indexed only once logged, so a failed set isn't visible. key and value may point into the pair being replaced. */
+	LepkFileStatus status = lepk__kv_log(kv, LEPK__KV_SET, key, key_length, value, value_length);
+	if (status != LEPK_FILE_STATUS_OK) {
+		return status;
+	}
+	lepk__kv_insert(kv, key, key_length, value, value_length);
+	return lepk__kv_mutated(kv);
+}
+
+LEPKKV const void *lepk_kv_get(LepkKv *kv, const void *key, unsigned long key_length, unsigned long *value_length) {
+	Lepk__KvKey probe = { key, key_length };
+	const Lepk__KvValue *value = lepk_ht_find(kv->index, &probe);
+	if (value == NULL) {
+		return NULL;
+	}
+	if (value_length != NULL) {
+		*value_length = value->length;
+	}
+	return value->data;
+}
+
+LEPKKV LepkFileStatus lepk_kv_remove(LepkKv *kv, const void *key, unsigned long key_length) {
+	Lepk__KvKey probe = { key, key_length };
+	if (lepk_ht_find(kv->index, &probe) == NULL) {
+		return LEPK_FILE_STATUS_OK;
+	}
+	/* Logged first, key may point into the pair, and a failed remove leaves it in place. */
+	LepkFileStatus status = lepk__kv_log(kv, LEPK__KV_REMOVE, key, key_length, NULL, 0);
+	if (status != LEPK_FILE_STATUS_OK) {
+		return status;
+	}
+	lepk__kv_erase(kv, &probe);
+	return lepk__kv_mutated(kv);
+}
+
+LEPKKV bool lepk_kv_next(LepkKv *kv, unsigned long *iterator, const void **key, unsigned long *key_length, const void **value, unsigned long *value_length) {
+	if (*iterator >= lepk_ht_count(kv->index)) {
+		return false;
+	}
+
+	const Lepk__KvKey *keys = lepk__ht_keys(kv->index);
+	const Lepk__KvValue *values = lepk__ht_values(kv->index);
+	*key = keys[*iterator].data;
+	*key_length = keys[*iterator].length;
+	*value = values[*iterator].data;
+	*value_length = values[*iterator].length;
+	(*iterator)++;
+	return true;
+}
+
+LEPKKV LepkFileStatus lepk_kv_commit(LepkKv *kv) {
+	kv->uncommitted = 0;
+	if (kv->log == NULL) {
+		return LEPK_FILE_STATUS_WRITE_FAILED;
+	}
+	LepkFileStatus status = kv->durability == LEPK_FILE_DURABILITY_NONE ? lepk_file_writer_flush(kv->log) : lepk_file_writer_sync(kv->log);
+	if (status != LEPK_FILE_STATUS_OK) {
+		return status;
+	}
+
+	uint64_t snapshot_length = kv->has_snapshot ? kv->snapshot.length : 0;
+	uint64_t log_length = lepk_file_writer_offset(kv->log);
+	if (log_length > LEPK_KV_COMPACT_MIN && log_length > snapshot_length) {
+		return lepk_kv_compact(kv);
+	}
+	return LEPK_FILE_STATUS_OK;
+}
+
+LEPKKV LepkFileStatus lepk_kv_compact(LepkKv *kv) {
+	if (kv->log == NULL) {
+		return LEPK_FILE_STATUS_WRITE_FAILED;
+	}
+	size_t count = lepk_ht_count(kv->index);
+	const Lepk__KvKey *keys = lepk__ht_keys(kv->index);
+	const Lepk__KvValue *values = lepk__ht_values(kv->index);
+
+	size_t length = sizeof(Lepk__KvSnapshotHeader);
+	for (size_t i = 0; i < count; i++) {
+		length += 2 * sizeof(uint32_t) + keys[i].length + values[i].length;
+	}
+	char *buffer = malloc(length);
+	if (buffer == NULL) {
+		return LEPK_FILE_STATUS_OUT_OF_MEMORY;
+	}
+
+	Lepk__KvSnapshotHeader header = { LEPK__KV_SNAPSHOT_MAGIC, LEPK__KV_VERSION, kv->generation + 1, count };
+	memcpy(buffer, &header, sizeof(header));
+	size_t offset = sizeof(header);
+	for (size_t i = 0; i < count; i++) {
+		uint32_t lengths[2] = { (uint32_t) keys[i].length, (uint32_t) values[i].length };
+		memcpy(buffer + offset, lengths, sizeof(lengths));
+		offset += sizeof(lengths);
+		if (keys[i].length != 0) {
+			memcpy(buffer + offset, keys[i].data, keys[i].length);
+		}
+		if (values[i].length != 0) {
+			memcpy(buffer + offset + keys[i].length, values[i].data, values[i].length);
+		}
+		offset += keys[i].length + values[i].length;
+	}
+
+	/*
+	 * The snapshot and a new, empty log go in place together. Once the snapshot is, the old log is out of date, its
+	 * generation is older. Failing before that leaves everything as it was, failing after it stops the store logging,
+	 * since appending to the old log would be lost. Whatever is on disk is consistent either way.
+	 */
+	LepkFileGroup *group = lepk_file_group_create(lepk__kv_install_durability(kv));
+	if (group == NULL) {
+		free(buffer);
+		return LEPK_FILE_STATUS_OUT_OF_MEMORY;
+	}
+	Lepk__KvLogHeader log_header = { LEPK__KV_LOG_MAGIC, LEPK__KV_VERSION, kv->generation + 1 };
+	LepkFileStatus status = lepk_file_group_write(group, kv->snapshot_path, buffer, length);
+	if (status == LEPK_FILE_STATUS_OK) {
+		status = lepk_file_group_write(group, kv->log_path, (const char *) &log_header, sizeof(log_header));
+	}
+	free(buffer);
+	if (status != LEPK_FILE_STATUS_OK) {
+		lepk_file_group_destroy(group);
+		return status;
+	}
+	status = lepk_file_group_commit(group);
+	lepk_file_group_destroy(group);
+
+	LepkFileWriter *log = NULL;
+	if (status == LEPK_FILE_STATUS_OK) {
+		log = lepk_file_writer_open(kv->log_path, true, 0, &status);
+	}
+	lepk_file_writer_close(kv->log);
+	kv->log = log;
+	kv->uncommitted = 0;
+	if (log == NULL) {
+		return status;
+	}
+	kv->generation++;
+
+	/* Point a new index into the new snapshot. The current index holds the same pairs, so it stays if that fails. */
+	LepkFileView snapshot;
+	if (lepk_file_map(kv->snapshot_path, LEPK_FILE_ADVICE_RANDOM, &snapshot) != LEPK_FILE_STATUS_OK) {
+		return LEPK_FILE_STATUS_OK;
+	}
+	LepkHt *index = kv->index;
+	kv->index = lepk_ht_create(lepk__kv_hash, lepk__kv_compare, sizeof(Lepk__KvKey), sizeof(Lepk__KvValue));
+	if (!lepk__kv_index_snapshot(kv, &snapshot)) {
+		lepk_ht_destroy(kv->index);
+		kv->index = index;
+		lepk_file_unmap(&snapshot);
+		return LEPK_FILE_STATUS_OK;
+	}
+	lepk__kv_free_index(index);
+	if (kv->has_snapshot) {
+		lepk_file_unmap(&kv->snapshot);
+	}
+	kv->snapshot = snapshot;
+	kv->has_snapshot = true;
+	return LEPK_FILE_STATUS_OK;
+}
+#endif /*LEPK_KV_IMPLEMENTATION*/
+#endif /* LEPK_KV_H */
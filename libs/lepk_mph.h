@@ -0,0 +1,499 @@
+/* Version: 1.0 */
+
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2022 Linus Erik Pontus Kåreblom
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Minimal perfect hashing for static key sets.
+ *
+ * Add:
+ *     #define LEPK_MPH_IMPLEMENTATION
+ * in one C or C++ file, before #include "lepk_mph.h", to create the implementation.
+ *
+ * If LEPK_MPH_STATIC is defined the implementation will be local to a single file only.
+ */
+
+/*
+ * === Documentation ===
+ * Built once from a fixed set of keys, every key maps to its own position in [0, count),
+ * so a lookup is one hash and one probe with no empty slots.
+ * Keys are fixed size and compared byte by byte, pad structs with zeroes.
+ *
+ * Usage:
+ * int keys[3] = { 10, 20, 30 };
+ * const char *names[3] = { "ten", "twenty", "thirty" };
+ * LepkMph *mph = lepk_mph_create(keys, sizeof(int), names, sizeof(const char *), 3);
+ * const char **name = (const char **) lepk_mph_get(mph, &keys[1]);
+ *
+ * Storing and loading, using lepk_file.h:
+ * unsigned long length;
+ * void *image = lepk_mph_serialize(mph, &length);
+ * lepk_file_write("keys.mph", image, length, LEPK_FILE_MODE_BINARY);
+ * char *content = lepk_file_read("keys.mph", NULL);
+ * LepkMph *loaded = lepk_mph_load(content, 0);
+ *
+ * lepk_mph_emit_c turns the same image into C source, so a table built by a tool can be compiled into a program
+ * and loaded with lepk_mph_load(name, sizeof(name)).
+ * The image uses the byte order of the machine that built it.
+ */
+
+#ifndef LEPK_MPH_H
+#define LEPK_MPH_H
+
+#ifndef LEPK_MPH_STATIC
+#define LEPKMPH extern
+#else /* LEPK_MPH_STATIC */
+#define LEPKMPH static
+#endif /* LEPK_MPH_STATIC */
+
+/* Minimal perfect hash function with the keys and data it was built from. */
+typedef struct LepkMph LepkMph;
+
+/* Build from count keys of key_size bytes each and their data, data can be NULL. NULL if keys contain duplicates. */
+LEPKMPH LepkMph *lepk_mph_create(const void *keys, unsigned long key_size, const void *data, unsigned long data_size, unsigned long count);
+/* Destroy a perfect hash. */
+LEPKMPH void lepk_mph_destroy(LepkMph *mph);
+
+/* Amount of keys. */
+LEPKMPH unsigned long lepk_mph_count(const LepkMph *mph);
+/* Position of key in [0, count). Keys outside the set map to some position too. */
+LEPKMPH unsigned long lepk_mph_index(const LepkMph *mph, const void *key);
+/* Data stored for key, NULL if key isn't in the set. */
+LEPKMPH const void *lepk_mph_get(const LepkMph *mph, const void *key);
+
+/* Serialize to a malloc'd image of length bytes. */
+LEPKMPH void *lepk_mph_serialize(const LepkMph *mph, unsigned long *length);
+/* Load a serialized image, the buffer is copied. Length 0 trusts the size stored in the image. NULL if the image is invalid. */
+LEPKMPH LepkMph *lepk_mph_load(const void *buffer, unsigned long length);
+/* Serialize to malloc'd C source declaring "static const unsigned char name[]", length is set to the length of the text. */
+LEPKMPH char *lepk_mph_emit_c(const LepkMph *mph, const char *name, unsigned long *length);
+
+#ifdef LEPK_MPH_TEST
+
+#include <assert.h>
+#include <malloc.h>
+#include <string.h>
+
+static void lepk_mph_test(void) {
+	unsigned long keys[1000];
+	unsigned long data[1000];
+	for (unsigned long i = 0; i < 1000; i++) {
+		keys[i] = i * 7919;
+		data[i] = i;
+	}
+
+	LepkMph *mph = lepk_mph_create(keys, sizeof(unsigned long), data, sizeof(unsigned long), 1000);
+	assert(mph != NULL && lepk_mph_count(mph) == 1000 && "lepk_mph_create failed.");
+
+	char seen[1000] = { 0 };
+	for (unsigned long i = 0; i < 1000; i++) {
+		unsigned long index = lepk_mph_index(mph, &keys[i]);
+		assert(index < 1000 && !seen[index] && "lepk_mph_index isn't minimal and perfect.");
+		seen[index] = 1;
+		assert(*(const unsigned long *) lepk_mph_get(mph, &keys[i]) == i && "lepk_mph_get failed.");
+	}
+	unsigned long missing = 3;
+	assert(lepk_mph_get(mph, &missing) == NULL && "lepk_mph_get found a missing key.");
+
+	unsigned long length;
+	void *image = lepk_mph_serialize(mph, &length);
+	LepkMph *loaded = lepk_mph_load(image, length);
+	assert(loaded != NULL && *(const unsigned long *) lepk_mph_get(loaded, &keys[500]) == 500 && "lepk_mph_load failed.");
+	char *source = lepk_mph_emit_c(loaded, "table", &length);
+	assert(strncmp(source, "static const unsigned char table[", 33) == 0 && "lepk_mph_emit_c failed.");
+
+	free(source);
+	free(image);
+	lepk_mph_destroy(loaded);
+	lepk_mph_destroy(mph);
+
+	keys[1] = keys[0];
+	assert(lepk_mph_create(keys, sizeof(unsigned long), NULL, 0, 1000) == NULL && "lepk_mph_create accepted duplicates.");
+}
+
+#endif /* LEPK_MPH_TEST */
+
+#ifdef LEPK_MPH_IMPLEMENTATION
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#undef LEPKMPH
+#ifndef LEPK_MPH_STATIC
+#define LEPKMPH
+#else /* LEPK_MPH_STATIC */
+#define LEPKMPH static
+#endif /* LEPK_MPH_STATIC */
+
+/* "LMPH" */
+#define LEPK__MPH_MAGIC 0x48504d4cu
+#define LEPK__MPH_VERSION 1
+/* Average keys per bucket. */
+#define LEPK__MPH_BUCKET_SIZE 4
+/* Displacements tried per bucket before starting over with a new seed. */
+#define LEPK__MPH_MAX_DISPLACEMENT (1 << 20)
+
+/* Start of a serialized image, followed by the displacements, keys and data. */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t size;
+	uint64_t count;
+	uint64_t buckets;
+	uint64_t key_size;
+	uint64_t data_size;
+	uint64_t seed;
+} Lepk__MphHeader;
+
+/*
+ * Hash and displace. Keys are spread over count / 4 buckets and every bucket stores a value:
+ *     > 0: displacement mixed into the key's hash, picking a slot for every key in the bucket.
+ *     < 0: bucket has one key, -value - 1 is its slot.
+ *       0: bucket is empty.
+ */
+struct LepkMph {
+	/* The whole image is one allocation starting with the header. */
+	Lepk__MphHeader *header;
+	int32_t *displacements;
+	unsigned char *keys;
+	unsigned char *data;
+};
+
+static uint64_t lepk__mph_mix(uint64_t x) {
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ull;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebull;
+	x ^= x >> 31;
+	return x;
+}
+
+static uint64_t lepk__mph_hash(const void *key, size_t size, uint64_t seed) {
+	const unsigned char *bytes = key;
+	uint64_t hash = seed ^ (size * 0x9e3779b97f4a7c15ull);
+	while (size >= 8) {
+		uint64_t chunk;
+		memcpy(&chunk, bytes, 8);
+		hash = lepk__mph_mix(hash ^ chunk);
+		bytes += 8;
+		size -= 8;
+	}
+	if (size > 0) {
+		uint64_t chunk = 0;
+		memcpy(&chunk, bytes, size);
+		hash = lepk__mph_mix(hash ^ chunk);
+	}
+	return lepk__mph_mix(hash);
+}
+
+/* Map the top 32 bits of x onto [0, n) without a division. */
+static uint64_t lepk__mph_range(uint64_t x, uint64_t n) {
+	return ((x >> 32) * n) >> 32;
+}
+
+static uint64_t lepk__mph_bucket(uint64_t hash, uint64_t buckets) {
+	return lepk__mph_range(hash << 32, buckets);
+}
+
+static uint64_t lepk__mph_slot(uint64_t hash, uint32_t displacement, uint64_t count) {
+	return lepk__mph_range(lepk__mph_mix(hash ^ (displacement * 0x9e3779b97f4a7c15ull)), count);
+}
+
+static size_t lepk__mph_align(size_t size) {
+	return (size + 7) & ~(size_t) 7;
+}
+
+/* Point mph at the sections of the image starting at header. */
+static void lepk__mph_layout(LepkMph *mph, Lepk__MphHeader *header) {
+	unsigned char *image = (unsigned char *) header;
+	size_t displacements = sizeof(Lepk__MphHeader);
+	size_t keys = lepk__mph_align(displacements + header->buckets * sizeof(int32_t));
+	size_t data = lepk__mph_align(keys + header->count * header->key_size);
+
+	mph->header = header;
+	mph->displacements = (int32_t *) (image + displacements);
+	mph->keys = image + keys;
+	mph->data = image + data;
+}
+
+static size_t lepk__mph_image_size(uint64_t count, uint64_t buckets, uint64_t key_size, uint64_t data_size) {
+	size_t size = lepk__mph_align(sizeof(Lepk__MphHeader) + buckets * sizeof(int32_t));
+	size = lepk__mph_align(size + count * key_size);
+	return size + count * data_size;
+}
+
+/*
+ * Try to place every key using seed. Returns 1 on success, 0 if a new seed is needed and -1 on duplicate keys.
+ * slots is filled with the slot of every key.
+ */
+static int lepk__mph_place(const unsigned char *keys, size_t key_size, size_t count, size_t buckets, uint64_t seed, int32_t *displacements, uint32_t *slots) {
+	int result = 0;
+	uint64_t *hashes = malloc(count * sizeof(uint64_t));
+	/* Keys sorted by bucket, bucket i owns members[starts[i]..starts[i + 1]). */
+	size_t *starts = calloc(buckets + 1, sizeof(size_t));
+	uint32_t *members = malloc(count * sizeof(uint32_t));
+	bool *taken = calloc(count, sizeof(bool));
+	uint32_t *order = malloc(buckets * sizeof(uint32_t));
+
+	for (size_t i = 0; i < count; i++) {
+		hashes[i] = lepk__mph_hash(keys + i * key_size, key_size, seed);
+		starts[lepk__mph_bucket(hashes[i], buckets) + 1]++;
+	}
+	size_t largest = 0;
+	for (size_t i = 0; i < buckets; i++) {
+		if (starts[i + 1] > largest) {
+			largest = starts[i + 1];
+		}
+		starts[i + 1] += starts[i];
+	}
+	{
+		size_t *fill = malloc(buckets * sizeof(size_t));
+		memcpy(fill, starts, buckets * sizeof(size_t));
+		for (size_t i = 0; i < count; i++) {
+			members[fill[lepk__mph_bucket(hashes[i], buckets)]++] = i;
+		}
+		free(fill);
+	}
+
+	/* Identical hashes in a bucket can never be separated. */
+	for (size_t b = 0; b < buckets; b++) {
+		for (size_t i = starts[b]; i < starts[b + 1]; i++) {
+			for (size_t j = i + 1; j < starts[b + 1]; j++) {
+				if (hashes[members[i]] != hashes[members[j]]) {
+					continue;
+				}
+				result = memcmp(keys + members[i] * key_size, keys + members[j] * key_size, key_size) == 0 ? -1 : 0;
+				goto done;
+			}
+		}
+	}
+
+	/* Largest buckets first, while most slots are still free. */
+	{
+		size_t *size_starts = calloc(largest + 2, sizeof(size_t));
+		for (size_t b = 0; b < buckets; b++) {
+			size_starts[largest - (starts[b + 1] - starts[b]) + 1]++;
+		}
+		for (size_t i = 0; i <= largest; i++) {
+			size_starts[i + 1] += size_starts[i];
+		}
+		for (size_t b = 0; b < buckets; b++) {
+			order[size_starts[largest - (starts[b + 1] - starts[b])]++] = b;
+		}
+		free(size_starts);
+	}
+
+	size_t free_slot = 0;
+	for (size_t i = 0; i < buckets; i++) {
+		uint32_t b = order[i];
+		size_t size = starts[b + 1] - starts[b];
+
+		if (size == 0) {
+			displacements[b] = 0;
+			continue;
+		}
+
+		/* Single keys go straight into any free slot. */
+		if (size == 1) {
+			while (taken[free_slot]) {
+				free_slot++;
+			}
+			taken[free_slot] = true;
+			slots[members[starts[b]]] = free_slot;
+			displacements[b] = -(int32_t) free_slot - 1;
+			continue;
+		}
+
+		uint32_t displacement = 1;
+		for (; displacement < LEPK__MPH_MAX_DISPLACEMENT; displacement++) {
+			size_t placed = 0;
+			for (; placed < size; placed++) {
+				uint32_t key = members[starts[b] + placed];
+				uint32_t slot = lepk__mph_slot(hashes[key], displacement, count);
+				if (taken[slot]) {
+					break;
+				}
+				taken[slot] = true;
+				slots[key] = slot;
+			}
+			if (placed == size) {
+				break;
+			}
+			/* Undo the partial placement. */
+			for (size_t j = 0; j < placed; j++) {
+				taken[slots[members[starts[b] + j]]] = false;
+			}
+		}
+		if (displacement == LEPK__MPH_MAX_DISPLACEMENT) {
+			goto done;
+		}
+		displacements[b] = displacement;
+	}
+	result = 1;
+
+done:
+	free(hashes);
+	free(starts);
+	free(members);
+	free(taken);
+	free(order);
+	return result;
+}
+
+LEPKMPH LepkMph *lepk_mph_create(const void *keys, unsigned long key_size, const void *data, unsigned long data_size, unsigned long count) {
+	assert(count <= INT32_MAX && "lepk_mph can't hold that many keys.");
+	assert(key_size > 0 && "Key size can't be 0.");
+
+	size_t buckets = count / LEPK__MPH_BUCKET_SIZE + 1;
+	int32_t *displacements = malloc(buckets * sizeof(int32_t));
+	uint32_t *slots = malloc((count > 0 ? count : 1) * sizeof(uint32_t));
+
+	uint64_t seed = 0;
+	for (uint64_t attempt = 1;; attempt++) {
+		seed = lepk__mph_mix(attempt * 0x9e3779b97f4a7c15ull);
+		int result = lepk__mph_place(keys, key_size, count, buckets, seed, displacements, slots);
+		if (result < 0) {
+			free(displacements);
+			free(slots);
+			return NULL;
+		}
+		if (result > 0) {
+			break;
+		}
+	}
+
+	size_t size = lepk__mph_image_size(count, buckets, key_size, data_size);
+	Lepk__MphHeader *header = calloc(1, size);
+	header->magic = LEPK__MPH_MAGIC;
+	header->version = LEPK__MPH_VERSION;
+	header->size = size;
+	header->count = count;
+	header->buckets = buckets;
+	header->key_size = key_size;
+	header->data_size = data_size;
+	header->seed = seed;
+
+	LepkMph *mph = malloc(sizeof(LepkMph));
+	lepk__mph_layout(mph, header);
+	memcpy(mph->displacements, displacements, buckets * sizeof(int32_t));
+	for (size_t i = 0; i < count; i++) {
+		memcpy(mph->keys + slots[i] * key_size, (const unsigned char *) keys + i * key_size, key_size);
+		if (data != NULL) {
+			memcpy(mph->data + slots[i] * data_size, (const unsigned char *) data + i * data_size, data_size);
+		}
+	}
+
+	free(displacements);
+	free(slots);
+	return mph;
+}
+
+LEPKMPH void lepk_mph_destroy(LepkMph *mph) {
+	free(mph->header);
+	free(mph);
+}
+
+LEPKMPH unsigned long lepk_mph_count(const LepkMph *mph) {
+	return mph->header->count;
+}
+
+LEPKMPH unsigned long lepk_mph_index(const LepkMph *mph, const void *key) {
+	const Lepk__MphHeader *header = mph->header;
+	if (header->count == 0) {
+		return 0;
+	}
+
+	uint64_t hash = lepk__mph_hash(key, header->key_size, header->seed);
+	int32_t displacement = mph->displacements[lepk__mph_bucket(hash, header->buckets)];
+	if (displacement < 0) {
+		return -(displacement + 1);
+	}
+	return lepk__mph_slot(hash, displacement, header->count);
+}
+
+LEPKMPH const void *lepk_mph_get(const LepkMph *mph, const void *key) {
+	if (mph->header->count == 0) {
+		return NULL;
+	}
+
+	unsigned long index = lepk_mph_index(mph, key);
+	if (memcmp(mph->keys + index * mph->header->key_size, key, mph->header->key_size) != 0) {
+		return NULL;
+	}
+	return mph->data + index * mph->header->data_size;
+}
+
+LEPKMPH void *lepk_mph_serialize(const LepkMph *mph, unsigned long *length) {
+	void *image = malloc(mph->header->size);
+	memcpy(image, mph->header, mph->header->size);
+	*length = mph->header->size;
+	return image;
+}
+
+LEPKMPH LepkMph *lepk_mph_load(const void *buffer, unsigned long length) {
+	Lepk__MphHeader header;
+	if (length != 0 && length < sizeof(Lepk__MphHeader)) {
+		return NULL;
+	}
+	memcpy(&header, buffer, sizeof(Lepk__MphHeader));
+
+	if (header.magic != LEPK__MPH_MAGIC || header.version != LEPK__MPH_VERSION ||
+			header.size != lepk__mph_image_size(header.count, header.buckets, header.key_size, header.data_size) ||
+			(length != 0 && length < header.size)) {
+		return NULL;
+	}
+
+	Lepk__MphHeader *image = malloc(header.size);
+	memcpy(image, buffer, header.size);
+
+	LepkMph *mph = malloc(sizeof(LepkMph));
+	lepk__mph_layout(mph, image);
+	return mph;
+}
+
+LEPKMPH char *lepk_mph_emit_c(const LepkMph *mph, const char *name, unsigned long *length) {
+	const unsigned char *image = (const unsigned char *) mph->header;
+	size_t size = mph->header->size;
+
+	/* "0xff," per byte, a tab and newline per 16 bytes, and the declaration. */
+	size_t cap = size * 5 + (size / 16 + 1) * 2 + strlen(name) + 128;
+	char *source = malloc(cap);
+	size_t used = sprintf(source, "static const unsigned char %s[%lu] = {", name, (unsigned long) size);
+
+	for (size_t i = 0; i < size; i++) {
+		if (i % 16 == 0) {
+			used += sprintf(source + used, "\n\t");
+		}
+		used += sprintf(source + used, "0x%02x,", image[i]);
+	}
+	used += sprintf(source + used, "\n};\n");
+
+	*length = used;
+	return source;
+}
+#endif /*LEPK_MPH_IMPLEMENTATION*/
+#endif /* LEPK_MPH_H */
@@ -0,0 +1,448 @@
+/* Version: 1.0 */
+
+/*
+ * MIT License
+ * 
+ * Copyright (c) 2022 Linus Erik Pontus Kåreblom
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Hash set.
+ *
+ * Add:
+ *     #define LEPK_SET_IMPLEMENTATION
+ * in one C or C++ file, before #include "lepk_set.h", to create the implementation.
+ *
+ * If LEPK_SET_STATIC is defined the implementation will be local to a single file only.
+ *
+ * Use:
+ *     #define LEPK_SET_FINGERPRINT_BITS [8 or 16]
+ * to define how many hash bits are kept per slot. 16 filters more compares at twice the overhead.
+ *     #define LEPK_SET_MAX_LOAD [float]
+ * to define the load factor sets resize at.
+ *
+ * Uses the hashing and compare callbacks from lepk_ht.h.
+ */
+
+/*
+ * === Documentation ===
+ * Keys are stored inline in one open addressed array, next to a fingerprint per slot,
+ * so a set costs key_size plus 1 or 2 bytes per slot and nothing else.
+ * Full hashes aren't kept, growing calls the hashing function again for every key.
+ *
+ * Usage:
+ * LepkSet *set = lepk_set_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int));
+ * lepk_set_add(set, 4);
+ * if (lepk_set_contains(set, 4)) { ... }
+ *
+ * Iterating, in no particular order:
+ * unsigned long iterator = 0;
+ * const int *key;
+ * while ((key = lepk_set_next(set, &iterator)) != NULL) { ... }
+ *
+ * The set algebra functions modify the first set in place. Both sets must use the same key size and callbacks.
+ */
+
+#ifndef LEPK_SET_H
+#define LEPK_SET_H
+
+#ifndef LEPK_SET_STATIC
+#define LEPKSET extern
+#else /* LEPK_SET_STATIC */
+#define LEPKSET static
+#endif /* LEPK_SET_STATIC */
+
+#include <stdbool.h>
+
+#include "lepk_ht.h"
+
+/* Hash set. */
+typedef struct LepkSet LepkSet;
+
+/* Create a hash set. */
+LEPKSET LepkSet *lepk_set_create(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size);
+/* Destroy a hash set. */
+LEPKSET void lepk_set_destroy(LepkSet *set);
+
+/* Retrieve key count from set. */
+LEPKSET unsigned long lepk_set_count(const LepkSet *set);
+/* Memory held by the set in bytes. */
+LEPKSET unsigned long lepk_set_bytes(const LepkSet *set);
+/* Make room for capacity keys in total without resizing. */
+LEPKSET void lepk_set_reserve(LepkSet *set, unsigned long capacity);
+/* Remove every key, keeping the memory around for reuse. */
+LEPKSET void lepk_set_clear(LepkSet *set);
+
+/* Add key to set. Returns false if it was already there. */
+LEPKSET bool lepk__set_add(LepkSet *set, const void *key);
+/* Check if key is in set. */
+LEPKSET bool lepk__set_contains(const LepkSet *set, const void *key);
+/* Remove key from set. Returns false if it wasn't there. */
+LEPKSET bool lepk__set_remove(LepkSet *set, const void *key);
+/* Next key after iterator, which starts at 0. NULL when every key has been visited. */
+LEPKSET const void *lepk_set_next(const LepkSet *set, unsigned long *iterator);
+
+/* Add every key in other to set. */
+LEPKSET void lepk_set_union(LepkSet *set, const LepkSet *other);
+/* Remove every key from set that isn't in other. */
+LEPKSET void lepk_set_intersect(LepkSet *set, const LepkSet *other);
+/* Remove every key in other from set. */
+LEPKSET void lepk_set_difference(LepkSet *set, const LepkSet *other);
+
+#define lepk_set_add(set, key) lepk__set_add(set, &(__typeof__(key)) { key })
+#define lepk_set_contains(set, key) lepk__set_contains(set, &(__typeof__(key)) { key })
+#define lepk_set_remove(set, key) lepk__set_remove(set, &(__typeof__(key)) { key })
+
+#ifdef LEPK_SET_TEST
+
+#include <assert.h>
+
+static void lepk_set_test(void) {
+	LepkSet *set = lepk_set_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int));
+	LepkSet *other = lepk_set_create(lepk_ht_hash_generic, lepk_ht_compare_generic, sizeof(int));
+	for (int i = 0; i < 1000; i++) {
+		assert(lepk_set_add(set, i) && "lepk_set_add failed.");
+		lepk_set_add(other, i * 2);
+	}
+	assert(!lepk_set_add(set, 10) && lepk_set_count(set) == 1000 && "lepk_set_add added a duplicate.");
+	for (int i = 0; i < 1000; i += 2) {
+		assert(lepk_set_remove(set, i) && "lepk_set_remove failed.");
+	}
+	assert(!lepk_set_remove(set, 0) && lepk_set_count(set) == 500 && "lepk_set_remove failed.");
+	for (int i = 0; i < 1000; i++) {
+		assert(lepk_set_contains(set, i) == (i % 2 == 1) && "lepk_set_contains failed.");
+	}
+
+	unsigned long iterator = 0;
+	const int *key;
+	long sum = 0;
+	while ((key = lepk_set_next(set, &iterator)) != NULL) {
+		sum += *key;
+	}
+	assert(sum == 250000 && "lepk_set_next failed.");
+
+	/* set: odd numbers below 1000, other: even numbers below 2000. */
+	lepk_set_union(set, other);
+	assert(lepk_set_count(set) == 1500 && lepk_set_contains(set, 1998) && lepk_set_contains(set, 3) && "lepk_set_union failed.");
+	lepk_set_difference(set, other);
+	assert(lepk_set_count(set) == 500 && !lepk_set_contains(set, 2) && lepk_set_contains(set, 3) && "lepk_set_difference failed.");
+	lepk_set_add(set, 4);
+	lepk_set_intersect(set, other);
+	assert(lepk_set_count(set) == 1 && lepk_set_contains(set, 4) && "lepk_set_intersect failed.");
+	assert(lepk_set_bytes(other) >= 1000 * sizeof(int) && "lepk_set_bytes failed.");
+
+	lepk_set_clear(other);
+	assert(lepk_set_count(other) == 0 && !lepk_set_contains(other, 4) && "lepk_set_clear failed.");
+	lepk_set_destroy(other);
+	lepk_set_destroy(set);
+}
+
+#endif /* LEPK_SET_TEST */
+
+#ifdef LEPK_SET_IMPLEMENTATION
+#include <malloc.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#undef LEPKSET
+#ifndef LEPK_SET_STATIC
+#define LEPKSET
+#else /* LEPK_SET_STATIC */
+#define LEPKSET static
+#endif /* LEPK_SET_STATIC */
+
+#ifndef LEPK_SET_FINGERPRINT_BITS
+#define LEPK_SET_FINGERPRINT_BITS 8
+#endif /* LEPK_SET_FINGERPRINT_BITS */
+
+#ifndef LEPK_SET_MAX_LOAD
+#define LEPK_SET_MAX_LOAD 0.8f
+#endif /* LEPK_SET_MAX_LOAD */
+
+#if LEPK_SET_FINGERPRINT_BITS == 8
+typedef uint8_t Lepk__SetTag;
+#elif LEPK_SET_FINGERPRINT_BITS == 16
+typedef uint16_t Lepk__SetTag;
+#else /* LEPK_SET_FINGERPRINT_BITS */
+#error "LEPK_SET_FINGERPRINT_BITS must be 8 or 16."
+#endif /* LEPK_SET_FINGERPRINT_BITS */
+
+/* Smallest amount of slots. */
+#define LEPK__SET_MIN_CAP 8
+
+/* Slot never used, ends a probe sequence. */
+#define LEPK__SET_TAG_EMPTY 0
+/* Slot removed, probe sequences continue past it. */
+#define LEPK__SET_TAG_DEAD 1
+/* Fingerprints below this are moved up so they can't be mistaken for the markers above. */
+#define LEPK__SET_TAG_MIN 2
+
+/*
+ * Open addressed with linear probing. Every slot has a fingerprint of its key's hash,
+ * so probing only calls the compare function on keys that are likely equal.
+ */
+struct LepkSet {
+	LepkHtHash hash;
+	LepkHtCompare compare;
+
+	size_t key_size;
+	size_t count;
+
+	size_t cap;
+	/* Alive and dead slots. */
+	size_t used;
+	/* Fingerprint per slot, the same allocation continues with the keys. */
+	Lepk__SetTag *tags;
+	unsigned char *keys;
+};
+
+static size_t lepk__set_keys_offset(size_t cap) {
+	return (cap * sizeof(Lepk__SetTag) + 15) & ~(size_t) 15;
+}
+
+static size_t lepk__set_cap(size_t capacity) {
+	size_t cap = LEPK__SET_MIN_CAP;
+	while ((size_t) (cap * LEPK_SET_MAX_LOAD) < capacity) {
+		cap *= 2;
+	}
+	return cap;
+}
+
+static void lepk__set_alloc(LepkSet *set, size_t cap) {
+	size_t offset = lepk__set_keys_offset(cap);
+	unsigned char *block = malloc(offset + cap * set->key_size);
+	memset(block, 0, cap * sizeof(Lepk__SetTag));
+
+	set->tags = (Lepk__SetTag *) block;
+	set->keys = block + offset;
+	set->cap = cap;
+	set->used = 0;
+}
+
+/* Fingerprint from the top bits of the mixed hash, the slot is picked by the bottom bits. */
+static Lepk__SetTag lepk__set_tag(size_t hash) {
+	uint64_t mixed = (uint64_t) hash * 0x9e3779b97f4a7c15ull;
+	Lepk__SetTag tag = (Lepk__SetTag) (mixed >> (64 - LEPK_SET_FINGERPRINT_BITS));
+	return tag < LEPK__SET_TAG_MIN ? tag + LEPK__SET_TAG_MIN : tag;
+}
+
+/*
+ * Slot holding key, cap if key isn't in the set.
+ * If free_slot isn't NULL it's set to the first slot the key could be inserted at.
+ */
+static size_t lepk__set_find(const LepkSet *set, const void *key, size_t hash, size_t *free_slot) {
+	Lepk__SetTag tag = lepk__set_tag(hash);
+	size_t slot = hash & (set->cap - 1);
+	size_t first_dead = set->cap;
+
+	for (;;) {
+		Lepk__SetTag current = set->tags[slot];
+
+		if (current == LEPK__SET_TAG_EMPTY) {
+			if (free_slot != NULL) {
+				*free_slot = first_dead != set->cap ? first_dead : slot;
+			}
+			return set->cap;
+		}
+		if (current == LEPK__SET_TAG_DEAD) {
+			if (first_dead == set->cap) {
+				first_dead = slot;
+			}
+		} else if (current == tag && set->compare(key, set->keys + slot * set->key_size, set->key_size) == 0) {
+			return slot;
+		}
+
+		slot = (slot + 1) & (set->cap - 1);
+	}
+}
+
+/* Move every key into a new array of cap slots, dropping dead slots. */
+static void lepk__set_rehash(LepkSet *set, size_t cap) {
+	Lepk__SetTag *old_tags = set->tags;
+	unsigned char *old_keys = set->keys;
+	size_t old_cap = set->cap;
+
+	lepk__set_alloc(set, cap);
+	for (size_t i = 0; i < old_cap; i++) {
+		if (old_tags[i] < LEPK__SET_TAG_MIN) {
+			continue;
+		}
+
+		const unsigned char *key = old_keys + i * set->key_size;
+		size_t hash = set->hash(key, set->key_size);
+		size_t slot = hash & (cap - 1);
+		while (set->tags[slot] != LEPK__SET_TAG_EMPTY) {
+			slot = (slot + 1) & (cap - 1);
+		}
+
+		set->tags[slot] = old_tags[i];
+		memcpy(set->keys + slot * set->key_size, key, set->key_size);
+	}
+	set->used = set->count;
+
+	free(old_tags);
+}
+
+/* Remove the key in slot. If nothing probes past it, it and any dead slots before it become empty again. */
+static void lepk__set_erase(LepkSet *set, size_t slot) {
+	set->count--;
+	if (set->tags[(slot + 1) & (set->cap - 1)] != LEPK__SET_TAG_EMPTY) {
+		set->tags[slot] = LEPK__SET_TAG_DEAD;
+		return;
+	}
+
+	do {
+		set->tags[slot] = LEPK__SET_TAG_EMPTY;
+		set->used--;
+		slot = (slot - 1) & (set->cap - 1);
+	} while (set->tags[slot] == LEPK__SET_TAG_DEAD);
+}
+
+LEPKSET LepkSet *lepk_set_create(LepkHtHash hash, LepkHtCompare compare, unsigned long key_size) {
+	LepkSet *set = malloc(sizeof(LepkSet));
+
+	set->hash = hash;
+	set->compare = compare;
+	set->key_size = key_size;
+	set->count = 0;
+	lepk__set_alloc(set, LEPK__SET_MIN_CAP);
+
+	return set;
+}
+
+LEPKSET void lepk_set_destroy(LepkSet *set) {
+	free(set->tags);
+	free(set);
+}
+
+LEPKSET unsigned long lepk_set_count(const LepkSet *set) {
+	return set->count;
+}
+
+LEPKSET unsigned long lepk_set_bytes(const LepkSet *set) {
+	return sizeof(LepkSet) + lepk__set_keys_offset(set->cap) + set->cap * set->key_size;
+}
+
+LEPKSET void lepk_set_reserve(LepkSet *set, unsigned long capacity) {
+	size_t cap = lepk__set_cap(capacity);
+	if (cap > set->cap) {
+		lepk__set_rehash(set, cap);
+	}
+}
+
+LEPKSET void lepk_set_clear(LepkSet *set) {
+	memset(set->tags, 0, set->cap * sizeof(Lepk__SetTag));
+	set->count = 0;
+	set->used = 0;
+}
+
+LEPKSET bool lepk__set_add(LepkSet *set, const void *key) {
+	size_t hash = set->hash(key, set->key_size);
+	size_t slot;
+	if (lepk__set_find(set, key, hash, &slot) != set->cap) {
+		return false;
+	}
+
+	/* Only new keys rehash. With half or more of the used slots dead, dropping them frees enough room. */
+	if ((size_t) (set->cap * LEPK_SET_MAX_LOAD) <= set->used) {
+		lepk__set_rehash(set, set->count * 2 >= set->used ? set->cap * 2 : set->cap);
+		lepk__set_find(set, key, hash, &slot);
+	}
+
+	if (set->tags[slot] == LEPK__SET_TAG_EMPTY) {
+		set->used++;
+	}
+	set->tags[slot] = lepk__set_tag(hash);
+	memcpy(set->keys + slot * set->key_size, key, set->key_size);
+	set->count++;
+	return true;
+}
+
+LEPKSET bool lepk__set_contains(const LepkSet *set, const void *key) {
+	return lepk__set_find(set, key, set->hash(key, set->key_size), NULL) != set->cap;
+}
+
+LEPKSET bool lepk__set_remove(LepkSet *set, const void *key) {
+	size_t slot = lepk__set_find(set, key, set->hash(key, set->key_size), NULL);
+	if (slot == set->cap) {
+		return false;
+	}
+
+	lepk__set_erase(set, slot);
+	return true;
+}
+
+LEPKSET const void *lepk_set_next(const LepkSet *set, unsigned long *iterator) {
+	for (size_t i = *iterator; i < set->cap; i++) {
+		if (set->tags[i] >= LEPK__SET_TAG_MIN) {
+			*iterator = i + 1;
+			return set->keys + i * set->key_size;
+		}
+	}
+
+	*iterator = set->cap;
+	return NULL;
+}
+
+LEPKSET void lepk_set_union(LepkSet *set, const LepkSet *other) {
+	assert(set->key_size == other->key_size && "Sets must have the same key size.");
+
+	lepk_set_reserve(set, set->count + other->count);
+	for (size_t i = 0; i < other->cap; i++) {
+		if (other->tags[i] >= LEPK__SET_TAG_MIN) {
+			lepk__set_add(set, other->keys + i * other->key_size);
+		}
+	}
+}
+
+LEPKSET void lepk_set_intersect(LepkSet *set, const LepkSet *other) {
+	assert(set->key_size == other->key_size && "Sets must have the same key size.");
+
+	/* Backwards, so runs of removed keys ending in an empty slot are emptied in one pass. */
+	for (size_t i = set->cap; i-- > 0;) {
+		if (set->tags[i] >= LEPK__SET_TAG_MIN && !lepk__set_contains(other, set->keys + i * set->key_size)) {
+			lepk__set_erase(set, i);
+		}
+	}
+}
+
+LEPKSET void lepk_set_difference(LepkSet *set, const LepkSet *other) {
+	assert(set->key_size == other->key_size && "Sets must have the same key size.");
+
+	/* Walk whichever set is smaller. */
+	if (other->count < set->count) {
+		for (size_t i = 0; i < other->cap; i++) {
+			if (other->tags[i] >= LEPK__SET_TAG_MIN) {
+				lepk__set_remove(set, other->keys + i * other->key_size);
+			}
+		}
+		return;
+	}
+
+	for (size_t i = set->cap; i-- > 0;) {
+		if (set->tags[i] >= LEPK__SET_TAG_MIN && lepk__set_contains(other, set->keys + i * set->key_size)) {
+			lepk__set_erase(set, i);
+		}
+	}
+}
+#endif /*LEPK_SET_IMPLEMENTATION*/
+#endif /* LEPK_SET_H */
@@ -1,3 +1,7 @@
+/* lepk_file's implementation needs POSIX declarations and a 64 bit off_t, which have to be asked for before any system header. */
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
 #define LEPK_DA_IMPLEMENTATION
 #define LEPK_DA_TEST
 #include "lepk_da.h"
@@ -10,6 +14,42 @@
 #define LEPK_HT_TEST
 #include "lepk_ht.h"
 
+#define LEPK_CHT_IMPLEMENTATION
+#define LEPK_CHT_TEST
+#include "lepk_cht.h"
+
+#define LEPK_INTERN_IMPLEMENTATION
+#define LEPK_INTERN_TEST
+#include "lepk_intern.h"
+
+#define LEPK_MPH_IMPLEMENTATION
+#define LEPK_MPH_TEST
+#include "lepk_mph.h"
+
+#define LEPK_SET_IMPLEMENTATION
+#define LEPK_SET_TEST
+#include "lepk_set.h"
+
+#define LEPK_CACHE_IMPLEMENTATION
+#define LEPK_CACHE_TEST
+#include "lepk_cache.h"
+
+#define LEPK_FILTER_IMPLEMENTATION
+#define LEPK_FILTER_TEST
+#include "lepk_filter.h"
+
+#define LEPK_BT_IMPLEMENTATION
+#define LEPK_BT_TEST
+#include "lepk_bt.h"
+
+#define LEPK_ART_IMPLEMENTATION
+#define LEPK_ART_TEST
+#include "lepk_art.h"
+
+#define LEPK_KV_IMPLEMENTATION
+#define LEPK_KV_TEST
+#include "lepk_kv.h"
+
 /* #define LEPK_WINDOW_IMPLEMENTATION */
 /* #include "lepk_window.h" */
 
@@ -27,6 +67,15 @@ int main(void) {
 	lepk_da_test();
 	lepk_file_test();
 	lepk_ht_test();
+	lepk_cht_test();
+	lepk_intern_test();
+	lepk_mph_test();
+	lepk_set_test();
+	lepk_cache_test();
+	lepk_filter_test();
+	lepk_bt_test();
+	lepk_art_test();
+	lepk_kv_test();
 
 	/* LepkWindow *window = lepk_window_create(800, 600, "Linux Window", true); */
 	/* lepk_window_callback_resize(window, resize_callback); */